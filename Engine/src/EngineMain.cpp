@@ -1,12 +1,44 @@
 #include "EngineMain.h"
 
+#include <filesystem>
+
 using namespace engine;
 
+namespace
+{
+	using LoopClock = std::chrono::steady_clock;
+
+	double ElapsedMs(LoopClock::time_point from_, LoopClock::time_point to_)
+	{
+		return std::chrono::duration<double, std::milli>(to_ - from_).count();
+	}
+}
+
 void Engine::Initiailize()
 {
-	m_environment_manager = std::make_shared<environment::EnvironmentManager>(800, 600, m_app_name, environment::WINDOWED);
-	m_graphics_manager = std::make_shared<graphics::GraphicsManager>(m_environment_manager, 2);
-	m_sound_manager = std::make_shared<sound::SoundManager>();
+	// Opening only validates the table of contents, entries are paged in when an asset is created
+	if (std::filesystem::exists(ASSET_PACKAGE_FILE))
+	{
+		try
+		{
+			m_package = std::make_shared<memory::Package>(ASSET_PACKAGE_FILE);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Asset package ignored, loading loose files: " << e.what() << std::endl;
+			m_package.reset();
+		}
+	}
+
+	m_environment_manager = std::make_shared<environment::EnvironmentManager>(800, 600, m_app_name, m_window_type);
+	m_graphics_manager = std::make_shared<graphics::GraphicsManager>(m_environment_manager, MAX_FRAMES_IN_FLIGHT, m_package);
+	m_sound_manager = std::make_shared<sound::SoundManager>(m_package);
+	m_asset_loader = std::make_unique<asset::Loader>(m_package.get());
+	m_asset_registry = std::make_unique<asset::Registry>(*m_asset_loader, *m_graphics_manager);
+
+	m_frame_time_metric = &profiling::Metrics().AddHistogram("engine_frame_time_seconds", "CPU time of a rendered frame",
+		{ 0.001, 0.002, 0.004, 0.008, 0.0167, 0.0333, 0.0667, 0.1, 0.25 });
+	m_frame_jitter_metric = &profiling::Metrics().AddGauge("engine_frame_jitter_seconds", "Standard deviation of the frame interval over the last frames");
 
 	m_initialized = true;
 }
@@ -14,22 +46,148 @@ void Engine::Initiailize()
 int Engine::Loop()
 {
 	// If engine was not initialized successfully exit the loop
-	if (!m_initialized)
+	if (!m_initialized || !m_graphics_manager->IsInitialized())
 		return EXIT_CODE_FAILURE;
 
-	if (!m_environment_manager->IsWindowCreated())
-		return EXIT_CODE_OK;
+	profiling::SetThreadName("Main");
 
 	while (!m_environment_manager->ShouldFinish() && !m_should_finish)
 	{
+		// Captures are started and finished between frames so no frame zone is cut in half
+		if (m_profile_frames == 0 && profiling::IsCapturing())
+			FinishProfileCapture();
+		else if (m_profile_frames > 0 && !profiling::IsCapturing())
+			profiling::StartCapture();
+
+		{
+			PROFILE_SCOPE("FramePacing");
+			m_frame_pacer.BeginFrame();
+		}
+
+		PROFILE_SCOPE("Frame");
+		LoopClock::time_point stage_start[profiling::StageCount + 1];
+		uint64_t allocations_start = memory::ThreadAllocationCount();
+		m_frame_arenas.NextFrame();
+
 		// Get key press events, mouse move events, window size change events etc.
-		m_environment_manager->ProcessMessages();
+		stage_start[profiling::StageProcessMessages] = LoopClock::now();
+		m_environment_manager->ProcessMessages(m_asset_loader->InFlight() > 0);
+
+		// Nothing is visible while minimized, ProcessMessages already slept until the next event.
+		// Loads keep finishing meanwhile, their main thread steps and uploads need no frame
+		if (m_environment_manager->IsMinimized())
+		{
+			m_asset_loader->ResumeMainThread();
+			m_asset_registry->Update();
+			continue;
+		}
+
+		stage_start[profiling::StageBeginFrame] = LoopClock::now();
 		m_graphics_manager->BeginFrame();
-		FrameAction();
+		stage_start[profiling::StageFrameAction] = LoopClock::now();
+		{
+			PROFILE_SCOPE("FrameAction");
+			m_asset_loader->ResumeMainThread(); // Frame boundary, finished loads are visible to FrameAction
+			m_asset_registry->Update();
+			FrameAction();
+			m_sound_manager->UpdateVoices(); // Sound work is timed as part of the FrameAction stage
+		}
+		stage_start[profiling::StageEndFrame] = LoopClock::now();
 		m_graphics_manager->EndFrame();
+		stage_start[profiling::StageCount] = LoopClock::now();
+		m_last_frame_allocations = memory::ThreadAllocationCount() - allocations_start;
+
+		m_environment_manager->Input()->MarkPresented();
+		m_frame_time_metric->Observe(ElapsedMs(stage_start[0], stage_start[profiling::StageCount]) / 1000.0);
+		m_frame_pacer.EndFrame();
+		m_frame_jitter_metric->Set(m_frame_pacer.Stats().jitter_ms / 1000.0);
+
+		if (m_profile_frames > 0)
+			m_profile_frames--;
+
+		if (m_benchmark)
+		{
+			profiling::FrameTiming timing;
+			timing.cpu_frame_ms = ElapsedMs(stage_start[0], stage_start[profiling::StageCount]);
+			for (size_t i = 0; i < profiling::StageCount; i++)
+				timing.stage_ms[i] = ElapsedMs(stage_start[i], stage_start[i + 1]);
+			timing.gpu_frame_ms = m_graphics_manager->LastGpuFrameTime();
+			timing.heap_allocations = memory::ALLOCATION_COUNTING ? static_cast<int64_t>(m_last_frame_allocations) : -1;
+
+			m_benchmark->RecordFrame(timing);
+			if (m_benchmark->Finished())
+				break;
+		}
 	}
 
+	// Loads in flight finish while the game they report to still exists
+	m_asset_loader->WaitIdle();
 	m_graphics_manager->WaitDevice();
 
+	if (profiling::IsCapturing())
+		FinishProfileCapture();
+
+	if (m_benchmark)
+		return FinishBenchmark();
+
+	return EXIT_CODE_OK;
+}
+
+void Engine::SetPresentPolicy(graphics::PresentPolicy policy_, double frames_per_second_)
+{
+	m_graphics_manager->SetPresentPolicy(policy_);
+
+	double refresh_rate = static_cast<double>(m_environment_manager->Window().refresh_rate);
+	switch (policy_)
+	{
+	case graphics::PresentVsync:
+	case graphics::PresentUncapped:
+		m_frame_pacer.SetTargetFrameRate(0.0);
+		m_frame_pacer.SetLowLatency(false);
+		break;
+
+	case graphics::PresentLowLatency:
+		m_frame_pacer.SetTargetFrameRate(frames_per_second_ > 0.0 ? frames_per_second_ : refresh_rate);
+		m_frame_pacer.SetLowLatency(true);
+		break;
+
+	case graphics::PresentCapped:
+		m_frame_pacer.SetTargetFrameRate(frames_per_second_ > 0.0 ? frames_per_second_ : refresh_rate);
+		m_frame_pacer.SetLowLatency(false);
+		break;
+	}
+}
+
+void Engine::CaptureProfile(const std::string& file_name_, size_t frames_)
+{
+	m_profile_file = file_name_;
+	m_profile_frames = frames_;
+}
+
+void Engine::FinishProfileCapture()
+{
+	profiling::StopCapture();
+	m_profile_frames = 0;
+	if (!profiling::WriteChromeTrace(m_profile_file))
+		std::cerr << "Unable to write profile trace: " << m_profile_file << std::endl;
+}
+
+int Engine::FinishBenchmark()
+{
+	try
+	{
+		m_benchmark->WriteReport();
+		if (!m_benchmark->CompareWithBaseline(std::cout))
+		{
+			std::cerr << "Benchmark regressed beyond " << m_benchmark->Settings().regression_threshold * 100.0 << "% of the baseline" << std::endl;
+			return EXIT_CODE_REGRESSION;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_CODE_FAILURE;
+	}
+
 	return EXIT_CODE_OK;
 }
@@ -1,33 +1,70 @@
 #pragma once
 
 #include <memory>
+#include <iostream>
 
 #include "environment/EnvironmentMain.h"
 #include "environment/InputMain.h"
 #include "graphics/GraphicsMain.h"
 #include "sound/SoundMain.h"
+#include "asset/AssetLoader.h"
+#include "asset/AssetRegistry.h"
+#include "EnginePacing.h"
+#include "ecs/EcsWorld.h"
+#include "ecs/EcsScheduler.h"
+#include "memory/MemoryArena.h"
+#include "memory/MemoryCounting.h"
+#include "memory/MemoryPackage.h"
+#include "profiling/ProfilingBenchmark.h"
+#include "profiling/ProfilingZones.h"
+#include "profiling/ProfilingMetrics.h"
 
 namespace engine
 {
 
 	constexpr int EXIT_CODE_OK = 0;
 	constexpr int EXIT_CODE_FAILURE = -1;
+	constexpr int EXIT_CODE_REGRESSION = 2; // Benchmark run slower than its baseline
+
+	constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+	constexpr size_t FRAME_ARENA_SIZE = 1 << 20; // Initial size, an arena grows to the peak frame usage
+	constexpr const char* ASSET_PACKAGE_FILE = "assets.pack"; // Mapped at startup if present, assets it lacks are read from loose files
 
 	class Engine
 	{
 		// VARIABLES
 	private:
 		bool m_initialized = false;
+		std::shared_ptr<memory::Package> m_package;
 		std::shared_ptr<graphics::GraphicsManager> m_graphics_manager;
 		std::shared_ptr<sound::SoundManager> m_sound_manager;
 		std::shared_ptr<environment::EnvironmentManager> m_environment_manager;
+		std::unique_ptr<asset::Loader> m_asset_loader; // After the managers, loads in flight finish while they still exist
+		std::unique_ptr<asset::Registry> m_asset_registry; // After the loader, its assets are unloaded before the loader stops
 
 		std::string m_app_name;
+		environment::WindowType m_window_type = environment::WINDOWED; // NO_WINDOW renders headless into offscreen images
 		bool m_should_finish = false;
 
+		ecs::World m_world;
+		ecs::Scheduler m_scheduler{ m_world };
+
+		FramePacer m_frame_pacer;
+		memory::FrameArenas m_frame_arenas{ MAX_FRAMES_IN_FLIGHT, FRAME_ARENA_SIZE };
+		uint64_t m_last_frame_allocations = 0; // Heap allocations of the last frame on the loop thread, debug builds only
+		profiling::Gauge* m_frame_jitter_metric = nullptr;
+
+		std::unique_ptr<profiling::Benchmark> m_benchmark; // Set while a benchmark run is active
+		std::string m_profile_file; // Chrome trace written when the requested profile frames are captured
+		size_t m_profile_frames = 0; // Frames left to capture
+
+		std::unique_ptr<profiling::MetricsServer> m_metrics_server;
+		profiling::Histogram* m_frame_time_metric = nullptr;
+
 		// CONSTRUCTORS/DESTRUCTORS
 	public:
 		Engine(const std::string& app_name_) : m_app_name(app_name_) { Initiailize(); }
+		Engine(const std::string& app_name_, environment::WindowType window_type_) : m_app_name(app_name_), m_window_type(window_type_) { Initiailize(); }
 		Engine() : m_app_name("default app") { Initiailize(); }
 		virtual ~Engine() { /* Shutdown(); */ };
 
@@ -36,19 +73,45 @@ namespace engine
 		void Initiailize();
 		void Shutdown();
 
+		int FinishBenchmark();
+		void FinishProfileCapture();
+
 	protected:
 		virtual void FrameAction() = 0;
 
 		std::shared_ptr<graphics::GraphicsManager> Graphics() { return m_graphics_manager; }
 		std::shared_ptr<sound::SoundManager> Sound() { return m_sound_manager; }
 		std::shared_ptr<environment::EnvironmentManager> Environment() { return m_environment_manager; }
+		asset::Loader& Assets() { return *m_asset_loader; }
+		asset::Registry& Registry() { return *m_asset_registry; }
+
+		ecs::World& World() { return m_world; }
+		ecs::Scheduler& Systems() { return m_scheduler; }
 
 		std::string AppName() { return m_app_name; }
 
 		void SetShouldFinish(bool state_) { m_should_finish = state_; }
 
+		// Transient memory for the current frame, valid until the frame slot is reused MAX_FRAMES_IN_FLIGHT frames later
+		memory::LinearArena& FrameArena() { return m_frame_arenas.Arena(); }
+		std::pmr::memory_resource* FrameMemory() { return m_frame_arenas.Resource(); }
+
 	public:
 		int Loop();
+
+		void RecordInput(const std::string& file_name_) { m_environment_manager->Input()->StartRecording(file_name_); }
+		void ReplayInput(const std::string& file_name_) { m_environment_manager->Input()->StartReplay(file_name_); }
+		// Loop exits after the configured frames, writes the report and returns EXIT_CODE_REGRESSION if the baseline is exceeded
+		void RunBenchmark(const profiling::BenchmarkSettings& settings_) { m_benchmark = std::make_unique<profiling::Benchmark>(settings_); }
+		// Captures profile zones of the next frames_ frames and writes them as a Chrome trace
+		void CaptureProfile(const std::string& file_name_, size_t frames_);
+		// Vsync and uncapped are not limited, low latency is paced to frames_per_second_ (monitor refresh rate if 0)
+		// and samples input just in time, capped is limited to frames_per_second_
+		void SetPresentPolicy(graphics::PresentPolicy policy_, double frames_per_second_ = 0.0);
+		FramePacingStats FramePacing() const { return m_frame_pacer.Stats(); }
+		uint64_t LastFrameAllocations() const { return m_last_frame_allocations; }
+		// Serves all registered metrics in the Prometheus text format on http://127.0.0.1:port_/metrics
+		void ServeMetrics(uint16_t port_) { m_metrics_server = std::make_unique<profiling::MetricsServer>(port_); }
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "EnginePacing.h"
+
+using namespace engine;
+
+void FramePacer::SetTargetFrameRate(double frames_per_second_)
+{
+	if (frames_per_second_ <= 0.0)
+	{
+		m_frame_period = Clock::duration::zero();
+		return;
+	}
+
+	m_frame_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frames_per_second_));
+	m_next_deadline = Clock::now();
+}
+
+void FramePacer::WaitUntil(Clock::time_point deadline_)
+{
+	constexpr auto sleep_step = std::chrono::milliseconds(1);
+
+	for (;;)
+	{
+		auto now = Clock::now();
+		double remaining_ns = std::chrono::duration<double, std::nano>(deadline_ - now).count();
+		if (remaining_ns <= std::chrono::duration<double, std::nano>(sleep_step).count() + m_sleep_error_ns)
+			break;
+
+		std::this_thread::sleep_for(sleep_step);
+
+		// The error estimate follows spikes at once and decays slowly, a late wake up costs more than a long spin
+		double overshoot_ns = std::chrono::duration<double, std::nano>(Clock::now() - now - sleep_step).count();
+		m_sleep_error_ns = (std::max)(overshoot_ns, m_sleep_error_ns * 0.99);
+	}
+
+	while (Clock::now() < deadline_)
+		std::this_thread::yield();
+}
+
+void FramePacer::BeginFrame()
+{
+	if (m_frame_period != Clock::duration::zero())
+	{
+		Clock::time_point wake_time = m_next_deadline;
+		if (m_low_latency)
+		{
+			// Work estimate with a margin of two deviations, a frame that ends after its deadline misses a refresh
+			double predicted_ns = m_work_average_ns + 2.0 * m_work_deviation_ns;
+			wake_time -= std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::nano>(predicted_ns));
+		}
+
+		WaitUntil(wake_time);
+
+		// A frame that ran long starts a new schedule instead of rushing to catch up
+		m_next_deadline += m_frame_period;
+		if (m_next_deadline < Clock::now())
+			m_next_deadline = Clock::now() + m_frame_period;
+	}
+
+	m_previous_frame_start = m_frame_start;
+	m_frame_start = Clock::now();
+}
+
+void FramePacer::EndFrame()
+{
+	double work_ns = std::chrono::duration<double, std::nano>(Clock::now() - m_frame_start).count();
+	if (m_frames == 0)
+		m_work_average_ns = work_ns;
+	m_work_deviation_ns += 0.1 * (std::abs(work_ns - m_work_average_ns) - m_work_deviation_ns);
+	m_work_average_ns += 0.1 * (work_ns - m_work_average_ns);
+
+	if (m_previous_frame_start != Clock::time_point())
+		m_intervals[m_frames % FRAME_PACING_HISTORY] = std::chrono::duration<double, std::milli>(m_frame_start - m_previous_frame_start).count();
+	m_frames++;
+}
+
+FramePacingStats FramePacer::Stats() const
+{
+	FramePacingStats stats;
+	stats.target_ms = std::chrono::duration<double, std::milli>(m_frame_period).count();
+	stats.predicted_work_ms = (m_work_average_ns + 2.0 * m_work_deviation_ns) / 1000000.0;
+	stats.frames = m_frames;
+
+	// The first frame has no interval
+	size_t count = static_cast<size_t>((std::min)(m_frames > 0 ? m_frames - 1 : 0, static_cast<uint64_t>(FRAME_PACING_HISTORY)));
+	if (count == 0)
+		return stats;
+
+	stats.last_ms = m_intervals[(m_frames - 1) % FRAME_PACING_HISTORY];
+	stats.min_ms = stats.last_ms;
+	stats.max_ms = stats.last_ms;
+
+	double sum = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double interval = m_intervals[(m_frames - 1 - i) % FRAME_PACING_HISTORY];
+		sum += interval;
+		stats.min_ms = (std::min)(stats.min_ms, interval);
+		stats.max_ms = (std::max)(stats.max_ms, interval);
+	}
+	stats.average_ms = sum / static_cast<double>(count);
+
+	double variance = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double deviation = m_intervals[(m_frames - 1 - i) % FRAME_PACING_HISTORY] - stats.average_ms;
+		variance += deviation * deviation;
+	}
+	stats.jitter_ms = std::sqrt(variance / static_cast<double>(count));
+
+	return stats;
+}
\ No newline at end of file
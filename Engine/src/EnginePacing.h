@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+namespace engine
+{
+	constexpr size_t FRAME_PACING_HISTORY = 128; // Frame intervals the jitter is measured over
+
+	struct FramePacingStats
+	{
+		double target_ms = 0.0; // 0 - not limited
+		double last_ms = 0.0; // Start to start interval of the last frame
+		double average_ms = 0.0;
+		double jitter_ms = 0.0; // Standard deviation of the interval
+		double min_ms = 0.0;
+		double max_ms = 0.0;
+		double predicted_work_ms = 0.0; // Frame work the low latency mode wakes up ahead of the deadline for
+		uint64_t frames = 0;
+	};
+
+	// Frame limiter with a sleep+spin wait: sleeps while the remaining time covers the measured oversleep
+	// of the OS timer and spins the rest for sub millisecond accuracy
+	class FramePacer
+	{
+		// VARIABLES
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		Clock::duration m_frame_period = Clock::duration::zero(); // Zero - no limit
+		bool m_low_latency = false; // Start frames late so they end on the deadline, input is sampled as late as possible
+		Clock::time_point m_next_deadline;
+		Clock::time_point m_frame_start;
+		Clock::time_point m_previous_frame_start;
+
+		double m_sleep_error_ns = 1000000.0; // Decaying maximum of the OS sleep overshoot
+		double m_work_average_ns = 0.0;
+		double m_work_deviation_ns = 0.0;
+
+		std::array<double, FRAME_PACING_HISTORY> m_intervals = {};
+		uint64_t m_frames = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		FramePacer() {}
+		~FramePacer() {}
+
+		// METHODES
+	private:
+		void WaitUntil(Clock::time_point deadline_);
+
+	public:
+		void SetTargetFrameRate(double frames_per_second_); // 0 disables the limiter
+		void SetLowLatency(bool state_) { m_low_latency = state_; }
+
+		void BeginFrame(); // Waits for the frame slot, call before sampling input
+		void EndFrame(); // Call after the frame is presented
+
+		FramePacingStats Stats() const;
+	};
+}
\ No newline at end of file
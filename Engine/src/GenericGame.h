@@ -5,12 +5,14 @@
 #include "EngineMain.h"
 
 constexpr double DEFAULT_GAME_TICKRATE = 60.0; // 60 game updates per second
+constexpr int MAX_TICKS_PER_FRAME = 8; // Drop simulation time instead of spiralling when frames take too long
 
 class GenericGame : public virtual engine::Engine
 {
 	// VARIABLES
 protected:
 	double m_game_tickrate; // Game updates per second
+	int64_t m_tick_start = 0; // Input frame time where the next simulation tick begins
 
 	// CONSTRUCTORS/DESTRUCTORS
 public:
@@ -18,4 +20,38 @@ public:
 		m_game_tickrate(game_tickrate_) {}
 
 	virtual ~GenericGame() {};
+
+	// METHODES
+protected:
+	virtual void InputEventAction(const environment::InputEvent& event_) {} // Called for every input event inside the tick it happened in
+	virtual void TickAction(double tick_time_) {} // Fixed rate simulation step, tick_time_ in seconds
+
+	// Runs every simulation tick that ended since the last frame, feeding each one the input events that arrived during it.
+	// The ECS systems run after TickAction of every tick
+	void FrameAction() override
+	{
+		const int64_t tick_length = static_cast<int64_t>(1e9 / m_game_tickrate);
+		auto input = Environment()->Input();
+		const int64_t now = input->FrameTime(); // Recorded frame time during replays, keeps ticks deterministic
+
+		if (m_tick_start == 0)
+			m_tick_start = now;
+
+		int ticks = 0;
+		while (m_tick_start + tick_length <= now && ticks < MAX_TICKS_PER_FRAME)
+		{
+			m_tick_start += tick_length;
+
+			environment::InputEvent event;
+			while (input->PopEvent(m_tick_start, event))
+				InputEventAction(event);
+
+			TickAction(1.0 / m_game_tickrate);
+			Systems().Run(1.0 / m_game_tickrate);
+			ticks++;
+		}
+
+		if (m_tick_start + tick_length <= now)
+			m_tick_start = now;
+	}
 };
\ No newline at end of file
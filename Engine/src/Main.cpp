@@ -1,31 +1,724 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <random>
+
 #include "GenericGame.h"
+#include "scene/SceneCulling.h"
+#include "scene/SceneTransforms.h"
+#include "gtc/matrix_transform.hpp"
+
+enum GameAction : environment::ActionId
+{
+	ActionQuit,
+};
+
+constexpr uint32_t STREAM_TEXTURE_SIZE = 1024;
+constexpr uint64_t STREAM_WINDOW_STEP = 2; // Frames until the requested window moves on by one texture
+const std::string STREAM_TEXTURE_DIRECTORY = "texture_stream/";
+constexpr uint32_t ASYNC_MESH_GRID = 8; // Vertices along each side of a generated mesh
+const std::string ASYNC_MESH_DIRECTORY = "async_meshes/";
+constexpr size_t REGISTRY_MATERIALS = 8; // Sharing both shaders, each texture is used by two of them
+constexpr size_t WORKLOAD_CHURN_DIVISOR = 16; // Objects created and destroyed per frame, a fraction of the workload size
+
+constexpr double WORKLOAD_TICK = 1.0 / 60.0;
+constexpr float WORKLOAD_LIFETIME = 4.0f; // Seconds until an entity is replaced, about 1/240 of them per frame
+constexpr size_t WORKLOAD_TREE_SIZE = 1024; // Nodes per transform tree, every node has up to 4 children
+constexpr size_t WORKLOAD_ANIMATED_STRIDE = 100; // One node in this many is moved every frame
+constexpr float WORKLOAD_SCENE_EXTENT = 1000.0f; // Culled objects are spread over a cube twice this wide
+constexpr uint64_t WORKLOAD_WARMUP_FRAMES = 8; // Frames the scratch vectors and the frame arenas take to reach their peak
+
+// Stands in for a small engine object, a pool slot against a heap allocation
+struct ChurnPayload
+{
+	glm::mat4 transform;
+	uint64_t id;
+};
+
+struct WorkloadTransform
+{
+	glm::vec3 position;
+	float scale;
+};
+
+struct WorkloadVelocity
+{
+	glm::vec3 linear;
+	float angular;
+};
+
+struct WorkloadLifetime
+{
+	float age;
+};
+
+enum RegistryPhase
+{
+	RegistryIdle,
+	RegistryLoading, // Every path acquired twice, waiting for the loads
+	RegistryUnloading, // Everything released under a zero budget, waiting for the registry to empty
+	RegistryDone
+};
+
+struct WorkloadSamples
+{
+	const char* name = nullptr;
+	std::vector<double> ms; // Per frame
+	uint64_t steady_allocations = 0; // Heap allocations on the loop thread after the warmup frames, debug builds only
+};
+
+// BC1 blocks of noise stand in for compressed art, the streamer never looks at the payload
+void GenerateStreamTextures(size_t count_)
+{
+	std::filesystem::create_directories(STREAM_TEXTURE_DIRECTORY);
+	graphics::TextureFormatInfo info = graphics::GetTextureFormatInfo(VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+	std::mt19937 random(42);
+
+	for (size_t i = 0; i < count_; i++)
+	{
+		std::string file_name = STREAM_TEXTURE_DIRECTORY + "texture_" + std::to_string(i) + ".ktx2";
+		if (std::filesystem::exists(file_name))
+			continue;
+
+		std::vector<std::vector<uint8_t>> mips;
+		for (uint32_t size = STREAM_TEXTURE_SIZE; size > 0; size /= 2)
+		{
+			mips.emplace_back(static_cast<size_t>(graphics::TextureMipBytes(info, size, size)));
+			for (auto& byte : mips.back())
+				byte = static_cast<uint8_t>(random());
+		}
+
+		std::vector<uint8_t> file = graphics::WriteTextureFile(VK_FORMAT_BC1_RGB_UNORM_BLOCK, STREAM_TEXTURE_SIZE, STREAM_TEXTURE_SIZE, mips);
+		std::ofstream output(file_name, std::ios::binary);
+		output.write(reinterpret_cast<const char*>(file.data()), file.size());
+	}
+}
+
+// Small grids, each slightly offset. Half float positions round nearby offsets to the same value, so the first
+// vertex's color holds the index in its 8 bit channels and no two of up to 2^24 files are equal
+void GenerateAsyncMeshes(size_t count_, const graphics::VertexLayout& layout_)
+{
+	std::filesystem::create_directories(ASYNC_MESH_DIRECTORY);
+	for (size_t i = 0; i < count_; i++)
+	{
+		std::string file_name = ASYNC_MESH_DIRECTORY + "mesh_" + std::to_string(i) + ".mesh";
+		if (std::filesystem::exists(file_name))
+			continue;
+
+		graphics::VertexSource source;
+		source.vertex_count = ASYNC_MESH_GRID * ASYNC_MESH_GRID;
+		float offset = static_cast<float>(i % 1000) * 0.001f;
+		for (uint32_t y = 0; y < ASYNC_MESH_GRID; y++)
+		{
+			for (uint32_t x = 0; x < ASYNC_MESH_GRID; x++)
+			{
+				glm::vec2 position = glm::vec2(x, y) / static_cast<float>(ASYNC_MESH_GRID - 1) - 0.5f + offset;
+				source.attributes[graphics::SemanticPosition].push_back(glm::vec4(position, 0.0f, 1.0f));
+				source.attributes[graphics::SemanticColor].push_back(glm::vec4(position + 0.5f, 1.0f, 1.0f));
+			}
+		}
+		uint32_t id = static_cast<uint32_t>(i);
+		source.attributes[graphics::SemanticColor][0] = glm::vec4(glm::vec3(glm::uvec3(id, id >> 8, id >> 16) & 255u), 255.0f) / 255.0f;
+
+		std::vector<uint32_t> indices;
+		for (uint32_t y = 0; y + 1 < ASYNC_MESH_GRID; y++)
+		{
+			for (uint32_t x = 0; x + 1 < ASYNC_MESH_GRID; x++)
+			{
+				uint32_t corner = y * ASYNC_MESH_GRID + x;
+				indices.insert(indices.end(), { corner, corner + 1, corner + ASYNC_MESH_GRID, corner + 1, corner + ASYNC_MESH_GRID + 1, corner + ASYNC_MESH_GRID });
+			}
+		}
+
+		glm::vec3 min = glm::vec3(-0.5f + offset, -0.5f + offset, 0.0f);
+		glm::vec3 max = glm::vec3(0.5f + offset, 0.5f + offset, 0.0f);
+		graphics::MeshBounds bounds = { min, max, glm::vec4((min + max) * 0.5f, glm::length(max - min) * 0.5f) };
+		std::vector<graphics::MeshLod> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f, 0 } };
+		std::vector<uint8_t> file = graphics::WriteMeshFile(layout_, graphics::EncodeVertices(layout_, source), source.vertex_count, indices, lods, bounds);
+		std::ofstream output(file_name, std::ios::binary);
+		output.write(reinterpret_cast<const char*>(file.data()), file.size());
+	}
+}
 
 class Game : public virtual GenericGame
 {
+	// VARIABLES
+private:
+	std::vector<graphics::TextureHandle> m_stream_textures;
+	std::chrono::steady_clock::time_point m_stream_start;
+	uint64_t m_stream_frames = 0;
+	double m_stream_window_residency = 0.0; // Sum over frames of the requested textures at full detail
+
+	size_t m_async_count = 0;
+	std::vector<graphics::MeshHandle> m_async_meshes;
+	std::chrono::steady_clock::time_point m_async_start;
+	std::chrono::steady_clock::time_point m_async_last_frame;
+	double m_async_ms = 0.0; // Until every load finished
+	double m_async_longest_frame_ms = 0.0;
+	uint64_t m_async_frames = 0;
+	double m_sync_ms = 0.0; // Main thread blocked loading the same meshes one after another
+
+	RegistryPhase m_registry_phase = RegistryIdle;
+	size_t m_registry_meshes = 0;
+	std::vector<asset::AssetHandle> m_registry_assets; // Every reference taken, paths appear twice
+	asset::RegistryBudget m_registry_budget; // Restored once the registry emptied
+	asset::RegistryStats m_registry_loaded; // When the last load finished
+	std::chrono::steady_clock::time_point m_registry_start;
+	double m_registry_load_ms = 0.0;
+	double m_registry_unload_ms = 0.0;
+	uint64_t m_registry_load_frames = 0;
+	uint64_t m_registry_unload_frames = 0;
+
+	size_t m_workload_size = 0;
+	std::vector<WorkloadSamples> m_workload_times; // In the order first run
+	memory::Pool<ChurnPayload> m_churn_pool;
+	std::vector<memory::Handle<ChurnPayload>> m_churn_handles;
+	std::vector<ChurnPayload*> m_churn_pointers;
+	ecs::World m_workload_world;
+	std::unique_ptr<ecs::Scheduler> m_workload_scheduler; // After its world
+	scene::TransformHierarchy m_workload_hierarchy;
+	std::vector<scene::NodeHandle> m_workload_nodes;
+	scene::CullingScene m_workload_culling;
+	size_t m_workload_visible = 0; // Objects in the last frustum
+	uint64_t m_workload_frames = 0;
+
 	// CONSTRUCTORS/DESTRUCTORS
 public:
-	Game() {}
+	Game(environment::WindowType window_type_) : engine::Engine("default app", window_type_)
+	{
+		auto& actions = Environment()->Input()->Actions();
+		actions.DeclareAction(ActionQuit, "quit");
+		actions.Bind(ActionQuit, { environment::KeyBinding, GLFW_KEY_ESCAPE });
+	}
 	~Game() {}
 
 	// METHODES
 public:
-	void FrameAction()
+	void TickAction(double tick_time_) override
 	{
-		// If escape key is pressed - finish the program
-		if (Environment()->Input()->KeyPressed(256))
+		// If quit action is triggered - finish the program
+		if (Environment()->Input()->Action(ActionQuit).active)
 			SetShouldFinish(true);
 	}
+
+	void FrameAction() override
+	{
+		GenericGame::FrameAction();
+		if (!m_stream_textures.empty())
+			RequestStreamWindow();
+		if (m_async_count > 0 && m_async_ms == 0.0)
+			TrackAsyncLoading();
+		if (m_workload_size > 0)
+			RunWorkloads();
+		if (m_registry_phase == RegistryLoading || m_registry_phase == RegistryUnloading)
+			TrackRegistryLoad();
+	}
+
+	// Engine subsystems exercised every frame at count_ objects, each is timed on its own. Run with --benchmark the
+	// frame report includes them, the per workload times are printed at exit
+	void StartWorkloads(size_t count_)
+	{
+		m_workload_size = count_;
+		m_churn_handles.reserve(count_ / WORKLOAD_CHURN_DIVISOR);
+		m_churn_pointers.reserve(count_ / WORKLOAD_CHURN_DIVISOR);
+
+		StartEcsWorkload();
+		StartTransformWorkload();
+		StartCullingWorkload();
+	}
+
+	// Boxes of 1 to 10 units scattered over the scene
+	void StartCullingWorkload()
+	{
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> position(-WORKLOAD_SCENE_EXTENT, WORKLOAD_SCENE_EXTENT);
+		std::uniform_real_distribution<float> size(0.5f, 5.0f);
+		for (size_t i = 0; i < m_workload_size; i++)
+		{
+			glm::vec3 center(position(random), position(random), position(random));
+			glm::vec3 extent(size(random));
+			m_workload_culling.Insert({ center - extent, center + extent }, static_cast<uint32_t>(i));
+		}
+		m_workload_culling.Rebuild();
+	}
+
+	// A forest of 4-ary trees built in arbitrary order, sorted once like a loaded scene
+	void StartTransformWorkload()
+	{
+		m_workload_nodes.reserve(m_workload_size);
+		for (size_t i = 0; i < m_workload_size; i++)
+		{
+			size_t tree = i - i % WORKLOAD_TREE_SIZE;
+			scene::NodeHandle parent = i == tree ? scene::NodeHandle() : m_workload_nodes[tree + (i - tree - 1) / 4];
+			glm::vec3 offset(static_cast<float>(i % 7), static_cast<float>(i % 5), static_cast<float>(i % 3));
+			m_workload_nodes.push_back(m_workload_hierarchy.Create(parent, glm::translate(glm::mat4(1.0f), offset)));
+		}
+		m_workload_hierarchy.SortDepthFirst();
+		m_workload_hierarchy.Update();
+	}
+
+	// Entities with a transform and velocity. Integrate and Age do not conflict and run in parallel, Expire waits
+	// for Age and replaces the entities that got too old through its command buffer
+	void StartEcsWorkload()
+	{
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		for (size_t i = 0; i < m_workload_size; i++)
+		{
+			m_workload_world.Create(
+				WorkloadTransform{ glm::vec3(unit(random), unit(random), unit(random)) * 100.0f, 1.0f },
+				WorkloadVelocity{ glm::vec3(unit(random), unit(random), unit(random)), unit(random) },
+				WorkloadLifetime{ (unit(random) + 1.0f) * 0.5f * WORKLOAD_LIFETIME });
+		}
+
+		m_workload_scheduler = std::make_unique<ecs::Scheduler>(m_workload_world);
+		m_workload_scheduler->AddSystem("Integrate", ecs::SystemAccess().Write<WorkloadTransform>().Read<WorkloadVelocity>(), [](ecs::SystemContext& context_)
+		{
+			float delta_time = static_cast<float>(context_.delta_time);
+			context_.world.EachChunk<WorkloadTransform, const WorkloadVelocity>([delta_time](size_t count_, const ecs::Entity*, WorkloadTransform* transforms_, const WorkloadVelocity* velocities_)
+			{
+				for (size_t i = 0; i < count_; i++)
+				{
+					transforms_[i].position += velocities_[i].linear * delta_time;
+					transforms_[i].scale += velocities_[i].angular * delta_time * 0.01f;
+				}
+			});
+		});
+		m_workload_scheduler->AddSystem("Age", ecs::SystemAccess().Write<WorkloadLifetime>(), [](ecs::SystemContext& context_)
+		{
+			float delta_time = static_cast<float>(context_.delta_time);
+			context_.world.EachChunk<WorkloadLifetime>([delta_time](size_t count_, const ecs::Entity*, WorkloadLifetime* lifetimes_)
+			{
+				for (size_t i = 0; i < count_; i++)
+					lifetimes_[i].age += delta_time;
+			});
+		});
+		m_workload_scheduler->AddSystem("Expire", ecs::SystemAccess().Read<WorkloadLifetime>(), [](ecs::SystemContext& context_)
+		{
+			context_.world.Each<const WorkloadLifetime>([&context_](ecs::Entity entity_, const WorkloadLifetime& lifetime_)
+			{
+				if (lifetime_.age < WORKLOAD_LIFETIME)
+					return;
+				context_.commands.Destroy(entity_);
+				ecs::Entity replacement = context_.commands.Create();
+				context_.commands.Add(replacement, WorkloadTransform{ glm::vec3(0.0f), 1.0f });
+				context_.commands.Add(replacement, WorkloadVelocity{ glm::vec3(0.0f, 1.0f, 0.0f), 0.0f });
+				context_.commands.Add(replacement, WorkloadLifetime{ 0.0f });
+			});
+		});
+	}
+
+	// Adds the time and the heap allocations fn_ takes to the samples of workload name_
+	template<typename F>
+	void TimeWorkload(const char* name_, F&& fn_)
+	{
+		uint64_t allocations = memory::ThreadAllocationCount();
+		auto start = std::chrono::steady_clock::now();
+		fn_();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		allocations = memory::ThreadAllocationCount() - allocations;
+
+		auto workload = std::find_if(m_workload_times.begin(), m_workload_times.end(), [name_](const WorkloadSamples& samples_) { return std::strcmp(samples_.name, name_) == 0; });
+		if (workload == m_workload_times.end())
+		{
+			workload = m_workload_times.insert(workload, WorkloadSamples());
+			workload->name = name_;
+		}
+		workload->ms.push_back(ms);
+		if (m_workload_frames >= WORKLOAD_WARMUP_FRAMES)
+			workload->steady_allocations += allocations;
+	}
+
+	void RunWorkloads()
+	{
+		// The same objects through a pool and through new and delete
+		size_t churn = m_workload_size / WORKLOAD_CHURN_DIVISOR;
+		TimeWorkload("pool_churn", [&]()
+		{
+			for (size_t i = 0; i < churn; i++)
+				m_churn_handles.push_back(m_churn_pool.Create(glm::mat4(1.0f), static_cast<uint64_t>(i)));
+			for (auto handle : m_churn_handles)
+				m_churn_pool.Destroy(handle);
+			m_churn_handles.clear();
+		});
+		TimeWorkload("heap_churn", [&]()
+		{
+			for (size_t i = 0; i < churn; i++)
+				m_churn_pointers.push_back(new ChurnPayload{ glm::mat4(1.0f), static_cast<uint64_t>(i) });
+			for (auto pointer : m_churn_pointers)
+				delete pointer;
+			m_churn_pointers.clear();
+		});
+
+		TimeWorkload("ecs_systems", [&]() { m_workload_scheduler->Run(WORKLOAD_TICK); });
+
+		// A different 1% of the nodes moves every frame, the static subtrees are skipped
+		TimeWorkload("transform_update", [&]()
+		{
+			float angle = static_cast<float>(m_workload_frames) * 0.01f;
+			glm::quat rotation = glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f));
+			for (size_t i = m_workload_frames % WORKLOAD_ANIMATED_STRIDE; i < m_workload_nodes.size(); i += WORKLOAD_ANIMATED_STRIDE)
+				m_workload_hierarchy.SetLocal(m_workload_nodes[i], glm::vec3(1.0f, 0.0f, 0.0f), rotation, glm::vec3(1.0f));
+			m_workload_hierarchy.Update();
+		});
+		// A camera orbiting the center, the tests run on the workload scheduler's workers. The visible list lives in the
+		// frame arena, so the culling stops allocating once the arena grew to the largest list
+		TimeWorkload("culling", [&]()
+		{
+			float angle = static_cast<float>(m_workload_frames) * 0.01f;
+			glm::vec3 eye(std::cos(angle) * WORKLOAD_SCENE_EXTENT, 0.0f, std::sin(angle) * WORKLOAD_SCENE_EXTENT);
+			glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			// Vulkan's 0 to 1 clip depth, ExtractFrustum takes the near plane from it
+			glm::mat4 projection = glm::perspectiveZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, WORKLOAD_SCENE_EXTENT * 2.0f);
+			std::pmr::vector<uint32_t> visible(FrameMemory());
+			m_workload_culling.Cull(scene::ExtractFrustum(projection * view), visible, m_workload_scheduler.get());
+			m_workload_visible = visible.size();
+		});
+		m_workload_frames++;
+	}
+
+	void PrintWorkloads()
+	{
+		if (m_workload_times.empty())
+			return;
+
+		std::cout << "Workloads of " << m_workload_size << " objects, milliseconds per frame:\n";
+		for (const WorkloadSamples& samples : m_workload_times)
+		{
+			profiling::SampleSummary summary = profiling::Benchmark::Summarize(samples.ms);
+			std::cout << "  " << samples.name << ": p50 " << summary.p50 << ", p95 " << summary.p95 << ", p99 " << summary.p99 << ", max " << summary.max;
+			if (memory::ALLOCATION_COUNTING && m_workload_frames > WORKLOAD_WARMUP_FRAMES)
+				std::cout << ", heap allocations per frame " << static_cast<double>(samples.steady_allocations) / static_cast<double>(m_workload_frames - WORKLOAD_WARMUP_FRAMES);
+			std::cout << "\n";
+		}
+		std::cout << "  last frustum held " << m_workload_visible << " objects" << std::endl;
+	}
+
+	// Loads count_ generated textures, only a moving window of them is requested at full detail
+	void StartTextureStreaming(size_t count_, uint64_t budget_bytes_)
+	{
+		GenerateStreamTextures(count_);
+
+		graphics::TextureStreamBudget budget = Graphics()->GetTextureBudget();
+		budget.memory_bytes = budget_bytes_;
+		Graphics()->SetTextureBudget(budget);
+
+		for (size_t i = 0; i < count_; i++)
+			m_stream_textures.push_back(Graphics()->CreateTexture(STREAM_TEXTURE_DIRECTORY + "texture_" + std::to_string(i) + ".ktx2"));
+		m_stream_start = std::chrono::steady_clock::now();
+	}
+
+	// A camera panning over the set, every texture leaving the window is left to the eviction
+	void RequestStreamWindow()
+	{
+		size_t count = m_stream_textures.size();
+		size_t window = (std::max<size_t>)(count / 8, 1);
+		size_t first = static_cast<size_t>(m_stream_frames / STREAM_WINDOW_STEP) % count;
+
+		size_t full_detail = 0;
+		for (size_t i = 0; i < window; i++)
+		{
+			graphics::TextureHandle texture = m_stream_textures[(first + i) % count];
+			Graphics()->RequestTextureMip(texture, 0);
+			full_detail += Graphics()->GetTexture(texture)->stream.resident_mip == 0 ? 1 : 0;
+		}
+		m_stream_window_residency += static_cast<double>(full_detail) / static_cast<double>(window);
+		m_stream_frames++;
+	}
+
+	// Loads count_ generated meshes one after another, frees them and loads them again as concurrent coroutines
+	void StartAsyncLoading(size_t count_)
+	{
+		GenerateAsyncMeshes(count_, Graphics()->GetVertexLayout());
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count_; i++)
+			m_async_meshes.push_back(Graphics()->CreateMesh(ASYNC_MESH_DIRECTORY + "mesh_" + std::to_string(i) + ".mesh"));
+		m_sync_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		for (graphics::MeshHandle mesh : m_async_meshes)
+			Graphics()->DestroyMesh(mesh);
+		m_async_meshes.clear();
+
+		m_async_count = count_;
+		m_async_start = std::chrono::steady_clock::now();
+		m_async_last_frame = m_async_start;
+		for (size_t i = 0; i < count_; i++)
+			Assets().Spawn(LoadAsyncMesh(ASYNC_MESH_DIRECTORY + "mesh_" + std::to_string(i) + ".mesh"));
+	}
+
+	asset::Task<void> LoadAsyncMesh(std::string file_name_)
+	{
+		graphics::MeshHandle mesh = co_await asset::LoadMesh(Assets(), *Graphics(), file_name_);
+		m_async_meshes.push_back(mesh); // Uploads resume on the main thread
+	}
+
+	void TrackAsyncLoading()
+	{
+		auto now = std::chrono::steady_clock::now();
+		m_async_longest_frame_ms = (std::max)(m_async_longest_frame_ms, std::chrono::duration<double, std::milli>(now - m_async_last_frame).count());
+		m_async_last_frame = now;
+		m_async_frames++;
+		if (Assets().InFlight() == 0)
+			m_async_ms = std::chrono::duration<double, std::milli>(now - m_async_start).count();
+	}
+
+	// Acquires count_ generated meshes and REGISTRY_MATERIALS materials twice each in one frame, so every second
+	// acquire shares a load in flight. Once loaded everything is released and the budget shrunk to zero, the registry
+	// unloads the materials first and their shaders and textures after them
+	void StartRegistryLoad(size_t count_)
+	{
+		GenerateAsyncMeshes(count_, Graphics()->GetVertexLayout());
+		GenerateStreamTextures(REGISTRY_MATERIALS);
+
+		m_registry_meshes = count_;
+		m_registry_budget = Registry().GetBudget();
+		m_registry_start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count_; i++)
+		{
+			std::string file_name = ASYNC_MESH_DIRECTORY + "mesh_" + std::to_string(i) + ".mesh";
+			m_registry_assets.push_back(Registry().AcquireMesh(file_name));
+			m_registry_assets.push_back(Registry().AcquireMesh(file_name));
+		}
+		for (size_t i = 0; i < REGISTRY_MATERIALS; i++)
+		{
+			asset::MaterialDesc material;
+			material.vertex_shader = "BasicVert.spv";
+			material.fragment_shader = "BasicFrag.spv";
+			material.textures.push_back(STREAM_TEXTURE_DIRECTORY + "texture_" + std::to_string(i) + ".ktx2");
+			material.textures.push_back(STREAM_TEXTURE_DIRECTORY + "texture_" + std::to_string((i + 1) % REGISTRY_MATERIALS) + ".ktx2");
+			std::string name = "registry_material_" + std::to_string(i);
+			m_registry_assets.push_back(Registry().AcquireMaterial(name, material));
+			m_registry_assets.push_back(Registry().AcquireMaterial(name, material));
+		}
+		m_registry_phase = RegistryLoading;
+	}
+
+	void TrackRegistryLoad()
+	{
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_registry_start).count();
+		if (m_registry_phase == RegistryLoading)
+		{
+			m_registry_load_frames++;
+			for (asset::AssetHandle asset : m_registry_assets)
+				if (Registry().Get(asset)->state == asset::AssetLoading)
+					return;
+
+			m_registry_load_ms = ms;
+			m_registry_loaded = Registry().Stats();
+			for (asset::AssetHandle asset : m_registry_assets)
+				Registry().Release(asset);
+			m_registry_assets.clear();
+
+			asset::RegistryBudget budget = m_registry_budget;
+			budget.memory_bytes = 0;
+			Registry().SetBudget(budget);
+			m_registry_phase = RegistryUnloading;
+			return;
+		}
+
+		m_registry_unload_frames++;
+		if (Registry().Stats().assets > 0)
+			return;
+		m_registry_unload_ms = ms - m_registry_load_ms;
+		Registry().SetBudget(m_registry_budget);
+		m_registry_phase = RegistryDone;
+	}
+
+	void PrintRegistryLoad()
+	{
+		if (m_registry_phase == RegistryIdle)
+			return;
+
+		// Meshes, materials, their two shaders and the textures
+		size_t paths = m_registry_meshes + REGISTRY_MATERIALS + 2 + REGISTRY_MATERIALS;
+		const double mb = 1024.0 * 1024.0;
+		asset::RegistryStats stats = Registry().Stats();
+		std::cout << "Registry: " << m_registry_meshes << " meshes and " << REGISTRY_MATERIALS << " materials acquired twice each\n"
+			<< "  loads " << m_registry_loaded.loads << " for " << paths << " paths, " << m_registry_loaded.shared_loads << " shared, "
+			<< m_registry_loaded.failed << " failed\n";
+		if (m_registry_phase == RegistryLoading)
+		{
+			std::cout << "  unfinished after " << m_registry_load_frames << " frames" << std::endl;
+			return;
+		}
+
+		std::cout << "  loaded " << m_registry_loaded.loaded_bytes / mb << " MB in " << m_registry_load_ms << " ms over " << m_registry_load_frames << " frames\n";
+		if (m_registry_phase == RegistryUnloading)
+			std::cout << "  zero budget: " << stats.assets << " assets left after " << m_registry_unload_frames << " frames, " << stats.unused << " unused" << std::endl;
+		else
+			std::cout << "  zero budget: " << stats.unloads << " unloads in " << m_registry_unload_ms << " ms over " << m_registry_unload_frames << " frames, "
+				<< stats.loaded_bytes << " bytes left" << std::endl;
+	}
+
+	void PrintAsyncLoading()
+	{
+		if (m_async_count == 0)
+			return;
+
+		asset::LoaderStats stats = Assets().Stats();
+		std::cout << "Async loading: " << m_async_meshes.size() << " of " << m_async_count << " meshes, " << stats.failed << " failed\n"
+			<< "  synchronous: " << m_sync_ms << " ms blocking the main thread\n";
+		if (m_async_ms == 0.0)
+			std::cout << "  coroutines: unfinished after " << m_async_frames << " frames" << std::endl;
+		else
+			std::cout << "  coroutines: " << m_async_ms << " ms over " << m_async_frames << " frames, longest frame " << m_async_longest_frame_ms << " ms" << std::endl;
+	}
+
+	void PrintTextureStreaming()
+	{
+		if (m_stream_textures.empty())
+			return;
+
+		const double mb = 1024.0 * 1024.0;
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_stream_start).count();
+		graphics::TextureStreamingStats stats = Graphics()->TextureStats();
+		std::cout << "Texture streaming: " << stats.textures << " textures, " << stats.resident_bytes / mb << " MB resident of a "
+			<< stats.budget_bytes / mb << " MB budget (" << stats.device_bytes / mb << " MB device memory)\n"
+			<< "  streamed " << stats.streamed_bytes / mb << " MB in " << stats.streamed_mips << " mips, " << stats.streamed_bytes / mb / seconds << " MB/s\n"
+			<< "  evicted " << stats.evicted_bytes / mb << " MB in " << stats.evicted_mips << " mips\n"
+			<< "  requested window at full detail " << 100.0 * m_stream_window_residency / static_cast<double>((std::max<uint64_t>)(m_stream_frames, 1))
+			<< "% of " << m_stream_frames << " frames" << std::endl;
+	}
 };
 
+bool HasArgument(int argc, char** argv, const std::string& name_)
+{
+	for (int i = 1; i < argc; i++)
+		if (name_ == argv[i])
+			return true;
+	return false;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage: Engine [options]\n"
+		<< "  --record <file>                  Saves the session input\n"
+		<< "  --replay <file>                  Plays a saved session back\n"
+		<< "  --headless                       Renders into offscreen images without creating a window\n"
+		<< "  --benchmark <frames>             Measures that many frames and writes --benchmark-report <file> (benchmark.json by default)\n"
+		<< "  --benchmark-baseline <file>      Fails the run if p50/p95/p99 are more than --benchmark-threshold <percent> slower\n"
+		<< "  --profile <file>                 Writes a Chrome trace of the first --profile-frames <frames> frames (120 by default)\n"
+		<< "  --metrics-port <port>            Serves Prometheus metrics on 127.0.0.1\n"
+		<< "  --present vsync|low-latency|uncapped|capped  Present policy, --fps <rate> its frame rate\n"
+		<< "  --texture-stream <count>         Streams a generated set of textures under a --texture-budget <MB> (64 by default)\n"
+		<< "  --async-load <count>             Compares loading that many generated meshes synchronously and as coroutines\n"
+		<< "  --registry-load <count>          Loads that many generated meshes and a few materials through the asset registry, then unloads them\n"
+		<< "  --benchmark-workloads <count>    Times engine subsystems at that many objects every frame" << std::endl;
+}
+
+// Options as listed by PrintUsage. Throws std::invalid_argument for a malformed value or an unknown present policy
+void ParseArguments(Game& engine_, int argc, char** argv)
+{
+	bool benchmark = false;
+	profiling::BenchmarkSettings benchmark_settings;
+	std::string profile_file;
+	size_t profile_frames = 120;
+	std::string present_policy;
+	double frames_per_second = 0.0;
+	size_t stream_textures = 0;
+	uint64_t texture_budget_mb = 64;
+	size_t async_meshes = 0;
+	size_t registry_meshes = 0;
+	size_t workloads = 0;
+
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		std::string argument = argv[i];
+		try
+		{
+			if (argument == "--record")
+				engine_.RecordInput(argv[++i]);
+			else if (argument == "--replay")
+				engine_.ReplayInput(argv[++i]);
+			else if (argument == "--benchmark")
+			{
+				benchmark = true;
+				benchmark_settings.frames = std::stoul(argv[++i]);
+			}
+			else if (argument == "--benchmark-report")
+				benchmark_settings.report_file = argv[++i];
+			else if (argument == "--benchmark-baseline")
+				benchmark_settings.baseline_file = argv[++i];
+			else if (argument == "--benchmark-threshold")
+				benchmark_settings.regression_threshold = std::stod(argv[++i]) / 100.0;
+			else if (argument == "--profile")
+				profile_file = argv[++i];
+			else if (argument == "--profile-frames")
+				profile_frames = std::stoul(argv[++i]);
+			else if (argument == "--metrics-port")
+				engine_.ServeMetrics(static_cast<uint16_t>(std::stoul(argv[++i])));
+			else if (argument == "--present")
+				present_policy = argv[++i];
+			else if (argument == "--fps")
+				frames_per_second = std::stod(argv[++i]);
+			else if (argument == "--texture-stream")
+				stream_textures = std::stoul(argv[++i]);
+			else if (argument == "--texture-budget")
+				texture_budget_mb = std::stoull(argv[++i]);
+			else if (argument == "--async-load")
+				async_meshes = std::stoul(argv[++i]);
+			else if (argument == "--registry-load")
+				registry_meshes = std::stoul(argv[++i]);
+			else if (argument == "--benchmark-workloads")
+				workloads = std::stoul(argv[++i]);
+		}
+		catch (const std::logic_error&)
+		{
+			// std::stoul and std::stod throw invalid_argument or out_of_range
+			throw std::invalid_argument("Invalid value " + std::string(argv[i]) + " for " + argument);
+		}
+	}
+
+	if (present_policy == "vsync")
+		engine_.SetPresentPolicy(graphics::PresentVsync, frames_per_second);
+	else if (present_policy == "low-latency")
+		engine_.SetPresentPolicy(graphics::PresentLowLatency, frames_per_second);
+	else if (present_policy == "uncapped")
+		engine_.SetPresentPolicy(graphics::PresentUncapped, frames_per_second);
+	else if (present_policy == "capped" || (present_policy.empty() && frames_per_second > 0.0))
+		engine_.SetPresentPolicy(graphics::PresentCapped, frames_per_second);
+	else if (!present_policy.empty())
+		throw std::invalid_argument("Unknown present policy " + present_policy);
+
+	if (stream_textures > 0)
+		engine_.StartTextureStreaming(stream_textures, texture_budget_mb << 20);
+	if (async_meshes > 0)
+		engine_.StartAsyncLoading(async_meshes);
+	if (registry_meshes > 0)
+		engine_.StartRegistryLoad(registry_meshes);
+	if (workloads > 0)
+		engine_.StartWorkloads(workloads);
+	if (benchmark)
+		engine_.RunBenchmark(benchmark_settings);
+	if (!profile_file.empty())
+		engine_.CaptureProfile(profile_file, profile_frames);
+}
+
 int main(int argc, char** argv)
 {
+	Game game(HasArgument(argc, argv, "--headless") ? environment::NO_WINDOW : environment::WINDOWED);
+	try
+	{
+		ParseArguments(game, argc, argv);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		PrintUsage();
+		return engine::EXIT_CODE_FAILURE;
+	}
+
+	int return_value = game.Loop();
+	game.PrintTextureStreaming();
+	game.PrintAsyncLoading();
+	game.PrintRegistryLoad();
+	game.PrintWorkloads();
 #ifdef _DEBUG
-	Game debug_game;
-	int return_value = debug_game.Loop();
-	std::cin.get();
-	return return_value;
-#else
-	Game debug_game;
-	return debug_game.Loop();
+	// Benchmark runs are scripted, nobody is there to press a key
+	if (!HasArgument(argc, argv, "--benchmark"))
+		std::cin.get();
 #endif
-}
+	return return_value;
+}
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	constexpr size_t PREFETCH_PAGE_SIZE = 4096;
+
+	// Touches every page so the worker decoding the file does not stall on page faults
+	void Prefetch(const memory::AssetFile& file_)
+	{
+		const volatile uint8_t* data = file_.Data();
+		for (size_t offset = 0; offset < file_.Size(); offset += PREFETCH_PAGE_SIZE)
+			(void)data[offset];
+	}
+}
+
+void asset::Loader::ReadAwaiter::await_suspend(std::coroutine_handle<> handle_)
+{
+	handle = handle_;
+	std::lock_guard<std::mutex> lock(loader.m_mutex);
+	loader.m_reads.push_back(this);
+	loader.m_io_changed.notify_one();
+}
+
+memory::AssetFile asset::Loader::ReadAwaiter::await_resume()
+{
+	if (error)
+		std::rethrow_exception(error);
+	return std::move(file);
+}
+
+void asset::Loader::ThreadAwaiter::await_suspend(std::coroutine_handle<> handle_)
+{
+	std::lock_guard<std::mutex> lock(loader.m_mutex);
+	if (main_thread)
+	{
+		loader.m_main_queue.push_back(handle_);
+		loader.m_main_changed.notify_all();
+	}
+	else
+	{
+		loader.m_worker_queue.push_back(handle_);
+		loader.m_worker_changed.notify_one();
+	}
+}
+
+void asset::Loader::UploadAwaiter::await_suspend(std::coroutine_handle<> handle_)
+{
+	handle = handle_;
+	std::lock_guard<std::mutex> lock(loader.m_mutex);
+	loader.m_uploads.push_back(this);
+	loader.m_main_changed.notify_all();
+}
+
+void asset::Loader::Initialize(size_t worker_threads_)
+{
+	auto& metrics = profiling::Metrics();
+	m_in_flight_metric = &metrics.AddGauge("asset_loads_in_flight", "Asset loads started and not yet finished");
+	m_read_bytes_metric = &metrics.AddCounter("asset_read_bytes_total", "Asset file bytes read by the I/O thread");
+	m_failed_metric = &metrics.AddCounter("asset_loads_failed_total", "Asset loads ended by an exception");
+
+	m_io_thread = std::thread(&Loader::IoLoop, this);
+	for (size_t i = 0; i < (std::max<size_t>)(worker_threads_, 1); i++)
+		m_workers.emplace_back(&Loader::WorkerLoop, this, i);
+}
+
+void asset::Loader::Shutdown()
+{
+	WaitIdle();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_io_changed.notify_all();
+	m_worker_changed.notify_all();
+	m_io_thread.join();
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+size_t asset::Loader::DefaultWorkerCount()
+{
+	return (std::max<size_t>)(std::thread::hardware_concurrency() / 2, 1);
+}
+
+void asset::Loader::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_in_flight > 0)
+	{
+		m_main_changed.wait(lock, [&]() { return m_in_flight == 0 || !m_main_queue.empty() || !m_uploads.empty(); });
+		lock.unlock();
+		ResumeMainThread(true);
+		lock.lock();
+	}
+}
+
+void asset::Loader::IoLoop()
+{
+	profiling::SetThreadName("AssetIO");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_io_changed.wait(lock, [&]() { return m_stop || !m_reads.empty(); });
+		if (m_reads.empty())
+			return;
+
+		ReadAwaiter* read = m_reads.front();
+		m_reads.pop_front();
+		lock.unlock();
+
+		{
+			PROFILE_SCOPE("AssetRead");
+			try
+			{
+				read->file.Open(m_package, read->path);
+				Prefetch(read->file);
+			}
+			catch (...)
+			{
+				read->error = std::current_exception();
+			}
+		}
+		m_read_bytes_metric->Add(read->file.Size());
+
+		// The awaiting coroutine may run and free the awaiter as soon as it is queued
+		lock.lock();
+		m_stats.read_bytes += read->file.Size();
+		m_worker_queue.push_back(read->handle);
+		m_worker_changed.notify_one();
+	}
+}
+
+void asset::Loader::WorkerLoop(size_t worker_index_)
+{
+	profiling::SetThreadName("AssetWorker " + std::to_string(worker_index_));
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_worker_changed.wait(lock, [&]() { return m_stop || !m_worker_queue.empty(); });
+		if (m_worker_queue.empty())
+			return;
+
+		std::coroutine_handle<> handle = m_worker_queue.front();
+		m_worker_queue.pop_front();
+		lock.unlock();
+		handle.resume();
+		lock.lock();
+	}
+}
+
+void asset::Loader::ResumeMainThread(bool ignore_budget_)
+{
+	PROFILE_FUNCTION();
+	std::deque<std::coroutine_handle<>> main_queue;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		main_queue.swap(m_main_queue);
+	}
+	for (std::coroutine_handle<> handle : main_queue)
+		handle.resume();
+
+	uint64_t frame_bytes = 0;
+	uint32_t frame_uploads = 0;
+	while (true)
+	{
+		UploadAwaiter* upload;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_uploads.empty())
+				return;
+
+			upload = m_uploads.front();
+			bool fits = frame_uploads < m_budget.uploads_per_frame && frame_bytes + upload->bytes <= m_budget.upload_bytes_per_frame;
+			if (!ignore_budget_ && frame_uploads > 0 && !fits)
+				return;
+
+			m_uploads.pop_front();
+			m_stats.uploads++;
+			m_stats.uploaded_bytes += upload->bytes;
+		}
+
+		frame_bytes += upload->bytes;
+		frame_uploads++;
+		upload->handle.resume();
+	}
+}
+
+asset::DetachedTask asset::Loader::RunDetached(Task<void> task_)
+{
+	bool failed = false;
+	try
+	{
+		co_await task_;
+	}
+	catch (const std::exception& e)
+	{
+		failed = true;
+		std::cerr << "Asset load failed: " << e.what() << std::endl;
+	}
+	catch (...)
+	{
+		failed = true;
+		std::cerr << "Asset load failed with an unknown exception" << std::endl;
+	}
+	FinishLoad(failed);
+}
+
+void asset::Loader::FinishLoad(bool failed_)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_in_flight--;
+	m_stats.finished++;
+	if (failed_)
+	{
+		m_stats.failed++;
+		m_failed_metric->Add(1);
+	}
+	m_in_flight_metric->Set(static_cast<double>(m_in_flight));
+	m_main_changed.notify_all();
+}
+
+void asset::Loader::Spawn(Task<void> task_)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_in_flight++;
+		m_stats.started++;
+		m_in_flight_metric->Set(static_cast<double>(m_in_flight));
+	}
+	RunDetached(std::move(task_));
+}
+
+void asset::Loader::SetBudget(const LoadBudget& budget_)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budget = budget_;
+}
+
+asset::LoadBudget asset::Loader::GetBudget()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_budget;
+}
+
+asset::LoaderStats asset::Loader::Stats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+uint64_t asset::Loader::InFlight()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_in_flight;
+}
+
+asset::Task<graphics::MeshHandle> asset::LoadMesh(Loader& loader_, graphics::GraphicsManager& graphics_, std::string path_)
+{
+	memory::AssetFile file = co_await loader_.ReadFile(path_);
+	graphics::MeshView view = graphics::ReadMeshFile(file.Data(), file.Size());
+	if (view.layout != graphics_.GetVertexLayout())
+		throw std::runtime_error("Mesh vertex layout does not match the pipeline: " + path_);
+
+	co_await loader_.Upload(view.header->vertex_bytes + view.header->index_bytes);
+	co_return graphics_.CreateMesh(view);
+}
+
+asset::Task<graphics::TextureHandle> asset::LoadTexture(Loader& loader_, graphics::GraphicsManager& graphics_, std::string path_)
+{
+	memory::AssetFile file = co_await loader_.ReadFile(path_);
+	graphics::TextureView view = graphics::ReadTextureFile(file.Data(), file.Size());
+
+	uint64_t upload_bytes = view.mips.back().bytes;
+	for (size_t mip = 0; mip + 1 < view.mips.size(); mip++)
+		if ((std::max)(view.mips[mip].width, view.mips[mip].height) <= graphics::TEXTURE_STREAMING_TAIL_SIZE)
+			upload_bytes += view.mips[mip].bytes;
+
+	co_await loader_.Upload(upload_bytes);
+	co_return graphics_.CreateTexture(std::move(file), path_);
+}
+
+asset::Task<void> asset::PrecompilePipeline(Loader& loader_, graphics::GraphicsManager& graphics_, graphics::ShaderPermutation permutation_)
+{
+	co_await loader_.Worker();
+	graphics::CompiledPipeline pipeline = graphics_.CompilePipeline(permutation_);
+
+	co_await loader_.MainThread();
+	graphics_.AddPipeline(permutation_, pipeline);
+}
+
+void asset::PrecompilePipelines(Loader& loader_, graphics::GraphicsManager& graphics_, const std::vector<graphics::ShaderPermutation>& permutations_)
+{
+	for (const graphics::ShaderPermutation& permutation : permutations_)
+		if (!graphics_.HasPipeline(permutation))
+			loader_.Spawn(PrecompilePipeline(loader_, graphics_, permutation));
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AssetTask.h"
+#include "../graphics/GraphicsMain.h"
+#include "../memory/MemoryPackage.h"
+#include "../profiling/ProfilingMetrics.h"
+#include "../profiling/ProfilingZones.h"
+
+namespace asset
+{
+	struct LoadBudget
+	{
+		uint64_t upload_bytes_per_frame = 32 << 20; // A single larger upload runs alone
+		uint32_t uploads_per_frame = 256; // Every upload is a submission the frame waits for
+	};
+
+	struct LoaderStats
+	{
+		uint64_t started = 0;
+		uint64_t finished = 0; // Failed loads included
+		uint64_t failed = 0;
+		uint64_t read_bytes = 0;
+		uint64_t uploads = 0;
+		uint64_t uploaded_bytes = 0;
+	};
+
+	// Coroutine nobody awaits, its frame is freed when it finishes
+	struct DetachedTask
+	{
+		struct promise_type
+		{
+			DetachedTask get_return_object() noexcept { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept { std::terminate(); }
+		};
+	};
+
+	// Runs the steps of asset loads where they belong: file reads on one I/O thread, decoding on a worker pool and
+	// GPU uploads on the main thread at the frame boundary, within a per frame upload budget. A load is a coroutine
+	// that co_awaits ReadFile, Worker, MainThread and Upload to move between them
+	class Loader
+	{
+		// VARIABLES
+	public:
+		// Maps the file, from the package if it has it, and faults its pages in on the I/O thread, then resumes on a worker
+		struct ReadAwaiter
+		{
+			Loader& loader;
+			std::string path;
+			memory::AssetFile file = {};
+			std::exception_ptr error = nullptr;
+			std::coroutine_handle<> handle = nullptr;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle_);
+			memory::AssetFile await_resume();
+		};
+
+		struct ThreadAwaiter
+		{
+			Loader& loader;
+			bool main_thread;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle_);
+			void await_resume() const noexcept {}
+		};
+
+		struct UploadAwaiter
+		{
+			Loader& loader;
+			uint64_t bytes = 0;
+			std::coroutine_handle<> handle = nullptr;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle_);
+			void await_resume() const noexcept {}
+		};
+
+	private:
+		const memory::Package* m_package = nullptr;
+		LoadBudget m_budget;
+
+		std::thread m_io_thread;
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_io_changed;
+		std::condition_variable m_worker_changed;
+		std::condition_variable m_main_changed; // Main thread work or finished loads, waited for by Shutdown
+		std::deque<ReadAwaiter*> m_reads;
+		std::deque<std::coroutine_handle<>> m_worker_queue;
+		std::deque<std::coroutine_handle<>> m_main_queue;
+		std::deque<UploadAwaiter*> m_uploads;
+		uint64_t m_in_flight = 0;
+		LoaderStats m_stats;
+		bool m_stop = false;
+
+		profiling::Gauge* m_in_flight_metric = nullptr;
+		profiling::Counter* m_read_bytes_metric = nullptr;
+		profiling::Counter* m_failed_metric = nullptr;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		// package_ must outlive the loader, nullptr reads loose files only
+		Loader(const memory::Package* package_ = nullptr, size_t worker_threads_ = DefaultWorkerCount()) : m_package(package_) { Initialize(worker_threads_); }
+		~Loader() { Shutdown(); }
+
+		Loader(const Loader&) = delete;
+		Loader& operator=(const Loader&) = delete;
+
+		// METHODES
+	private:
+		void Initialize(size_t worker_threads_);
+		void Shutdown();
+
+		void IoLoop();
+		void WorkerLoop(size_t worker_index_);
+		void ResumeMainThread(bool ignore_budget_);
+		DetachedTask RunDetached(Task<void> task_);
+		void FinishLoad(bool failed_);
+
+	public:
+		static size_t DefaultWorkerCount(); // Half the hardware threads, the other half runs the frame
+
+		ReadAwaiter ReadFile(const std::string& path_) { return { *this, path_ }; }
+		ThreadAwaiter Worker() { return { *this, false }; }
+		ThreadAwaiter MainThread() { return { *this, true }; } // Resumes at the next frame boundary
+		// Resumes on the main thread at the first frame boundary with bytes_ left in the upload budget
+		UploadAwaiter Upload(uint64_t bytes_) { return { *this, bytes_ }; }
+
+		// Starts a load without awaiting it, an exception ending it is reported and counted as a failed load
+		void Spawn(Task<void> task_);
+		// Frame boundary, called by the engine on the main thread before FrameAction
+		void ResumeMainThread() { ResumeMainThread(false); }
+		// Blocks until no load is in flight, their main thread steps run here ignoring the budget
+		void WaitIdle();
+
+		void SetBudget(const LoadBudget& budget_);
+		LoadBudget GetBudget();
+		LoaderStats Stats();
+		uint64_t InFlight();
+	};
+
+	// Reads the cooked mesh on the I/O thread, validates it on a worker and uploads it at a frame boundary.
+	// Coroutine arguments are taken by value, the load outlives the caller's references
+	Task<graphics::MeshHandle> LoadMesh(Loader& loader_, graphics::GraphicsManager& graphics_, std::string path_);
+	// Only the mips up to TEXTURE_STREAMING_TAIL_SIZE count against the upload budget, the rest is streamed later
+	Task<graphics::TextureHandle> LoadTexture(Loader& loader_, graphics::GraphicsManager& graphics_, std::string path_);
+	// Compiles the pipeline permutation on a worker and adds it to the graphics manager's cache at a frame boundary,
+	// the first draw with it does not stall the frame
+	Task<void> PrecompilePipeline(Loader& loader_, graphics::GraphicsManager& graphics_, graphics::ShaderPermutation permutation_);
+	// Spawns a precompile of every permutation not cached yet, for the set a scene declares while it loads
+	void PrecompilePipelines(Loader& loader_, graphics::GraphicsManager& graphics_, const std::vector<graphics::ShaderPermutation>& permutations_);
+}
\ No newline at end of file
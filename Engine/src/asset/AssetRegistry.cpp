@@ -0,0 +1,366 @@
+#include "AssetRegistry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	const char* KIND_PREFIXES[] = { "mesh:", "texture:", "shader:", "material:" };
+
+	uint64_t MeshBytes(const graphics::GraphicsManager& graphics_, graphics::MeshHandle mesh_)
+	{
+		const graphics::Mesh* mesh = graphics_.GetMesh(mesh_);
+		const graphics::VertexLayout& layout = graphics_.GetVertexLayout();
+		uint64_t vertex_size = 0;
+		for (uint32_t stream = 0; stream < layout.StreamCount(); stream++)
+			vertex_size += layout.Stride(stream);
+		return vertex_size * mesh->vertex_count + static_cast<uint64_t>(mesh->index_count) * (mesh->index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+	}
+
+	// Unmapping a large file can take longer than a frame has, the last reference is dropped on a worker
+	asset::Task<void> CloseFile(asset::Loader& loader_, memory::AssetFile file_)
+	{
+		memory::AssetFile file = std::move(file_);
+		co_await loader_.Worker();
+	}
+}
+
+bool asset::Registry::ReadyAwaiter::await_ready() const
+{
+	const AssetEntry* entry = registry.m_entries.Get(asset);
+	return entry == nullptr || entry->state != AssetLoading;
+}
+
+void asset::Registry::ReadyAwaiter::await_suspend(std::coroutine_handle<> handle_)
+{
+	registry.m_entries.At(asset).waiters.push_back(handle_);
+}
+
+void asset::Registry::ReadyAwaiter::await_resume() const
+{
+	const AssetEntry* entry = registry.m_entries.Get(asset);
+	if (entry == nullptr)
+		throw std::runtime_error("Asset was released while it was awaited");
+	if (entry->state == AssetFailed)
+		throw std::runtime_error(entry->error);
+}
+
+void asset::Registry::Initialize()
+{
+	auto& metrics = profiling::Metrics();
+	m_loaded_bytes_metric = &metrics.AddGauge("asset_loaded_bytes", "Bytes of the assets loaded by the registry, counted against its budget");
+	m_unloads_metric = &metrics.AddCounter("asset_unloads_total", "Assets unloaded by the registry");
+}
+
+void asset::Registry::Shutdown()
+{
+	// Every load finishes before its asset can go
+	m_loader.WaitIdle();
+	while (m_entries.Size() > 0)
+		Unload(m_entries.HandleAt(m_entries.Size() - 1));
+}
+
+asset::AssetHandle asset::Registry::Acquire(AssetKind kind_, const std::string& path_, bool& created_)
+{
+	std::string key = KIND_PREFIXES[kind_] + memory::NormalizePackagePath(path_);
+	auto it = m_keys.find(key);
+	created_ = it == m_keys.end();
+	if (!created_)
+	{
+		m_stats.shared_loads++;
+		return AddReference(it->second);
+	}
+
+	AssetEntry entry;
+	entry.kind = kind_;
+	entry.key = key;
+	entry.path = path_;
+	entry.references = 1;
+	AssetHandle asset = m_entries.Create(std::move(entry));
+	m_keys.emplace(std::move(key), asset);
+	m_stats.loads++;
+	return asset;
+}
+
+asset::Task<void> asset::Registry::Load(AssetHandle asset_, MaterialDesc material_)
+{
+	AssetKind kind = m_entries.At(asset_).kind;
+	std::string path = m_entries.At(asset_).path;
+
+	// Every step ends on the main thread, the entry may have moved in the pool while the load was suspended
+	bool failed = false;
+	std::string error;
+	try
+	{
+		if (kind == MeshAsset)
+		{
+			graphics::MeshHandle mesh = co_await LoadMesh(m_loader, m_graphics, path);
+			AssetEntry& entry = m_entries.At(asset_);
+			entry.mesh = mesh;
+			entry.bytes = MeshBytes(m_graphics, mesh);
+		}
+		else if (kind == TextureAsset)
+		{
+			graphics::TextureHandle texture = co_await LoadTexture(m_loader, m_graphics, path);
+			AssetEntry& entry = m_entries.At(asset_);
+			entry.texture = texture;
+			entry.bytes = m_graphics.GetTexture(texture)->memory_size;
+		}
+		else if (kind == ShaderAsset)
+		{
+			memory::AssetFile file = co_await m_loader.ReadFile(m_graphics.ShaderPath(path));
+			co_await m_loader.MainThread();
+			AssetEntry& entry = m_entries.At(asset_);
+			entry.shader = m_graphics.CreateShader(path, file);
+			entry.bytes = file.Size();
+		}
+		else
+			co_await LoadMaterial(asset_, std::move(material_));
+	}
+	catch (const std::exception& e)
+	{
+		failed = true;
+		error = e.what();
+	}
+
+	if (failed)
+		co_await m_loader.MainThread();
+	FinishLoad(asset_, failed ? (error.empty() ? "Asset load failed: " + path : error) : std::string());
+}
+
+asset::Task<void> asset::Registry::LoadMaterial(AssetHandle asset_, MaterialDesc material_)
+{
+	Material material;
+	material.vertex_shader = AcquireShader(material_.vertex_shader);
+	material.fragment_shader = AcquireShader(material_.fragment_shader);
+	for (const std::string& texture : material_.textures)
+		material.textures.push_back(AcquireTexture(texture));
+
+	std::vector<AssetHandle> dependencies = { material.vertex_shader, material.fragment_shader };
+	dependencies.insert(dependencies.end(), material.textures.begin(), material.textures.end());
+
+	// Held from here on, so a failed dependency is released with the material
+	AssetEntry& entry = m_entries.At(asset_);
+	entry.material = std::move(material);
+	entry.dependencies = dependencies;
+
+	// The dependencies load side by side, the material is ready with the last of them
+	for (AssetHandle dependency : dependencies)
+		co_await Ready(dependency);
+}
+
+void asset::Registry::FinishLoad(AssetHandle asset_, const std::string& error_)
+{
+	AssetEntry& entry = m_entries.At(asset_);
+	entry.error = error_;
+	entry.state = error_.empty() ? AssetLoaded : AssetFailed;
+	std::vector<std::coroutine_handle<>> waiters = std::move(entry.waiters);
+
+	if (entry.state == AssetLoaded)
+	{
+		SetLoadedBytes(m_stats.loaded_bytes + entry.bytes);
+		if (entry.references == 0)
+			m_unused.push_back({ asset_, entry.release_serial });
+	}
+	else
+	{
+		m_stats.failed++;
+		if (entry.references == 0)
+			Unload(asset_);
+	}
+
+	for (std::coroutine_handle<> waiter : waiters)
+		waiter.resume();
+}
+
+void asset::Registry::Unload(AssetHandle asset_)
+{
+	PROFILE_FUNCTION();
+	AssetEntry& entry = m_entries.At(asset_);
+	if (entry.kind == MeshAsset)
+		m_graphics.DestroyMesh(entry.mesh);
+	else if (entry.kind == TextureAsset)
+	{
+		memory::AssetFile file = m_graphics.DestroyTexture(entry.texture);
+		if (file.Size() > 0)
+			m_loader.Spawn(CloseFile(m_loader, std::move(file)));
+	}
+	else if (entry.kind == ShaderAsset)
+		m_graphics.DestroyShader(entry.shader);
+
+	if (entry.state == AssetLoaded)
+		SetLoadedBytes(m_stats.loaded_bytes - entry.bytes);
+
+	std::vector<AssetHandle> dependencies = std::move(entry.dependencies);
+	m_keys.erase(entry.key);
+	m_entries.Destroy(asset_);
+	m_stats.unloads++;
+	m_unloads_metric->Add(1);
+
+	for (AssetHandle dependency : dependencies)
+		Release(dependency);
+}
+
+void asset::Registry::SetLoadedBytes(uint64_t loaded_bytes_)
+{
+	m_stats.loaded_bytes = loaded_bytes_;
+	m_loaded_bytes_metric->Set(static_cast<double>(loaded_bytes_));
+}
+
+asset::AssetHandle asset::Registry::AcquireMesh(const std::string& path_)
+{
+	bool created;
+	AssetHandle asset = Acquire(MeshAsset, path_, created);
+	if (created)
+		m_loader.Spawn(Load(asset, {}));
+	return asset;
+}
+
+asset::AssetHandle asset::Registry::AcquireTexture(const std::string& path_)
+{
+	bool created;
+	AssetHandle asset = Acquire(TextureAsset, path_, created);
+	if (created)
+		m_loader.Spawn(Load(asset, {}));
+	return asset;
+}
+
+asset::AssetHandle asset::Registry::AcquireShader(const std::string& file_name_)
+{
+	bool created;
+	AssetHandle asset = Acquire(ShaderAsset, file_name_, created);
+	if (created)
+		m_loader.Spawn(Load(asset, {}));
+	return asset;
+}
+
+asset::AssetHandle asset::Registry::AcquireMaterial(const std::string& name_, const MaterialDesc& material_)
+{
+	bool created;
+	AssetHandle asset = Acquire(MaterialAsset, name_, created);
+	if (created)
+		m_loader.Spawn(Load(asset, material_));
+	return asset;
+}
+
+asset::AssetHandle asset::Registry::AddReference(AssetHandle asset_)
+{
+	AssetEntry* entry = m_entries.Get(asset_);
+	if (entry != nullptr)
+		entry->references++;
+	return asset_;
+}
+
+void asset::Registry::Release(AssetHandle asset_)
+{
+	AssetEntry* entry = m_entries.Get(asset_);
+	if (entry == nullptr || entry->references == 0 || --entry->references > 0)
+		return;
+
+	if (entry->state == AssetFailed)
+	{
+		Unload(asset_);
+		return;
+	}
+
+	// A load in flight is queued when it finishes
+	entry->release_serial = ++m_release_serial;
+	if (entry->state == AssetLoaded)
+		m_unused.push_back({ asset_, entry->release_serial });
+}
+
+void asset::Registry::Update()
+{
+	PROFILE_FUNCTION();
+	uint32_t unloads = 0;
+	while (!m_unused.empty() && unloads < m_budget.unloads_per_frame && m_stats.loaded_bytes > m_budget.memory_bytes)
+	{
+		auto [asset, serial] = m_unused.front();
+		m_unused.pop_front();
+
+		// Acquired again or released again since it was queued
+		const AssetEntry* entry = m_entries.Get(asset);
+		if (entry == nullptr || entry->references > 0 || entry->release_serial != serial)
+			continue;
+
+		Unload(asset);
+		unloads++;
+	}
+
+	// Assets acquired and released every frame leave stale items behind while the budget is not reached
+	if (m_unused.size() > 2 * m_entries.Size() + 64)
+	{
+		auto stale = [&](const std::pair<AssetHandle, uint64_t>& item_)
+		{
+			const AssetEntry* entry = m_entries.Get(item_.first);
+			return entry == nullptr || entry->references > 0 || entry->release_serial != item_.second;
+		};
+		m_unused.erase(std::remove_if(m_unused.begin(), m_unused.end(), stale), m_unused.end());
+	}
+}
+
+void asset::Registry::UnloadUnused()
+{
+	PROFILE_FUNCTION();
+	m_loader.WaitIdle();
+
+	// Unloading a material leaves its dependencies unused, so this runs until nothing is left to unload
+	bool unloaded = true;
+	while (unloaded)
+	{
+		unloaded = false;
+		while (!m_unused.empty())
+		{
+			auto [asset, serial] = m_unused.front();
+			m_unused.pop_front();
+
+			const AssetEntry* entry = m_entries.Get(asset);
+			if (entry == nullptr || entry->references > 0 || entry->release_serial != serial)
+				continue;
+
+			Unload(asset);
+			unloaded = true;
+		}
+	}
+}
+
+bool asset::Registry::IsLoaded(AssetHandle asset_) const
+{
+	const AssetEntry* entry = m_entries.Get(asset_);
+	return entry != nullptr && entry->state == AssetLoaded;
+}
+
+graphics::MeshHandle asset::Registry::GetMesh(AssetHandle asset_) const
+{
+	const AssetEntry* entry = m_entries.Get(asset_);
+	return entry != nullptr && entry->state == AssetLoaded ? entry->mesh : graphics::MeshHandle();
+}
+
+graphics::TextureHandle asset::Registry::GetTexture(AssetHandle asset_) const
+{
+	const AssetEntry* entry = m_entries.Get(asset_);
+	return entry != nullptr && entry->state == AssetLoaded ? entry->texture : graphics::TextureHandle();
+}
+
+graphics::ShaderHandle asset::Registry::GetShader(AssetHandle asset_) const
+{
+	const AssetEntry* entry = m_entries.Get(asset_);
+	return entry != nullptr && entry->state == AssetLoaded ? entry->shader : graphics::ShaderHandle();
+}
+
+const asset::Material* asset::Registry::GetMaterial(AssetHandle asset_) const
+{
+	const AssetEntry* entry = m_entries.Get(asset_);
+	return entry != nullptr && entry->state == AssetLoaded && entry->kind == MaterialAsset ? &entry->material : nullptr;
+}
+
+asset::RegistryStats asset::Registry::Stats() const
+{
+	RegistryStats stats = m_stats;
+	stats.assets = m_entries.Size();
+	stats.budget_bytes = m_budget.memory_bytes;
+	for (const AssetEntry& entry : m_entries)
+		if (entry.references == 0 && entry.state == AssetLoaded)
+			stats.unused++;
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <coroutine>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetLoader.h"
+#include "AssetTask.h"
+#include "../graphics/GraphicsMain.h"
+#include "../memory/MemoryPool.h"
+#include "../profiling/ProfilingMetrics.h"
+
+namespace asset
+{
+	enum AssetKind : uint32_t
+	{
+		MeshAsset,
+		TextureAsset,
+		ShaderAsset,
+		MaterialAsset
+	};
+
+	enum AssetState : uint32_t
+	{
+		AssetLoading,
+		AssetLoaded,
+		AssetFailed
+	};
+
+	struct AssetEntry;
+	using AssetHandle = memory::Handle<AssetEntry>;
+
+	// Shader file names are relative to the shader directory, texture paths to the working directory
+	struct MaterialDesc
+	{
+		std::string vertex_shader;
+		std::string fragment_shader;
+		std::vector<std::string> textures;
+	};
+
+	// Holds a reference on each of its assets while it is loaded
+	struct Material
+	{
+		AssetHandle vertex_shader;
+		AssetHandle fragment_shader;
+		std::vector<AssetHandle> textures;
+	};
+
+	struct AssetEntry
+	{
+		AssetKind kind = MeshAsset;
+		std::string key; // Kind and normalized path, the key of m_keys
+		std::string path;
+		AssetState state = AssetLoading;
+		uint32_t references = 0;
+		uint64_t bytes = 0; // Counted against the budget while loaded
+		uint64_t release_serial = 0; // Of the last release to zero references, stale unused queue items differ
+
+		graphics::MeshHandle mesh;
+		graphics::TextureHandle texture;
+		graphics::ShaderHandle shader;
+		Material material;
+
+		std::vector<AssetHandle> dependencies; // Released when the asset is unloaded
+		std::vector<std::coroutine_handle<>> waiters; // Resumed on the main thread when the load ends
+		std::string error;
+	};
+
+	struct RegistryBudget
+	{
+		uint64_t memory_bytes = 512ull << 20; // Unused assets stay loaded until the loaded ones exceed this
+		uint32_t unloads_per_frame = 64;
+	};
+
+	struct RegistryStats
+	{
+		uint64_t loads = 0; // Started, every path once while it stays loaded
+		uint64_t shared_loads = 0; // Acquires that got an asset already loaded or in flight
+		uint64_t failed = 0;
+		uint64_t unloads = 0;
+		size_t assets = 0;
+		size_t unused = 0; // Loaded without references, unloaded first when over the budget
+		uint64_t loaded_bytes = 0;
+		uint64_t budget_bytes = 0;
+	};
+
+	// Reference counted assets keyed by kind and path. Acquiring a path that is loaded or in flight shares it, so an
+	// asset is loaded once however many users ask for it at the same time. Assets reaching zero references stay loaded
+	// and are unloaded oldest first at the frame boundary while the loaded ones exceed the budget. Unloading releases
+	// the dependencies, a material frees its shaders and textures once no other material uses them.
+	// Main thread only, the loads run on the Loader and finish on the main thread
+	class Registry
+	{
+		// VARIABLES
+	public:
+		// Resumes when the asset finished loading, rethrows its error if it failed
+		struct ReadyAwaiter
+		{
+			Registry& registry;
+			AssetHandle asset;
+
+			bool await_ready() const;
+			void await_suspend(std::coroutine_handle<> handle_);
+			void await_resume() const;
+		};
+
+	private:
+		Loader& m_loader;
+		graphics::GraphicsManager& m_graphics;
+		RegistryBudget m_budget;
+
+		memory::Pool<AssetEntry> m_entries;
+		std::unordered_map<std::string, AssetHandle> m_keys;
+		std::deque<std::pair<AssetHandle, uint64_t>> m_unused; // Release order, items are checked when taken
+		uint64_t m_release_serial = 0;
+		RegistryStats m_stats;
+
+		profiling::Gauge* m_loaded_bytes_metric = nullptr;
+		profiling::Counter* m_unloads_metric = nullptr;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		Registry(Loader& loader_, graphics::GraphicsManager& graphics_) : m_loader(loader_), m_graphics(graphics_) { Initialize(); }
+		~Registry() { Shutdown(); }
+
+		Registry(const Registry&) = delete;
+		Registry& operator=(const Registry&) = delete;
+
+		// METHODES
+	private:
+		void Initialize();
+		void Shutdown();
+
+		// Returns the entry of the key with one more reference, starting its load if it is new. created_ tells which
+		AssetHandle Acquire(AssetKind kind_, const std::string& path_, bool& created_);
+		Task<void> Load(AssetHandle asset_, MaterialDesc material_);
+		Task<void> LoadMaterial(AssetHandle asset_, MaterialDesc material_);
+		void FinishLoad(AssetHandle asset_, const std::string& error_); // An empty error_ means loaded
+		void Unload(AssetHandle asset_);
+		void SetLoadedBytes(uint64_t loaded_bytes_);
+
+	public:
+		// Each returns a new reference the caller releases, the asset may still be loading
+		AssetHandle AcquireMesh(const std::string& path_);
+		AssetHandle AcquireTexture(const std::string& path_);
+		AssetHandle AcquireShader(const std::string& file_name_);
+		AssetHandle AcquireMaterial(const std::string& name_, const MaterialDesc& material_); // Shared by name_, the first acquire's material_ is loaded
+		AssetHandle AddReference(AssetHandle asset_);
+		void Release(AssetHandle asset_); // A failed asset is removed right away, it is retried by the next acquire
+
+		ReadyAwaiter Ready(AssetHandle asset_) { return { *this, asset_ }; }
+		// Frame boundary, called by the engine on the main thread after the loader's steps
+		void Update();
+		// Unloads every unused asset, loads in flight finish first
+		void UnloadUnused();
+
+		const AssetEntry* Get(AssetHandle asset_) const { return m_entries.Get(asset_); }
+		bool IsLoaded(AssetHandle asset_) const;
+		// Null handles while the asset is loading, failed or of another kind
+		graphics::MeshHandle GetMesh(AssetHandle asset_) const;
+		graphics::TextureHandle GetTexture(AssetHandle asset_) const;
+		graphics::ShaderHandle GetShader(AssetHandle asset_) const;
+		const Material* GetMaterial(AssetHandle asset_) const;
+
+		void SetBudget(const RegistryBudget& budget_) { m_budget = budget_; }
+		const RegistryBudget& GetBudget() const { return m_budget; }
+		RegistryStats Stats() const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace asset
+{
+	template<typename T>
+	class Task;
+
+	struct TaskPromiseBase
+	{
+		std::coroutine_handle<> continuation; // Awaiting coroutine, resumed by the final suspend
+		std::exception_ptr error;
+
+		// Transfers straight to the awaiting coroutine instead of returning, so long chains do not grow the stack
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+			template<typename Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle_) noexcept
+			{
+				std::coroutine_handle<> continuation = handle_.promise().continuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		FinalAwaiter final_suspend() noexcept { return {}; }
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	template<typename T>
+	struct TaskPromise : TaskPromiseBase
+	{
+		std::optional<T> value;
+
+		Task<T> get_return_object();
+		void return_value(T value_) { value = std::move(value_); }
+		T Result()
+		{
+			if (error)
+				std::rethrow_exception(error);
+			return std::move(*value);
+		}
+	};
+
+	template<>
+	struct TaskPromise<void> : TaskPromiseBase
+	{
+		Task<void> get_return_object();
+		void return_void() {}
+		void Result()
+		{
+			if (error)
+				std::rethrow_exception(error);
+		}
+	};
+
+	// Lazy coroutine, starts when awaited and resumes the awaiting coroutine on the thread it finished on.
+	// Exceptions are rethrown by co_await. Owns the coroutine frame, a Task must be awaited or given to Loader::Spawn
+	template<typename T = void>
+	class Task
+	{
+		// VARIABLES
+	public:
+		using promise_type = TaskPromise<T>;
+
+	private:
+		std::coroutine_handle<promise_type> m_handle;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		Task() {}
+		explicit Task(std::coroutine_handle<promise_type> handle_) : m_handle(handle_) {}
+		~Task()
+		{
+			if (m_handle)
+				m_handle.destroy();
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+		Task(Task&& other_) noexcept : m_handle(std::exchange(other_.m_handle, {})) {}
+		Task& operator=(Task&& other_) noexcept
+		{
+			if (this != &other_)
+			{
+				if (m_handle)
+					m_handle.destroy();
+				m_handle = std::exchange(other_.m_handle, {});
+			}
+			return *this;
+		}
+
+		// METHODES
+	public:
+		bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting_) noexcept
+		{
+			m_handle.promise().continuation = awaiting_;
+			return m_handle;
+		}
+		T await_resume() { return m_handle.promise().Result(); }
+	};
+
+	template<typename T>
+	Task<T> TaskPromise<T>::get_return_object() { return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this)); }
+
+	inline Task<void> TaskPromise<void>::get_return_object() { return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this)); }
+}
\ No newline at end of file
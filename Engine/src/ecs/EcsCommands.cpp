@@ -0,0 +1,77 @@
+#include "EcsCommands.h"
+
+ecs::Entity ecs::CommandBuffer::Resolve(Entity entity_) const
+{
+	if (entity_.generation == 0 && entity_.index < m_created_entities.size())
+		return m_created_entities[entity_.index];
+	return entity_;
+}
+
+ecs::Entity ecs::CommandBuffer::Create()
+{
+	Entity placeholder = { m_created++, 0 };
+	m_commands.push_back({ CommandCreate, placeholder, 0, 0 });
+	return placeholder;
+}
+
+void ecs::CommandBuffer::Destroy(Entity entity_)
+{
+	m_commands.push_back({ CommandDestroy, entity_, 0, 0 });
+}
+
+void ecs::CommandBuffer::AddComponent(Entity entity_, ComponentId id_, const void* data_)
+{
+	// Values are copied in and out with memcpy, so the byte buffer needs no alignment
+	size_t offset = m_data.size();
+	m_data.resize(offset + Component(id_).size);
+	std::memcpy(m_data.data() + offset, data_, Component(id_).size);
+	m_commands.push_back({ CommandAdd, entity_, id_, offset });
+}
+
+void ecs::CommandBuffer::RemoveComponent(Entity entity_, ComponentId id_)
+{
+	m_commands.push_back({ CommandRemove, entity_, id_, 0 });
+}
+
+void ecs::CommandBuffer::Playback(World& world_)
+{
+	m_created_entities.resize(m_created);
+
+	for (const auto& command : m_commands)
+	{
+		if (command.type == CommandCreate)
+		{
+			m_created_entities[command.entity.index] = world_.Create();
+			continue;
+		}
+
+		Entity entity = Resolve(command.entity);
+		if (!world_.IsAlive(entity))
+			continue;
+
+		switch (command.type)
+		{
+		case CommandDestroy:
+			world_.Destroy(entity);
+			break;
+		case CommandAdd:
+			world_.AddComponent(entity, command.component, m_data.data() + command.data_offset);
+			break;
+		case CommandRemove:
+			world_.RemoveComponent(entity, command.component);
+			break;
+		default:
+			break;
+		}
+	}
+
+	Clear();
+}
+
+void ecs::CommandBuffer::Clear()
+{
+	m_commands.clear();
+	m_data.clear();
+	m_created = 0;
+	m_created_entities.clear();
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "EcsWorld.h"
+
+namespace ecs
+{
+	// Structural changes recorded while queries run, Playback applies them in recording order.
+	// Commands on entities that died in the meantime are skipped
+	class CommandBuffer
+	{
+		// VARIABLES
+	private:
+		enum CommandType : uint8_t
+		{
+			CommandCreate,
+			CommandDestroy,
+			CommandAdd,
+			CommandRemove
+		};
+
+		struct Command
+		{
+			CommandType type;
+			Entity entity;
+			ComponentId component;
+			size_t data_offset; // Component value in m_data for CommandAdd
+		};
+
+		std::vector<Command> m_commands;
+		std::vector<std::byte> m_data;
+		uint32_t m_created = 0;
+		std::vector<Entity> m_created_entities; // Placeholder number to real entity during playback
+
+		// METHODES
+	private:
+		Entity Resolve(Entity entity_) const;
+
+	public:
+		// The returned placeholder is only valid in later commands of the same buffer.
+		// Placeholders use generation 0, which no live entity has
+		Entity Create();
+		void Destroy(Entity entity_);
+		void AddComponent(Entity entity_, ComponentId id_, const void* data_);
+		void RemoveComponent(Entity entity_, ComponentId id_);
+
+		template<typename T> void Add(Entity entity_, const T& component_ = {}) { AddComponent(entity_, ComponentType<T>(), &component_); }
+		template<typename T> void Remove(Entity entity_) { RemoveComponent(entity_, ComponentType<T>()); }
+
+		void Playback(World& world_); // Applies and clears the buffer
+		void Clear();
+		bool Empty() const { return m_commands.empty(); }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "EcsScheduler.h"
+
+#include <algorithm>
+
+void ecs::Scheduler::Initialize(size_t worker_threads_)
+{
+	for (size_t i = 0; i < worker_threads_; i++)
+		m_workers.emplace_back(&Scheduler::WorkerLoop, this, i);
+}
+
+void ecs::Scheduler::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_changed.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+size_t ecs::Scheduler::DefaultWorkerCount()
+{
+	unsigned int hardware_threads = std::thread::hardware_concurrency();
+	return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+void ecs::Scheduler::WorkerLoop(size_t worker_index_)
+{
+	profiling::SetThreadName("ECS worker " + std::to_string(worker_index_));
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_changed.wait(lock, [this]() { return m_stop || !m_ready.empty() || !m_jobs.empty(); });
+		if (m_stop)
+			return;
+
+		// Someone blocks on a parallel job, help there first
+		if (!m_jobs.empty())
+		{
+			std::shared_ptr<ParallelJob> job = m_jobs.front();
+			lock.unlock();
+			HelpJob(*job);
+			lock.lock();
+			auto found = std::find(m_jobs.begin(), m_jobs.end(), job);
+			if (found != m_jobs.end() && job->next.load() >= job->count)
+				m_jobs.erase(found);
+			continue;
+		}
+		RunReady(lock);
+	}
+}
+
+void ecs::Scheduler::RunReady(std::unique_lock<std::mutex>& lock_)
+{
+	size_t index = m_ready.front();
+	m_ready.pop_front();
+	lock_.unlock();
+
+	System& system = m_systems[index];
+	std::exception_ptr error;
+	try
+	{
+		PROFILE_SCOPE(system.name.c_str());
+		SystemContext context = { m_world, system.commands, m_delta_time };
+		system.function(context);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	lock_.lock();
+	if (error && !m_error)
+		m_error = error;
+
+	// Dependents still run after a failure, Run reports the error once everything settled
+	for (size_t dependent : system.dependents)
+		if (--m_pending[dependent] == 0)
+			m_ready.push_back(dependent);
+	m_remaining--;
+
+	if (!m_ready.empty() || m_remaining == 0)
+		m_changed.notify_all();
+}
+
+void ecs::Scheduler::HelpJob(ParallelJob& job_)
+{
+	size_t index;
+	while ((index = job_.next.fetch_add(1)) < job_.count)
+	{
+		try
+		{
+			(*job_.function)(index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!job_.error)
+				job_.error = std::current_exception();
+		}
+
+		if (job_.done.fetch_add(1) + 1 == job_.count)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_changed.notify_all();
+		}
+	}
+}
+
+void ecs::Scheduler::ParallelFor(size_t count_, const std::function<void(size_t)>& function_)
+{
+	if (m_workers.empty() || count_ <= 1)
+	{
+		for (size_t i = 0; i < count_; i++)
+			function_(i);
+		return;
+	}
+
+	std::shared_ptr<ParallelJob> job;
+	{
+		// Workers drop their reference with the lock held, so a job only this list holds is idle
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto free_job = std::find_if(m_free_jobs.begin(), m_free_jobs.end(), [](const std::shared_ptr<ParallelJob>& job_) { return job_.use_count() == 1; });
+		if (free_job != m_free_jobs.end())
+		{
+			job = std::move(*free_job);
+			m_free_jobs.erase(free_job);
+		}
+		else
+		{
+			job = std::make_shared<ParallelJob>();
+		}
+
+		job->function = &function_;
+		job->count = count_;
+		job->next = 0;
+		job->done = 0;
+		job->error = nullptr;
+		m_jobs.push_back(job);
+	}
+	m_changed.notify_all();
+
+	HelpJob(*job);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto found = std::find(m_jobs.begin(), m_jobs.end(), job);
+	if (found != m_jobs.end())
+		m_jobs.erase(found);
+	m_changed.wait(lock, [&job]() { return job->done.load() == job->count; });
+
+	std::exception_ptr error = std::move(job->error);
+	job->error = nullptr;
+	m_free_jobs.push_back(std::move(job));
+	lock.unlock();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void ecs::Scheduler::AddSystem(const std::string& name_, const SystemAccess& access_, SystemFunction function_)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_remaining != 0)
+		throw std::logic_error("Systems cannot be added while the scheduler runs");
+
+	size_t index = m_systems.size();
+	System system;
+	system.name = name_;
+	system.access = access_;
+	system.function = std::move(function_);
+	m_systems.push_back(std::move(system));
+
+	for (size_t i = 0; i < index; i++)
+	{
+		if (m_systems[i].access.ConflictsWith(access_))
+		{
+			m_systems[i].dependents.push_back(index);
+			m_systems[index].dependency_count++;
+		}
+	}
+	m_pending.resize(m_systems.size());
+}
+
+void ecs::Scheduler::Run(double delta_time_)
+{
+	PROFILE_FUNCTION();
+	if (m_systems.empty())
+		return;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_delta_time = delta_time_;
+	m_remaining = m_systems.size();
+	for (size_t i = 0; i < m_systems.size(); i++)
+	{
+		m_pending[i] = m_systems[i].dependency_count;
+		if (m_pending[i] == 0)
+			m_ready.push_back(i);
+	}
+	m_changed.notify_all();
+
+	while (m_remaining > 0)
+	{
+		if (!m_ready.empty())
+			RunReady(lock);
+		else
+			m_changed.wait(lock);
+	}
+
+	std::exception_ptr error = m_error;
+	m_error = nullptr;
+	lock.unlock();
+
+	{
+		PROFILE_SCOPE("Command playback");
+		for (auto& system : m_systems)
+			system.commands.Playback(m_world);
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
\ No newline at end of file
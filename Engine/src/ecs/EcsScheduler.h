@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EcsWorld.h"
+#include "EcsCommands.h"
+#include "../profiling/ProfilingZones.h"
+
+namespace ecs
+{
+	struct SystemContext
+	{
+		World& world;
+		CommandBuffer& commands; // Played back after every system of the run finished
+		double delta_time;
+	};
+
+	using SystemFunction = std::function<void(SystemContext&)>;
+
+	// Components a system touches. Two systems conflict when one writes a component the other reads or writes
+	struct SystemAccess
+	{
+		ComponentMask reads = 0;
+		ComponentMask writes = 0;
+
+		template<typename... Ts> SystemAccess& Read() { reads |= MaskOf<Ts...>(); return *this; }
+		template<typename... Ts> SystemAccess& Write() { writes |= MaskOf<Ts...>(); return *this; }
+
+		bool ConflictsWith(const SystemAccess& other_) const
+		{
+			return (writes & (other_.reads | other_.writes)) != 0 || (other_.writes & reads) != 0;
+		}
+	};
+
+	// Runs systems on a worker pool. A system waits for every earlier added system it conflicts with,
+	// so results match running them one after another in the order they were added
+	class Scheduler
+	{
+		// VARIABLES
+	private:
+		struct System
+		{
+			std::string name;
+			SystemAccess access;
+			SystemFunction function;
+			std::vector<size_t> dependents; // Later systems waiting for this one
+			size_t dependency_count = 0;
+			CommandBuffer commands;
+		};
+
+		// Index range shared by the threads helping with a ParallelFor
+		struct ParallelJob
+		{
+			const std::function<void(size_t)>* function;
+			size_t count;
+			std::atomic<size_t> next = 0;
+			std::atomic<size_t> done = 0;
+			std::exception_ptr error;
+		};
+
+		World& m_world;
+		std::vector<System> m_systems;
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_mutex;
+		std::condition_variable m_changed; // New ready systems or parallel jobs, finished work or shutdown
+		std::deque<size_t> m_ready;
+		std::vector<std::shared_ptr<ParallelJob>> m_jobs; // ParallelFor calls with unclaimed indices
+		std::vector<std::shared_ptr<ParallelJob>> m_free_jobs; // Finished jobs, reused once no worker holds them
+		std::vector<size_t> m_pending; // Unfinished dependencies of every system in the current run
+		size_t m_remaining = 0;
+		double m_delta_time = 0.0;
+		std::exception_ptr m_error; // First exception thrown by a system, rethrown by Run
+		bool m_stop = false;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		// Worker threads besides the thread calling Run, one less than the hardware threads by default
+		Scheduler(World& world_, size_t worker_threads_ = DefaultWorkerCount()) : m_world(world_) { Initialize(worker_threads_); }
+		~Scheduler() { Shutdown(); }
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		// METHODES
+	private:
+		void Initialize(size_t worker_threads_);
+		void Shutdown();
+
+		void WorkerLoop(size_t worker_index_);
+		void RunReady(std::unique_lock<std::mutex>& lock_); // Runs one ready system, called with the lock held
+		void HelpJob(ParallelJob& job_); // Runs job indices until none are left, called without the lock
+
+	public:
+		static size_t DefaultWorkerCount();
+
+		void AddSystem(const std::string& name_, const SystemAccess& access_, SystemFunction function_);
+		// Runs every system once and blocks until all finished, the calling thread helps.
+		// Command buffers are played back afterwards in the order the systems were added
+		void Run(double delta_time_);
+		// Calls function_(i) for every i below count_ on the workers and the calling thread, returns once all finished.
+		// Callable from systems, the first exception is rethrown after the other indices finished
+		void ParallelFor(size_t count_, const std::function<void(size_t)>& function_);
+
+		size_t SystemCount() const { return m_systems.size(); }
+		size_t WorkerCount() const { return m_workers.size(); }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "EcsWorld.h"
+
+#include <mutex>
+
+namespace
+{
+	std::array<ecs::ComponentInfo, ecs::MAX_COMPONENTS> g_components;
+	std::atomic<ecs::ComponentId> g_component_count = 0;
+	std::mutex g_component_mutex;
+
+	size_t AlignUp(size_t value_, size_t alignment_)
+	{
+		return (value_ + alignment_ - 1) / alignment_ * alignment_;
+	}
+}
+
+ecs::ComponentId ecs::detail::RegisterComponent(size_t size_, size_t alignment_, const char* name_)
+{
+	std::lock_guard<std::mutex> lock(g_component_mutex);
+	ComponentId id = g_component_count.load();
+	if (id == MAX_COMPONENTS)
+		throw std::runtime_error("Too many component types, maximum is " + std::to_string(MAX_COMPONENTS));
+	if (alignment_ > COLUMN_ALIGNMENT)
+		throw std::runtime_error(std::string("Component alignment above the column alignment: ") + name_);
+
+	g_components[id] = { size_, alignment_, name_ };
+	g_component_count.store(id + 1);
+	return id;
+}
+
+const ecs::ComponentInfo& ecs::Component(ComponentId id_)
+{
+	return g_components[id_];
+}
+
+ecs::Archetype::Archetype(ComponentMask mask_) : m_mask(mask_)
+{
+	m_columns.fill(NO_COLUMN);
+
+	size_t entity_bytes = sizeof(Entity);
+	for (ComponentId id = 0; id < MAX_COMPONENTS; id++)
+	{
+		if (!Has(id))
+			continue;
+		m_columns[id] = static_cast<uint32_t>(m_components.size());
+		m_components.push_back(id);
+		entity_bytes += Component(id).size;
+	}
+
+	// Leave room for the padding in front of every column
+	size_t padding = COLUMN_ALIGNMENT * m_components.size();
+	m_chunk_capacity = static_cast<uint32_t>((CHUNK_SIZE - padding) / entity_bytes);
+	if (m_chunk_capacity == 0)
+		throw std::runtime_error("Archetype components do not fit into a chunk");
+
+	size_t offset = sizeof(Entity) * m_chunk_capacity;
+	for (ComponentId id : m_components)
+	{
+		offset = AlignUp(offset, COLUMN_ALIGNMENT);
+		m_offsets.push_back(offset);
+		offset += Component(id).size * m_chunk_capacity;
+	}
+}
+
+std::pair<uint32_t, uint32_t> ecs::Archetype::AddRow(Entity entity_)
+{
+	uint32_t chunk_index = static_cast<uint32_t>(m_entity_count / m_chunk_capacity);
+	if (chunk_index == m_chunks.size())
+		m_chunks.push_back({ std::unique_ptr<ChunkBlock>(new ChunkBlock), 0 });
+
+	Chunk& chunk = m_chunks[chunk_index];
+	uint32_t row = chunk.count++;
+	Entities(chunk)[row] = entity_;
+	m_entity_count++;
+
+	return { chunk_index, row };
+}
+
+ecs::Entity ecs::Archetype::RemoveRow(uint32_t chunk_, uint32_t row_)
+{
+	size_t last = m_entity_count - 1;
+	Chunk& last_chunk = m_chunks[last / m_chunk_capacity];
+	uint32_t last_row = static_cast<uint32_t>(last % m_chunk_capacity);
+
+	Entity moved;
+	if (chunk_ != last / m_chunk_capacity || row_ != last_row)
+	{
+		Chunk& chunk = m_chunks[chunk_];
+		moved = Entities(last_chunk)[last_row];
+		Entities(chunk)[row_] = moved;
+		for (ComponentId id : m_components)
+		{
+			size_t size = Component(id).size;
+			std::memcpy(Column(chunk, id) + row_ * size, Column(last_chunk, id) + last_row * size, size);
+		}
+	}
+
+	last_chunk.count--;
+	m_entity_count--;
+	return moved;
+}
+
+ecs::Archetype& ecs::World::FindArchetype(ComponentMask mask_)
+{
+	auto found = m_archetype_map.find(mask_);
+	if (found != m_archetype_map.end())
+		return *found->second;
+
+	m_archetypes.push_back(std::make_unique<Archetype>(mask_));
+	m_archetype_map[mask_] = m_archetypes.back().get();
+	return *m_archetypes.back();
+}
+
+const ecs::EntityRecord& ecs::World::Record(Entity entity_) const
+{
+	if (!IsAlive(entity_))
+		throw std::out_of_range("Stale or invalid entity");
+	return m_entities[entity_.index];
+}
+
+void ecs::World::CheckStructuralChange() const
+{
+	if (m_iterating.load() != 0)
+		throw std::logic_error("Structural change while a query is running, record it in a CommandBuffer");
+}
+
+void ecs::World::RemoveFromArchetype(const EntityRecord& record_)
+{
+	Entity moved = record_.archetype->RemoveRow(record_.chunk, record_.row);
+	if (!moved.IsNull())
+	{
+		m_entities[moved.index].chunk = record_.chunk;
+		m_entities[moved.index].row = record_.row;
+	}
+}
+
+void ecs::World::MoveEntity(Entity entity_, Archetype& target_)
+{
+	EntityRecord& record = m_entities[entity_.index];
+	Archetype& source = *record.archetype;
+
+	auto [chunk, row] = target_.AddRow(entity_);
+	Chunk& source_chunk = source.ChunkAt(record.chunk);
+	Chunk& target_chunk = target_.ChunkAt(chunk);
+	for (ComponentId id : target_.Components())
+	{
+		size_t size = Component(id).size;
+		if (source.Has(id))
+			std::memcpy(target_.Column(target_chunk, id) + row * size, source.Column(source_chunk, id) + record.row * size, size);
+		else
+			std::memset(target_.Column(target_chunk, id) + row * size, 0, size);
+	}
+
+	RemoveFromArchetype(record);
+	record.archetype = &target_;
+	record.chunk = chunk;
+	record.row = row;
+}
+
+ecs::Entity ecs::World::Create(ComponentMask mask_)
+{
+	CheckStructuralChange();
+
+	uint32_t index;
+	if (m_free_entities.empty())
+	{
+		index = static_cast<uint32_t>(m_entities.size());
+		m_entities.emplace_back();
+	}
+	else
+	{
+		index = m_free_entities.back();
+		m_free_entities.pop_back();
+	}
+
+	EntityRecord& record = m_entities[index];
+	Entity entity = { index, record.generation };
+	Archetype& archetype = FindArchetype(mask_);
+	auto [chunk, row] = archetype.AddRow(entity);
+	record.archetype = &archetype;
+	record.chunk = chunk;
+	record.row = row;
+
+	Chunk& chunk_data = archetype.ChunkAt(chunk);
+	for (ComponentId id : archetype.Components())
+		std::memset(archetype.Column(chunk_data, id) + row * Component(id).size, 0, Component(id).size);
+
+	m_entity_count++;
+	return entity;
+}
+
+void ecs::World::Destroy(Entity entity_)
+{
+	CheckStructuralChange();
+	if (!IsAlive(entity_))
+		return;
+
+	EntityRecord& record = m_entities[entity_.index];
+	RemoveFromArchetype(record);
+	record.archetype = nullptr;
+	// Generation 0 is never handed out, see memory::Handle
+	if (++record.generation == 0)
+		record.generation = 1;
+	m_free_entities.push_back(entity_.index);
+	m_entity_count--;
+}
+
+bool ecs::World::IsAlive(Entity entity_) const
+{
+	return entity_.index < m_entities.size()
+		&& m_entities[entity_.index].generation == entity_.generation
+		&& m_entities[entity_.index].archetype != nullptr;
+}
+
+void ecs::World::AddComponent(Entity entity_, ComponentId id_, const void* data_)
+{
+	CheckStructuralChange();
+	const EntityRecord& record = Record(entity_);
+	if (!record.archetype->Has(id_))
+		MoveEntity(entity_, FindArchetype(record.archetype->Mask() | (ComponentMask(1) << id_)));
+	SetComponent(entity_, id_, data_);
+}
+
+void ecs::World::RemoveComponent(Entity entity_, ComponentId id_)
+{
+	CheckStructuralChange();
+	const EntityRecord& record = Record(entity_);
+	if (record.archetype->Has(id_))
+		MoveEntity(entity_, FindArchetype(record.archetype->Mask() & ~(ComponentMask(1) << id_)));
+}
+
+void* ecs::World::GetComponent(Entity entity_, ComponentId id_)
+{
+	if (!IsAlive(entity_))
+		return nullptr;
+	const EntityRecord& record = m_entities[entity_.index];
+	std::byte* column = record.archetype->Column(record.archetype->ChunkAt(record.chunk), id_);
+	return column != nullptr ? column + record.row * Component(id_).size : nullptr;
+}
+
+void ecs::World::SetComponent(Entity entity_, ComponentId id_, const void* data_)
+{
+	void* component = GetComponent(entity_, id_);
+	if (component == nullptr)
+		throw std::out_of_range(std::string("Entity has no component ") + Component(id_).name);
+	std::memcpy(component, data_, Component(id_).size);
+}
\ No newline at end of file
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "../memory/MemoryPool.h"
+
+namespace ecs
+{
+	constexpr size_t MAX_COMPONENTS = 64; // Component types per program, one bit each in a ComponentMask
+	constexpr size_t CHUNK_SIZE = 16 * 1024;
+	constexpr size_t COLUMN_ALIGNMENT = 64; // Every component array in a chunk starts on its own cache line
+
+	using ComponentId = uint32_t;
+	using ComponentMask = uint64_t;
+
+	struct EntityRecord;
+	using Entity = memory::Handle<EntityRecord>;
+
+	struct ComponentInfo
+	{
+		size_t size;
+		size_t alignment;
+		const char* name;
+	};
+
+	namespace detail
+	{
+		ComponentId RegisterComponent(size_t size_, size_t alignment_, const char* name_);
+
+		template<typename T>
+		ComponentId ComponentTypeOf()
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Components are plain data, chunks move them with memcpy");
+			static const ComponentId id = RegisterComponent(sizeof(T), alignof(T), typeid(T).name());
+			return id;
+		}
+	}
+
+	// Ids are handed out on first use, const and non-const T share one
+	template<typename T>
+	ComponentId ComponentType() { return detail::ComponentTypeOf<std::remove_cv_t<T>>(); }
+
+	const ComponentInfo& Component(ComponentId id_);
+
+	template<typename... Ts>
+	ComponentMask MaskOf() { return (ComponentMask(0) | ... | (ComponentMask(1) << ComponentType<Ts>())); }
+
+	// Archetypes having every component of all and none of none
+	struct Query
+	{
+		ComponentMask all = 0;
+		ComponentMask none = 0;
+
+		bool Matches(ComponentMask mask_) const { return (mask_ & all) == all && (mask_ & none) == 0; }
+
+		template<typename... Ts> Query& With() { all |= MaskOf<Ts...>(); return *this; }
+		template<typename... Ts> Query& Without() { none |= MaskOf<Ts...>(); return *this; }
+	};
+
+	struct alignas(COLUMN_ALIGNMENT) ChunkBlock
+	{
+		std::byte bytes[CHUNK_SIZE];
+	};
+
+	struct Chunk
+	{
+		std::unique_ptr<ChunkBlock> block;
+		uint32_t count = 0;
+	};
+
+	// Entities with exactly the same component set. Chunks store the entity handles followed by one array per component,
+	// every chunk but the last is full
+	class Archetype
+	{
+		// VARIABLES
+	private:
+		static constexpr uint32_t NO_COLUMN = 0xFFFFFFFF;
+
+		ComponentMask m_mask;
+		std::vector<ComponentId> m_components;
+		std::array<uint32_t, MAX_COMPONENTS> m_columns; // Column of every component id, NO_COLUMN if absent
+		std::vector<size_t> m_offsets; // Byte offset of every column inside a chunk
+		uint32_t m_chunk_capacity = 0;
+		std::vector<Chunk> m_chunks; // Emptied chunks are kept for reuse
+		size_t m_entity_count = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		explicit Archetype(ComponentMask mask_);
+
+		Archetype(const Archetype&) = delete;
+		Archetype& operator=(const Archetype&) = delete;
+
+		// METHODES
+	public:
+		// Appends an entity with uninitialized components, returns its chunk and row
+		std::pair<uint32_t, uint32_t> AddRow(Entity entity_);
+		// Moves the last entity into the hole and returns it, null handle if the removed row was the last one
+		Entity RemoveRow(uint32_t chunk_, uint32_t row_);
+
+		ComponentMask Mask() const { return m_mask; }
+		const std::vector<ComponentId>& Components() const { return m_components; }
+		bool Has(ComponentId id_) const { return (m_mask >> id_) & 1; }
+
+		uint32_t ChunkCapacity() const { return m_chunk_capacity; }
+		size_t ChunkCount() const { return (m_entity_count + m_chunk_capacity - 1) / m_chunk_capacity; }
+		Chunk& ChunkAt(size_t index_) { return m_chunks[index_]; }
+		size_t EntityCount() const { return m_entity_count; }
+
+		Entity* Entities(Chunk& chunk_) const { return reinterpret_cast<Entity*>(chunk_.block->bytes); }
+		std::byte* Column(Chunk& chunk_, ComponentId id_) const
+		{
+			return Has(id_) ? chunk_.block->bytes + m_offsets[m_columns[id_]] : nullptr;
+		}
+		template<typename T>
+		T* Column(Chunk& chunk_) const { return reinterpret_cast<T*>(Column(chunk_, ComponentType<T>())); }
+	};
+
+	struct EntityRecord
+	{
+		Archetype* archetype = nullptr; // nullptr while the slot is free
+		uint32_t chunk = 0;
+		uint32_t row = 0;
+		uint32_t generation = 1;
+	};
+
+	// Owns all entities and archetypes. Structural changes (create, destroy, add, remove) are not allowed
+	// while a query runs, systems record them in a CommandBuffer instead
+	class World
+	{
+		// VARIABLES
+	private:
+		std::vector<std::unique_ptr<Archetype>> m_archetypes;
+		std::unordered_map<ComponentMask, Archetype*> m_archetype_map;
+		std::vector<EntityRecord> m_entities;
+		std::vector<uint32_t> m_free_entities;
+		size_t m_entity_count = 0;
+		mutable std::atomic<int> m_iterating = 0; // Queries running right now, possibly on several threads
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		World() = default;
+
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		// METHODES
+	private:
+		Archetype& FindArchetype(ComponentMask mask_);
+		const EntityRecord& Record(Entity entity_) const;
+		void MoveEntity(Entity entity_, Archetype& target_);
+		void RemoveFromArchetype(const EntityRecord& record_);
+		void CheckStructuralChange() const;
+
+		struct IterationScope
+		{
+			std::atomic<int>& iterating;
+			explicit IterationScope(std::atomic<int>& iterating_) : iterating(iterating_) { iterating++; }
+			~IterationScope() { iterating--; }
+		};
+
+	public:
+		Entity Create(ComponentMask mask_ = 0); // Components of mask_ are zero initialized
+		template<typename... Ts>
+		Entity Create(const Ts&... components_)
+		{
+			Entity entity = Create(MaskOf<Ts...>());
+			(SetComponent(entity, ComponentType<Ts>(), &components_), ...);
+			return entity;
+		}
+		void Destroy(Entity entity_);
+		bool IsAlive(Entity entity_) const;
+
+		// Adding a component the entity already has overwrites it, removing a missing one does nothing
+		void AddComponent(Entity entity_, ComponentId id_, const void* data_);
+		void RemoveComponent(Entity entity_, ComponentId id_);
+		void* GetComponent(Entity entity_, ComponentId id_);
+		void SetComponent(Entity entity_, ComponentId id_, const void* data_);
+		ComponentMask Mask(Entity entity_) const { return Record(entity_).archetype->Mask(); }
+
+		template<typename T> void Add(Entity entity_, const T& component_ = {}) { AddComponent(entity_, ComponentType<T>(), &component_); }
+		template<typename T> void Remove(Entity entity_) { RemoveComponent(entity_, ComponentType<T>()); }
+		template<typename T> T* Get(Entity entity_) { return static_cast<T*>(GetComponent(entity_, ComponentType<T>())); }
+		template<typename T> bool Has(Entity entity_) const { return IsAlive(entity_) && (Mask(entity_) >> ComponentType<T>()) & 1; }
+
+		size_t EntityCount() const { return m_entity_count; }
+		size_t ArchetypeCount() const { return m_archetypes.size(); }
+
+		// fn_(count, entities, Ts* columns...) once per matching chunk, for loops the compiler can vectorize
+		template<typename... Ts, typename F>
+		void EachChunk(Query query_, F&& fn_)
+		{
+			IterationScope scope(m_iterating);
+			query_.With<Ts...>();
+			for (auto& archetype : m_archetypes)
+			{
+				if (!query_.Matches(archetype->Mask()))
+					continue;
+				for (size_t i = 0; i < archetype->ChunkCount(); i++)
+				{
+					Chunk& chunk = archetype->ChunkAt(i);
+					fn_(static_cast<size_t>(chunk.count), static_cast<const Entity*>(archetype->Entities(chunk)), archetype->template Column<Ts>(chunk)...);
+				}
+			}
+		}
+		template<typename... Ts, typename F>
+		void EachChunk(F&& fn_) { EachChunk<Ts...>(Query{}, std::forward<F>(fn_)); }
+
+		// fn_(entity, Ts&... components) for every matching entity
+		template<typename... Ts, typename F>
+		void Each(Query query_, F&& fn_)
+		{
+			EachChunk<Ts...>(query_, [&fn_](size_t count_, const Entity* entities_, Ts*... columns_)
+			{
+				for (size_t i = 0; i < count_; i++)
+					fn_(entities_[i], columns_[i]...);
+			});
+		}
+		template<typename... Ts, typename F>
+		void Each(F&& fn_) { Each<Ts...>(Query{}, std::forward<F>(fn_)); }
+	};
+}
\ No newline at end of file
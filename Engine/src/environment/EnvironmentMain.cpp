@@ -5,6 +5,7 @@ void environment::EnvironmentManager::Initialize(bool create_window_)
 	if (glfwInit() == GLFW_FALSE)
 	{
 		m_initialized = false;
+		SetupHeadless();
 		return;
 	}
 	
@@ -16,11 +17,31 @@ void environment::EnvironmentManager::Initialize(bool create_window_)
 
 	if (create_window_)
 		WindowCreate(m_window_width, m_window_height, m_window_title, m_window_type);
-	glfwSetFramebufferSizeCallback(m_window, FramebufferResizeCallback);
+
+	if (m_window == nullptr)
+		SetupHeadless();
+}
+
+void environment::EnvironmentManager::SetupHeadless()
+{
+	// Without a window input can still be injected, e.g. from an input replay
+	if (m_input_manager == nullptr)
+		m_input_manager = std::make_shared<InputManager>(nullptr);
+
+	// The requested size becomes the size of the offscreen render targets
+	m_window_state = WindowState();
+	m_window_state.width = m_window_width;
+	m_window_state.height = m_window_height;
+	m_window_state.framebuffer_width = m_window_width;
+	m_window_state.framebuffer_height = m_window_height;
+	m_window_state.generation++;
 }
 
 void environment::EnvironmentManager::Shutdown()
 {
+	if (!m_initialized)
+		return;
+
 	glfwPollEvents();
 	DestroyWindow();
 	glfwTerminate();
@@ -30,7 +51,7 @@ int environment::EnvironmentManager::CreateWindowedWindow()
 {
 	if ((m_window = glfwCreateWindow(m_window_width, m_window_height, m_window_title.c_str(), nullptr, nullptr)) != NULL)
 	{
-		m_input_manager = std::make_shared<InputManager>(m_window);
+		SetupWindow();
 		return environment::EXIT_CODE_OK;
 	}
 
@@ -43,7 +64,7 @@ int environment::EnvironmentManager::CreateFullscreenWindow()
 {
 	if ((m_window = glfwCreateWindow(m_window_width, m_window_height, m_window_title.c_str(), m_monitor, nullptr)) != NULL)
 	{
-		m_input_manager = std::make_shared<InputManager>(m_window);
+		SetupWindow();
 		return environment::EXIT_CODE_OK;
 	}
 
@@ -61,7 +82,7 @@ int environment::EnvironmentManager::CreateBorderlessWindow()
 	glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
 	if ((m_window = glfwCreateWindow(mode->width, mode->height, m_window_title.c_str(), m_monitor, nullptr)) != NULL)
 	{
-		m_input_manager = std::make_shared<InputManager>(m_window);
+		SetupWindow();
 		return environment::EXIT_CODE_OK;
 	}
 
@@ -72,18 +93,90 @@ int environment::EnvironmentManager::CreateBorderlessWindow()
 
 int environment::EnvironmentManager::DestroyWindow()
 {
-	if (m_window_type == environment::NO_WINDOW)
+	if (m_window == nullptr)
 		return environment::EXIT_CODE_FAILURE;
 
 	glfwDestroyWindow(m_window);
+	m_window = nullptr;
 	m_window_type = environment::NO_WINDOW;
+	m_window_state = WindowState();
 	return environment::EXIT_CODE_OK;
 }
 
+void environment::EnvironmentManager::SetupWindow()
+{
+	m_input_manager = std::make_shared<InputManager>(m_window);
+
+	m_window_user_data.environment_manager = this;
+	m_window_user_data.input_manager = m_input_manager.get();
+	glfwSetWindowUserPointer(m_window, &m_window_user_data);
+
+	glfwSetWindowSizeCallback(m_window, WindowSizeCallback);
+	glfwSetFramebufferSizeCallback(m_window, FramebufferResizeCallback);
+	glfwSetWindowFocusCallback(m_window, WindowFocusCallback);
+	glfwSetWindowIconifyCallback(m_window, WindowIconifyCallback);
+
+	// Initial state is queried once, afterwards only callbacks update it
+	glfwGetWindowSize(m_window, &m_window_state.width, &m_window_state.height);
+	glfwGetFramebufferSize(m_window, &m_window_state.framebuffer_width, &m_window_state.framebuffer_height);
+	m_window_state.focused = glfwGetWindowAttrib(m_window, GLFW_FOCUSED) == GLFW_TRUE;
+	m_window_state.minimized = glfwGetWindowAttrib(m_window, GLFW_ICONIFIED) == GLFW_TRUE;
+	UpdateMonitorState();
+	m_window_state.generation++;
+}
+
+void environment::EnvironmentManager::UpdateMonitorState()
+{
+	// GLFW 3.2 has no content scale query, derive it from the physical size of the monitor
+	GLFWmonitor* monitor = glfwGetWindowMonitor(m_window);
+	if (monitor == nullptr)
+		monitor = m_monitor;
+	if (monitor == nullptr)
+		return;
+
+	int width_mm = 0;
+	int height_mm = 0;
+	glfwGetMonitorPhysicalSize(monitor, &width_mm, &height_mm);
+	const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+	if (width_mm > 0 && mode != nullptr)
+		m_window_state.dpi_scale = static_cast<float>(mode->width) / (static_cast<float>(width_mm) / 25.4f) / 96.0f;
+	if (mode != nullptr && mode->refreshRate > 0)
+		m_window_state.refresh_rate = mode->refreshRate;
+}
+
+environment::EnvironmentManager* environment::EnvironmentManager::FromWindow(GLFWwindow* window_)
+{
+	return static_cast<WindowUserData*>(glfwGetWindowUserPointer(window_))->environment_manager;
+}
+
+void environment::EnvironmentManager::WindowSizeCallback(GLFWwindow* window_, int width_, int height_)
+{
+	auto app = FromWindow(window_);
+	app->m_window_state.width = width_;
+	app->m_window_state.height = height_;
+	app->m_window_state.generation++;
+}
+
 void environment::EnvironmentManager::FramebufferResizeCallback(GLFWwindow* window_, int width_, int height_)
 {
-	auto app = reinterpret_cast<EnvironmentManager*>(glfwGetWindowUserPointer(window_));
-	app->m_framebuffer_resized = true;
+	auto app = FromWindow(window_);
+	app->m_window_state.framebuffer_width = width_;
+	app->m_window_state.framebuffer_height = height_;
+	app->m_window_state.generation++;
+}
+
+void environment::EnvironmentManager::WindowFocusCallback(GLFWwindow* window_, int focused_)
+{
+	auto app = FromWindow(window_);
+	app->m_window_state.focused = focused_ == GLFW_TRUE;
+	app->m_window_state.generation++;
+}
+
+void environment::EnvironmentManager::WindowIconifyCallback(GLFWwindow* window_, int iconified_)
+{
+	auto app = FromWindow(window_);
+	app->m_window_state.minimized = iconified_ == GLFW_TRUE;
+	app->m_window_state.generation++;
 }
 
 int environment::EnvironmentManager::WindowCreate(int width_, int height_, std::string title_, WindowType type_)
@@ -115,22 +208,44 @@ int environment::EnvironmentManager::WindowCreate(int width_, int height_, std::
 	}
 }
 
-void environment::EnvironmentManager::ProcessMessages()
-{ 
-	glfwPollEvents();
+void environment::EnvironmentManager::ProcessMessages(bool background_work_)
+{
+	PROFILE_FUNCTION();
+	m_input_manager->UpdateFrame();
+
+	// Window events are still pumped during replay, but input callbacks ignore them
+	if (m_window != nullptr)
+	{
+		if (m_window_state.minimized && background_work_)
+			glfwWaitEventsTimeout(MINIMIZED_WAIT_TIMEOUT);
+		else if (m_window_state.minimized)
+			WaitMessages();
+		else
+			glfwPollEvents();
+	}
+
+	// A minimized frame runs no FrameAction, it is neither recorded nor replayed so a replay runs the recorded frames
+	if (m_window_state.minimized)
+		return;
+
+	m_input_manager->ReplayFrame();
+	m_input_manager->FinishFrame();
+}
+
+void environment::EnvironmentManager::WaitMessages()
+{
+	glfwWaitEvents();
 }
 
 bool environment::EnvironmentManager::ShouldFinish()
 {
-	return glfwWindowShouldClose(m_window);
+	if (m_input_manager->ReplayFinished())
+		return true;
+
+	return m_window != nullptr && glfwWindowShouldClose(m_window);
 }
 
 bool environment::EnvironmentManager::IsWindowCreated()
 {
 	return (m_window == nullptr || m_window_type == environment::NO_WINDOW) ? false : true;
 }
-
-HWND environment::EnvironmentManager::GetWindowHandle()
-{
-	return glfwGetWin32Window(m_window);
-}
\ No newline at end of file
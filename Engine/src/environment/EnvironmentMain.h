@@ -2,14 +2,12 @@
 
 #include <string>
 #include <memory>
-#include <Windows.h>
 
 #define GLFW_INCLUDE_VULKAN
-#define GLFW_EXPOSE_NATIVE_WIN32
 #include "GLFW/glfw3.h"
-#include "GLFW/glfw3native.h"
 
 #include "InputMain.h"
+#include "../profiling/ProfilingZones.h"
 
 namespace environment
 {
@@ -22,16 +20,30 @@ namespace environment
 
 	constexpr int EXIT_CODE_OK = 0;
 	constexpr int EXIT_CODE_FAILURE = -1;
+	constexpr double MINIMIZED_WAIT_TIMEOUT = 1.0 / 60.0; // Seconds a minimized window sleeps while background work is pending
 #pragma endregion
 
 enum WindowType{ NO_WINDOW, WINDOWED, BORDERLESS, FULLSCREEN };
 
+	// Maintained from GLFW callbacks, reading it never calls into GLFW
+	struct WindowState
+	{
+		int width = 0; // Screen coordinates
+		int height = 0;
+		int framebuffer_width = 0; // Pixels
+		int framebuffer_height = 0;
+		float dpi_scale = 1.0f; // Monitor DPI relative to 96
+		int refresh_rate = 60; // Hz of the monitor the window is on
+		bool focused = false;
+		bool minimized = false;
+		uint64_t generation = 0; // Incremented on every change
+	};
+
 	class EnvironmentManager
 	{
 		// VARIABLES
 	private:
 		bool m_initialized = false;
-		bool m_framebuffer_resized = false;
 
 		int m_window_width = 0;
 		int m_window_height = 0;
@@ -41,6 +53,9 @@ enum WindowType{ NO_WINDOW, WINDOWED, BORDERLESS, FULLSCREEN };
 		GLFWmonitor* m_monitor = nullptr;
 		GLFWwindow* m_window = nullptr;
 
+		WindowState m_window_state;
+		WindowUserData m_window_user_data;
+
 		std::shared_ptr<InputManager> m_input_manager;
 
 		// CONSTRUCTORS/DESTRUCTORS
@@ -61,31 +76,31 @@ enum WindowType{ NO_WINDOW, WINDOWED, BORDERLESS, FULLSCREEN };
 		int CreateWindowedWindow();
 		int CreateFullscreenWindow();
 		int CreateBorderlessWindow();
+		void SetupWindow();
+		void SetupHeadless();
+		void UpdateMonitorState();
 
-	public:
+		static EnvironmentManager* FromWindow(GLFWwindow* window_);
+		static void WindowSizeCallback(GLFWwindow* window_, int width_, int height_);
 		static void FramebufferResizeCallback(GLFWwindow* window_, int width_, int height_);
+		static void WindowFocusCallback(GLFWwindow* window_, int focused_);
+		static void WindowIconifyCallback(GLFWwindow* window_, int iconified_);
+
+	public:
 
 		int WindowCreate(int width_, int height_, std::string title_, WindowType type_);
-		void ProcessMessages();
+		// Blocks until the next event instead of polling while the window is minimized,
+		// at most MINIMIZED_WAIT_TIMEOUT if background_work_ such as loads in flight needs the loop to run
+		void ProcessMessages(bool background_work_ = false);
+		void WaitMessages();
 		bool ShouldFinish();
 		bool IsWindowCreated();
-		HWND GetWindowHandle();
-
-		bool &ResizeState() { return m_framebuffer_resized; };
-
-		void UpdateWindowSize() { glfwGetWindowSize(m_window, &m_window_width, &m_window_height); }
+		GLFWwindow* GetWindow() { return m_window; }
 
-		int WindowWidth() 
-		{
-			UpdateWindowSize();
-			return m_window_width; 
-		}
-
-		int WindowHeight() 
-		{
-			UpdateWindowSize();
-			return m_window_height;
-		}
+		const WindowState& Window() const { return m_window_state; }
+		int WindowWidth() const { return m_window_state.width; }
+		int WindowHeight() const { return m_window_state.height; }
+		bool IsMinimized() const { return m_window_state.minimized; }
 
 		std::shared_ptr<InputManager> Input() { return m_input_manager; }
 	};
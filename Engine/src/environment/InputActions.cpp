@@ -0,0 +1,152 @@
+#include "InputActions.h"
+#include "InputMain.h"
+
+void environment::ActionMap::DeclareAction(ActionId id_, const std::string& name_)
+{
+	if (id_ >= m_states.size())
+	{
+		m_action_names.resize(id_ + 1);
+		m_states.resize(id_ + 1);
+	}
+
+	m_action_names[id_] = name_;
+	m_action_ids[name_] = id_;
+	m_resolved = false;
+}
+
+void environment::ActionMap::Bind(ActionId id_, const InputBinding& binding_)
+{
+	// Evaluate indexes the joystick state and its axes and buttons with these unchecked
+	if (binding_.joystick < 0 || binding_.joystick > GLFW_JOYSTICK_LAST)
+		throw std::runtime_error("Input binding joystick " + std::to_string(binding_.joystick) + " is out of range");
+	if (binding_.code < 0)
+		throw std::runtime_error("Input binding code " + std::to_string(binding_.code) + " is negative");
+
+	if (id_ >= m_states.size())
+		DeclareAction(id_, "");
+
+	m_pending_bindings.emplace_back(id_, binding_);
+	m_resolved = false;
+}
+
+bool environment::ActionMap::Bind(const std::string& name_, const InputBinding& binding_)
+{
+	auto id = m_action_ids.find(name_);
+	if (id == m_action_ids.end())
+		return false;
+
+	Bind(id->second, binding_);
+	return true;
+}
+
+void environment::ActionMap::ClearBindings()
+{
+	m_pending_bindings.clear();
+	m_resolved = false;
+}
+
+void environment::ActionMap::Resolve()
+{
+	m_bindings.clear();
+	m_binding_offsets.assign(m_states.size() + 1, 0);
+	m_used_joysticks.clear();
+
+	// Counting sort of the bindings by action
+	for (const auto& pending : m_pending_bindings)
+		m_binding_offsets[pending.first + 1]++;
+	for (size_t i = 1; i < m_binding_offsets.size(); i++)
+		m_binding_offsets[i] += m_binding_offsets[i - 1];
+
+	m_bindings.resize(m_pending_bindings.size());
+	std::vector<uint32_t> cursor(m_binding_offsets.begin(), m_binding_offsets.end() - 1);
+	for (const auto& pending : m_pending_bindings)
+	{
+		m_bindings[cursor[pending.first]++] = pending.second;
+
+		bool gamepad = pending.second.source == GamepadButtonBinding || pending.second.source == GamepadAxisBinding;
+		if (gamepad && std::find(m_used_joysticks.begin(), m_used_joysticks.end(), pending.second.joystick) == m_used_joysticks.end())
+			m_used_joysticks.push_back(pending.second.joystick);
+	}
+
+	m_resolved = true;
+}
+
+float environment::ActionMap::ApplyDeadZone(float value_, float dead_zone_)
+{
+	float magnitude = std::abs(value_);
+	if (magnitude <= dead_zone_)
+		return 0.0f;
+
+	// Rescale so the output starts at 0 on the edge of the dead zone
+	return std::copysign((magnitude - dead_zone_) / (1.0f - dead_zone_), value_);
+}
+
+void environment::ActionMap::Evaluate(const InputManager& input_)
+{
+	if (!m_resolved)
+		Resolve();
+
+	// Joystick state is fetched once per frame for every joystick any binding uses
+	struct JoystickState
+	{
+		const float* axes = nullptr;
+		const unsigned char* buttons = nullptr;
+		int axis_count = 0;
+		int button_count = 0;
+	} joysticks[GLFW_JOYSTICK_LAST + 1];
+
+	// Joysticks are polled rather than event driven, so they are left out of replays to keep them deterministic
+	for (int joystick : m_used_joysticks)
+	{
+		if (input_.IsReplaying() || glfwJoystickPresent(joystick) == GLFW_FALSE)
+			continue;
+		joysticks[joystick].axes = glfwGetJoystickAxes(joystick, &joysticks[joystick].axis_count);
+		joysticks[joystick].buttons = glfwGetJoystickButtons(joystick, &joysticks[joystick].button_count);
+	}
+
+	for (size_t action = 0; action < m_states.size(); action++)
+	{
+		float value = 0.0f;
+		for (uint32_t i = m_binding_offsets[action]; i < m_binding_offsets[action + 1]; i++)
+		{
+			const InputBinding& binding = m_bindings[i];
+
+			switch (binding.source)
+			{
+			case KeyBinding:
+				if (input_.KeyPressed(binding.code))
+					value += binding.scale;
+				break;
+
+			case MouseButtonBinding:
+				if (input_.MouseButtonPressed(binding.code))
+					value += binding.scale;
+				break;
+
+			case GamepadButtonBinding:
+			{
+				const JoystickState& joystick = joysticks[binding.joystick];
+				if (binding.code < joystick.button_count && joystick.buttons[binding.code] == GLFW_PRESS)
+					value += binding.scale;
+				break;
+			}
+
+			case GamepadAxisBinding:
+			{
+				const JoystickState& joystick = joysticks[binding.joystick];
+				if (binding.code < joystick.axis_count)
+					value += ApplyDeadZone(joystick.axes[binding.code], binding.dead_zone) * binding.scale;
+				break;
+			}
+			}
+		}
+
+		ActionState& state = m_states[action];
+		bool was_active = state.active;
+
+		state.value = std::clamp(value, -1.0f, 1.0f);
+		state.active = state.value != 0.0f;
+		state.pressed = state.active && !was_active;
+		state.released = !state.active && was_active;
+	}
+}
\ No newline at end of file
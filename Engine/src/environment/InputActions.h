@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#define GLFW_INCLUDE_VULKAN
+#include "GLFW/glfw3.h"
+
+namespace environment
+{
+	class InputManager;
+
+	// Games declare their actions as an enum, the enum values index straight into the state block
+	using ActionId = uint16_t;
+
+	enum BindingSource : uint8_t
+	{
+		KeyBinding,
+		MouseButtonBinding,
+		GamepadButtonBinding,
+		GamepadAxisBinding
+	};
+
+	struct InputBinding
+	{
+		BindingSource source = KeyBinding;
+		int code = 0; // Key id, mouse button, joystick button or joystick axis index
+		float scale = 1.0f; // Value contributed while active, -1 makes a key drive the negative side of an axis
+		float dead_zone = 0.0f; // Only used by axes, values inside it read as 0
+		int joystick = GLFW_JOYSTICK_1;
+	};
+
+	struct ActionState
+	{
+		float value = 0.0f; // Sum of all bindings clamped to [-1, 1]
+		bool active = false;
+		bool pressed = false; // Became active this frame
+		bool released = false; // Became inactive this frame
+	};
+
+	class ActionMap
+	{
+		// VARIABLES
+	private:
+		bool m_resolved = false;
+
+		// Load time tables
+		std::vector<std::string> m_action_names;
+		std::unordered_map<std::string, ActionId> m_action_ids;
+		std::vector<std::pair<ActionId, InputBinding>> m_pending_bindings;
+
+		// Flat tables built by Resolve, bindings of action i are [m_binding_offsets[i], m_binding_offsets[i + 1])
+		std::vector<InputBinding> m_bindings;
+		std::vector<uint32_t> m_binding_offsets;
+		std::vector<int> m_used_joysticks;
+
+		std::vector<ActionState> m_states;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		ActionMap() {}
+		~ActionMap() {}
+
+		// METHODES
+	private:
+		static float ApplyDeadZone(float value_, float dead_zone_);
+
+	public:
+		void DeclareAction(ActionId id_, const std::string& name_);
+		void Bind(ActionId id_, const InputBinding& binding_); // Throws for a joystick out of range or a negative code
+		bool Bind(const std::string& name_, const InputBinding& binding_); // Returns false for undeclared action names
+		void ClearBindings();
+		void Resolve(); // Flattens the bindings into lookup arrays, called automatically on the first Evaluate after a change
+
+		void Evaluate(const InputManager& input_); // Called once per frame after events were polled
+
+		const ActionState& State(ActionId id_) const { return m_states[id_]; }
+		bool Active(ActionId id_) const { return m_states[id_].active; }
+		float Value(ActionId id_) const { return m_states[id_].value; }
+
+		const std::string& ActionName(ActionId id_) const { return m_action_names[id_]; }
+		size_t ActionCount() const { return m_states.size(); }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace environment
+{
+	using InputClock = std::chrono::steady_clock;
+
+	// Nanoseconds on the monotonic input clock
+	inline int64_t InputTimestamp()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(InputClock::now().time_since_epoch()).count();
+	}
+
+	enum InputEventType : uint8_t
+	{
+		KeyEvent,
+		MouseButtonEvent,
+		CursorEvent,
+		ScrollEvent,
+		CharEvent
+	};
+
+	struct InputEvent
+	{
+		int64_t timestamp = 0;
+		InputEventType type = KeyEvent;
+		int code = 0;	// Key id, mouse button id or unicode codepoint
+		int action = 0;	// GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+		int mods = 0;
+		double x = 0.0;	// Cursor position or scroll offset
+		double y = 0.0;
+	};
+
+	// Single producer / single consumer lock-free ring buffer, capacity must be a power of two
+	template<typename T, size_t Capacity>
+	class RingBuffer
+	{
+		static_assert((Capacity & (Capacity - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+		// VARIABLES
+	private:
+		std::array<T, Capacity> m_items;
+		alignas(64) std::atomic<size_t> m_head = 0; // Next slot to read, owned by the consumer
+		alignas(64) std::atomic<size_t> m_tail = 0; // Next slot to write, owned by the producer
+
+		// METHODES
+	public:
+		bool Push(const T& item_)
+		{
+			size_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+				return false;
+
+			m_items[tail & (Capacity - 1)] = item_;
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		const T* Peek() const
+		{
+			size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail.load(std::memory_order_acquire))
+				return nullptr;
+
+			return &m_items[head & (Capacity - 1)];
+		}
+
+		bool Pop(T& item_)
+		{
+			size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tail.load(std::memory_order_acquire))
+				return false;
+
+			item_ = m_items[head & (Capacity - 1)];
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		size_t Size() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+		bool Empty() const { return Size() == 0; }
+	};
+
+	struct InputLatencyStats
+	{
+		int64_t last_ns = 0;
+		int64_t min_ns = 0;
+		int64_t max_ns = 0;
+		double average_ns = 0.0; // Exponential moving average
+		uint64_t samples = 0;
+		uint64_t dropped_events = 0; // Events lost because the queue was full
+	};
+}
\ No newline at end of file
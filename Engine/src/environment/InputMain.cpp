@@ -2,39 +2,230 @@
 
 void environment::InputManager::Initialize()
 {
+	m_queue_depth_metric = &profiling::Metrics().AddGauge("input_event_queue_depth", "Input events queued at the end of event polling");
+	m_dropped_events_metric = &profiling::Metrics().AddCounter("input_events_dropped_total", "Input events lost to a full event queue");
+
 	if (m_window == nullptr)
 		return;
 
-	glfwSetWindowUserPointer(m_window, this);
 	glfwSetKeyCallback(m_window, KeyCallback);
+	glfwSetMouseButtonCallback(m_window, MouseButtonCallback);
+	glfwSetCursorPosCallback(m_window, CursorCallback);
+	glfwSetScrollCallback(m_window, ScrollCallback);
+	glfwSetCharCallback(m_window, CharCallback);
 
 	m_initialized = true;
 }
 
 void environment::InputManager::Shutdown()
 {
-	glfwSetWindowUserPointer(m_window, nullptr);
 	m_initialized = false;
 }
 
-bool environment::InputManager::KeyPressed(int key_id_)
+void environment::InputManager::UpdateFrame()
+{
+	m_key_state_previous = m_key_state;
+	m_mouse_state_previous = m_mouse_state;
+}
+
+bool environment::InputManager::ReplayFrame()
+{
+	if (m_player == nullptr)
+		return false;
+
+	if (m_player->NextFrame(m_replay_events, m_frame_time))
+		for (const auto& event : m_replay_events)
+			InjectEvent(event);
+
+	return true;
+}
+
+void environment::InputManager::FinishFrame()
+{
+	if (m_player == nullptr)
+		m_frame_time = InputTimestamp();
+
+	if (m_recorder != nullptr)
+		m_recorder->RecordFrame(m_frame_time);
+
+	m_actions.Evaluate(*this);
+
+	m_queue_depth_metric->Set(static_cast<double>(m_events.Size()));
+}
+
+void environment::InputManager::StartRecording(const std::string& file_name_)
+{
+	m_recorder = std::make_unique<InputRecorder>(file_name_);
+}
+
+void environment::InputManager::StartReplay(const std::string& file_name_)
+{
+	m_player = std::make_unique<InputPlayer>(file_name_);
+}
+
+bool environment::InputManager::KeyPressed(int key_id_) const
+{
+	return IsKeyValid(key_id_) && m_key_state.test(key_id_);
+}
+
+bool environment::InputManager::KeyDown(int key_id_) const
+{
+	return IsKeyValid(key_id_) && m_key_state.test(key_id_) && !m_key_state_previous.test(key_id_);
+}
+
+bool environment::InputManager::KeyUp(int key_id_) const
+{
+	return IsKeyValid(key_id_) && !m_key_state.test(key_id_) && m_key_state_previous.test(key_id_);
+}
+
+bool environment::InputManager::KeyHeld(int key_id_) const
+{
+	return IsKeyValid(key_id_) && m_key_state.test(key_id_) && m_key_state_previous.test(key_id_);
+}
+
+bool environment::InputManager::MouseButtonPressed(int button_id_) const
+{
+	return IsMouseButtonValid(button_id_) && m_mouse_state.test(button_id_);
+}
+
+bool environment::InputManager::MouseButtonDown(int button_id_) const
+{
+	return IsMouseButtonValid(button_id_) && m_mouse_state.test(button_id_) && !m_mouse_state_previous.test(button_id_);
+}
+
+bool environment::InputManager::MouseButtonUp(int button_id_) const
 {
-	return m_key_map[key_id_];
+	return IsMouseButtonValid(button_id_) && !m_mouse_state.test(button_id_) && m_mouse_state_previous.test(button_id_);
 }
 
 void environment::InputManager::KeyCallback(GLFWwindow* window_, int key_id_, int scancode_, int action_, int mods_)
 {
-	InputManager* input_manager = (InputManager*)glfwGetWindowUserPointer(window_);
+	InputManager* input_manager = static_cast<WindowUserData*>(glfwGetWindowUserPointer(window_))->input_manager;
 
-	if (action_ == GLFW_PRESS)
-		input_manager->SetKeyState(key_id_, true);
-	else if (action_ == GLFW_RELEASE)
-		input_manager->SetKeyState(key_id_, false);
+	input_manager->PushEvent(KeyEvent, key_id_, action_, mods_);
+}
+
+void environment::InputManager::MouseButtonCallback(GLFWwindow* window_, int button_id_, int action_, int mods_)
+{
+	InputManager* input_manager = static_cast<WindowUserData*>(glfwGetWindowUserPointer(window_))->input_manager;
+
+	input_manager->PushEvent(MouseButtonEvent, button_id_, action_, mods_);
+}
+
+void environment::InputManager::CursorCallback(GLFWwindow* window_, double x_, double y_)
+{
+	InputManager* input_manager = static_cast<WindowUserData*>(glfwGetWindowUserPointer(window_))->input_manager;
+	input_manager->PushEvent(CursorEvent, 0, 0, input_manager->m_modifiers, x_, y_);
+}
+
+void environment::InputManager::ScrollCallback(GLFWwindow* window_, double x_offset_, double y_offset_)
+{
+	InputManager* input_manager = static_cast<WindowUserData*>(glfwGetWindowUserPointer(window_))->input_manager;
+	input_manager->PushEvent(ScrollEvent, 0, 0, input_manager->m_modifiers, x_offset_, y_offset_);
+}
+
+void environment::InputManager::CharCallback(GLFWwindow* window_, unsigned int codepoint_)
+{
+	InputManager* input_manager = static_cast<WindowUserData*>(glfwGetWindowUserPointer(window_))->input_manager;
+	input_manager->PushEvent(CharEvent, static_cast<int>(codepoint_), 0, input_manager->m_modifiers);
+}
+
+void environment::InputManager::PushEvent(InputEventType type_, int code_, int action_, int mods_, double x_, double y_)
+{
+	// Live input would break the determinism of a replay
+	if (m_player != nullptr)
+		return;
+
+	InputEvent event;
+	event.timestamp = InputTimestamp();
+	event.type = type_;
+	event.code = code_;
+	event.action = action_;
+	event.mods = mods_;
+	event.x = x_;
+	event.y = y_;
+
+	InjectEvent(event);
+}
+
+void environment::InputManager::InjectEvent(const InputEvent& event_)
+{
+	if (event_.type == KeyEvent || event_.type == MouseButtonEvent)
+	{
+		m_modifiers = event_.mods;
+
+		// GLFW_REPEAT leaves the state untouched
+		if (event_.action == GLFW_PRESS || event_.action == GLFW_RELEASE)
+		{
+			if (event_.type == KeyEvent)
+				SetKeyState(event_.code, event_.action == GLFW_PRESS);
+			else
+				SetMouseButtonState(event_.code, event_.action == GLFW_PRESS);
+		}
+	}
+
+	if (m_recorder != nullptr)
+		m_recorder->RecordEvent(event_);
+
+	if (!m_events.Push(event_))
+	{
+		m_latency_stats.dropped_events++;
+		m_dropped_events_metric->Add();
+	}
+}
+
+bool environment::InputManager::PopEvent(int64_t until_timestamp_, InputEvent& event_)
+{
+	const InputEvent* next = m_events.Peek();
+	if (next == nullptr || next->timestamp >= until_timestamp_)
+		return false;
+
+	m_events.Pop(event_);
+	if (m_oldest_unpresented_event == 0)
+		m_oldest_unpresented_event = event_.timestamp;
+
+	return true;
+}
+
+void environment::InputManager::MarkPresented()
+{
+	// Replayed timestamps come from another session, a latency against the live clock would be meaningless
+	if (m_oldest_unpresented_event == 0 || m_player != nullptr)
+	{
+		m_oldest_unpresented_event = 0;
+		return;
+	}
+
+	int64_t latency = InputTimestamp() - m_oldest_unpresented_event;
+	m_oldest_unpresented_event = 0;
+
+	m_latency_stats.last_ns = latency;
+	if (m_latency_stats.samples == 0)
+	{
+		m_latency_stats.min_ns = latency;
+		m_latency_stats.max_ns = latency;
+		m_latency_stats.average_ns = static_cast<double>(latency);
+	}
+	else
+	{
+		m_latency_stats.min_ns = std::min(m_latency_stats.min_ns, latency);
+		m_latency_stats.max_ns = std::max(m_latency_stats.max_ns, latency);
+		m_latency_stats.average_ns += (static_cast<double>(latency) - m_latency_stats.average_ns) * 0.1;
+	}
+	m_latency_stats.samples++;
 }
 
 void environment::InputManager::SetKeyState(int key_id_, bool pressed_)
 {
-	m_key_map[key_id_] = pressed_;
+	// GLFW_KEY_UNKNOWN (-1) is reported for keys without a key code
+	if (IsKeyValid(key_id_))
+		m_key_state.set(key_id_, pressed_);
+}
+
+void environment::InputManager::SetMouseButtonState(int button_id_, bool pressed_)
+{
+	if (IsMouseButtonValid(button_id_))
+		m_mouse_state.set(button_id_, pressed_);
 }
 
 std::string environment::InputManager::KeyName(int key_id_)
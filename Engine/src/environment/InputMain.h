@@ -1,20 +1,61 @@
 #pragma once
 
-#include <map>
+#include <algorithm>
+#include <bitset>
+#include <memory>
 #include <string>
 
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
 
+#include "InputActions.h"
+#include "InputEvents.h"
+#include "InputRecord.h"
+#include "../profiling/ProfilingMetrics.h"
+
 namespace environment
 {
+	constexpr int KEY_COUNT = GLFW_KEY_LAST + 1;
+	constexpr int MOUSE_BUTTON_COUNT = GLFW_MOUSE_BUTTON_LAST + 1;
+	constexpr size_t INPUT_EVENT_QUEUE_SIZE = 4096;
+
+	class EnvironmentManager;
+	class InputManager;
+
+	// GLFW has a single user pointer per window, every manager installing window callbacks finds itself through this
+	struct WindowUserData
+	{
+		EnvironmentManager* environment_manager = nullptr;
+		InputManager* input_manager = nullptr;
+	};
 
 	class InputManager
 	{
 		// VARIABLES
 	private:
 		bool m_initialized = false;
-		std::map<int, bool> m_key_map;
+
+		// Current state is written by GLFW callbacks, previous state is a copy taken at the start of every frame
+		std::bitset<KEY_COUNT> m_key_state;
+		std::bitset<KEY_COUNT> m_key_state_previous;
+		std::bitset<MOUSE_BUTTON_COUNT> m_mouse_state;
+		std::bitset<MOUSE_BUTTON_COUNT> m_mouse_state_previous;
+		int m_modifiers = 0;
+
+		// Every event in arrival order, drained by the game per simulation tick
+		RingBuffer<InputEvent, INPUT_EVENT_QUEUE_SIZE> m_events;
+		int64_t m_oldest_unpresented_event = 0; // Timestamp of the oldest event consumed since the last present
+		InputLatencyStats m_latency_stats;
+		profiling::Gauge* m_queue_depth_metric = nullptr;
+		profiling::Counter* m_dropped_events_metric = nullptr;
+
+		ActionMap m_actions;
+
+		// Recording and replay, while replaying the frame time comes from the log instead of the clock
+		int64_t m_frame_time = 0;
+		std::unique_ptr<InputRecorder> m_recorder;
+		std::unique_ptr<InputPlayer> m_player;
+		std::vector<InputEvent> m_replay_events;
 
 		GLFWwindow* m_window = nullptr;
 
@@ -29,11 +70,55 @@ namespace environment
 		void Shutdown();
 
 		void SetKeyState(int key_id_, bool pressed_);
+		void SetMouseButtonState(int button_id_, bool pressed_);
+		void PushEvent(InputEventType type_, int code_, int action_, int mods_, double x_ = 0.0, double y_ = 0.0);
 
 		static void KeyCallback(GLFWwindow* window_, int key_id_, int scancode_, int action_, int mods_);
+		static void MouseButtonCallback(GLFWwindow* window_, int button_id_, int action_, int mods_);
+		static void CursorCallback(GLFWwindow* window_, double x_, double y_);
+		static void ScrollCallback(GLFWwindow* window_, double x_offset_, double y_offset_);
+		static void CharCallback(GLFWwindow* window_, unsigned int codepoint_);
+
+		static bool IsKeyValid(int key_id_) { return key_id_ >= 0 && key_id_ < KEY_COUNT; }
+		static bool IsMouseButtonValid(int button_id_) { return button_id_ >= 0 && button_id_ < MOUSE_BUTTON_COUNT; }
 
 	public:
-		bool KeyPressed(int key_id_); // Returns the state of the key. True - pressed, False - not pressed
+		void UpdateFrame(); // Must be called once per frame before polling events, starts a new edge detection frame
+		bool ReplayFrame(); // Injects the next recorded frame instead of polling events, false when not replaying
+		void FinishFrame(); // Must be called once per frame after polling events, stamps the frame and evaluates actions
+
+		void InjectEvent(const InputEvent& event_); // Applies an event exactly like the GLFW callbacks do
+
+		void StartRecording(const std::string& file_name_);
+		void StopRecording() { m_recorder.reset(); }
+		void StartReplay(const std::string& file_name_);
+		bool IsRecording() const { return m_recorder != nullptr; }
+		bool IsReplaying() const { return m_player != nullptr; }
+		bool ReplayFinished() const { return m_player != nullptr && m_player->Finished(); }
+
+		int64_t FrameTime() const { return m_frame_time; } // Input clock time of the current frame, recorded or replayed
+
+		bool KeyPressed(int key_id_) const; // Returns the state of the key. True - pressed, False - not pressed
+		bool KeyDown(int key_id_) const; // True only on the frame the key went down
+		bool KeyUp(int key_id_) const; // True only on the frame the key was released
+		bool KeyHeld(int key_id_) const; // True if the key was down on the previous frame and is still down
+
+		bool MouseButtonPressed(int button_id_) const;
+		bool MouseButtonDown(int button_id_) const;
+		bool MouseButtonUp(int button_id_) const;
+
+		int Modifiers() const { return m_modifiers; } // GLFW_MOD_* bits of the last key or mouse button event
+		bool ModifierActive(int modifier_) const { return (m_modifiers & modifier_) != 0; }
+
+		bool PopEvent(int64_t until_timestamp_, InputEvent& event_); // Pops the oldest event with timestamp < until_timestamp_
+		size_t QueuedEvents() const { return m_events.Size(); }
+
+		void MarkPresented(); // Called after a frame is presented, closes the input-to-present latency sample
+		const InputLatencyStats& LatencyStats() const { return m_latency_stats; }
+
+		ActionMap& Actions() { return m_actions; }
+		const ActionState& Action(ActionId id_) const { return m_actions.State(id_); }
+
 		std::string KeyName(int key_id_);
 	};
 
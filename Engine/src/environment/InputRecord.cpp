@@ -0,0 +1,143 @@
+#include "InputRecord.h"
+
+environment::InputRecorder::InputRecorder(const std::string& file_name_)
+{
+	m_file.open(file_name_, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!m_file.is_open())
+		throw std::runtime_error("Unable to open input log for writing: " + file_name_);
+
+	m_file.write(reinterpret_cast<const char*>(&INPUT_LOG_MAGIC), sizeof(INPUT_LOG_MAGIC));
+	m_file.write(reinterpret_cast<const char*>(&INPUT_LOG_VERSION), sizeof(INPUT_LOG_VERSION));
+}
+
+void environment::InputRecorder::WriteVarint(uint64_t value_)
+{
+	uint8_t bytes[10];
+	size_t count = 0;
+	do
+	{
+		bytes[count] = static_cast<uint8_t>(value_ & 0x7F);
+		value_ >>= 7;
+		if (value_ != 0)
+			bytes[count] |= 0x80;
+		count++;
+	} while (value_ != 0);
+
+	m_file.write(reinterpret_cast<const char*>(bytes), count);
+}
+
+void environment::InputRecorder::WriteTime(int64_t time_)
+{
+	// Timestamps come from a monotonic clock, so deltas are never negative
+	WriteVarint(static_cast<uint64_t>(time_ - m_last_time));
+	m_last_time = time_;
+}
+
+void environment::InputRecorder::RecordEvent(const InputEvent& event_)
+{
+	m_file.put(static_cast<char>(EventRecord + static_cast<int>(event_.type)));
+	WriteTime(event_.timestamp);
+	WriteVarint((static_cast<uint64_t>(event_.code) << 1) ^ static_cast<uint64_t>(event_.code >> 31));
+	m_file.put(static_cast<char>(event_.action));
+	m_file.put(static_cast<char>(event_.mods));
+
+	if (event_.type == CursorEvent || event_.type == ScrollEvent)
+	{
+		m_file.write(reinterpret_cast<const char*>(&event_.x), sizeof(event_.x));
+		m_file.write(reinterpret_cast<const char*>(&event_.y), sizeof(event_.y));
+	}
+}
+
+void environment::InputRecorder::RecordFrame(int64_t frame_time_)
+{
+	m_file.put(static_cast<char>(FrameRecord));
+	WriteTime(frame_time_);
+	m_frames++;
+}
+
+environment::InputPlayer::InputPlayer(const std::string& file_name_)
+{
+	std::ifstream input_file(file_name_, std::ios::binary | std::ios::ate | std::ios::in);
+	if (!input_file.is_open())
+		throw std::runtime_error("Unable to open input log: " + file_name_);
+
+	size_t file_size = static_cast<size_t>(input_file.tellg());
+	m_data.resize(file_size);
+	input_file.seekg(0);
+	input_file.read(reinterpret_cast<char*>(m_data.data()), file_size);
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	if (file_size >= sizeof(magic) + sizeof(version))
+	{
+		memcpy(&magic, m_data.data(), sizeof(magic));
+		memcpy(&version, m_data.data() + sizeof(magic), sizeof(version));
+	}
+	if (magic != INPUT_LOG_MAGIC || version != INPUT_LOG_VERSION)
+		throw std::runtime_error("Invalid input log: " + file_name_);
+
+	m_position = sizeof(magic) + sizeof(version);
+}
+
+uint64_t environment::InputPlayer::ReadVarint()
+{
+	uint64_t value = 0;
+	for (int shift = 0; m_position < m_data.size() && shift < 64; shift += 7)
+	{
+		uint8_t byte = m_data[m_position++];
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return value;
+	}
+
+	throw std::runtime_error("Truncated input log");
+}
+
+int64_t environment::InputPlayer::ReadTime()
+{
+	m_last_time += static_cast<int64_t>(ReadVarint());
+	return m_last_time;
+}
+
+bool environment::InputPlayer::NextFrame(std::vector<InputEvent>& events_, int64_t& frame_time_)
+{
+	events_.clear();
+	while (m_position < m_data.size())
+	{
+		uint8_t tag = m_data[m_position++];
+		if (tag == FrameRecord)
+		{
+			frame_time_ = ReadTime();
+			m_frames++;
+			return true;
+		}
+
+		if (tag < EventRecord || tag - EventRecord > CharEvent)
+			throw std::runtime_error("Unknown input log record tag " + std::to_string(tag));
+
+		InputEvent event;
+		event.type = static_cast<InputEventType>(tag - EventRecord);
+		event.timestamp = ReadTime();
+		uint64_t code = ReadVarint();
+		event.code = static_cast<int>((code >> 1) ^ (~(code & 1) + 1));
+
+		if (m_position + 2 > m_data.size())
+			throw std::runtime_error("Truncated input log");
+		event.action = m_data[m_position++];
+		event.mods = m_data[m_position++];
+
+		if (event.type == CursorEvent || event.type == ScrollEvent)
+		{
+			if (m_position + sizeof(event.x) + sizeof(event.y) > m_data.size())
+				throw std::runtime_error("Truncated input log");
+			memcpy(&event.x, m_data.data() + m_position, sizeof(event.x));
+			memcpy(&event.y, m_data.data() + m_position + sizeof(event.x), sizeof(event.y));
+			m_position += sizeof(event.x) + sizeof(event.y);
+		}
+
+		events_.push_back(event);
+	}
+
+	// Events after the last frame marker belong to a frame that was never finished
+	return false;
+}
\ No newline at end of file
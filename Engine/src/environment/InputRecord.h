@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "InputEvents.h"
+
+namespace environment
+{
+	// Input log layout: "EIRL" magic, uint32 version, then a stream of records.
+	// Every record starts with a tag byte and the varint time delta to the previous record:
+	//	Frame marker: tag FrameRecord
+	//	Event: tag EventRecord + InputEventType, zigzag varint code, uint8 action, uint8 mods, two doubles for cursor and scroll events
+	constexpr uint32_t INPUT_LOG_MAGIC = 0x4C524945; // "EIRL"
+	constexpr uint32_t INPUT_LOG_VERSION = 1;
+
+	enum InputRecordTag : uint8_t
+	{
+		FrameRecord = 0,
+		EventRecord = 1
+	};
+
+	class InputRecorder
+	{
+		// VARIABLES
+	private:
+		std::ofstream m_file;
+		int64_t m_last_time = 0;
+		uint64_t m_frames = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		InputRecorder(const std::string& file_name_);
+		~InputRecorder() { m_file.close(); }
+
+		// METHODES
+	private:
+		void WriteVarint(uint64_t value_);
+		void WriteTime(int64_t time_);
+
+	public:
+		void RecordEvent(const InputEvent& event_);
+		void RecordFrame(int64_t frame_time_);
+
+		uint64_t Frames() const { return m_frames; }
+	};
+
+	class InputPlayer
+	{
+		// VARIABLES
+	private:
+		std::vector<uint8_t> m_data;
+		size_t m_position = 0;
+		int64_t m_last_time = 0;
+		uint64_t m_frames = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		InputPlayer(const std::string& file_name_);
+		~InputPlayer() {}
+
+		// METHODES
+	private:
+		uint64_t ReadVarint();
+		int64_t ReadTime();
+
+	public:
+		// Reads the events of the next recorded frame into events_ and returns the frame time, false at the end of the log
+		bool NextFrame(std::vector<InputEvent>& events_, int64_t& frame_time_);
+		bool Finished() const { return m_position >= m_data.size(); }
+
+		uint64_t Frames() const { return m_frames; }
+	};
+}
\ No newline at end of file
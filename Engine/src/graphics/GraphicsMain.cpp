@@ -2,6 +2,18 @@
 
 void graphics::GraphicsManager::Initialize()
 {
+	m_headless = !m_environment_manager->IsWindowCreated();
+
+	auto& metrics = profiling::Metrics();
+	m_draw_calls_metric = &metrics.AddCounter("graphics_draw_calls_total", "Draw calls submitted to the GPU");
+	m_staging_upload_metric = &metrics.AddCounter("graphics_staging_upload_bytes_total", "Bytes copied from staging buffers to device memory");
+	m_device_memory_metric = &metrics.AddGauge("graphics_device_memory_bytes", "Vulkan device memory allocated by the engine");
+	m_gpu_frame_time_metric = &metrics.AddGauge("graphics_gpu_frame_time_seconds", "GPU time of the last measured frame");
+	m_texture_resident_metric = &metrics.AddGauge("graphics_texture_resident_bytes", "Texture mip data on the GPU");
+	m_texture_streamed_metric = &metrics.AddCounter("graphics_texture_streamed_bytes_total", "Texture mip data streamed to the GPU");
+	m_texture_evicted_metric = &metrics.AddCounter("graphics_texture_evicted_bytes_total", "Texture mip data evicted to stay in the texture budget");
+	m_pipeline_compiles_metric = &metrics.AddCounter("graphics_pipeline_compiles_total", "Graphics pipelines compiled, every permutation and swap chain");
+
 	if (!InitializeVulkan())
 		return;
 
@@ -12,11 +24,22 @@ void graphics::GraphicsManager::Shutdown()
 {
 	ShutdownSwapChain();
 
-	vkDestroyBuffer(m_vk_device, m_vk_vertex_buffer, nullptr);
-	vkFreeMemory(m_vk_device, m_vk_vertex_buffer_memory, nullptr);
+	while (!m_meshes.Empty())
+		DestroyMesh(m_meshes.HandleAt(0));
+	FreeRetiredRanges((std::numeric_limits<uint64_t>::max)());
+
+	while (!m_textures.Empty())
+		DestroyTexture(m_textures.HandleAt(0));
+	DestroyRetiredImages((std::numeric_limits<uint64_t>::max)());
+
+	for (auto& sampler : m_samplers)
+		vkDestroySampler(m_vk_device, sampler.second, nullptr);
+	m_samplers.clear();
+	vkDestroyCommandPool(m_vk_device, m_vk_streaming_command_pool, nullptr);
 
-	vkDestroyBuffer(m_vk_device, m_vk_index_buffer, nullptr);
-	vkFreeMemory(m_vk_device, m_vk_index_buffer_memory, nullptr);
+	// Every buffer still alive, the geometry and staging buffers included
+	while (!m_buffers.Empty())
+		DestroyBuffer(m_buffers.HandleAt(0));
 
 	for (size_t i = 0; i < m_max_frames_in_flight; i++)
 	{
@@ -27,12 +50,21 @@ void graphics::GraphicsManager::Shutdown()
 
 	vkDestroyCommandPool(m_vk_device, m_vk_command_pool, nullptr);
 
+	vkDestroyPipelineCache(m_vk_device, m_vk_pipeline_cache, nullptr);
+	m_shader_manager->DestroyShaderModule(m_pipeline_base.fragment_shader);
+	m_shader_manager->DestroyShaderModule(m_pipeline_base.vertex_shader);
+	m_pipeline_base = {};
+
+	// The cached shader modules live until here
+	m_shader_manager.reset();
+
 	vkDestroyDevice(m_vk_device, nullptr);
 
 	if (m_enable_validation_layers)
 		DestroyDebugUtilsMessengerEXT(nullptr);
 
-	vkDestroySurfaceKHR(m_vk_instance, m_vk_surface, nullptr);
+	if (m_vk_surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(m_vk_instance, m_vk_surface, nullptr);
 	vkDestroyInstance(m_vk_instance, nullptr);
 
 	m_initialized = false;
@@ -43,39 +75,66 @@ void graphics::GraphicsManager::ShutdownSwapChain()
 	for (auto framebuffer : m_vk_swapchain_framebuffers)
 		vkDestroyFramebuffer(m_vk_device, framebuffer, nullptr);
 
+	vkDestroyQueryPool(m_vk_device, m_vk_timestamp_query_pool, nullptr);
+	m_vk_timestamp_query_pool = VK_NULL_HANDLE;
+
 	vkFreeCommandBuffers(m_vk_device, m_vk_command_pool, static_cast<uint32_t>(m_vk_command_buffers.size()), m_vk_command_buffers.data());
 
-	vkDestroyPipeline(m_vk_device, m_vk_graphics_pipeline, nullptr);
-	vkDestroyPipelineLayout(m_vk_device, m_vk_pipeline_layout, nullptr);
+	// Pipelines bake in the render pass and extent, the permutations keep their keys to be compiled again
+	for (auto& [permutation, pipeline] : m_permutation_pipelines)
+	{
+		DestroyPipeline(pipeline);
+		pipeline = {};
+	}
+	m_graphics_pipeline = {};
+	m_pipeline_generation++;
 	vkDestroyRenderPass(m_vk_device, m_vk_render_pass, nullptr);
 
 	for (auto image_view : m_vk_image_views)
 		vkDestroyImageView(m_vk_device, image_view, nullptr);
 
-	vkDestroySwapchainKHR(m_vk_device, m_vk_swapchain, nullptr);
+	if (m_headless)
+	{
+		for (size_t i = 0; i < m_vk_swapchain_images.size(); i++)
+		{
+			vkDestroyImage(m_vk_device, m_vk_swapchain_images[i], nullptr);
+			FreeMemory(m_vk_offscreen_images_memory[i]);
+		}
+		m_vk_swapchain_images.clear();
+		m_vk_offscreen_images_memory.clear();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(m_vk_device, m_vk_swapchain, nullptr);
+	}
 }
 
 bool graphics::GraphicsManager::InitializeVulkan()
 {
+	PROFILE_FUNCTION();
 #ifdef _DEBUG
 	m_enable_validation_layers = true;
 #endif
-	m_shader_manager = std::make_shared<graphics::ShaderManager>("src/shaders/");
+	m_shader_manager = std::make_shared<graphics::ShaderManager>("src/shaders/", m_package.get());
 	try
 	{
 		CreateInstance();
 		SetupDebugMessenger();
-		CreateSurface();
+		if (!m_headless)
+			CreateSurface();
 		PickPhysicalDevice();
 		CreateLogicalDevice();
+		CreatePipelineCache();
 		CreateSwapChain();
 		CreateImageViews();
 		CreateRenderPass();
 		CreateGraphicsPipeline();
 		CreateFramebuffers();
 		CreateCommandPool();
-		CreateVertexBuffers();
-		CreateIndexBuffers();
+		CreateGeometryBuffers();
+		CreateBuiltinMeshes();
+		CreateTextureStreaming();
+		CreateTimestampQueries();
 		CreateCommandBuffers();
 		CreateSync();
 	}
@@ -184,15 +243,24 @@ void graphics::GraphicsManager::CreateLogicalDevice()
 		queue_create_infos.push_back(queue_create_info);
 	}
 
+	// Compressed texture formats and anisotropic filtering are used where the device has them
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(m_vk_physical_device, &supported_features);
+
 	VkPhysicalDeviceFeatures device_features = {};
+	device_features.textureCompressionBC = supported_features.textureCompressionBC;
+	device_features.textureCompressionASTC_LDR = supported_features.textureCompressionASTC_LDR;
+	device_features.samplerAnisotropy = supported_features.samplerAnisotropy;
+	m_vk_enabled_features = device_features;
 
 	VkDeviceCreateInfo create_info = {};
 	create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	create_info.pQueueCreateInfos = queue_create_infos.data();
 	create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
 	create_info.pEnabledFeatures = &device_features;
-	create_info.ppEnabledExtensionNames = device_extensions.data();
-	create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
+	// Headless rendering does not present, so it needs no swap chain extension
+	create_info.ppEnabledExtensionNames = m_headless ? nullptr : device_extensions.data();
+	create_info.enabledExtensionCount = m_headless ? 0 : static_cast<uint32_t>(device_extensions.size());
 	create_info.enabledLayerCount = 0;
 
 	auto result = vkCreateDevice(m_vk_physical_device, &create_info, nullptr, &m_vk_device);
@@ -205,12 +273,7 @@ void graphics::GraphicsManager::CreateLogicalDevice()
 
 void graphics::GraphicsManager::CreateSurface()
 {
-	VkWin32SurfaceCreateInfoKHR create_info = {};
-	create_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-	create_info.hwnd = m_environment_manager->GetWindowHandle();
-	create_info.hinstance = GetModuleHandle(nullptr);
-
-	auto result = vkCreateWin32SurfaceKHR(m_vk_instance, &create_info, nullptr, &m_vk_surface);
+	auto result = glfwCreateWindowSurface(m_vk_instance, m_environment_manager->GetWindow(), nullptr, &m_vk_surface);
 
 	if (result != VK_SUCCESS)
 		throw std::runtime_error("Failed to create VkSurface, error: " + FormatVkResult(result));
@@ -218,11 +281,19 @@ void graphics::GraphicsManager::CreateSurface()
 
 void graphics::GraphicsManager::CreateSwapChain()
 {
+	if (m_headless)
+	{
+		CreateOffscreenImages();
+		return;
+	}
+
 	SwapChainSupportDetails swapchain_support = QuerySwapChainSupport(m_vk_physical_device, m_vk_surface);
 
 	VkSurfaceFormatKHR surface_format = ChooseSwapSurfaceFormat(swapchain_support.formats);
-	VkPresentModeKHR present_mode = ChooseSwapPresentMode(swapchain_support.present_modes);
-	VkExtent2D extent = ChooseSwapExtent(swapchain_support.capabilities, m_environment_manager->WindowWidth(), m_environment_manager->WindowHeight());
+	VkPresentModeKHR present_mode = ChooseSwapPresentMode(swapchain_support.present_modes, m_present_policy);
+	m_present_mode = present_mode;
+	const auto& window = m_environment_manager->Window();
+	VkExtent2D extent = ChooseSwapExtent(swapchain_support.capabilities, window.framebuffer_width, window.framebuffer_height);
 
 	uint32_t image_count = swapchain_support.capabilities.minImageCount + 1;
 	if (swapchain_support.capabilities.maxImageCount > 0 && image_count > swapchain_support.capabilities.maxImageCount)
@@ -272,6 +343,53 @@ void graphics::GraphicsManager::CreateSwapChain()
 	m_vk_swapchain_image_format = surface_format.format;
 }
 
+void graphics::GraphicsManager::CreateOffscreenImages()
+{
+	const auto& window = m_environment_manager->Window();
+	m_vk_swapchain_extent = { static_cast<uint32_t>(window.framebuffer_width), static_cast<uint32_t>(window.framebuffer_height) };
+	m_vk_swapchain_image_format = VK_FORMAT_B8G8R8A8_UNORM;
+
+	// One target per frame in flight, the frame fence then also guards its image
+	m_vk_swapchain_images.resize(m_max_frames_in_flight);
+	m_vk_offscreen_images_memory.resize(m_max_frames_in_flight);
+
+	for (size_t i = 0; i < m_vk_swapchain_images.size(); i++)
+	{
+		VkImageCreateInfo image_info = {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.format = m_vk_swapchain_image_format;
+		image_info.extent = { m_vk_swapchain_extent.width, m_vk_swapchain_extent.height, 1 };
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		auto result = vkCreateImage(m_vk_device, &image_info, nullptr, &m_vk_swapchain_images[i]);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to create offscreen VkImage, error: " + FormatVkResult(result));
+
+		VkMemoryRequirements mem_requirements;
+		vkGetImageMemoryRequirements(m_vk_device, m_vk_swapchain_images[i], &mem_requirements);
+
+		VkMemoryAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		alloc_info.allocationSize = mem_requirements.size;
+		alloc_info.memoryTypeIndex = FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vk_physical_device);
+
+		result = AllocateMemory(alloc_info, m_vk_offscreen_images_memory[i]);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate offscreen image memory, error: " + FormatVkResult(result));
+
+		result = vkBindImageMemory(m_vk_device, m_vk_swapchain_images[i], m_vk_offscreen_images_memory[i], 0);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to bind offscreen image memory, error: " + FormatVkResult(result));
+	}
+}
+
 void graphics::GraphicsManager::CreateImageViews()
 {
 	m_vk_image_views.resize(m_vk_swapchain_images.size());
@@ -309,7 +427,7 @@ void graphics::GraphicsManager::CreateRenderPass()
 	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	color_attachment.finalLayout = m_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 	// VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: Images used as color attachment 
 	// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: Images to be presented in the swap chain 
 	// VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : Images to be used as destination for a memory copy operation 
@@ -347,39 +465,127 @@ void graphics::GraphicsManager::CreateRenderPass()
 	}
 }
 
+void graphics::GraphicsManager::CreatePipelineCache()
+{
+	// Shared by every permutation compile, the driver reuses the shader compilation of equal stages
+	VkPipelineCacheCreateInfo cache_info = {};
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	auto result = vkCreatePipelineCache(m_vk_device, &cache_info, nullptr, &m_vk_pipeline_cache);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create VkPipelineCache, error: " + FormatVkResult(result));
+	}
+}
+
 void graphics::GraphicsManager::CreateGraphicsPipeline()
 {
+	PROFILE_FUNCTION();
 	// using normalized device coordinates 
 	// compiled SPIR-V shaders 
 
-// shader module and stages creation 
-	VkShaderModule vert_shader_module = m_shader_manager->CreateShaderModule("BasicVert.spv", BinaryInput, m_vk_device);
-	VkShaderModule frag_shader_module = m_shader_manager->CreateShaderModule("BasicFrag.spv", BinaryInput, m_vk_device);
+// shader modules, cached by the shader manager so swap chain recreation reads no files. The new references are
+// taken before the old ones are released, an unchanged shader keeps its module
+	ShaderHandle vert_shader_module = m_shader_manager->CreateShaderModule("BasicVert.spv", BinaryInput, m_vk_device);
+	ShaderHandle frag_shader_module = m_shader_manager->CreateShaderModule("BasicFrag.spv", BinaryInput, m_vk_device);
+	m_shader_manager->DestroyShaderModule(m_pipeline_base.fragment_shader);
+	m_shader_manager->DestroyShaderModule(m_pipeline_base.vertex_shader);
+	m_pipeline_base.vertex_shader = vert_shader_module;
+	m_pipeline_base.fragment_shader = frag_shader_module;
+	m_pipeline_base.vertex_module = m_shader_manager->Module(vert_shader_module);
+	m_pipeline_base.fragment_module = m_shader_manager->Module(frag_shader_module);
+
+	const ShaderReflection& vert_reflection = m_shader_manager->Reflection(vert_shader_module);
+	const ShaderReflection& frag_reflection = m_shader_manager->Reflection(frag_shader_module);
+
+// vertex input 
+	// Attributes of the vertex layout at the locations the vertex shader reads, throws if the layout cannot feed it
+	m_pipeline_base.vertex_input = BuildVertexInput(vert_reflection, m_vertex_layout);
+
+// Pipeline layout, reflected from the shaders and shared by the pipelines with the same resources 
+	m_pipeline_base.layout = m_shader_manager->PipelineLayout({ vert_shader_module, frag_shader_module }, m_vk_device).pipeline_layout;
+
+// specialization constants, a permutation gives both stages the same values 
+	std::vector<ShaderSpecConstant>& spec_constants = m_pipeline_base.spec_constants;
+	spec_constants = vert_reflection.spec_constants;
+	for (const ShaderSpecConstant& constant : frag_reflection.spec_constants)
+	{
+		auto it = std::lower_bound(spec_constants.begin(), spec_constants.end(), constant.constant_id,
+			[](const ShaderSpecConstant& lhs_, uint32_t rhs_) { return lhs_.constant_id < rhs_; });
+		if (it == spec_constants.end() || it->constant_id != constant.constant_id)
+			spec_constants.insert(it, constant);
+		else if (it->size != constant.size)
+			throw std::runtime_error("Specialization constant " + std::to_string(constant.constant_id) + " has different sizes in the basic shaders");
+	}
+
+// permutations, the ones used with the old swap chain are compiled again 
+	std::vector<ShaderPermutation> failed;
+	m_permutation_pipelines.try_emplace(m_permutation);
+	for (auto& [permutation, pipeline] : m_permutation_pipelines)
+	{
+		if (!pipeline.IsNull())
+			continue;
+		// A shader change may drop a constant a cached permutation sets, only the active one must compile
+		try
+		{
+			pipeline = m_pipelines.Create(CompilePipelineLocked(permutation), m_pipeline_base.layout);
+		}
+		catch (const std::exception& e)
+		{
+			if (permutation == m_permutation)
+				throw;
+			std::cerr << e.what() << "\n";
+			failed.push_back(permutation);
+		}
+	}
+	for (const ShaderPermutation& permutation : failed)
+		m_permutation_pipelines.erase(permutation);
+	m_graphics_pipeline = m_permutation_pipelines.at(m_permutation);
+}
+
+VkPipeline graphics::GraphicsManager::CompilePipelineLocked(const ShaderPermutation& permutation_) const
+{
+	PROFILE_FUNCTION();
+	const std::vector<uint32_t>& constant_ids = permutation_.ConstantIds();
+	for (uint32_t constant_id : constant_ids)
+	{
+		auto it = std::lower_bound(m_pipeline_base.spec_constants.begin(), m_pipeline_base.spec_constants.end(), constant_id,
+			[](const ShaderSpecConstant& lhs_, uint32_t rhs_) { return lhs_.constant_id < rhs_; });
+		if (it == m_pipeline_base.spec_constants.end() || it->constant_id != constant_id)
+			throw std::runtime_error("Pipeline permutation " + permutation_.ToString() + " sets constant " + std::to_string(constant_id) + " no stage declares");
+		if (it->size != sizeof(uint32_t))
+			throw std::runtime_error("Pipeline permutation " + permutation_.ToString() + " sets constant " + std::to_string(constant_id) + " wider than 4 bytes");
+	}
+
+// shader stages 
+	std::vector<VkSpecializationMapEntry> specialization_entries;
+	VkSpecializationInfo specialization_info = permutation_.SpecializationInfo(specialization_entries);
 
 	VkPipelineShaderStageCreateInfo vert_shader_create_info = {};
 	vert_shader_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vert_shader_create_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vert_shader_create_info.module = vert_shader_module;
+	vert_shader_create_info.module = m_pipeline_base.vertex_module;
 	vert_shader_create_info.pName = "main";
+	vert_shader_create_info.pSpecializationInfo = permutation_.Empty() ? nullptr : &specialization_info;
 
 	VkPipelineShaderStageCreateInfo frag_shader_create_info = {};
 	frag_shader_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	frag_shader_create_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	frag_shader_create_info.module = frag_shader_module;
+	frag_shader_create_info.module = m_pipeline_base.fragment_module;
 	frag_shader_create_info.pName = "main";
+	frag_shader_create_info.pSpecializationInfo = permutation_.Empty() ? nullptr : &specialization_info;
 
 	VkPipelineShaderStageCreateInfo shader_stages[] = { vert_shader_create_info, frag_shader_create_info };
 
 // vertex and input assembly 
-	auto binding_description = Vertex::GetBindingDescription();
-	auto attribute_descriptions = Vertex::GetAttributeDescriptions();
+	const VertexInputDesc& vertex_input = m_pipeline_base.vertex_input;
 
 	VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
 	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_info.vertexBindingDescriptionCount = 1;
-	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-	vertex_input_info.pVertexBindingDescriptions = &binding_description;
-	vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
+	vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input.bindings.size());
+	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input.attributes.size());
+	vertex_input_info.pVertexBindingDescriptions = vertex_input.bindings.data();
+	vertex_input_info.pVertexAttributeDescriptions = vertex_input.attributes.data();
 
 	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
 	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -458,14 +664,6 @@ void graphics::GraphicsManager::CreateGraphicsPipeline()
 	color_blending.attachmentCount = 1;
 	color_blending.pAttachments = &color_blend_attachment;
 
-// Pipeline layout 
-	VkPipelineLayoutCreateInfo pipeline_layout_info = {};
-	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-
-	auto pipeline_layout_creation_result = vkCreatePipelineLayout(m_vk_device, &pipeline_layout_info, nullptr, &m_vk_pipeline_layout);
-	if (pipeline_layout_creation_result != VK_SUCCESS)
-		throw std::runtime_error("Failed to create VkPipelineLayout, error: " + FormatVkResult(pipeline_layout_creation_result));
-
 // Graphics pipeline creation 
 	VkGraphicsPipelineCreateInfo pipeline_info = {};
 	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -481,7 +679,7 @@ void graphics::GraphicsManager::CreateGraphicsPipeline()
 	pipeline_info.pDepthStencilState = nullptr;
 	pipeline_info.pDynamicState = nullptr;
 	// 
-	pipeline_info.layout = m_vk_pipeline_layout;
+	pipeline_info.layout = m_pipeline_base.layout;
 	pipeline_info.renderPass = m_vk_render_pass;
 	pipeline_info.subpass = 0;
 	// Optional deriving from an existing pipeline 
@@ -489,14 +687,16 @@ void graphics::GraphicsManager::CreateGraphicsPipeline()
 	pipeline_info.basePipelineIndex = 0;
 	// 
 
-	auto graphics_pipeline_creation_result = vkCreateGraphicsPipelines(m_vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_vk_graphics_pipeline);
+	// The pipeline cache is internally synchronized, compiles on several threads may share it
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	auto graphics_pipeline_creation_result = vkCreateGraphicsPipelines(m_vk_device, m_vk_pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
 	if (graphics_pipeline_creation_result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to create VkPipeline, error: " + FormatVkResult(graphics_pipeline_creation_result));
+		throw std::runtime_error("Failed to create VkPipeline for permutation " + permutation_.ToString() + ", error: " + FormatVkResult(graphics_pipeline_creation_result));
 	}
-
-	vkDestroyShaderModule(m_vk_device, frag_shader_module, nullptr);
-	vkDestroyShaderModule(m_vk_device, vert_shader_module, nullptr);
+	m_pipeline_compiles++;
+	m_pipeline_compiles_metric->Add();
+	return pipeline;
 }
 
 void graphics::GraphicsManager::CreateFramebuffers()
@@ -543,73 +743,120 @@ void graphics::GraphicsManager::CreateCommandPool()
 		throw std::runtime_error("Failed to create VkCommandPool, error: " + FormatVkResult(result));
 }
 
-void graphics::GraphicsManager::CreateVertexBuffers()
+void graphics::GraphicsManager::CreateGeometryBuffers()
 {
-	VkDeviceSize buffer_size = sizeof(vertices[0]) * vertices.size();
+	for (uint32_t stream = 0; stream < m_vertex_layout.StreamCount(); stream++)
+		m_vertex_streams.push_back(CreateBuffer(
+			static_cast<VkDeviceSize>(GEOMETRY_INITIAL_VERTICES) * m_vertex_layout.Stride(stream),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+	m_index_buffer = CreateBuffer(
+		GEOMETRY_INITIAL_INDEX_BYTES,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	m_vertex_ranges = memory::RangeAllocator(GEOMETRY_INITIAL_VERTICES);
+	m_index_ranges = memory::RangeAllocator(GEOMETRY_INITIAL_INDEX_BYTES);
+}
 
-	VkBuffer staging_buffer;
-	VkDeviceMemory staging_buffer_memory;
-	CreateBuffer(
-		buffer_size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // Buffer can be used as source in a memory transfer operation 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		staging_buffer,
-		staging_buffer_memory);
+// TODO: Change to Vulkan Memory Allocation! 
+// https://github.com/GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator 
 
-	void* data;
-	vkMapMemory(m_vk_device, staging_buffer_memory, 0, buffer_size, 0, &data);
-	memcpy(data, vertices.data(), (size_t)buffer_size);
-	vkUnmapMemory(m_vk_device, staging_buffer_memory);
+void graphics::GraphicsManager::CreateBuiltinMeshes()
+{
+	VertexSource source;
+	source.vertex_count = vertices.size();
+	std::vector<glm::vec3> positions;
+	for (const auto& vertex : vertices)
+	{
+		source.attributes[SemanticPosition].push_back(glm::vec4(vertex.pos, 0.0f, 1.0f));
+		source.attributes[SemanticColor].push_back(glm::vec4(vertex.color, 1.0f));
+		positions.push_back(glm::vec3(vertex.pos, 0.0f));
+	}
 
-	CreateBuffer(
-		buffer_size,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, // Buffer can be used as destination in a memory transfer operation 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_vk_vertex_buffer,
-		m_vk_vertex_buffer_memory);
+	MeshBounds bounds = { positions[0], positions[0], glm::vec4(0.0f) };
+	for (const auto& position : positions)
+	{
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+	bounds.sphere = glm::vec4((bounds.min + bounds.max) * 0.5f, glm::length(bounds.max - bounds.min) * 0.5f);
 
-	CopyBuffer(staging_buffer, m_vk_vertex_buffer, buffer_size);
+	// Goes through the mesh file format so the quad takes the same upload path as cooked meshes
+	std::vector<uint32_t> quad_indices(indices.begin(), indices.end());
+	std::vector<MeshLod> lods = { { 0, static_cast<uint32_t>(quad_indices.size()), 0.0f, 0 } };
+	std::vector<uint8_t> file = WriteMeshFile(m_vertex_layout, EncodeVertices(m_vertex_layout, source), 
+		static_cast<uint32_t>(source.vertex_count), quad_indices, lods, bounds);
 
-	vkDestroyBuffer(m_vk_device, staging_buffer, nullptr);
-	vkFreeMemory(m_vk_device, staging_buffer_memory, nullptr);
+	m_quad_mesh = CreateMesh(ReadMeshFile(file.data(), file.size()));
+	m_draw_list = { m_quad_mesh };
 }
 
-// TODO: Change to Vulkan Memory Allocation! 
-// https://github.com/GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator 
+void graphics::GraphicsManager::CreateTextureStreaming()
+{
+	VkCommandPoolCreateInfo pool_info = {};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_info.queueFamilyIndex = FindQueueFamilies(m_vk_physical_device).graphics_family.value();
+	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	auto result = vkCreateCommandPool(m_vk_device, &pool_info, nullptr, &m_vk_streaming_command_pool);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create streaming VkCommandPool, error: " + FormatVkResult(result));
+
+	m_streaming_command_buffers.resize(m_max_frames_in_flight);
+	VkCommandBufferAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.commandPool = m_vk_streaming_command_pool;
+	allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocate_info.commandBufferCount = static_cast<uint32_t>(m_streaming_command_buffers.size());
 
-void graphics::GraphicsManager::CreateIndexBuffers()
+	result = vkAllocateCommandBuffers(m_vk_device, &allocate_info, m_streaming_command_buffers.data());
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate streaming command buffers, error: " + FormatVkResult(result));
+
+	for (size_t i = 0; i < m_max_frames_in_flight; i++)
+	{
+		m_streaming_staging.push_back(CreateBuffer(
+			m_texture_budget.upload_bytes_per_frame,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+		void* data;
+		vkMapMemory(m_vk_device, m_buffers.At(m_streaming_staging[i]).memory, 0, VK_WHOLE_SIZE, 0, &data);
+		m_streaming_staging_data.push_back(static_cast<uint8_t*>(data));
+	}
+}
+
+void graphics::GraphicsManager::CreateTimestampQueries()
 {
-	VkDeviceSize buffer_size = sizeof(indices[0]) * indices.size();
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_vk_physical_device, &properties);
 
-	VkBuffer staging_buffer;
-	VkDeviceMemory staging_buffer_memory;
-	CreateBuffer(
-		buffer_size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // Buffer can be used as source in a memory transfer operation 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		staging_buffer,
-		staging_buffer_memory);
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_vk_physical_device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_vk_physical_device, &queue_family_count, queue_families.data());
 
-	void* data;
-	vkMapMemory(m_vk_device, staging_buffer_memory, 0, buffer_size, 0, &data);
-	memcpy(data, indices.data(), (size_t)buffer_size);
-	vkUnmapMemory(m_vk_device, staging_buffer_memory);
+	uint32_t valid_bits = queue_families[FindQueueFamilies(m_vk_physical_device).graphics_family.value()].timestampValidBits;
+	if (valid_bits == 0 || properties.limits.timestampPeriod == 0.0f)
+		return; // GPU frame time stays unavailable
 
-	CreateBuffer(
-		buffer_size,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, // Buffer can be used as destination in a memory transfer operation 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_vk_index_buffer,
-		m_vk_index_buffer_memory);
+	m_timestamp_period = properties.limits.timestampPeriod;
+	m_timestamp_mask = valid_bits >= 64 ? (std::numeric_limits<uint64_t>::max)() : (uint64_t(1) << valid_bits) - 1;
 
-	CopyBuffer(staging_buffer, m_vk_index_buffer, buffer_size);
+	VkQueryPoolCreateInfo pool_info = {};
+	pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	pool_info.queryCount = static_cast<uint32_t>(m_vk_swapchain_framebuffers.size() * 2);
 
-	vkDestroyBuffer(m_vk_device, staging_buffer, nullptr);
-	vkFreeMemory(m_vk_device, staging_buffer_memory, nullptr);
+	auto result = vkCreateQueryPool(m_vk_device, &pool_info, nullptr, &m_vk_timestamp_query_pool);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create timestamp VkQueryPool, error: " + FormatVkResult(result));
 }
 
 void graphics::GraphicsManager::CreateCommandBuffers()
 {
+	PROFILE_FUNCTION();
 	m_vk_command_buffers.resize(m_vk_swapchain_framebuffers.size());
 
 	VkCommandBufferAllocateInfo allocate_info = {};
@@ -626,6 +873,18 @@ void graphics::GraphicsManager::CreateCommandBuffers()
 	if (allocate_result != VK_SUCCESS)
 		throw std::runtime_error("Failed to allocate comand buffers, error: " + FormatVkResult(allocate_result));
 
+	// 16 bit meshes first so the index buffer is bound at most once per index type
+	std::vector<const Mesh*> draws;
+	for (MeshHandle handle : m_draw_list)
+		if (const Mesh* mesh = m_meshes.Get(handle))
+			draws.push_back(mesh);
+	std::stable_sort(draws.begin(), draws.end(), [](const Mesh* a_, const Mesh* b_) { return a_->index_type < b_->index_type; });
+
+	std::vector<VkBuffer> vertex_buffers;
+	for (BufferHandle stream : m_vertex_streams)
+		vertex_buffers.push_back(m_buffers.At(stream).buffer);
+	std::vector<VkDeviceSize> vertex_offsets(vertex_buffers.size(), 0);
+
 	for (size_t i = 0; i < m_vk_command_buffers.size(); i++)
 	{
 		VkCommandBufferBeginInfo begin_info = {};
@@ -653,6 +912,14 @@ void graphics::GraphicsManager::CreateCommandBuffers()
 		render_pass_info.clearValueCount = 1;
 		render_pass_info.pClearValues = &clear_color;
 
+		// Query pairs are per command buffer, so a reset here never touches a pair another frame still reads
+		uint32_t first_query = static_cast<uint32_t>(i * 2);
+		if (m_vk_timestamp_query_pool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(m_vk_command_buffers[i], m_vk_timestamp_query_pool, first_query, 2);
+			vkCmdWriteTimestamp(m_vk_command_buffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_vk_timestamp_query_pool, first_query);
+		}
+
 		vkCmdBeginRenderPass(m_vk_command_buffers[i], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
 		//	VK_SUBPASS_CONTENTS_INLINE: 
 		//The render pass commands will be embedded in the primary command buffer itself
@@ -660,22 +927,36 @@ void graphics::GraphicsManager::CreateCommandBuffers()
 		//	VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : 
 		//The render pass commands will be executed from secondary command buffers.
 
-		vkCmdBindPipeline(m_vk_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_vk_graphics_pipeline);
+		vkCmdBindPipeline(m_vk_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines.At(m_graphics_pipeline).pipeline);
 
-		VkBuffer vertex_buffers[] = { m_vk_vertex_buffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(m_vk_command_buffers[i], 0, 1, vertex_buffers, offsets);
-		vkCmdBindIndexBuffer(m_vk_command_buffers[i], m_vk_index_buffer, 0, VK_INDEX_TYPE_UINT16);
-	
-		vkCmdDrawIndexed(m_vk_command_buffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+		// Meshes are told apart by their first index and vertex offset, nothing is rebound between draws
+		vkCmdBindVertexBuffers(m_vk_command_buffers[i], 0, static_cast<uint32_t>(vertex_buffers.size()), vertex_buffers.data(), vertex_offsets.data());
+		VkIndexType bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+		for (const Mesh* mesh : draws)
+		{
+			if (mesh->index_type != bound_index_type)
+			{
+				vkCmdBindIndexBuffer(m_vk_command_buffers[i], m_buffers.At(m_index_buffer).buffer, 0, mesh->index_type);
+				bound_index_type = mesh->index_type;
+			}
+
+			// No camera yet, every mesh is drawn at full detail
+			const MeshLod& lod = mesh->lods[0];
+			vkCmdDrawIndexed(m_vk_command_buffers[i], lod.index_count, 1, mesh->first_index + lod.first_index, static_cast<int32_t>(mesh->first_vertex), 0);
+		}
+		m_recorded_draw_calls = static_cast<uint32_t>(draws.size());
 
 		vkCmdEndRenderPass(m_vk_command_buffers[i]);
 
+		if (m_vk_timestamp_query_pool != VK_NULL_HANDLE)
+			vkCmdWriteTimestamp(m_vk_command_buffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_vk_timestamp_query_pool, first_query + 1);
+
 		auto record_result = vkEndCommandBuffer(m_vk_command_buffers[i]);
 		if (record_result != VK_SUCCESS)
 			throw std::runtime_error("Failed to record command buffer, error: " + FormatVkResult(record_result));
 	}
 
+	m_command_buffers_dirty = false;
 }
 
 void graphics::GraphicsManager::CreateSync()
@@ -706,11 +987,14 @@ void graphics::GraphicsManager::CreateSync()
 
 void graphics::GraphicsManager::RecreateSwapChain()
 {
-	while (m_environment_manager->WindowHeight() == 0 || m_environment_manager->WindowWidth() == 0)
-		glfwWaitEvents();
+	PROFILE_FUNCTION();
+	while (m_environment_manager->Window().framebuffer_width == 0 || m_environment_manager->Window().framebuffer_height == 0)
+		m_environment_manager->WaitMessages();
 
 	WaitDevice();
 
+	// Compiles on other threads read the swap chain state, they finish first and see the new generation after
+	std::unique_lock<std::shared_mutex> lock(m_pipeline_mutex);
 	ShutdownSwapChain();
 
 	CreateSwapChain();
@@ -718,14 +1002,27 @@ void graphics::GraphicsManager::RecreateSwapChain()
 	CreateRenderPass();
 	CreateGraphicsPipeline();
 	CreateFramebuffers();
+	CreateTimestampQueries();
+	CreateCommandBuffers();
+}
+
+void graphics::GraphicsManager::RerecordCommandBuffers()
+{
+	PROFILE_FUNCTION();
+	// Every command buffer may still be pending, they are all recorded with simultaneous use
+	WaitDevice();
+
+	vkFreeCommandBuffers(m_vk_device, m_vk_command_pool, static_cast<uint32_t>(m_vk_command_buffers.size()), m_vk_command_buffers.data());
 	CreateCommandBuffers();
 }
 
 std::vector<const char*> graphics::GraphicsManager::GetRequiredExtensions()
 {
 	uint32_t glfw_extension_count = 0;
-	auto glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-	std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+	const char** glfw_extensions = m_headless ? nullptr : glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+	std::vector<const char*> extensions;
+	if (!m_headless)
+		extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
 
 	if (m_enable_validation_layers) 
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -744,8 +1041,11 @@ VkResult graphics::GraphicsManager::CreateDebugUtilsMessengerEXT(
 		return VK_ERROR_EXTENSION_NOT_PRESENT;
 }
 
-void graphics::GraphicsManager::CreateBuffer(VkDeviceSize size_, VkBufferUsageFlags usage_, VkMemoryPropertyFlags properties_, VkBuffer& buffer_, VkDeviceMemory& buffer_memory_)
+graphics::BufferHandle graphics::GraphicsManager::CreateBuffer(VkDeviceSize size_, VkBufferUsageFlags usage_, VkMemoryPropertyFlags properties_)
 {
+	Buffer buffer;
+	buffer.size = size_;
+
 	VkBufferCreateInfo buffer_info = {};
 	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	buffer_info.size = size_;
@@ -753,30 +1053,171 @@ void graphics::GraphicsManager::CreateBuffer(VkDeviceSize size_, VkBufferUsageFl
 	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	buffer_info.flags = 0;
 
-	auto result = vkCreateBuffer(m_vk_device, &buffer_info, nullptr, &buffer_);
+	auto result = vkCreateBuffer(m_vk_device, &buffer_info, nullptr, &buffer.buffer);
 	if (result != VK_SUCCESS)
 		throw std::runtime_error("Failed to create VkBuffer, error: " + FormatVkResult(result));
 
 	VkMemoryRequirements mem_requirements;
-	vkGetBufferMemoryRequirements(m_vk_device, buffer_, &mem_requirements);
+	vkGetBufferMemoryRequirements(m_vk_device, buffer.buffer, &mem_requirements);
 
 	VkMemoryAllocateInfo alloc_info = {};
-	alloc_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	alloc_info.allocationSize = mem_requirements.size;
 	alloc_info.memoryTypeIndex = FindMemoryType(mem_requirements.memoryTypeBits,
 		properties_,
 		m_vk_physical_device);
 
-	result = vkAllocateMemory(m_vk_device, &alloc_info, nullptr, &buffer_memory_);
+	result = AllocateMemory(alloc_info, buffer.memory);
 	if (result != VK_SUCCESS)
+	{
+		vkDestroyBuffer(m_vk_device, buffer.buffer, nullptr);
 		throw std::runtime_error("Failed to allocate vertex buffer memory, error: " + FormatVkResult(result));
+	}
 
-	result = vkBindBufferMemory(m_vk_device, buffer_, buffer_memory_, 0);
+	result = vkBindBufferMemory(m_vk_device, buffer.buffer, buffer.memory, 0);
 	if (result != VK_SUCCESS)
+	{
+		vkDestroyBuffer(m_vk_device, buffer.buffer, nullptr);
+		FreeMemory(buffer.memory);
 		throw std::runtime_error("Failed to bind vertex buffer memory, error: " + FormatVkResult(result));
+	}
+
+	return m_buffers.Create(buffer);
+}
+
+void graphics::GraphicsManager::GrowBuffer(BufferHandle& buffer_, VkDeviceSize size_, VkBufferUsageFlags usage_)
+{
+	PROFILE_FUNCTION();
+	BufferHandle buffer = CreateBuffer(size_, usage_, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// The old buffer is bound in every recorded command buffer
+	WaitDevice();
+	CopyBuffer(buffer_, buffer, m_buffers.At(buffer_).size);
+	DestroyBuffer(buffer_);
+	buffer_ = buffer;
+	m_command_buffers_dirty = true;
+}
+
+void graphics::GraphicsManager::GrowGeometryBuffers(uint32_t vertex_count_, VkDeviceSize index_bytes_)
+{
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	uint64_t vertex_capacity = m_vertex_ranges.Capacity();
+	while (m_vertex_ranges.LargestFree() < vertex_count_)
+		m_vertex_ranges.Grow(m_vertex_ranges.Capacity() * 2);
+	if (m_vertex_ranges.Capacity() != vertex_capacity)
+		for (uint32_t stream = 0; stream < m_vertex_streams.size(); stream++)
+			GrowBuffer(m_vertex_streams[stream], m_vertex_ranges.Capacity() * m_vertex_layout.Stride(stream), usage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+	// Alignment padding is at most GEOMETRY_INDEX_ALIGNMENT - 1 bytes
+	uint64_t index_capacity = m_index_ranges.Capacity();
+	while (m_index_ranges.LargestFree() < index_bytes_ + GEOMETRY_INDEX_ALIGNMENT)
+		m_index_ranges.Grow(m_index_ranges.Capacity() * 2);
+	if (m_index_ranges.Capacity() != index_capacity)
+		GrowBuffer(m_index_buffer, m_index_ranges.Capacity(), usage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+void graphics::GraphicsManager::DestroyBuffer(BufferHandle buffer_)
+{
+	Buffer* buffer = m_buffers.Get(buffer_);
+	if (buffer == nullptr)
+		return;
+
+	vkDestroyBuffer(m_vk_device, buffer->buffer, nullptr);
+	FreeMemory(buffer->memory);
+	m_buffers.Destroy(buffer_);
+}
+
+void graphics::GraphicsManager::DestroyPipeline(PipelineHandle pipeline_)
+{
+	Pipeline* pipeline = m_pipelines.Get(pipeline_);
+	if (pipeline == nullptr)
+		return;
+
+	vkDestroyPipeline(m_vk_device, pipeline->pipeline, nullptr);
+	m_pipelines.Destroy(pipeline_);
 }
 
-void graphics::GraphicsManager::CopyBuffer(VkBuffer src_buffer_, VkBuffer dst_buffer_, VkDeviceSize size_)
+graphics::PipelineHandle graphics::GraphicsManager::GetPipeline(const ShaderPermutation& permutation_)
+{
+	auto it = m_permutation_pipelines.find(permutation_);
+	if (it != m_permutation_pipelines.end() && !it->second.IsNull())
+	{
+		m_pipeline_stats.hits++;
+		return it->second;
+	}
+
+	// A frame hitch, precompiling the permutation on a worker avoids it
+	m_pipeline_stats.misses++;
+	CompiledPipeline compiled = CompilePipeline(permutation_);
+	PipelineHandle pipeline = m_pipelines.Create(compiled.pipeline, compiled.layout);
+	m_permutation_pipelines[permutation_] = pipeline;
+	return pipeline;
+}
+
+bool graphics::GraphicsManager::HasPipeline(const ShaderPermutation& permutation_) const
+{
+	auto it = m_permutation_pipelines.find(permutation_);
+	return it != m_permutation_pipelines.end() && !it->second.IsNull();
+}
+
+void graphics::GraphicsManager::SetPipelinePermutation(const ShaderPermutation& permutation_)
+{
+	if (permutation_ == m_permutation)
+		return;
+
+	m_graphics_pipeline = GetPipeline(permutation_);
+	m_permutation = permutation_;
+	m_command_buffers_dirty = true;
+}
+
+graphics::CompiledPipeline graphics::GraphicsManager::CompilePipeline(const ShaderPermutation& permutation_) const
+{
+	std::shared_lock<std::shared_mutex> lock(m_pipeline_mutex);
+	CompiledPipeline compiled;
+	compiled.pipeline = CompilePipelineLocked(permutation_);
+	compiled.layout = m_pipeline_base.layout;
+	compiled.generation = m_pipeline_generation;
+	return compiled;
+}
+
+void graphics::GraphicsManager::AddPipeline(const ShaderPermutation& permutation_, const CompiledPipeline& pipeline_)
+{
+	// A stale permutation is compiled on the main thread if it is asked for, the swap chain changed since
+	if (pipeline_.generation != m_pipeline_generation || HasPipeline(permutation_))
+	{
+		vkDestroyPipeline(m_vk_device, pipeline_.pipeline, nullptr);
+		m_pipeline_stats.discarded++;
+		return;
+	}
+
+	m_permutation_pipelines[permutation_] = m_pipelines.Create(pipeline_.pipeline, pipeline_.layout);
+	m_pipeline_stats.precompiled++;
+}
+
+graphics::PipelineCacheStats graphics::GraphicsManager::PipelineStats() const
+{
+	PipelineCacheStats stats = m_pipeline_stats;
+	stats.permutations = m_permutation_pipelines.size();
+	stats.compiles = m_pipeline_compiles.load();
+	return stats;
+}
+
+void graphics::GraphicsManager::CopyBuffer(BufferHandle src_buffer_, BufferHandle dst_buffer_, VkDeviceSize size_, VkDeviceSize src_offset_, VkDeviceSize dst_offset_)
+{
+	VkCommandBuffer command_buffer = BeginOneTimeCommands();
+
+	VkBufferCopy copy_region = {};
+	copy_region.srcOffset = src_offset_;
+	copy_region.dstOffset = dst_offset_;
+	copy_region.size = size_;
+	vkCmdCopyBuffer(command_buffer, m_buffers.At(src_buffer_).buffer, m_buffers.At(dst_buffer_).buffer, 1, &copy_region);
+
+	EndOneTimeCommands(command_buffer);
+	m_staging_upload_metric->Add(size_);
+}
+
+VkCommandBuffer graphics::GraphicsManager::BeginOneTimeCommands()
 {
 	VkCommandBufferAllocateInfo alloc_info = {};
 	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -792,28 +1233,73 @@ void graphics::GraphicsManager::CopyBuffer(VkBuffer src_buffer_, VkBuffer dst_bu
 	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	vkBeginCommandBuffer(command_buffer, &begin_info);
+	return command_buffer;
+}
 
-	VkBufferCopy copy_region = {};
-	copy_region.size = size_;
-	vkCmdCopyBuffer(command_buffer, src_buffer_, dst_buffer_, 1, &copy_region);
-
-	vkEndCommandBuffer(command_buffer);
+void graphics::GraphicsManager::EndOneTimeCommands(VkCommandBuffer command_buffer_)
+{
+	vkEndCommandBuffer(command_buffer_);
 
 	VkSubmitInfo submit_info = {};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &command_buffer;
+	submit_info.pCommandBuffers = &command_buffer_;
 
 	vkQueueSubmit(m_vk_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
 	vkQueueWaitIdle(m_vk_graphics_queue);
 
-	vkFreeCommandBuffers(m_vk_device, m_vk_command_pool, 1, &command_buffer);
+	vkFreeCommandBuffers(m_vk_device, m_vk_command_pool, 1, &command_buffer_);
+}
+
+VkResult graphics::GraphicsManager::AllocateMemory(const VkMemoryAllocateInfo& alloc_info_, VkDeviceMemory& memory_)
+{
+	auto result = vkAllocateMemory(m_vk_device, &alloc_info_, nullptr, &memory_);
+	if (result == VK_SUCCESS)
+	{
+		m_allocation_sizes[memory_] = alloc_info_.allocationSize;
+		m_device_memory_metric->Add(static_cast<double>(alloc_info_.allocationSize));
+	}
+	return result;
+}
+
+void graphics::GraphicsManager::FreeMemory(VkDeviceMemory memory_)
+{
+	auto allocation = m_allocation_sizes.find(memory_);
+	if (allocation != m_allocation_sizes.end())
+	{
+		m_device_memory_metric->Add(-static_cast<double>(allocation->second));
+		m_allocation_sizes.erase(allocation);
+	}
+	vkFreeMemory(m_vk_device, memory_, nullptr);
+}
+
+void graphics::GraphicsManager::CopyImageToBuffer(VkImage src_image_, BufferHandle dst_buffer_, VkExtent2D extent_)
+{
+	VkCommandBuffer command_buffer = BeginOneTimeCommands();
+
+	// The render pass leaves offscreen images in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+	VkBufferImageCopy copy_region = {};
+	copy_region.bufferOffset = 0;
+	copy_region.bufferRowLength = 0;
+	copy_region.bufferImageHeight = 0;
+	copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy_region.imageSubresource.mipLevel = 0;
+	copy_region.imageSubresource.baseArrayLayer = 0;
+	copy_region.imageSubresource.layerCount = 1;
+	copy_region.imageOffset = { 0, 0, 0 };
+	copy_region.imageExtent = { extent_.width, extent_.height, 1 };
+	vkCmdCopyImageToBuffer(command_buffer, src_image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_buffers.At(dst_buffer_).buffer, 1, &copy_region);
+
+	EndOneTimeCommands(command_buffer);
 }
 
 bool graphics::GraphicsManager::IsDeviceSuitable(VkPhysicalDevice device_)
 {
 	QueueFamilyIndices indices = FindQueueFamilies(device_);
 
+	if (m_headless)
+		return indices.IsComplete();
+
 	bool extensions_supported = CheckDeviceExtensionSupport(device_);
 
 	bool swap_chain_adequate = false;
@@ -858,8 +1344,12 @@ graphics::QueueFamilyIndices graphics::GraphicsManager::FindQueueFamilies(VkPhys
 		if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 			indices.graphics_family = i;
 
+		// Without a surface nothing is presented, the graphics queue also serves as the present queue
 		VkBool32 present_support = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device_, i, m_vk_surface, &present_support);
+		if (m_headless)
+			present_support = (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		else
+			vkGetPhysicalDeviceSurfaceSupportKHR(device_, i, m_vk_surface, &present_support);
 
 		if (queue_family.queueCount > 0 && present_support) 
 			indices.present_family = i;
@@ -882,10 +1372,27 @@ void graphics::GraphicsManager::DestroyDebugUtilsMessengerEXT(const VkAllocation
 
 void graphics::GraphicsManager::BeginFrame()
 {
-	vkWaitForFences(m_vk_device, 1, &m_in_flight_fences[m_current_frame], VK_TRUE, (std::numeric_limits<uint64_t>::max)());
-	uint32_t image_index;
-	auto acquire_result = vkAcquireNextImageKHR(m_vk_device, m_vk_swapchain, (std::numeric_limits<uint64_t>::max)(), 
-		m_semaphores_image_available[m_current_frame], VK_NULL_HANDLE, &image_index);
+	PROFILE_FUNCTION();
+	{
+		PROFILE_SCOPE("WaitForFrameFence");
+		vkWaitForFences(m_vk_device, 1, &m_in_flight_fences[m_current_frame], VK_TRUE, (std::numeric_limits<uint64_t>::max)());
+	}
+
+	m_frame_number++;
+	if (m_frame_number > static_cast<uint64_t>(m_max_frames_in_flight))
+	{
+		DestroyRetiredImages(m_frame_number - m_max_frames_in_flight);
+		FreeRetiredRanges(m_frame_number - m_max_frames_in_flight);
+	}
+
+	if (m_command_buffers_dirty)
+		RerecordCommandBuffers();
+
+	uint32_t image_index = static_cast<uint32_t>(m_current_frame);
+	auto acquire_result = VK_SUCCESS;
+	if (!m_headless)
+		acquire_result = vkAcquireNextImageKHR(m_vk_device, m_vk_swapchain, (std::numeric_limits<uint64_t>::max)(), 
+			m_semaphores_image_available[m_current_frame], VK_NULL_HANDLE, &image_index);
 
 	if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
@@ -897,6 +1404,10 @@ void graphics::GraphicsManager::BeginFrame()
 		throw std::runtime_error("Failed to acquire swap chain image, error : " + FormatVkResult(acquire_result));
 	}
 
+	// Recorded only once the frame is sure to be submitted, the mip changes are already visible to the textures
+	VkCommandBuffer streaming_commands = UpdateTextureStreaming();
+	VkCommandBuffer command_buffers[] = { streaming_commands, m_vk_command_buffers[image_index] };
+
 	VkSubmitInfo submit_info = {};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
@@ -904,13 +1415,14 @@ void graphics::GraphicsManager::BeginFrame()
 	VkSemaphore signal_semaphores[] = { m_semaphores_finished[m_current_frame] };
 
 	VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submit_info.waitSemaphoreCount = 1;
+	// Offscreen images are not shared with a presentation engine, the frame fence is enough
+	submit_info.waitSemaphoreCount = m_headless ? 0 : 1;
 	submit_info.pWaitSemaphores = wait_semaphores;
-	submit_info.signalSemaphoreCount = 1;
+	submit_info.signalSemaphoreCount = m_headless ? 0 : 1;
 	submit_info.pSignalSemaphores = signal_semaphores;
 	submit_info.pWaitDstStageMask = wait_stages;
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &m_vk_command_buffers[image_index];
+	submit_info.commandBufferCount = streaming_commands != VK_NULL_HANDLE ? 2 : 1;
+	submit_info.pCommandBuffers = streaming_commands != VK_NULL_HANDLE ? command_buffers : command_buffers + 1;
 
 	vkResetFences(m_vk_device, 1, &m_in_flight_fences[m_current_frame]);
 	
@@ -918,6 +1430,10 @@ void graphics::GraphicsManager::BeginFrame()
 	if (submit_result != VK_SUCCESS)
 		throw std::runtime_error("Failed to submit begin frame command buffer, error: " + FormatVkResult(submit_result));
 
+	m_last_image_index = image_index;
+	m_draw_calls_metric->Add(m_recorded_draw_calls);
+	if (m_headless)
+		return;
 
 	VkPresentInfoKHR present_info = {};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -929,10 +1445,24 @@ void graphics::GraphicsManager::BeginFrame()
 	present_info.pImageIndices = &image_index;
 	present_info.pResults = nullptr; // Optional, It's not necessary if only use a single swap chain 
 
-	auto present_result = vkQueuePresentKHR(m_vk_present_queue, &present_info);
-	if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR || m_environment_manager->ResizeState())
+	// Only a framebuffer size change needs a new swap chain, focus changes also bump the generation
+	bool framebuffer_resized = false;
+	const auto& window = m_environment_manager->Window();
+	if (window.generation != m_window_generation)
+	{
+		m_window_generation = window.generation;
+		framebuffer_resized = 
+			static_cast<uint32_t>(window.framebuffer_width) != m_vk_swapchain_extent.width || 
+			static_cast<uint32_t>(window.framebuffer_height) != m_vk_swapchain_extent.height;
+	}
+
+	VkResult present_result;
+	{
+		PROFILE_SCOPE("QueuePresent");
+		present_result = vkQueuePresentKHR(m_vk_present_queue, &present_info);
+	}
+	if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR || framebuffer_resized)
 	{
-		m_environment_manager->ResizeState() = false;
 		RecreateSwapChain();
 	}
 	else if (present_result != VK_SUCCESS)
@@ -943,16 +1473,101 @@ void graphics::GraphicsManager::BeginFrame()
 
 void graphics::GraphicsManager::EndFrame()
 {
+	PROFILE_FUNCTION();
 	vkQueueWaitIdle(m_vk_present_queue);
 
+	ReadGpuFrameTime();
+
 	m_current_frame = (m_current_frame + 1) % m_max_frames_in_flight;
 }
 
+void graphics::GraphicsManager::ReadGpuFrameTime()
+{
+	m_last_gpu_frame_time = -1.0;
+	if (m_vk_timestamp_query_pool == VK_NULL_HANDLE)
+		return;
+
+	// No wait flag, a frame whose queries are not finished yet is simply not reported
+	uint64_t timestamps[2] = {};
+	auto result = vkGetQueryPoolResults(m_vk_device, m_vk_timestamp_query_pool, m_last_image_index * 2, 2,
+		sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return;
+
+	uint64_t ticks = ((timestamps[1] & m_timestamp_mask) - (timestamps[0] & m_timestamp_mask)) & m_timestamp_mask;
+	m_last_gpu_frame_time = static_cast<double>(ticks) * m_timestamp_period / 1000000.0;
+	m_gpu_frame_time_metric->Set(m_last_gpu_frame_time / 1000.0);
+}
+
+void graphics::GraphicsManager::SetPresentPolicy(PresentPolicy policy_)
+{
+	if (policy_ == m_present_policy)
+		return;
+
+	m_present_policy = policy_;
+	if (!m_initialized || m_headless)
+		return;
+
+	if (ChooseSwapPresentMode(QuerySwapChainSupport(m_vk_physical_device, m_vk_surface).present_modes, policy_) != m_present_mode)
+		RecreateSwapChain();
+}
+
 void graphics::GraphicsManager::WaitDevice()
 {
+	PROFILE_FUNCTION();
 	vkDeviceWaitIdle(m_vk_device);
 }
 
+void graphics::GraphicsManager::CaptureFrame(const std::string& file_name_)
+{
+	PROFILE_FUNCTION();
+	// Swap chain images belong to the presentation engine once presented
+	if (!m_headless)
+		throw std::runtime_error("Frame capture is only supported in headless mode");
+
+	WaitDevice();
+
+	VkDeviceSize buffer_size = static_cast<VkDeviceSize>(m_vk_swapchain_extent.width) * m_vk_swapchain_extent.height * 4;
+
+	BufferHandle readback_buffer = CreateBuffer(
+		buffer_size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VkDeviceMemory readback_buffer_memory = m_buffers.At(readback_buffer).memory;
+
+	CopyImageToBuffer(m_vk_swapchain_images[m_last_image_index], readback_buffer, m_vk_swapchain_extent);
+
+	void* data;
+	vkMapMemory(m_vk_device, readback_buffer_memory, 0, buffer_size, 0, &data);
+
+	std::ofstream output_file(file_name_, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (output_file.is_open())
+	{
+		output_file << "P6\n" << m_vk_swapchain_extent.width << " " << m_vk_swapchain_extent.height << "\n255\n";
+
+		// B8G8R8A8 to packed RGB
+		const uint8_t* pixels = static_cast<const uint8_t*>(data);
+		std::vector<uint8_t> row(m_vk_swapchain_extent.width * 3);
+		for (uint32_t y = 0; y < m_vk_swapchain_extent.height; y++)
+		{
+			for (uint32_t x = 0; x < m_vk_swapchain_extent.width; x++)
+			{
+				const uint8_t* pixel = pixels + (static_cast<size_t>(y) * m_vk_swapchain_extent.width + x) * 4;
+				row[x * 3 + 0] = pixel[2];
+				row[x * 3 + 1] = pixel[1];
+				row[x * 3 + 2] = pixel[0];
+			}
+			output_file.write(reinterpret_cast<const char*>(row.data()), row.size());
+		}
+	}
+
+	vkUnmapMemory(m_vk_device, readback_buffer_memory);
+	DestroyBuffer(readback_buffer);
+
+	if (!output_file.is_open())
+		throw std::runtime_error("Unable to open frame capture file: " + file_name_);
+}
+
 VKAPI_ATTR VkBool32 VKAPI_CALL graphics::DebugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT message_severity_,
 	VkDebugUtilsMessageTypeFlagsEXT message_type_,
@@ -962,3 +1577,489 @@ VKAPI_ATTR VkBool32 VKAPI_CALL graphics::DebugCallback(
 	std::cerr << "Validation layer : " << callback_data_->pMessage << std::endl;
 	return VK_FALSE;
 }
+
+
+graphics::MeshHandle graphics::GraphicsManager::CreateMesh(const std::string& file_name_)
+{
+	PROFILE_FUNCTION();
+	memory::AssetFile file(m_package.get(), file_name_);
+	MeshView view = ReadMeshFile(file.Data(), file.Size());
+	if (view.layout != m_vertex_layout)
+		throw std::runtime_error("Mesh vertex layout does not match the pipeline: " + file_name_);
+	return CreateMesh(view);
+}
+
+graphics::MeshHandle graphics::GraphicsManager::CreateMesh(const MeshView& view_)
+{
+	PROFILE_FUNCTION();
+	if (view_.layout != m_vertex_layout)
+		throw std::runtime_error("Mesh vertex layout does not match the pipeline");
+
+	const MeshFileHeader& header = *view_.header;
+	if (header.vertex_count == 0 || header.index_count == 0)
+		throw std::runtime_error("Mesh has no geometry");
+
+	uint64_t vertex_range = m_vertex_ranges.Allocate(header.vertex_count);
+	uint64_t index_range = m_index_ranges.Allocate(header.index_bytes, GEOMETRY_INDEX_ALIGNMENT);
+	if (vertex_range == memory::NO_RANGE || index_range == memory::NO_RANGE)
+	{
+		m_vertex_ranges.Free(vertex_range, header.vertex_count);
+		m_index_ranges.Free(index_range, header.index_bytes);
+		GrowGeometryBuffers(header.vertex_count, header.index_bytes);
+		vertex_range = m_vertex_ranges.Allocate(header.vertex_count);
+		index_range = m_index_ranges.Allocate(header.index_bytes, GEOMETRY_INDEX_ALIGNMENT);
+	}
+
+	Mesh mesh;
+	mesh.first_vertex = static_cast<uint32_t>(vertex_range);
+	mesh.vertex_count = header.vertex_count;
+	mesh.index_offset = index_range;
+	mesh.index_count = header.index_count;
+	mesh.index_type = header.index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	mesh.first_index = static_cast<uint32_t>(index_range / header.index_size);
+	mesh.lods.assign(view_.lods, view_.lods + header.lod_count);
+	mesh.bounds = header.bounds;
+
+	// Both sections are copied straight from the file data into one staging buffer, then every stream to its shared buffer
+	BufferHandle staging_buffer;
+	try
+	{
+		staging_buffer = CreateBuffer(
+			header.vertex_bytes + header.index_bytes,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // Buffer can be used as source in a memory transfer operation 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		void* data;
+		vkMapMemory(m_vk_device, m_buffers.At(staging_buffer).memory, 0, header.vertex_bytes + header.index_bytes, 0, &data);
+		memcpy(data, view_.vertex_data, (size_t)header.vertex_bytes);
+		memcpy(static_cast<uint8_t*>(data) + header.vertex_bytes, view_.index_data, (size_t)header.index_bytes);
+		vkUnmapMemory(m_vk_device, m_buffers.At(staging_buffer).memory);
+
+		for (uint32_t stream = 0; stream < m_vertex_streams.size(); stream++)
+		{
+			VkDeviceSize stride = m_vertex_layout.Stride(stream);
+			CopyBuffer(staging_buffer, m_vertex_streams[stream], stride * header.vertex_count, view_.stream_offsets[stream], stride * mesh.first_vertex);
+		}
+		CopyBuffer(staging_buffer, m_index_buffer, header.index_bytes, header.vertex_bytes, mesh.index_offset);
+	}
+	catch (...)
+	{
+		// The copies wait for the queue, nothing in flight uses the ranges when one throws
+		DestroyBuffer(staging_buffer);
+		m_vertex_ranges.Free(vertex_range, header.vertex_count);
+		m_index_ranges.Free(index_range, header.index_bytes);
+		throw;
+	}
+
+	DestroyBuffer(staging_buffer);
+	return m_meshes.Create(std::move(mesh));
+}
+
+void graphics::GraphicsManager::DestroyMesh(MeshHandle mesh_)
+{
+	Mesh* mesh = m_meshes.Get(mesh_);
+	if (mesh == nullptr)
+		return;
+
+	// Frames in flight, and the one recorded before the draw list is rerecorded, may still draw from the ranges.
+	// They are freed once those frames finished, so an upload never overwrites geometry a frame reads
+	uint64_t index_bytes = static_cast<uint64_t>(mesh->index_count) * (mesh->index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+	m_retired_ranges.push_back({ mesh->first_vertex, mesh->vertex_count, mesh->index_offset, index_bytes, m_frame_number });
+	m_meshes.Destroy(mesh_);
+
+	auto it = std::find(m_draw_list.begin(), m_draw_list.end(), mesh_);
+	if (it != m_draw_list.end())
+	{
+		m_draw_list.erase(it);
+		m_command_buffers_dirty = true;
+	}
+}
+
+void graphics::GraphicsManager::SetDrawList(const std::vector<MeshHandle>& meshes_)
+{
+	m_draw_list = meshes_;
+	m_command_buffers_dirty = true;
+}
+
+graphics::ShaderHandle graphics::GraphicsManager::CreateShader(const std::string& file_name_, const memory::AssetFile& binary_)
+{
+	return m_shader_manager->CreateShaderModule(file_name_, binary_, m_vk_device);
+}
+
+void graphics::GraphicsManager::DestroyShader(ShaderHandle shader_)
+{
+	// Pipelines keep no reference to their modules, so this does not wait for the frames in flight
+	m_shader_manager->DestroyShaderModule(shader_);
+}
+
+graphics::TextureHandle graphics::GraphicsManager::CreateTexture(const std::string& file_name_)
+{
+	return CreateTexture(memory::AssetFile(m_package.get(), file_name_), file_name_);
+}
+
+graphics::TextureHandle graphics::GraphicsManager::CreateTexture(memory::AssetFile file_, const std::string& name_)
+{
+	PROFILE_FUNCTION();
+	Texture texture;
+	texture.file = std::move(file_);
+	texture.source = ReadTextureFile(texture.file.Data(), texture.file.Size());
+
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(m_vk_physical_device, texture.source.format, &format_properties);
+	if ((format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0)
+		throw std::runtime_error("Texture format is not supported by the device: " + name_);
+
+	TextureStreamState& stream = texture.stream;
+	stream.mip_count = static_cast<uint32_t>(texture.source.mips.size());
+	for (uint32_t mip = 0; mip < stream.mip_count; mip++)
+		stream.mip_bytes[mip] = texture.source.mips[mip].bytes;
+
+	// At least the smallest mip is always resident
+	stream.tail_mip = stream.mip_count - 1;
+	while (stream.tail_mip > 0 && (std::max)(texture.source.mips[stream.tail_mip - 1].width, texture.source.mips[stream.tail_mip - 1].height) <= TEXTURE_STREAMING_TAIL_SIZE)
+		stream.tail_mip--;
+	stream.resident_mip = stream.mip_count; // Nothing on the GPU yet
+	stream.wanted_mip = 0;
+	stream.last_used_frame = m_frame_number;
+
+	VkDeviceSize staging_size = 0;
+	for (uint32_t mip = stream.tail_mip; mip < stream.mip_count; mip++)
+		staging_size += (stream.mip_bytes[mip] + TEXTURE_STAGING_ALIGNMENT - 1) / TEXTURE_STAGING_ALIGNMENT * TEXTURE_STAGING_ALIGNMENT;
+
+	BufferHandle staging_buffer = CreateBuffer(
+		staging_size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	void* data;
+	vkMapMemory(m_vk_device, m_buffers.At(staging_buffer).memory, 0, staging_size, 0, &data);
+
+	VkCommandBuffer command_buffer = BeginOneTimeCommands();
+	VkDeviceSize staging_offset = 0;
+	RecordTextureResidency(command_buffer, texture, stream.tail_mip, staging_buffer, static_cast<uint8_t*>(data), staging_offset);
+	EndOneTimeCommands(command_buffer);
+	m_staging_upload_metric->Add(staging_offset);
+
+	vkUnmapMemory(m_vk_device, m_buffers.At(staging_buffer).memory);
+	DestroyBuffer(staging_buffer);
+	return m_textures.Create(std::move(texture));
+}
+
+memory::AssetFile graphics::GraphicsManager::DestroyTexture(TextureHandle texture_)
+{
+	Texture* texture = m_textures.Get(texture_);
+	if (texture == nullptr)
+		return {};
+
+	m_retired_images.push_back({ texture->image, texture->memory, texture->image_view, m_frame_number });
+	memory::AssetFile file = std::move(texture->file);
+	m_textures.Destroy(texture_);
+	return file;
+}
+
+void graphics::GraphicsManager::RequestTextureMip(TextureHandle texture_, uint32_t mip_)
+{
+	Texture* texture = m_textures.Get(texture_);
+	if (texture == nullptr)
+		return;
+
+	texture->stream.wanted_mip = (std::min)(mip_, texture->stream.tail_mip);
+	texture->stream.last_used_frame = m_frame_number;
+}
+
+graphics::TextureStreamingStats graphics::GraphicsManager::TextureStats() const
+{
+	TextureStreamingStats stats = m_texture_stats;
+	stats.textures = static_cast<uint32_t>(m_textures.Size());
+	stats.budget_bytes = m_texture_budget.memory_bytes;
+	for (size_t i = 0; i < m_textures.Size(); i++)
+	{
+		const Texture& texture = *m_textures.Get(m_textures.HandleAt(i));
+		stats.streaming_textures += texture.stream.resident_mip > texture.stream.wanted_mip ? 1 : 0;
+		stats.resident_bytes += ResidentBytes(texture.stream, texture.stream.resident_mip);
+		stats.wanted_bytes += ResidentBytes(texture.stream, texture.stream.wanted_mip);
+		stats.device_bytes += texture.memory_size;
+	}
+	return stats;
+}
+
+VkSampler graphics::GraphicsManager::GetSampler(const SamplerDesc& desc_)
+{
+	auto it = m_samplers.find(desc_);
+	if (it != m_samplers.end())
+		return it->second;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_vk_physical_device, &properties);
+
+	VkSamplerCreateInfo sampler_info = {};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = desc_.filter;
+	sampler_info.minFilter = desc_.filter;
+	sampler_info.mipmapMode = desc_.mipmap_mode;
+	sampler_info.addressModeU = desc_.address_mode;
+	sampler_info.addressModeV = desc_.address_mode;
+	sampler_info.addressModeW = desc_.address_mode;
+	sampler_info.anisotropyEnable = m_vk_enabled_features.samplerAnisotropy && desc_.max_anisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+	sampler_info.maxAnisotropy = sampler_info.anisotropyEnable ? (std::min)(desc_.max_anisotropy, properties.limits.maxSamplerAnisotropy) : 1.0f;
+	sampler_info.minLod = 0.0f;
+	sampler_info.maxLod = VK_LOD_CLAMP_NONE; // Views only hold the resident mips
+	sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+	VkSampler sampler;
+	auto result = vkCreateSampler(m_vk_device, &sampler_info, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create VkSampler, error: " + FormatVkResult(result));
+
+	m_samplers.emplace(desc_, sampler);
+	return sampler;
+}
+
+VkCommandBuffer graphics::GraphicsManager::UpdateTextureStreaming()
+{
+	PROFILE_FUNCTION();
+	m_texture_stats.last_frame_upload_bytes = 0;
+	if (m_textures.Empty())
+		return VK_NULL_HANDLE;
+
+	m_texture_states.clear();
+	for (size_t i = 0; i < m_textures.Size(); i++)
+		m_texture_states.push_back(&m_textures.At(m_textures.HandleAt(i)).stream);
+
+	TextureStreamPlan plan = m_texture_planner.Plan(m_texture_states, m_texture_budget, m_frame_number);
+	m_texture_resident_metric->Set(static_cast<double>(plan.resident_bytes));
+	if (plan.streamed_mips == 0 && plan.evicted_mips == 0)
+		return VK_NULL_HANDLE;
+
+	// The fence of this frame slot was waited, so its staging buffer is free to be replaced
+	VkDeviceSize staging_size = plan.upload_bytes + plan.streamed_mips * TEXTURE_STAGING_ALIGNMENT;
+	if (staging_size > m_buffers.At(m_streaming_staging[m_current_frame]).size)
+	{
+		DestroyBuffer(m_streaming_staging[m_current_frame]);
+		m_streaming_staging[m_current_frame] = CreateBuffer(
+			staging_size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		void* data;
+		vkMapMemory(m_vk_device, m_buffers.At(m_streaming_staging[m_current_frame]).memory, 0, VK_WHOLE_SIZE, 0, &data);
+		m_streaming_staging_data[m_current_frame] = static_cast<uint8_t*>(data);
+	}
+
+	VkCommandBuffer command_buffer = m_streaming_command_buffers[m_current_frame];
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	auto begin_result = vkBeginCommandBuffer(command_buffer, &begin_info);
+	if (begin_result != VK_SUCCESS)
+		throw std::runtime_error("Failed to begin recording streaming command buffer, error: " + FormatVkResult(begin_result));
+
+	VkDeviceSize staging_offset = 0;
+	for (size_t i = 0; i < m_textures.Size(); i++)
+	{
+		Texture& texture = m_textures.At(m_textures.HandleAt(i));
+		if (texture.stream.target_mip != texture.stream.resident_mip)
+			RecordTextureResidency(command_buffer, texture, texture.stream.target_mip, 
+				m_streaming_staging[m_current_frame], m_streaming_staging_data[m_current_frame], staging_offset);
+	}
+
+	auto record_result = vkEndCommandBuffer(command_buffer);
+	if (record_result != VK_SUCCESS)
+		throw std::runtime_error("Failed to record streaming command buffer, error: " + FormatVkResult(record_result));
+
+	m_texture_stats.streamed_bytes += plan.upload_bytes;
+	m_texture_stats.evicted_bytes += plan.evicted_bytes;
+	m_texture_stats.streamed_mips += plan.streamed_mips;
+	m_texture_stats.evicted_mips += plan.evicted_mips;
+	m_texture_stats.last_frame_upload_bytes = plan.upload_bytes;
+	m_texture_streamed_metric->Add(plan.upload_bytes);
+	m_texture_evicted_metric->Add(plan.evicted_bytes);
+	m_staging_upload_metric->Add(plan.upload_bytes);
+	return command_buffer;
+}
+
+void graphics::GraphicsManager::DestroyRetiredImages(uint64_t finished_frame_)
+{
+	auto retired = std::remove_if(m_retired_images.begin(), m_retired_images.end(), [&](const RetiredImage& image_)
+	{
+		if (image_.frame > finished_frame_)
+			return false;
+
+		vkDestroyImageView(m_vk_device, image_.image_view, nullptr);
+		vkDestroyImage(m_vk_device, image_.image, nullptr);
+		FreeMemory(image_.memory);
+		return true;
+	});
+	m_retired_images.erase(retired, m_retired_images.end());
+}
+
+void graphics::GraphicsManager::FreeRetiredRanges(uint64_t finished_frame_)
+{
+	auto retired = std::remove_if(m_retired_ranges.begin(), m_retired_ranges.end(), [&](const RetiredRange& range_)
+	{
+		if (range_.frame > finished_frame_)
+			return false;
+
+		m_vertex_ranges.Free(range_.vertex_offset, range_.vertex_count);
+		m_index_ranges.Free(range_.index_offset, range_.index_bytes);
+		return true;
+	});
+	m_retired_ranges.erase(retired, m_retired_ranges.end());
+}
+
+void graphics::GraphicsManager::CreateTextureImage(Texture& texture_, uint32_t first_mip_, RetiredImage& image_, VkDeviceSize& size_)
+{
+	const TextureMip& mip = texture_.source.mips[first_mip_];
+	uint32_t mip_levels = texture_.stream.mip_count - first_mip_;
+
+	VkImageCreateInfo image_info = {};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.format = texture_.source.format;
+	image_info.extent = { mip.width, mip.height, 1 };
+	image_info.mipLevels = mip_levels;
+	image_info.arrayLayers = 1;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	// Transfer source for the next residency change
+	image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	auto result = vkCreateImage(m_vk_device, &image_info, nullptr, &image_.image);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create texture VkImage, error: " + FormatVkResult(result));
+
+	VkMemoryRequirements mem_requirements;
+	vkGetImageMemoryRequirements(m_vk_device, image_.image, &mem_requirements);
+
+	VkMemoryAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = mem_requirements.size;
+	alloc_info.memoryTypeIndex = FindMemoryType(mem_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vk_physical_device);
+
+	result = AllocateMemory(alloc_info, image_.memory);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(m_vk_device, image_.image, nullptr);
+		throw std::runtime_error("Failed to allocate texture memory, error: " + FormatVkResult(result));
+	}
+	size_ = mem_requirements.size;
+
+	result = vkBindImageMemory(m_vk_device, image_.image, image_.memory, 0);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(m_vk_device, image_.image, nullptr);
+		FreeMemory(image_.memory);
+		throw std::runtime_error("Failed to bind texture memory, error: " + FormatVkResult(result));
+	}
+
+	VkImageViewCreateInfo view_info = {};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = image_.image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = texture_.source.format;
+	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	view_info.subresourceRange.baseMipLevel = 0;
+	view_info.subresourceRange.levelCount = mip_levels;
+	view_info.subresourceRange.baseArrayLayer = 0;
+	view_info.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(m_vk_device, &view_info, nullptr, &image_.image_view);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(m_vk_device, image_.image, nullptr);
+		FreeMemory(image_.memory);
+		throw std::runtime_error("Failed to create texture VkImageView, error: " + FormatVkResult(result));
+	}
+}
+
+void graphics::GraphicsManager::RecordTextureResidency(
+	VkCommandBuffer command_buffer_,
+	Texture& texture_,
+	uint32_t first_mip_,
+	BufferHandle staging_buffer_,
+	uint8_t* staging_data_,
+	VkDeviceSize& staging_offset_)
+{
+	TextureStreamState& stream = texture_.stream;
+	RetiredImage old_image = { texture_.image, texture_.memory, texture_.image_view, m_frame_number };
+	uint32_t old_first_mip = stream.resident_mip;
+
+	RetiredImage new_image;
+	VkDeviceSize new_size = 0;
+	CreateTextureImage(texture_, first_mip_, new_image, new_size);
+
+	VkImageMemoryBarrier barriers[2] = {};
+	for (auto& barrier : barriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.layerCount = 1;
+	}
+	barriers[0].image = new_image.image;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].image = old_image.image;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	uint32_t barrier_count = old_image.image != VK_NULL_HANDLE ? 2 : 1;
+	vkCmdPipelineBarrier(command_buffer_, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, barrier_count, barriers);
+
+	// Mips both images hold move on the GPU
+	std::array<VkImageCopy, MAX_TEXTURE_MIPS> image_copies;
+	uint32_t image_copy_count = 0;
+	for (uint32_t mip = (std::max)(first_mip_, old_first_mip); mip < stream.mip_count; mip++)
+	{
+		VkImageCopy& copy = image_copies[image_copy_count++];
+		copy = {};
+		copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - old_first_mip, 0, 1 };
+		copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - first_mip_, 0, 1 };
+		copy.extent = { texture_.source.mips[mip].width, texture_.source.mips[mip].height, 1 };
+	}
+	if (image_copy_count > 0)
+		vkCmdCopyImage(command_buffer_, old_image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+			new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image_copy_count, image_copies.data());
+
+	// Missing mips come straight from the mapped file
+	std::array<VkBufferImageCopy, MAX_TEXTURE_MIPS> buffer_copies;
+	uint32_t buffer_copy_count = 0;
+	for (uint32_t mip = first_mip_; mip < (std::min)(old_first_mip, stream.mip_count); mip++)
+	{
+		const TextureMip& source = texture_.source.mips[mip];
+		memcpy(staging_data_ + staging_offset_, source.data, (size_t)source.bytes);
+
+		VkBufferImageCopy& copy = buffer_copies[buffer_copy_count++];
+		copy = {};
+		copy.bufferOffset = staging_offset_;
+		copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - first_mip_, 0, 1 };
+		copy.imageExtent = { source.width, source.height, 1 };
+		staging_offset_ += (source.bytes + TEXTURE_STAGING_ALIGNMENT - 1) / TEXTURE_STAGING_ALIGNMENT * TEXTURE_STAGING_ALIGNMENT;
+	}
+	if (buffer_copy_count > 0)
+		vkCmdCopyBufferToImage(command_buffer_, m_buffers.At(staging_buffer_).buffer, new_image.image, 
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, buffer_copy_count, buffer_copies.data());
+
+	// Later submissions on the queue sample it, the frame's command buffers included
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, barriers);
+
+	if (old_image.image != VK_NULL_HANDLE)
+		m_retired_images.push_back(old_image);
+
+	texture_.image = new_image.image;
+	texture_.memory = new_image.memory;
+	texture_.image_view = new_image.image_view;
+	texture_.memory_size = new_size;
+	stream.resident_mip = first_mip_;
+}
\ No newline at end of file
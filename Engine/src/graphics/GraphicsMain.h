@@ -1,25 +1,127 @@
 #pragma once
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include "vulkan/vulkan.h"
 
 #include "../environment/EnvironmentMain.h"
 #include "GraphicsShaders.h"
+#include "GraphicsVertex.h"
+#include "GraphicsMesh.h"
+#include "GraphicsTexture.h"
+#include "GraphicsStreaming.h"
 #include "GraphicsUtils.h"
+#include "../profiling/ProfilingZones.h"
+#include "../profiling/ProfilingMetrics.h"
+#include "../memory/MemoryPool.h"
+#include "../memory/MemoryPackage.h"
+#include "../memory/MemoryRanges.h"
 #include <iostream>
 #include <optional>
 #include <cstring>
 #include <set>
 #include <memory>
 #include <limits>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <shared_mutex>
 
 namespace graphics
 {
+	constexpr uint32_t GEOMETRY_INITIAL_VERTICES = 1 << 20; // Capacity of the shared vertex streams, doubled when full
+	constexpr VkDeviceSize GEOMETRY_INITIAL_INDEX_BYTES = 16 << 20;
+	constexpr VkDeviceSize GEOMETRY_INDEX_ALIGNMENT = 4; // 16 and 32 bit meshes share the index buffer
+
+	struct Buffer
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+	};
+
+	struct Pipeline
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE; // Owned by the shader manager's layout cache
+	};
+
+	using BufferHandle = memory::Handle<Buffer>;
+	using PipelineHandle = memory::Handle<Pipeline>;
+
+	// Pipeline compiled off the main thread, owned by the caller until it is added to the graphics manager
+	struct CompiledPipeline
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		uint64_t generation = 0; // Of the swap chain it was compiled for, a later one discards it
+	};
+
+	struct PipelineCacheStats
+	{
+		size_t permutations = 0;
+		uint64_t compiles = 0; // On any thread, swap chain recreation included
+		uint64_t hits = 0;
+		uint64_t misses = 0; // Compiled on the main thread by GetPipeline
+		uint64_t precompiled = 0; // Compiled elsewhere and added
+		uint64_t discarded = 0; // Added for an older swap chain or already cached
+	};
+
+	// GPU copy of a cooked mesh file, a range of the shared vertex streams and index buffer
+	struct Mesh
+	{
+		uint32_t first_vertex = 0; // Vertex offset of the draws, the indices stay mesh relative
+		uint32_t vertex_count = 0;
+		VkDeviceSize index_offset = 0; // Bytes into the index buffer
+		uint32_t first_index = 0; // index_offset in index_type units
+		uint32_t index_count = 0;
+		VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+		std::vector<MeshLod> lods; // first_index relative to the mesh's first_index
+		MeshBounds bounds = {};
+	};
+
+	using MeshHandle = memory::Handle<Mesh>;
+
+	// Geometry ranges of a destroyed mesh, frames up to frame may still draw from them
+	struct RetiredRange
+	{
+		uint64_t vertex_offset = 0;
+		uint64_t vertex_count = 0;
+		uint64_t index_offset = 0;
+		uint64_t index_bytes = 0;
+		uint64_t frame = 0;
+	};
+
+	// Sampled image of a KTX2 file, the file stays mapped so mips can be streamed in and out without parsing
+	struct Texture
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView image_view = VK_NULL_HANDLE; // Its mip 0 is stream.resident_mip of the texture
+		VkDeviceSize memory_size = 0;
+		memory::AssetFile file;
+		TextureView source;
+		TextureStreamState stream;
+	};
+
+	using TextureHandle = memory::Handle<Texture>;
+
+	constexpr VkDeviceSize TEXTURE_STAGING_ALIGNMENT = 16; // Of every mip in the staging buffers, a multiple of all block sizes
+
+	// Image replaced by a streaming change or of a destroyed texture, frames up to frame may still sample it
+	struct RetiredImage
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView image_view = VK_NULL_HANDLE;
+		uint64_t frame = 0;
+	};
+
 	class GraphicsManager
 	{
 		// VARIABLES
 	private:
 		bool m_initialized = false;
+		bool m_headless = false; // No window, frames are rendered into offscreen images instead of a swap chain
 
 // Synchronization block 
 		std::vector<VkSemaphore> m_semaphores_image_available;
@@ -28,10 +130,14 @@ namespace graphics
 
 		int m_max_frames_in_flight = 1;
 		size_t m_current_frame = 0;
+		uint64_t m_window_generation = 0; // Last seen EnvironmentManager window state generation
+		PresentPolicy m_present_policy = PresentLowLatency; // Present mode preference only, pacing is done by the engine loop
+		VkPresentModeKHR m_present_mode = VK_PRESENT_MODE_FIFO_KHR;
 
 // Managers and information block 
 		std::shared_ptr<graphics::ShaderManager> m_shader_manager;
 		std::shared_ptr<environment::EnvironmentManager> m_environment_manager;
+		std::shared_ptr<const memory::Package> m_package; // Kept alive while textures read from its mapping
 		std::string m_engine_name;
 		std::string m_app_name;
 
@@ -48,25 +154,94 @@ namespace graphics
 		std::vector<VkFramebuffer> m_vk_swapchain_framebuffers;
 		std::vector<VkCommandBuffer> m_vk_command_buffers;
 		std::vector<VkImageView> m_vk_image_views;
-		VkBuffer m_vk_vertex_buffer = VK_NULL_HANDLE;
-		VkDeviceMemory m_vk_vertex_buffer_memory = VK_NULL_HANDLE;
-		VkBuffer m_vk_index_buffer = VK_NULL_HANDLE;
-		VkDeviceMemory m_vk_index_buffer_memory = VK_NULL_HANDLE;
+		std::vector<VkDeviceMemory> m_vk_offscreen_images_memory; // Headless only, swap chain images are owned by the swap chain
+		uint32_t m_last_image_index = 0;
+
+// Resource block 
+		memory::Pool<Buffer> m_buffers;
+		memory::Pool<Pipeline> m_pipelines;
+		memory::Pool<Mesh> m_meshes;
+		VertexLayout m_vertex_layout = BasicLayout();
+		PipelineHandle m_graphics_pipeline; // Of m_permutation, bound by the draws
+
+// Pipeline permutation block 
+		// Shader state every permutation of the basic pipeline shares, rebuilt with the swap chain
+		struct PipelineBase
+		{
+			ShaderHandle vertex_shader;
+			ShaderHandle fragment_shader;
+			VkShaderModule vertex_module = VK_NULL_HANDLE;
+			VkShaderModule fragment_module = VK_NULL_HANDLE;
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			VertexInputDesc vertex_input;
+			std::vector<ShaderSpecConstant> spec_constants; // Of both stages, by constant id
+		};
+
+		PipelineBase m_pipeline_base;
+		ShaderPermutation m_permutation;
+		// Keys stay across swap chain recreation so the permutations in use are compiled again, null handles in between
+		std::unordered_map<ShaderPermutation, PipelineHandle, ShaderPermutationHash> m_permutation_pipelines;
+		VkPipelineCache m_vk_pipeline_cache = VK_NULL_HANDLE;
+		mutable std::shared_mutex m_pipeline_mutex; // Shared by compiles, exclusive while the swap chain is recreated
+		uint64_t m_pipeline_generation = 0; // Swap chains created, guarded by m_pipeline_mutex
+		mutable std::atomic<uint64_t> m_pipeline_compiles = 0;
+		PipelineCacheStats m_pipeline_stats;
+
+// Geometry block 
+		std::vector<BufferHandle> m_vertex_streams; // One buffer per layout stream shared by every mesh
+		BufferHandle m_index_buffer;
+		memory::RangeAllocator m_vertex_ranges; // In vertices, the same range in every stream
+		memory::RangeAllocator m_index_ranges; // In bytes
+		std::vector<RetiredRange> m_retired_ranges;
+		MeshHandle m_quad_mesh;
+		std::vector<MeshHandle> m_draw_list;
+		bool m_command_buffers_dirty = false; // Draw list or geometry buffers changed since recording
+
+// Texture block 
+		memory::Pool<Texture> m_textures;
+		std::map<SamplerDesc, VkSampler> m_samplers;
+		TextureStreamBudget m_texture_budget;
+		TextureStreamPlanner m_texture_planner;
+		std::vector<TextureStreamState*> m_texture_states; // Planner input, rebuilt every frame
+		VkCommandPool m_vk_streaming_command_pool = VK_NULL_HANDLE; // Command buffers are reset one by one
+		std::vector<VkCommandBuffer> m_streaming_command_buffers; // Per frame in flight, submitted before the frame
+		std::vector<BufferHandle> m_streaming_staging; // Per frame in flight, stays mapped
+		std::vector<uint8_t*> m_streaming_staging_data;
+		std::vector<RetiredImage> m_retired_images;
+		uint64_t m_frame_number = 0; // Of the frame begun last
+		TextureStreamingStats m_texture_stats;
 
 // GPU block 
 		VkInstance m_vk_instance = VK_NULL_HANDLE;
 		VkPhysicalDevice m_vk_physical_device = VK_NULL_HANDLE;
 		VkDevice m_vk_device = VK_NULL_HANDLE;
 		VkSurfaceKHR m_vk_surface = VK_NULL_HANDLE;
+		VkPhysicalDeviceFeatures m_vk_enabled_features = {};
 
 // Render block 
 		VkQueue m_vk_graphics_queue = VK_NULL_HANDLE;
 		VkQueue m_vk_present_queue = VK_NULL_HANDLE;
 		VkRenderPass m_vk_render_pass = VK_NULL_HANDLE;
-		VkPipelineLayout m_vk_pipeline_layout = VK_NULL_HANDLE;
-		VkPipeline m_vk_graphics_pipeline = VK_NULL_HANDLE;
 		VkCommandPool m_vk_command_pool = VK_NULL_HANDLE;
 
+// GPU timing block 
+		VkQueryPool m_vk_timestamp_query_pool = VK_NULL_HANDLE; // Two timestamps per command buffer, VK_NULL_HANDLE if unsupported
+		double m_timestamp_period = 0.0; // Nanoseconds per timestamp tick
+		uint64_t m_timestamp_mask = 0; // Valid bits of the graphics queue timestamps
+		double m_last_gpu_frame_time = -1.0;
+
+// Metrics block 
+		uint32_t m_recorded_draw_calls = 0; // Draw calls in each prerecorded command buffer
+		std::unordered_map<VkDeviceMemory, VkDeviceSize> m_allocation_sizes;
+		profiling::Counter* m_draw_calls_metric = nullptr;
+		profiling::Counter* m_staging_upload_metric = nullptr;
+		profiling::Gauge* m_device_memory_metric = nullptr;
+		profiling::Gauge* m_gpu_frame_time_metric = nullptr;
+		profiling::Gauge* m_texture_resident_metric = nullptr;
+		profiling::Counter* m_texture_streamed_metric = nullptr;
+		profiling::Counter* m_texture_evicted_metric = nullptr;
+		profiling::Counter* m_pipeline_compiles_metric = nullptr;
+
 		const std::vector<const char*> device_extensions = {
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
@@ -76,10 +251,12 @@ namespace graphics
 		GraphicsManager(
 			std::shared_ptr<environment::EnvironmentManager>& environment_manager_, 
 			int max_frames_in_flight_ = 1,
+			std::shared_ptr<const memory::Package> package_ = nullptr,
 			const std::string& engine_name_ = "Engine", 
 			const std::string& app_name_ = "Default App") : 
-			m_environment_manager(environment_manager_), 
 			m_max_frames_in_flight(max_frames_in_flight_),
+			m_environment_manager(environment_manager_), 
+			m_package(package_),
 			m_engine_name(engine_name_), 
 			m_app_name(app_name_)
 		{ Initialize(); }
@@ -99,16 +276,26 @@ namespace graphics
 		void CreateLogicalDevice();
 		void CreateSurface();
 		void CreateSwapChain();
+		void CreateOffscreenImages();
 		void CreateImageViews();
 		void CreateRenderPass();
-		void CreateGraphicsPipeline();
+		void CreatePipelineCache();
+		void CreateGraphicsPipeline(); // Compiles every cached permutation for the current swap chain
+		VkPipeline CompilePipelineLocked(const ShaderPermutation& permutation_) const; // Caller holds m_pipeline_mutex
 		void CreateFramebuffers();
 		void CreateCommandPool();
-		void CreateVertexBuffers();
-		void CreateIndexBuffers();
+		void CreateGeometryBuffers();
+		void CreateBuiltinMeshes();
+		void CreateTextureStreaming();
+		void CreateTimestampQueries();
 		void CreateCommandBuffers();
 		void CreateSync();
 		void RecreateSwapChain();
+		void RerecordCommandBuffers();
+		VkCommandBuffer UpdateTextureStreaming(); // Records this frame's mip changes, VK_NULL_HANDLE if there are none
+		void DestroyRetiredImages(uint64_t finished_frame_); // Images retired up to finished_frame_
+		void FreeRetiredRanges(uint64_t finished_frame_); // Mesh ranges retired up to finished_frame_
+		void ReadGpuFrameTime();
 
 		bool IsDeviceSuitable(VkPhysicalDevice device_);
 		bool CheckDeviceExtensionSupport(VkPhysicalDevice device_);
@@ -118,21 +305,98 @@ namespace graphics
 		VkResult CreateDebugUtilsMessengerEXT(
 			const VkDebugUtilsMessengerCreateInfoEXT* create_info_,
 			const VkAllocationCallbacks* allocator_);
-		void CreateBuffer(
+		BufferHandle CreateBuffer(
 			VkDeviceSize size_, 
 			VkBufferUsageFlags usage_, 
-			VkMemoryPropertyFlags properties_,
-			VkBuffer& buffer_, 
-			VkDeviceMemory& buffer_memory_);
+			VkMemoryPropertyFlags properties_);
+		void GrowBuffer(BufferHandle& buffer_, VkDeviceSize size_, VkBufferUsageFlags usage_); // Keeps the contents, buffer_ receives the new handle
+		void GrowGeometryBuffers(uint32_t vertex_count_, VkDeviceSize index_bytes_); // Until both fit in a free range
+		void DestroyBuffer(BufferHandle buffer_);
+		void CreateTextureImage(Texture& texture_, uint32_t first_mip_, RetiredImage& image_, VkDeviceSize& size_);
+		// Gives texture_ an image holding mips [first_mip_, mip_count). Resident mips are copied on the GPU, the others
+		// are read from the mapped file into staging_data_ at staging_offset_. The old image goes to the retired images
+		void RecordTextureResidency(
+			VkCommandBuffer command_buffer_,
+			Texture& texture_,
+			uint32_t first_mip_,
+			BufferHandle staging_buffer_,
+			uint8_t* staging_data_,
+			VkDeviceSize& staging_offset_);
+		VkCommandBuffer BeginOneTimeCommands();
+		void EndOneTimeCommands(VkCommandBuffer command_buffer_); // Submits and waits for the queue
+		void DestroyPipeline(PipelineHandle pipeline_);
 		void CopyBuffer(
-			VkBuffer src_buffer_, 
-			VkBuffer dst_buffer_, 
-			VkDeviceSize size_);
+			BufferHandle src_buffer_, 
+			BufferHandle dst_buffer_, 
+			VkDeviceSize size_,
+			VkDeviceSize src_offset_ = 0,
+			VkDeviceSize dst_offset_ = 0);
+		void CopyImageToBuffer(
+			VkImage src_image_,
+			BufferHandle dst_buffer_,
+			VkExtent2D extent_);
 		void DestroyDebugUtilsMessengerEXT(const VkAllocationCallbacks* allocator_);
+		VkResult AllocateMemory(const VkMemoryAllocateInfo& alloc_info_, VkDeviceMemory& memory_); // Tracks device memory in use
+		void FreeMemory(VkDeviceMemory memory_);
 	public:
 		void BeginFrame();
 		void EndFrame();
 		void WaitDevice();
+
+		bool IsInitialized() const { return m_initialized; }
+		bool IsHeadless() const { return m_headless; }
+		double LastGpuFrameTime() const { return m_last_gpu_frame_time; } // Milliseconds, negative if not available
+		void SetPresentPolicy(PresentPolicy policy_); // Recreates the swap chain if the present mode changes
+		PresentPolicy GetPresentPolicy() const { return m_present_policy; }
+		VkPresentModeKHR PresentMode() const { return m_present_mode; }
+		void CaptureFrame(const std::string& file_name_); // Writes the last rendered frame as a binary PPM, headless only
+
+		// Maps a cooked mesh file, or finds it in the package, and uploads it without parsing. Throws if its layout differs from the pipeline's
+		MeshHandle CreateMesh(const std::string& file_name_);
+		MeshHandle CreateMesh(const MeshView& view_);
+		void DestroyMesh(MeshHandle mesh_); // Also removes it from the draw list
+
+		// Meshes drawn every frame, the geometry buffers are bound once and every mesh is one indexed draw.
+		// Command buffers are rerecorded at the next BeginFrame
+		void SetDrawList(const std::vector<MeshHandle>& meshes_);
+		const std::vector<MeshHandle>& GetDrawList() const { return m_draw_list; }
+		MeshHandle GetQuadMesh() const { return m_quad_mesh; }
+
+		// Maps a KTX2 file, or finds it in the package, and uploads the mips up to TEXTURE_STREAMING_TAIL_SIZE, the rest is streamed in under the budget.
+		// Throws if the device can not sample the texture format
+		TextureHandle CreateTexture(const std::string& file_name_);
+		TextureHandle CreateTexture(memory::AssetFile file_, const std::string& name_); // name_ only names the texture in errors
+		// Returns the texture's mapped file, a caller may close it on another thread. The image is freed once no frame uses it
+		memory::AssetFile DestroyTexture(TextureHandle texture_);
+		const Texture* GetTexture(TextureHandle texture_) const { return m_textures.Get(texture_); }
+		// Marks the texture used this frame and streams towards mip_ (0 is full detail), lower mips are kept until evicted
+		void RequestTextureMip(TextureHandle texture_, uint32_t mip_);
+		void SetTextureBudget(const TextureStreamBudget& budget_) { m_texture_budget = budget_; }
+		const TextureStreamBudget& GetTextureBudget() const { return m_texture_budget; }
+		TextureStreamingStats TextureStats() const;
+		VkSampler GetSampler(const SamplerDesc& desc_); // Created on first use, shared by every texture
+		const Mesh* GetMesh(MeshHandle mesh_) const { return m_meshes.Get(mesh_); }
+
+		// Shader modules of the assets, file names are relative to the shader directory of the package or the loose files
+		ShaderHandle CreateShader(const std::string& file_name_, const memory::AssetFile& binary_);
+		void DestroyShader(ShaderHandle shader_);
+		VkShaderModule GetShaderModule(ShaderHandle shader_) const { return m_shader_manager->Module(shader_); }
+		std::string ShaderPath(const std::string& file_name_) const { return m_shader_manager->ShaderPath(file_name_); }
+		ShaderCacheStats ShaderStats() const { return m_shader_manager->Stats(); }
+		const VertexLayout& GetVertexLayout() const { return m_vertex_layout; }
+
+		// Pipelines of the basic shaders specialized by a permutation. The constants must be declared by a stage and
+		// 4 bytes wide, a permutation with others throws. Main thread unless noted
+		PipelineHandle GetPipeline(const ShaderPermutation& permutation_); // Compiled on this thread if it is not cached
+		bool HasPipeline(const ShaderPermutation& permutation_) const;
+		// Permutation the draws use, compiled now if needed. Command buffers are rerecorded at the next BeginFrame
+		void SetPipelinePermutation(const ShaderPermutation& permutation_);
+		const ShaderPermutation& GetPipelinePermutation() const { return m_permutation; }
+		// Thread safe. Compiles for the current swap chain without caching, AddPipeline hands the result over
+		CompiledPipeline CompilePipeline(const ShaderPermutation& permutation_) const;
+		// Takes ownership of pipeline_, it is destroyed if it is stale or the permutation is already cached
+		void AddPipeline(const ShaderPermutation& permutation_, const CompiledPipeline& pipeline_);
+		PipelineCacheStats PipelineStats() const;
 	};
 
 	static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
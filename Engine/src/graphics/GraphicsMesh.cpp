@@ -0,0 +1,177 @@
+#include "GraphicsMesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// The file is read in place, the structs must not change size between compilers
+static_assert(sizeof(graphics::MeshBounds) == 40, "MeshBounds is part of the mesh file format");
+static_assert(sizeof(graphics::MeshLod) == 16, "MeshLod is part of the mesh file format");
+static_assert(sizeof(graphics::MeshFileAttribute) == 16, "MeshFileAttribute is part of the mesh file format");
+static_assert(sizeof(graphics::MeshFileHeader) == 136, "MeshFileHeader is part of the mesh file format");
+
+namespace
+{
+	size_t AlignSection(size_t offset_)
+	{
+		return (offset_ + graphics::MESH_SECTION_ALIGNMENT - 1) / graphics::MESH_SECTION_ALIGNMENT * graphics::MESH_SECTION_ALIGNMENT;
+	}
+
+	bool InFile(uint64_t offset_, uint64_t bytes_, size_t size_)
+	{
+		return offset_ <= size_ && bytes_ <= size_ - offset_;
+	}
+
+	// Largest of count_ indices of index_size_ bytes, 0 when there are none
+	uint32_t MaxIndex(const uint8_t* data_, uint32_t count_, uint32_t index_size_)
+	{
+		uint32_t max_index = 0;
+		if (index_size_ == 2)
+		{
+			for (uint32_t i = 0; i < count_; i++)
+			{
+				uint16_t index;
+				std::memcpy(&index, data_ + i * 2, 2);
+				max_index = (std::max)(max_index, static_cast<uint32_t>(index));
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < count_; i++)
+			{
+				uint32_t index;
+				std::memcpy(&index, data_ + i * 4, 4);
+				max_index = (std::max)(max_index, index);
+			}
+		}
+		return max_index;
+	}
+}
+
+graphics::MeshView graphics::ReadMeshFile(const uint8_t* data_, size_t size_)
+{
+	if (data_ == nullptr || size_ < sizeof(MeshFileHeader))
+		throw std::runtime_error("Mesh file is too small");
+
+	MeshView view;
+	view.header = reinterpret_cast<const MeshFileHeader*>(data_);
+	const MeshFileHeader& header = *view.header;
+	if (header.magic != MESH_FILE_MAGIC)
+		throw std::runtime_error("Not a mesh file");
+	if (header.version != MESH_FILE_VERSION)
+		throw std::runtime_error("Unsupported mesh file version " + std::to_string(header.version));
+	if (header.index_size != 2 && header.index_size != 4)
+		throw std::runtime_error("Invalid mesh index size");
+	if (header.stream_count == 0 || header.stream_count > MAX_MESH_STREAMS || header.lod_count == 0 || header.lod_count > MAX_MESH_LODS)
+		throw std::runtime_error("Invalid mesh stream or lod count");
+
+	size_t tables_bytes = header.attribute_count * sizeof(MeshFileAttribute) + header.lod_count * sizeof(MeshLod);
+	if (header.attribute_count > SemanticCount || !InFile(sizeof(MeshFileHeader), tables_bytes, size_))
+		throw std::runtime_error("Invalid mesh attribute table");
+
+	const MeshFileAttribute* attributes = reinterpret_cast<const MeshFileAttribute*>(data_ + sizeof(MeshFileHeader));
+	for (uint32_t i = 0; i < header.attribute_count; i++)
+	{
+		if (attributes[i].semantic >= SemanticCount || attributes[i].format >= FormatCount || attributes[i].stream >= header.stream_count)
+			throw std::runtime_error("Invalid mesh attribute");
+		view.layout.Add(
+			static_cast<VertexSemantic>(attributes[i].semantic),
+			static_cast<VertexFormat>(attributes[i].format),
+			attributes[i].stream);
+	}
+	view.lods = reinterpret_cast<const MeshLod*>(attributes + header.attribute_count);
+
+	if (view.layout.StreamCount() != header.stream_count)
+		throw std::runtime_error("Mesh stream without attributes");
+	if (!InFile(header.vertex_offset, header.vertex_bytes, size_) || !InFile(header.index_offset, header.index_bytes, size_))
+		throw std::runtime_error("Mesh sections exceed the file");
+	if (header.index_bytes != static_cast<uint64_t>(header.index_count) * header.index_size)
+		throw std::runtime_error("Invalid mesh index section size");
+
+	for (uint32_t stream = 0; stream < header.stream_count; stream++)
+	{
+		uint64_t stream_bytes = static_cast<uint64_t>(view.layout.Stride(stream)) * header.vertex_count;
+		if (!InFile(header.stream_offsets[stream], stream_bytes, static_cast<size_t>(header.vertex_bytes)))
+			throw std::runtime_error("Mesh vertex stream exceeds the vertex section");
+		view.stream_offsets.push_back(header.stream_offsets[stream]);
+	}
+
+	for (uint32_t lod = 0; lod < header.lod_count; lod++)
+		if (!InFile(view.lods[lod].first_index, view.lods[lod].index_count, header.index_count))
+			throw std::runtime_error("Mesh lod exceeds the index section");
+
+	view.vertex_data = data_ + header.vertex_offset;
+	view.index_data = data_ + header.index_offset;
+
+	// The draws add the mesh's first vertex, a larger index would fetch another mesh's vertices or past the streams
+	if (header.index_count > 0 && MaxIndex(view.index_data, header.index_count, header.index_size) >= header.vertex_count)
+		throw std::runtime_error("Mesh index exceeds the vertex count");
+	return view;
+}
+
+std::vector<uint8_t> graphics::WriteMeshFile(
+	const VertexLayout& layout_,
+	const EncodedVertices& vertices_,
+	uint32_t vertex_count_,
+	const std::vector<uint32_t>& indices_,
+	const std::vector<MeshLod>& lods_,
+	const MeshBounds& bounds_,
+	uint32_t index_size_)
+{
+	if (index_size_ == 0)
+		index_size_ = vertex_count_ <= 0xFFFF ? 2 : 4;
+	if ((index_size_ != 2 && index_size_ != 4) || (index_size_ == 2 && vertex_count_ > 0xFFFF))
+		throw std::runtime_error("Index size " + std::to_string(index_size_) + " can not address " + std::to_string(vertex_count_) + " vertices");
+	if (layout_.StreamCount() == 0 || layout_.StreamCount() > MAX_MESH_STREAMS || lods_.empty() || lods_.size() > MAX_MESH_LODS)
+		throw std::runtime_error("Mesh does not fit the mesh file limits");
+	for (uint32_t index : indices_)
+		if (index >= vertex_count_)
+			throw std::runtime_error("Mesh index " + std::to_string(index) + " exceeds the vertex count");
+
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertex_count = vertex_count_;
+	header.index_count = static_cast<uint32_t>(indices_.size());
+	header.index_size = index_size_;
+	header.attribute_count = static_cast<uint32_t>(layout_.Attributes().size());
+	header.lod_count = static_cast<uint32_t>(lods_.size());
+	header.stream_count = layout_.StreamCount();
+	header.bounds = bounds_;
+	for (size_t stream = 0; stream < vertices_.stream_offsets.size(); stream++)
+		header.stream_offsets[stream] = vertices_.stream_offsets[stream];
+
+	size_t tables_end = sizeof(MeshFileHeader) + header.attribute_count * sizeof(MeshFileAttribute) + header.lod_count * sizeof(MeshLod);
+	header.vertex_offset = AlignSection(tables_end);
+	header.vertex_bytes = vertices_.data.size();
+	header.index_offset = AlignSection(static_cast<size_t>(header.vertex_offset + header.vertex_bytes));
+	header.index_bytes = static_cast<uint64_t>(header.index_count) * header.index_size;
+
+	std::vector<uint8_t> file(static_cast<size_t>(header.index_offset + header.index_bytes), 0);
+	std::memcpy(file.data(), &header, sizeof(header));
+
+	MeshFileAttribute* attributes = reinterpret_cast<MeshFileAttribute*>(file.data() + sizeof(MeshFileHeader));
+	for (size_t i = 0; i < layout_.Attributes().size(); i++)
+	{
+		const VertexAttribute& attribute = layout_.Attributes()[i];
+		attributes[i] = { static_cast<uint32_t>(attribute.semantic), static_cast<uint32_t>(attribute.format), attribute.stream, 0 };
+	}
+	std::memcpy(attributes + header.attribute_count, lods_.data(), lods_.size() * sizeof(MeshLod));
+
+	std::memcpy(file.data() + header.vertex_offset, vertices_.data.data(), vertices_.data.size());
+
+	uint8_t* index_data = file.data() + header.index_offset;
+	if (header.index_size == 2)
+	{
+		for (size_t i = 0; i < indices_.size(); i++)
+		{
+			uint16_t index = static_cast<uint16_t>(indices_[i]);
+			std::memcpy(index_data + i * 2, &index, 2);
+		}
+	}
+	else
+		std::memcpy(index_data, indices_.data(), indices_.size() * 4);
+
+	return file;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.hpp"
+
+#include "GraphicsVertex.h"
+
+namespace graphics
+{
+	constexpr uint32_t MESH_FILE_MAGIC = 0x48534D45; // "EMSH"
+	constexpr uint32_t MESH_FILE_VERSION = 1;
+	constexpr uint32_t MESH_SECTION_ALIGNMENT = 64; // Of the vertex and index sections inside the file
+	constexpr uint32_t MAX_MESH_STREAMS = 4;
+	constexpr uint32_t MAX_MESH_LODS = 8;
+
+	struct MeshBounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec4 sphere; // Center and radius
+	};
+
+	struct MeshLod
+	{
+		uint32_t first_index;
+		uint32_t index_count;
+		float error; // Object space distance the simplification moved the surface, 0 for the full detail lod
+		uint32_t padding;
+	};
+
+	struct MeshFileAttribute
+	{
+		uint32_t semantic; // VertexSemantic
+		uint32_t format; // VertexFormat
+		uint32_t stream;
+		uint32_t padding;
+	};
+
+	// File layout: header, attributes in location order, lods from the most to the least detailed,
+	// then the vertex section exactly as EncodeVertices lays it out and the indices of every lod.
+	// Everything is little endian and position independent, the file is used in place from a mapping
+	struct MeshFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertex_count;
+		uint32_t index_count; // Of all lods
+		uint32_t index_size; // 2 or 4 bytes
+		uint32_t attribute_count;
+		uint32_t lod_count;
+		uint32_t stream_count;
+		MeshBounds bounds;
+		uint64_t stream_offsets[MAX_MESH_STREAMS]; // Inside the vertex section
+		uint64_t vertex_offset;
+		uint64_t vertex_bytes;
+		uint64_t index_offset;
+		uint64_t index_bytes;
+	};
+
+	// Pointers into the file data, valid as long as the data is
+	struct MeshView
+	{
+		const MeshFileHeader* header = nullptr;
+		VertexLayout layout;
+		const MeshLod* lods = nullptr;
+		const uint8_t* vertex_data = nullptr;
+		const uint8_t* index_data = nullptr;
+		std::vector<VkDeviceSize> stream_offsets;
+	};
+
+	// Validates the header, the section bounds and that every index addresses one of the mesh's vertices, throws on malformed files
+	MeshView ReadMeshFile(const uint8_t* data_, size_t size_);
+
+	// indices_ holds every lod. index_size_ 2 or 4 forces the stored index size, 0 picks 16 bit when the vertex count allows it
+	std::vector<uint8_t> WriteMeshFile(
+		const VertexLayout& layout_,
+		const EncodedVertices& vertices_,
+		uint32_t vertex_count_,
+		const std::vector<uint32_t>& indices_,
+		const std::vector<MeshLod>& lods_,
+		const MeshBounds& bounds_,
+		uint32_t index_size_ = 0);
+}
\ No newline at end of file
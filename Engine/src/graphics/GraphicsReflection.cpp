@@ -0,0 +1,409 @@
+#include "GraphicsReflection.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+	constexpr size_t SPIRV_HEADER_WORDS = 5;
+	constexpr uint32_t NO_DECORATION = 0xFFFFFFFF;
+
+	enum SpirvOp : uint32_t
+	{
+		OpEntryPoint = 15,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstantTrue = 48,
+		OpSpecConstantFalse = 49,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72
+	};
+
+	enum SpirvDecoration : uint32_t
+	{
+		DecorationSpecId = 1,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35
+	};
+
+	enum SpirvStorageClass : uint32_t
+	{
+		StorageUniformConstant = 0,
+		StorageInput = 1,
+		StorageUniform = 2,
+		StoragePushConstant = 9,
+		StorageBuffer = 12
+	};
+
+	constexpr uint32_t IMAGE_DIM_BUFFER = 5;
+	constexpr uint32_t IMAGE_DIM_SUBPASS_DATA = 6;
+	constexpr uint32_t IMAGE_SAMPLED_STORAGE = 2; // Sampled operand of an image used without a sampler
+	constexpr uint32_t LOCATION_COMPONENTS = 4; // One vertex input location holds a vec4
+
+	struct SpirvMember
+	{
+		uint32_t offset = 0;
+		uint32_t matrix_stride = 0;
+	};
+
+	// Result of a type, constant or variable instruction with the decorations it got
+	struct SpirvId
+	{
+		const uint32_t* words = nullptr; // The instruction, words[0] holds the opcode
+		uint32_t word_count = 0;
+		uint32_t location = NO_DECORATION;
+		uint32_t binding = NO_DECORATION;
+		uint32_t set = NO_DECORATION;
+		uint32_t spec_id = NO_DECORATION;
+		uint32_t array_stride = 0;
+		bool built_in = false;
+		bool buffer_block = false;
+		std::vector<SpirvMember> members;
+
+		uint32_t Opcode() const { return words != nullptr ? words[0] & 0xFFFF : 0; }
+		uint32_t Operand(uint32_t index_) const
+		{
+			if (index_ >= word_count)
+				throw std::runtime_error("Truncated SPIR-V instruction");
+			return words[index_];
+		}
+	};
+
+	class SpirvModule
+	{
+		// VARIABLES
+	public:
+		std::unordered_map<uint32_t, SpirvId> ids;
+		std::vector<uint32_t> variables;
+		std::vector<uint32_t> spec_constants;
+		uint32_t execution_model = NO_DECORATION;
+
+		// METHODES
+	public:
+		const SpirvId& Id(uint32_t id_) const
+		{
+			auto it = ids.find(id_);
+			if (it == ids.end() || it->second.words == nullptr)
+				throw std::runtime_error("SPIR-V references an undefined id " + std::to_string(id_));
+			return it->second;
+		}
+
+		SpirvMember& Member(uint32_t struct_, uint32_t member_)
+		{
+			std::vector<SpirvMember>& members = ids[struct_].members;
+			if (members.size() <= member_)
+				members.resize(member_ + 1);
+			return members[member_];
+		}
+
+		uint32_t TypeSize(uint32_t type_, uint32_t matrix_stride_ = 0) const
+		{
+			const SpirvId& type = Id(type_);
+			switch (type.Opcode())
+			{
+			case OpTypeInt:
+			case OpTypeFloat:
+				return type.Operand(2) / 8;
+			case OpTypeVector:
+				return type.Operand(3) * TypeSize(type.Operand(2));
+			case OpTypeMatrix:
+				return type.Operand(3) * (matrix_stride_ != 0 ? matrix_stride_ : TypeSize(type.Operand(2)));
+			case OpTypeArray:
+			{
+				uint32_t length = Id(type.Operand(3)).Operand(3);
+				return length * (type.array_stride != 0 ? type.array_stride : TypeSize(type.Operand(2), matrix_stride_));
+			}
+			case OpTypeRuntimeArray:
+				return 0;
+			case OpTypeStruct:
+			{
+				uint32_t size = 0;
+				for (uint32_t member = 0; member + 2 < type.word_count; member++)
+				{
+					SpirvMember layout = member < type.members.size() ? type.members[member] : SpirvMember();
+					size = (std::max)(size, layout.offset + TypeSize(type.Operand(member + 2), layout.matrix_stride));
+				}
+				return size;
+			}
+			default:
+				throw std::runtime_error("SPIR-V type without a size in a buffer block");
+			}
+		}
+	};
+
+	SpirvModule ParseSpirv(const uint32_t* code_, size_t word_count_)
+	{
+		if (word_count_ < SPIRV_HEADER_WORDS || code_[0] != SPIRV_MAGIC)
+			throw std::runtime_error("Not a SPIR-V module");
+
+		SpirvModule module;
+		size_t position = SPIRV_HEADER_WORDS;
+		while (position < word_count_)
+		{
+			const uint32_t* words = code_ + position;
+			uint32_t word_count = words[0] >> 16;
+			uint32_t opcode = words[0] & 0xFFFF;
+			if (word_count == 0 || position + word_count > word_count_)
+				throw std::runtime_error("Malformed SPIR-V instruction");
+			position += word_count;
+
+			auto operand = [&](uint32_t index_)
+			{
+				if (index_ >= word_count)
+					throw std::runtime_error("Truncated SPIR-V instruction");
+				return words[index_];
+			};
+
+			switch (opcode)
+			{
+			case OpEntryPoint:
+				if (module.execution_model == NO_DECORATION)
+					module.execution_model = operand(1);
+				break;
+			case OpTypeBool:
+			case OpTypeInt:
+			case OpTypeFloat:
+			case OpTypeVector:
+			case OpTypeMatrix:
+			case OpTypeImage:
+			case OpTypeSampler:
+			case OpTypeSampledImage:
+			case OpTypeArray:
+			case OpTypeRuntimeArray:
+			case OpTypeStruct:
+			case OpTypePointer:
+			{
+				SpirvId& id = module.ids[operand(1)];
+				id.words = words;
+				id.word_count = word_count;
+				break;
+			}
+			case OpConstant:
+			case OpSpecConstantTrue:
+			case OpSpecConstantFalse:
+			case OpSpecConstant:
+			case OpVariable:
+			{
+				SpirvId& id = module.ids[operand(2)];
+				id.words = words;
+				id.word_count = word_count;
+				if (opcode == OpVariable)
+					module.variables.push_back(operand(2));
+				else if (opcode != OpConstant)
+					module.spec_constants.push_back(operand(2));
+				break;
+			}
+			case OpDecorate:
+			{
+				SpirvId& id = module.ids[operand(1)];
+				switch (operand(2))
+				{
+				case DecorationSpecId: id.spec_id = operand(3); break;
+				case DecorationBufferBlock: id.buffer_block = true; break;
+				case DecorationArrayStride: id.array_stride = operand(3); break;
+				case DecorationBuiltIn: id.built_in = true; break;
+				case DecorationLocation: id.location = operand(3); break;
+				case DecorationBinding: id.binding = operand(3); break;
+				case DecorationDescriptorSet: id.set = operand(3); break;
+				}
+				break;
+			}
+			case OpMemberDecorate:
+				if (operand(3) == DecorationOffset)
+					module.Member(operand(1), operand(2)).offset = operand(4);
+				else if (operand(3) == DecorationMatrixStride)
+					module.Member(operand(1), operand(2)).matrix_stride = operand(4);
+				else if (operand(3) == DecorationBuiltIn)
+					module.ids[operand(1)].built_in = true; // gl_PerVertex blocks
+				break;
+			}
+		}
+
+		if (module.execution_model == NO_DECORATION)
+			throw std::runtime_error("SPIR-V module has no entry point");
+		return module;
+	}
+
+	VkShaderStageFlagBits StageOf(uint32_t execution_model_)
+	{
+		switch (execution_model_)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default: throw std::runtime_error("Unsupported SPIR-V execution model " + std::to_string(execution_model_));
+		}
+	}
+
+	VkDescriptorType DescriptorTypeOf(const SpirvModule& module_, const SpirvId& type_, uint32_t storage_class_)
+	{
+		switch (type_.Opcode())
+		{
+		case OpTypeSampler:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+		case OpTypeSampledImage:
+			if (module_.Id(type_.Operand(2)).Operand(3) == IMAGE_DIM_BUFFER)
+				return VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		case OpTypeImage:
+			if (type_.Operand(3) == IMAGE_DIM_SUBPASS_DATA)
+				return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			if (type_.Operand(3) == IMAGE_DIM_BUFFER)
+				return type_.Operand(7) == IMAGE_SAMPLED_STORAGE ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			return type_.Operand(7) == IMAGE_SAMPLED_STORAGE ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		case OpTypeStruct:
+			if (storage_class_ == StorageBuffer || type_.buffer_block)
+				return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		default:
+			throw std::runtime_error("Unsupported SPIR-V descriptor type");
+		}
+	}
+
+	void ReflectInput(const SpirvModule& module_, const SpirvId& variable_, uint32_t type_, graphics::ShaderReflection& reflection_)
+	{
+		const SpirvId& type = module_.Id(type_);
+		uint32_t locations = 1;
+		uint32_t column = type_;
+		if (type.Opcode() == OpTypeMatrix)
+		{
+			// One location per column
+			locations = type.Operand(3);
+			column = type.Operand(2);
+		}
+
+		const SpirvId& column_type = module_.Id(column);
+		uint32_t components = 1;
+		const SpirvId* scalar = &column_type;
+		if (column_type.Opcode() == OpTypeVector)
+		{
+			components = column_type.Operand(3);
+			scalar = &module_.Id(column_type.Operand(2));
+		}
+
+		graphics::ShaderBaseType base_type = graphics::BaseFloat;
+		if (scalar->Opcode() == OpTypeInt)
+			base_type = scalar->Operand(3) != 0 ? graphics::BaseInt : graphics::BaseUint;
+		else if (scalar->Opcode() != OpTypeFloat)
+			throw std::runtime_error("Unsupported SPIR-V input type at location " + std::to_string(variable_.location));
+
+		for (uint32_t i = 0; i < locations; i++)
+			reflection_.inputs.push_back({ variable_.location + i, components, base_type });
+	}
+}
+
+graphics::ShaderReflection graphics::ReflectShader(const uint32_t* code_, size_t word_count_)
+{
+	SpirvModule module = ParseSpirv(code_, word_count_);
+
+	ShaderReflection reflection;
+	reflection.stage = StageOf(module.execution_model);
+	for (uint32_t variable_id : module.variables)
+	{
+		const SpirvId& variable = module.Id(variable_id);
+		uint32_t storage_class = variable.Operand(3);
+		const SpirvId& pointer = module.Id(variable.Operand(1));
+		uint32_t type_id = pointer.Operand(3);
+
+		if (storage_class == StorageInput)
+		{
+			if (variable.built_in || module.Id(type_id).built_in || variable.location == NO_DECORATION)
+				continue;
+			ReflectInput(module, variable, type_id, reflection);
+		}
+		else if (storage_class == StoragePushConstant)
+			reflection.push_constant_size = (std::max)(reflection.push_constant_size, module.TypeSize(type_id));
+		else if (storage_class == StorageUniformConstant || storage_class == StorageUniform || storage_class == StorageBuffer)
+		{
+			if (variable.binding == NO_DECORATION)
+				continue;
+
+			uint32_t count = 1;
+			const SpirvId* type = &module.Id(type_id);
+			if (type->Opcode() == OpTypeArray)
+			{
+				count = module.Id(type->Operand(3)).Operand(3);
+				type = &module.Id(type->Operand(2));
+			}
+			else if (type->Opcode() == OpTypeRuntimeArray)
+				throw std::runtime_error("Unbounded descriptor arrays are not supported, binding " + std::to_string(variable.binding));
+
+			uint32_t set = variable.set != NO_DECORATION ? variable.set : 0;
+			reflection.bindings.push_back({ set, variable.binding, DescriptorTypeOf(module, *type, storage_class), count });
+		}
+	}
+
+	// Constants without a SpecId are results of spec constant operations, not settable
+	for (uint32_t constant_id : module.spec_constants)
+	{
+		const SpirvId& constant = module.Id(constant_id);
+		if (constant.spec_id == NO_DECORATION)
+			continue;
+
+		const SpirvId& type = module.Id(constant.Operand(1));
+		ShaderBaseType base_type = BaseBool;
+		uint32_t size = sizeof(VkBool32);
+		if (type.Opcode() == OpTypeInt || type.Opcode() == OpTypeFloat)
+		{
+			size = type.Operand(2) / 8;
+			base_type = type.Opcode() == OpTypeFloat ? BaseFloat : (type.Operand(3) != 0 ? BaseInt : BaseUint);
+		}
+		reflection.spec_constants.push_back({ constant.spec_id, base_type, size });
+	}
+
+	std::sort(reflection.spec_constants.begin(), reflection.spec_constants.end(), [](const ShaderSpecConstant& a_, const ShaderSpecConstant& b_) { return a_.constant_id < b_.constant_id; });
+	std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const ShaderInput& a_, const ShaderInput& b_) { return a_.location < b_.location; });
+	std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ShaderBinding& a_, const ShaderBinding& b_)
+	{
+		return a_.set != b_.set ? a_.set < b_.set : a_.binding < b_.binding;
+	});
+	return reflection;
+}
+
+graphics::VertexInputDesc graphics::BuildVertexInput(const ShaderReflection& vertex_stage_, const VertexLayout& layout_)
+{
+	VertexInputDesc input;
+	input.bindings = layout_.BindingDescriptions();
+
+	for (const ShaderInput& shader_input : vertex_stage_.inputs)
+	{
+		const auto& attributes = layout_.Attributes();
+		auto attribute = std::find_if(attributes.begin(), attributes.end(), [&](const VertexAttribute& attribute_) { return attribute_.location == shader_input.location; });
+		if (attribute == attributes.end())
+			throw std::runtime_error("Vertex shader reads location " + std::to_string(shader_input.location) + " which the vertex layout does not have");
+
+		const VertexFormatInfo& format = FormatInfo(attribute->format);
+		// Vulkan drops the components the shader does not read and fills the missing ones with (0, 0, 1),
+		// so only the base type and the 4 components one location holds have to match
+		if (shader_input.base_type != BaseFloat || shader_input.components > LOCATION_COMPONENTS || format.components > LOCATION_COMPONENTS)
+			throw std::runtime_error("Vertex shader input at location " + std::to_string(shader_input.location) + " does not match the " + format.name + " attribute");
+
+		input.attributes.push_back({ shader_input.location, attribute->stream, format.vk_format, attribute->offset });
+	}
+	return input;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GraphicsVertex.h"
+#include "vulkan/vulkan.h"
+
+namespace graphics
+{
+	enum ShaderBaseType
+	{
+		BaseFloat,
+		BaseInt,
+		BaseUint,
+		BaseBool
+	};
+
+	struct ShaderInput
+	{
+		uint32_t location;
+		uint32_t components;
+		ShaderBaseType base_type;
+	};
+
+	struct ShaderBinding
+	{
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count; // Array length, 1 for a single descriptor
+	};
+
+	struct ShaderSpecConstant
+	{
+		uint32_t constant_id;
+		ShaderBaseType type;
+		uint32_t size; // Bytes a specialization map entry gives it, bools take a VkBool32
+	};
+
+	struct ShaderReflection
+	{
+		VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+		std::vector<ShaderInput> inputs; // By location, built-ins are left out
+		std::vector<ShaderBinding> bindings; // By set and binding
+		uint32_t push_constant_size = 0; // Bytes of the push constant block from offset 0, 0 without one
+		std::vector<ShaderSpecConstant> spec_constants; // By constant id
+	};
+
+	// Reads the stage, inputs, descriptors, push constants and specialization constants of the first entry point of a SPIR-V module.
+	// Throws on malformed code and on resources a descriptor set layout cannot describe
+	ShaderReflection ReflectShader(const uint32_t* code_, size_t word_count_);
+
+	struct VertexInputDesc
+	{
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+	};
+
+	// Attributes of layout_ at the locations the vertex stage reads. Every stream keeps its binding, so the draws bind the
+	// same buffers whatever the shader reads. The shader may read fewer or more components than the format has.
+	// Throws if layout_ lacks a location, the base types differ or either side needs more than one location
+	VertexInputDesc BuildVertexInput(const ShaderReflection& vertex_stage_, const VertexLayout& layout_);
+}
\ No newline at end of file
@@ -1,29 +1,108 @@
 #include "GraphicsShaders.h"
 
-void graphics::ShaderManager::Initialize()
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace
 {
+	template<typename T>
+	void AppendKey(std::string& key_, const T& value_)
+	{
+		key_.append(reinterpret_cast<const char*>(&value_), sizeof(T));
+	}
+}
 
+void graphics::ShaderManager::Initialize()
+{
+	auto& metrics = profiling::Metrics();
+	m_disk_reads_metric = &metrics.AddCounter("shader_disk_reads_total", "Shader files read, a cached binary is read again only when its file changed");
+	m_module_creations_metric = &metrics.AddCounter("shader_module_creations_total", "Shader modules created, requests served by the cache are not counted");
 }
 
 void graphics::ShaderManager::Shutdown()
 {
+	// Modules the caller never destroyed and the cached ones
+	for (const auto& shader : m_modules)
+		vkDestroyShaderModule(shader.device, shader.module, nullptr);
+	for (const auto& [key, layout] : m_pipeline_layouts)
+		vkDestroyPipelineLayout(layout.device, layout.pipeline_layout, nullptr);
+	for (const auto& [key, layout] : m_set_layouts)
+		vkDestroyDescriptorSetLayout(layout.first, layout.second, nullptr);
+}
+
+bool graphics::ShaderManager::IsStale(const std::string& path_, const ShaderBinary& binary_) const
+{
+	if (binary_.packed)
+		return false;
 
+	std::error_code error;
+	uintmax_t file_size = std::filesystem::file_size(path_, error);
+	if (error)
+		return true;
+	std::filesystem::file_time_type write_time = std::filesystem::last_write_time(path_, error);
+	return error || file_size != binary_.file_size || write_time != binary_.write_time;
 }
 
-std::vector<char> graphics::ShaderManager::LoadShaderBinary(const std::string& file_name_)
+const graphics::ShaderBinary& graphics::ShaderManager::CacheBinary(
+	const std::string& path_,
+	const memory::AssetFile& file_,
+	uintmax_t file_size_,
+	std::filesystem::file_time_type write_time_)
 {
-	std::fstream input_file(m_base_dir + file_name_, std::ios::binary | std::ios::ate | std::ios::in);
-	if (!input_file.is_open())
-		throw std::runtime_error("Unable to open shader binary file");
+	if (file_.Size() == 0 || file_.Size() % sizeof(uint32_t) != 0)
+		throw std::runtime_error("Shader binary is not a sequence of SPIR-V words: " + path_);
 
-	size_t file_size = static_cast<size_t>(input_file.tellg());
-	std::vector<char> bytecode(file_size);
-	
-	input_file.seekg(0);
-	input_file.read(bytecode.data(), file_size);
-	input_file.close();
+	uint64_t content_hash = memory::HashContent(file_.Data(), file_.Size());
+	ShaderBinary& binary = m_binaries[path_];
+	if (!binary.code.empty() && binary.content_hash == content_hash)
+	{
+		// Same words, e.g. a file touched without changes or read again by a loader
+		binary.packed = file_.IsPacked();
+		binary.file_size = file_size_;
+		binary.write_time = write_time_;
+		return binary;
+	}
+	if (!binary.code.empty())
+	{
+		// Modules of the old content in use are destroyed when they are released
+		m_stats.invalidations++;
+		std::vector<ShaderHandle> unused;
+		for (size_t i = 0; i < m_modules.Size(); i++)
+		{
+			const ShaderModule& shader = *(m_modules.begin() + i);
+			if (shader.references == 0 && m_base_dir + shader.file_name == path_)
+				unused.push_back(m_modules.HandleAt(i));
+		}
+		for (ShaderHandle shader : unused)
+			DestroyModule(shader);
+	}
 
-	return bytecode;
+	// Copied out of the mapping, which is closed when the caller is done with the file
+	binary.code.resize(file_.Size() / sizeof(uint32_t));
+	std::memcpy(binary.code.data(), file_.Data(), file_.Size());
+	binary.content_hash = content_hash;
+	binary.packed = file_.IsPacked();
+	binary.file_size = file_size_;
+	binary.write_time = write_time_;
+	return binary;
+}
+
+const graphics::ShaderBinary& graphics::ShaderManager::LoadShaderBinary(const std::string& file_name_)
+{
+	PROFILE_FUNCTION();
+	std::string path = m_base_dir + file_name_;
+	auto it = m_binaries.find(path);
+	if (it != m_binaries.end() && !IsStale(path, it->second))
+		return it->second;
+
+	// Taken before the read, a change during the read is seen by the next load. Package entries have no loose file
+	std::error_code error;
+	uintmax_t file_size = std::filesystem::file_size(path, error);
+	std::filesystem::file_time_type write_time = std::filesystem::last_write_time(path, error);
+	m_stats.disk_reads++;
+	m_disk_reads_metric->Add(1);
+	return CacheBinary(path, memory::AssetFile(m_package, path), file_size, write_time);
 }
 
 std::string graphics::ShaderManager::LoadShaderCode(const std::string& file_name_)
@@ -38,55 +117,245 @@ std::string graphics::ShaderManager::LoadShaderCode(const std::string& file_name
 	return code;
 }
 
-VkShaderModule graphics::ShaderManager::CreateShaderModule(const std::vector<char>& binary_, VkDevice device_)
+graphics::ShaderHandle graphics::ShaderManager::AcquireModule(const std::string& file_name_, const uint32_t* code_, size_t size_, uint64_t content_hash_, VkDevice device_)
 {
+	std::string key = m_base_dir + file_name_ + "#" + std::to_string(content_hash_) + "#" + std::to_string(reinterpret_cast<uintptr_t>(device_));
+	auto it = m_module_keys.find(key);
+	if (it != m_module_keys.end())
+	{
+		m_modules.At(it->second).references++;
+		m_stats.module_hits++;
+		return it->second;
+	}
+
+	PROFILE_FUNCTION();
+	// Reflected before the module exists, a binary the layouts cannot describe creates nothing
+	ShaderReflection reflection = ReflectShader(code_, size_ / sizeof(uint32_t));
+
 	VkShaderModuleCreateInfo create_info = {};
 	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	create_info.codeSize = binary_.size();
-	create_info.pCode = reinterpret_cast<const uint32_t*>(binary_.data());
+	create_info.codeSize = size_;
+	create_info.pCode = code_;
 
 	VkShaderModule shader_module;
 	auto result = vkCreateShaderModule(device_, &create_info, nullptr, &shader_module);
 	if (result != VK_SUCCESS)
 		throw std::runtime_error(FormatVkResult(result));
 
-	return shader_module;
+	m_stats.module_creations++;
+	m_module_creations_metric->Add(1);
+	ShaderHandle shader = m_modules.Create(shader_module, device_, file_name_, key, content_hash_, 1u, std::move(reflection));
+	m_module_keys.emplace(std::move(key), shader);
+	return shader;
 }
 
-VkShaderModule graphics::ShaderManager::CreateShaderModule(const std::string& file_name_, ShaderInputType input_type_, VkDevice device_)
+void graphics::ShaderManager::DestroyModule(ShaderHandle shader_)
 {
-	VkShaderModule shader_module;
-	if (input_type_ == BinaryInput)
-		shader_module = CreateShaderModule(LoadShaderBinary(file_name_), device_);
-	else
+	const ShaderModule& shader = m_modules.At(shader_);
+	vkDestroyShaderModule(shader.device, shader.module, nullptr);
+	m_module_keys.erase(shader.key);
+	m_modules.Destroy(shader_);
+}
+
+graphics::ShaderHandle graphics::ShaderManager::CreateShaderModule(const std::string& file_name_, ShaderInputType input_type_, VkDevice device_)
+{
+	if (input_type_ != BinaryInput)
 		throw std::runtime_error("Shader code input is not yet supported");
 
-	return shader_module;
+	const ShaderBinary& binary = LoadShaderBinary(file_name_);
+	return AcquireModule(file_name_, binary.code.data(), binary.code.size() * sizeof(uint32_t), binary.content_hash, device_);
+}
+
+graphics::ShaderHandle graphics::ShaderManager::CreateShaderModule(const std::string& file_name_, const memory::AssetFile& binary_, VkDevice device_)
+{
+	std::string path = m_base_dir + file_name_;
+	std::error_code error;
+	uintmax_t file_size = std::filesystem::file_size(path, error);
+	std::filesystem::file_time_type write_time = std::filesystem::last_write_time(path, error);
+
+	const ShaderBinary& binary = CacheBinary(path, binary_, file_size, write_time);
+	return AcquireModule(file_name_, binary.code.data(), binary.code.size() * sizeof(uint32_t), binary.content_hash, device_);
+}
+
+void graphics::ShaderManager::DestroyShaderModule(ShaderHandle shader_)
+{
+	ShaderModule* shader = m_modules.Get(shader_);
+	if (shader == nullptr || shader->references == 0 || --shader->references > 0)
+		return;
+
+	// Kept for the next create unless the file changed since
+	auto binary = m_binaries.find(m_base_dir + shader->file_name);
+	if (binary == m_binaries.end() || binary->second.content_hash != shader->content_hash)
+		DestroyModule(shader_);
+}
+
+VkShaderModule graphics::ShaderManager::Module(ShaderHandle shader_) const
+{
+	const ShaderModule* shader = m_modules.Get(shader_);
+	return shader != nullptr ? shader->module : VK_NULL_HANDLE;
+}
+
+const graphics::ShaderReflection& graphics::ShaderManager::Reflection(ShaderHandle shader_) const
+{
+	const ShaderModule* shader = m_modules.Get(shader_);
+	if (shader == nullptr)
+		throw std::out_of_range("Stale or invalid shader handle");
+	return shader->reflection;
 }
 
-VkVertexInputBindingDescription graphics::Vertex::GetBindingDescription()
+VkDescriptorSetLayout graphics::ShaderManager::AcquireSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings_, VkDevice device_)
 {
-	VkVertexInputBindingDescription binding_discription = {};
+	std::string key;
+	AppendKey(key, device_);
+	for (const VkDescriptorSetLayoutBinding& binding : bindings_)
+	{
+		AppendKey(key, binding.binding);
+		AppendKey(key, binding.descriptorType);
+		AppendKey(key, binding.descriptorCount);
+		AppendKey(key, binding.stageFlags);
+	}
+
+	auto it = m_set_layouts.find(key);
+	if (it != m_set_layouts.end())
+		return it->second.second;
+
+	VkDescriptorSetLayoutCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	create_info.bindingCount = static_cast<uint32_t>(bindings_.size());
+	create_info.pBindings = bindings_.data();
 
-	binding_discription.binding = 0;
-	binding_discription.stride = sizeof(Vertex);
-	binding_discription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	VkDescriptorSetLayout set_layout;
+	auto result = vkCreateDescriptorSetLayout(device_, &create_info, nullptr, &set_layout);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create VkDescriptorSetLayout, error: " + FormatVkResult(result));
 
-	return binding_discription;
+	m_set_layouts.emplace(std::move(key), std::make_pair(device_, set_layout));
+	return set_layout;
 }
 
-std::array<VkVertexInputAttributeDescription, 2> graphics::Vertex::GetAttributeDescriptions()
+const graphics::ShaderLayout& graphics::ShaderManager::PipelineLayout(const std::vector<ShaderHandle>& stages_, VkDevice device_)
 {
-	std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions = {};
+	PROFILE_FUNCTION();
+	ShaderLayout layout;
+	layout.device = device_;
+
+	// Ordered by set and binding
+	std::map<std::pair<uint32_t, uint32_t>, VkDescriptorSetLayoutBinding> bindings;
+	for (ShaderHandle stage : stages_)
+	{
+		const ShaderReflection& reflection = Reflection(stage);
+		for (const ShaderBinding& binding : reflection.bindings)
+		{
+			auto [it, inserted] = bindings.try_emplace({ binding.set, binding.binding }, VkDescriptorSetLayoutBinding{ binding.binding, binding.type, binding.count, 0, nullptr });
+			if (!inserted && (it->second.descriptorType != binding.type || it->second.descriptorCount != binding.count))
+				throw std::runtime_error("Shader stages disagree on set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding));
+			it->second.stageFlags |= reflection.stage;
+		}
+
+		if (reflection.push_constant_size > 0)
+		{
+			layout.push_constant_size = (std::max)(layout.push_constant_size, reflection.push_constant_size);
+			layout.push_constant_stages |= reflection.stage;
+		}
+	}
+
+	// Sets in between the used ones get an empty layout
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets(bindings.empty() ? 0 : bindings.rbegin()->first.first + 1);
+	for (const auto& [slot, binding] : bindings)
+		sets[slot.first].push_back(binding);
 
-	attribute_descriptions[0].binding = 0;
-	attribute_descriptions[0].location = 0;
-	attribute_descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-	attribute_descriptions[0].offset = offsetof(Vertex, pos);
-	attribute_descriptions[1].binding = 0;
-	attribute_descriptions[1].location = 1;
-	attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribute_descriptions[1].offset = offsetof(Vertex, color);
+	std::string key;
+	AppendKey(key, device_);
+	for (const auto& set : sets)
+	{
+		layout.set_layouts.push_back(AcquireSetLayout(set, device_));
+		AppendKey(key, layout.set_layouts.back());
+	}
+	AppendKey(key, layout.push_constant_size);
+	AppendKey(key, layout.push_constant_stages);
 
-	return attribute_descriptions;
+	auto it = m_pipeline_layouts.find(key);
+	if (it != m_pipeline_layouts.end())
+	{
+		m_stats.layout_hits++;
+		return it->second;
+	}
+
+	VkPushConstantRange push_constant_range = { layout.push_constant_stages, 0, layout.push_constant_size };
+	VkPipelineLayoutCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	create_info.setLayoutCount = static_cast<uint32_t>(layout.set_layouts.size());
+	create_info.pSetLayouts = layout.set_layouts.data();
+	create_info.pushConstantRangeCount = layout.push_constant_size > 0 ? 1 : 0;
+	create_info.pPushConstantRanges = &push_constant_range;
+
+	auto result = vkCreatePipelineLayout(device_, &create_info, nullptr, &layout.pipeline_layout);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create VkPipelineLayout, error: " + FormatVkResult(result));
+
+	return m_pipeline_layouts.emplace(std::move(key), std::move(layout)).first->second;
 }
+
+graphics::ShaderCacheStats graphics::ShaderManager::Stats() const
+{
+	ShaderCacheStats stats = m_stats;
+	stats.binaries = m_binaries.size();
+	stats.modules = m_modules.Size();
+	stats.set_layouts = m_set_layouts.size();
+	stats.pipeline_layouts = m_pipeline_layouts.size();
+	return stats;
+}
+
+graphics::ShaderPermutation& graphics::ShaderPermutation::Set(uint32_t constant_id_, uint32_t value_)
+{
+	auto it = std::lower_bound(m_constant_ids.begin(), m_constant_ids.end(), constant_id_);
+	size_t index = it - m_constant_ids.begin();
+	if (it != m_constant_ids.end() && *it == constant_id_)
+		m_values[index] = value_;
+	else
+	{
+		m_constant_ids.insert(it, constant_id_);
+		m_values.insert(m_values.begin() + index, value_);
+	}
+	return *this;
+}
+
+graphics::ShaderPermutation& graphics::ShaderPermutation::Set(uint32_t constant_id_, float value_)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value_, sizeof(bits));
+	return Set(constant_id_, bits);
+}
+
+uint64_t graphics::ShaderPermutation::Hash() const
+{
+	// FNV-1a over the id and value pairs
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < m_constant_ids.size(); i++)
+		for (uint32_t word : { m_constant_ids[i], m_values[i] })
+			for (int byte = 0; byte < 4; byte++)
+				hash = (hash ^ ((word >> (byte * 8)) & 0xFF)) * 0x100000001B3ull;
+	return hash;
+}
+
+VkSpecializationInfo graphics::ShaderPermutation::SpecializationInfo(std::vector<VkSpecializationMapEntry>& entries_) const
+{
+	entries_.resize(m_constant_ids.size());
+	for (size_t i = 0; i < m_constant_ids.size(); i++)
+		entries_[i] = { m_constant_ids[i], static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t) };
+
+	VkSpecializationInfo info = {};
+	info.mapEntryCount = static_cast<uint32_t>(entries_.size());
+	info.pMapEntries = entries_.data();
+	info.dataSize = m_values.size() * sizeof(uint32_t);
+	info.pData = m_values.data();
+	return info;
+}
+
+std::string graphics::ShaderPermutation::ToString() const
+{
+	std::string text;
+	for (size_t i = 0; i < m_constant_ids.size(); i++)
+		text += (i > 0 ? " " : "") + std::to_string(m_constant_ids[i]) + "=" + std::to_string(m_values[i]);
+	return text.empty() ? "default" : text;
+}
\ No newline at end of file
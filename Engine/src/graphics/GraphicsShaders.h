@@ -1,22 +1,27 @@
 #pragma once
 
 #include "GraphicsUtils.h"
+#include "GraphicsReflection.h"
+#include "../profiling/ProfilingZones.h"
+#include "../memory/MemoryPool.h"
+#include "../memory/MemoryPackage.h"
+#include "../profiling/ProfilingMetrics.h"
 #include "vulkan/vulkan.h"
 #include "glm.hpp"
 #include <string>
 #include <vector>
 #include <array>
 #include <fstream>
+#include <filesystem>
+#include <unordered_map>
 
 namespace graphics 
 {
+	// Authoring format of the test quad, encoded with the renderer's VertexLayout before the upload
 	struct Vertex
 	{
 		glm::vec2 pos;
 		glm::vec3 color;
-
-		static VkVertexInputBindingDescription GetBindingDescription();
-		static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions();
 	};
 
 	const std::vector<Vertex> vertices =
@@ -38,6 +43,86 @@ namespace graphics
 		CodeInput
 	};
 
+	// Shared by everyone creating it from the same binary, it stays cached without references until its file changes
+	struct ShaderModule
+	{
+		VkShaderModule module = VK_NULL_HANDLE;
+		VkDevice device = VK_NULL_HANDLE;
+		std::string file_name;
+		std::string key; // Path, content hash and device
+		uint64_t content_hash = 0;
+		uint32_t references = 0;
+		ShaderReflection reflection;
+	};
+
+	using ShaderHandle = memory::Handle<ShaderModule>;
+
+	// SPIR-V of a shader file. Loose files are read again when their size or write time changes, package entries never change
+	struct ShaderBinary
+	{
+		std::vector<uint32_t> code;
+		uint64_t content_hash = 0;
+		bool packed = false;
+		uintmax_t file_size = 0;
+		std::filesystem::file_time_type write_time;
+	};
+
+	struct ShaderCacheStats
+	{
+		uint64_t disk_reads = 0; // Shader files the manager read, from the package or loose
+		uint64_t module_creations = 0;
+		uint64_t module_hits = 0; // Requests served by a cached module
+		uint64_t invalidations = 0; // Cached binaries whose file changed
+		size_t binaries = 0;
+		size_t modules = 0;
+		size_t set_layouts = 0;
+		size_t pipeline_layouts = 0;
+		uint64_t layout_hits = 0; // Pipeline layout requests served by the cache
+	};
+
+	// Values of specialization constants by constant id, the key of a pipeline permutation. Constants it leaves out keep
+	// the default the shader declares. Every value takes 4 bytes, bools are a VkBool32
+	class ShaderPermutation
+	{
+		// VARIABLES
+	private:
+		std::vector<uint32_t> m_constant_ids; // Ascending
+		std::vector<uint32_t> m_values; // Bits of the value of the constant at the same index
+
+		// METHODES
+	public:
+		ShaderPermutation& Set(uint32_t constant_id_, uint32_t value_);
+		ShaderPermutation& Set(uint32_t constant_id_, int32_t value_) { return Set(constant_id_, static_cast<uint32_t>(value_)); }
+		ShaderPermutation& Set(uint32_t constant_id_, float value_);
+		ShaderPermutation& Set(uint32_t constant_id_, bool value_) { return Set(constant_id_, static_cast<uint32_t>(value_ ? VK_TRUE : VK_FALSE)); }
+
+		const std::vector<uint32_t>& ConstantIds() const { return m_constant_ids; }
+		bool Empty() const { return m_constant_ids.empty(); }
+		uint64_t Hash() const;
+		// The info points into entries_ and the permutation, both must outlive its use
+		VkSpecializationInfo SpecializationInfo(std::vector<VkSpecializationMapEntry>& entries_) const;
+		std::string ToString() const; // "id=value ..." for errors and logs
+
+		bool operator==(const ShaderPermutation& other_) const { return m_constant_ids == other_.m_constant_ids && m_values == other_.m_values; }
+		bool operator!=(const ShaderPermutation& other_) const { return !(*this == other_); }
+	};
+
+	struct ShaderPermutationHash
+	{
+		size_t operator()(const ShaderPermutation& permutation_) const { return static_cast<size_t>(permutation_.Hash()); }
+	};
+
+	// Pipeline layout of a set of stages, with a set layout for every set index up to the highest one used.
+	// Push constants are one range from offset 0 visible to push_constant_stages
+	struct ShaderLayout
+	{
+		VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSetLayout> set_layouts;
+		uint32_t push_constant_size = 0;
+		VkShaderStageFlags push_constant_stages = 0;
+	};
+
 	class ShaderManager
 	{
 		// VARIABLES
@@ -45,10 +130,21 @@ namespace graphics
 		bool m_initialized = false;
 
 		std::string m_base_dir;
+		const memory::Package* m_package = nullptr; // Searched before the loose files under m_base_dir
+		memory::Pool<ShaderModule> m_modules;
+		std::unordered_map<std::string, ShaderHandle> m_module_keys;
+		std::unordered_map<std::string, ShaderBinary> m_binaries; // By path
+		// Keyed by their contents, equal layouts of different shaders are one object
+		std::unordered_map<std::string, std::pair<VkDevice, VkDescriptorSetLayout>> m_set_layouts;
+		std::unordered_map<std::string, ShaderLayout> m_pipeline_layouts;
+		ShaderCacheStats m_stats;
+
+		profiling::Counter* m_disk_reads_metric = nullptr;
+		profiling::Counter* m_module_creations_metric = nullptr;
 
 		// CONSTRUCTORS/DESTRUCTORS
 	public:
-		ShaderManager(const std::string& base_dir_ = "") : m_base_dir(base_dir_) { Initialize(); }
+		ShaderManager(const std::string& base_dir_ = "", const memory::Package* package_ = nullptr) : m_base_dir(base_dir_), m_package(package_) { Initialize(); }
 		~ShaderManager() { Shutdown(); }
 
 		// METHODES
@@ -56,12 +152,29 @@ namespace graphics
 		void Initialize();
 		void Shutdown();
 
-		std::vector<char> LoadShaderBinary(const std::string& file_name_);
+		bool IsStale(const std::string& path_, const ShaderBinary& binary_) const;
+		// Keeps a copy of the words unless the cached ones have the same content hash,
+		// file_ was opened after the stat in file_size_ and write_time_
+		const ShaderBinary& CacheBinary(const std::string& path_, const memory::AssetFile& file_, uintmax_t file_size_, std::filesystem::file_time_type write_time_);
 		std::string LoadShaderCode(const std::string& file_name_);
-		VkShaderModule CreateShaderModule(const std::vector<char>& binary_, VkDevice device_);
+		ShaderHandle AcquireModule(const std::string& file_name_, const uint32_t* code_, size_t size_, uint64_t content_hash_, VkDevice device_);
+		void DestroyModule(ShaderHandle shader_);
+		VkDescriptorSetLayout AcquireSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings_, VkDevice device_);
 
 	public:
-		VkShaderModule CreateShaderModule(const std::string& file_name_, ShaderInputType input_type_, VkDevice device_);
+		// Reads the file only if it is not cached or changed on disk since
+		const ShaderBinary& LoadShaderBinary(const std::string& file_name_);
+		// Every create returns a reference on the module cached for the file's content, destroy releases it
+		ShaderHandle CreateShaderModule(const std::string& file_name_, ShaderInputType input_type_, VkDevice device_);
+		ShaderHandle CreateShaderModule(const std::string& file_name_, const memory::AssetFile& binary_, VkDevice device_); // binary_ read by the caller
+		void DestroyShaderModule(ShaderHandle shader_);
 
+		VkShaderModule Module(ShaderHandle shader_) const;
+		const ShaderReflection& Reflection(ShaderHandle shader_) const; // Throws for a destroyed module
+		// Built from the stages' reflection, stages sharing a binding must agree on its type and count. Owned by the manager
+		const ShaderLayout& PipelineLayout(const std::vector<ShaderHandle>& stages_, VkDevice device_);
+		size_t ModuleCount() const { return m_modules.Size(); }
+		ShaderCacheStats Stats() const;
+		std::string ShaderPath(const std::string& file_name_) const { return m_base_dir + file_name_; } // Package or loose file path
 	};
 }
\ No newline at end of file
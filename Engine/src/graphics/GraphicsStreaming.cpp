@@ -0,0 +1,120 @@
+#include "GraphicsStreaming.h"
+
+#include <algorithm>
+
+uint64_t graphics::ResidentBytes(const TextureStreamState& state_, uint32_t first_mip_)
+{
+	uint64_t bytes = 0;
+	for (uint32_t mip = first_mip_; mip < state_.mip_count; mip++)
+		bytes += state_.mip_bytes[mip];
+	return bytes;
+}
+
+graphics::TextureStreamState* graphics::TextureStreamPlanner::FindVictim(const std::vector<TextureStreamState*>& textures_, const TextureStreamState* requester_, bool recent_) const
+{
+	TextureStreamState* victim = nullptr;
+	bool victim_excess = false;
+	for (TextureStreamState* texture : textures_)
+	{
+		// Mips streamed in by this plan stay, the tail is never evicted
+		if (texture == requester_ || texture->target_mip >= texture->tail_mip || texture->target_mip < texture->resident_mip)
+			continue;
+
+		bool excess = texture->target_mip < texture->wanted_mip;
+		if (!excess && requester_ != nullptr && (!recent_ || texture->last_used_frame >= requester_->last_used_frame))
+			continue;
+
+		bool better = victim == nullptr ||
+			(excess != victim_excess ? excess :
+			texture->last_used_frame != victim->last_used_frame ? texture->last_used_frame < victim->last_used_frame :
+			texture->target_mip < victim->target_mip);
+		if (better)
+		{
+			victim = texture;
+			victim_excess = excess;
+		}
+	}
+	return victim;
+}
+
+graphics::TextureStreamPlan graphics::TextureStreamPlanner::Plan(const std::vector<TextureStreamState*>& textures_, const TextureStreamBudget& budget_, uint64_t frame_)
+{
+	TextureStreamPlan plan;
+	m_candidates.clear();
+	for (TextureStreamState* texture : textures_)
+	{
+		texture->target_mip = texture->resident_mip;
+		plan.resident_bytes += ResidentBytes(*texture, texture->resident_mip);
+		if (texture->resident_mip > texture->wanted_mip)
+			m_candidates.push_back(texture);
+	}
+
+	auto evict = [&](TextureStreamState* texture_)
+	{
+		uint64_t bytes = texture_->mip_bytes[texture_->target_mip++];
+		plan.resident_bytes -= bytes;
+		plan.evicted_bytes += bytes;
+		plan.evicted_mips++;
+	};
+
+	// A lowered budget is met before anything is streamed
+	while (plan.resident_bytes > budget_.memory_bytes)
+	{
+		TextureStreamState* victim = FindVictim(textures_, nullptr, false);
+		if (victim == nullptr)
+			break;
+		evict(victim);
+	}
+
+	std::sort(m_candidates.begin(), m_candidates.end(), [](const TextureStreamState* a_, const TextureStreamState* b_)
+	{
+		if (a_->last_used_frame != b_->last_used_frame)
+			return a_->last_used_frame > b_->last_used_frame;
+		return a_->resident_mip - a_->wanted_mip > b_->resident_mip - b_->wanted_mip;
+	});
+
+	for (TextureStreamState* texture : m_candidates)
+	{
+		// Lost mips to a more recently used texture, streaming them back would only undo that
+		if (texture->target_mip > texture->resident_mip)
+			continue;
+
+		while (texture->target_mip > texture->wanted_mip)
+		{
+			uint64_t bytes = texture->mip_bytes[texture->target_mip - 1];
+			if (plan.upload_bytes > 0 && plan.upload_bytes + bytes > budget_.upload_bytes_per_frame)
+				break;
+
+			// Evictions are undone if they can not make enough room
+			bool recent = texture->last_used_frame + 1 >= frame_;
+			m_evicted.clear();
+			while (plan.resident_bytes + bytes > budget_.memory_bytes)
+			{
+				TextureStreamState* victim = FindVictim(textures_, texture, recent);
+				if (victim == nullptr)
+					break;
+				evict(victim);
+				m_evicted.push_back(victim);
+			}
+
+			if (plan.resident_bytes + bytes > budget_.memory_bytes)
+			{
+				for (auto it = m_evicted.rbegin(); it != m_evicted.rend(); ++it)
+				{
+					uint64_t evicted = (*it)->mip_bytes[--(*it)->target_mip];
+					plan.resident_bytes += evicted;
+					plan.evicted_bytes -= evicted;
+					plan.evicted_mips--;
+				}
+				break;
+			}
+
+			texture->target_mip--;
+			plan.resident_bytes += bytes;
+			plan.upload_bytes += bytes;
+			plan.streamed_mips++;
+		}
+	}
+
+	return plan;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "GraphicsTexture.h"
+
+namespace graphics
+{
+	constexpr uint32_t TEXTURE_STREAMING_TAIL_SIZE = 128; // Mips up to this size stay resident and are loaded with the texture
+
+	struct TextureStreamBudget
+	{
+		uint64_t memory_bytes = 256ull << 20; // Mip data all textures may keep resident together
+		uint64_t upload_bytes_per_frame = 8 << 20; // Staged each frame, a single larger mip is uploaded alone
+	};
+
+	// Mips [resident_mip, mip_count) of a texture are on the GPU
+	struct TextureStreamState
+	{
+		std::array<uint64_t, MAX_TEXTURE_MIPS> mip_bytes = {};
+		uint32_t mip_count = 0;
+		uint32_t tail_mip = 0; // Mips from here on are never evicted
+		uint32_t resident_mip = 0;
+		uint32_t wanted_mip = 0; // Most detailed mip the renderer asked for
+		uint64_t last_used_frame = 0;
+		uint32_t target_mip = 0; // Set by the planner, the texture is changed to hold mips [target_mip, mip_count)
+	};
+
+	struct TextureStreamPlan
+	{
+		uint64_t upload_bytes = 0;
+		uint64_t evicted_bytes = 0;
+		uint32_t streamed_mips = 0;
+		uint32_t evicted_mips = 0;
+		uint64_t resident_bytes = 0; // Of all textures once the plan is applied
+	};
+
+	struct TextureStreamingStats
+	{
+		uint32_t textures = 0;
+		uint32_t streaming_textures = 0; // Still below their wanted mip
+		uint64_t resident_bytes = 0; // Mip data on the GPU
+		uint64_t wanted_bytes = 0; // Mip data of every wanted mip
+		uint64_t device_bytes = 0; // Image memory, includes the alignment of the driver
+		uint64_t budget_bytes = 0;
+		uint64_t streamed_bytes = 0; // Since startup
+		uint64_t evicted_bytes = 0;
+		uint64_t streamed_mips = 0;
+		uint64_t evicted_mips = 0;
+		uint64_t last_frame_upload_bytes = 0;
+	};
+
+	uint64_t ResidentBytes(const TextureStreamState& state_, uint32_t first_mip_);
+
+	// Decides every frame which mips move in or out, the scratch vectors keep planning free of allocations
+	class TextureStreamPlanner
+	{
+		// VARIABLES
+	private:
+		std::vector<TextureStreamState*> m_candidates;
+		std::vector<TextureStreamState*> m_evicted;
+
+		// METHODES
+	private:
+		TextureStreamState* FindVictim(const std::vector<TextureStreamState*>& textures_, const TextureStreamState* requester_, bool recent_) const;
+
+	public:
+		// Streams the next more detailed mip of the most recently used textures first. A full budget evicts the most
+		// detailed mips of textures holding more than they want, then, for textures used in the last frame, of textures
+		// used less recently. Older requests only fill free memory so they do not shuffle mips between unused textures
+		TextureStreamPlan Plan(const std::vector<TextureStreamState*>& textures_, const TextureStreamBudget& budget_, uint64_t frame_);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "GraphicsTexture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+static_assert(sizeof(graphics::Ktx2Header) == 80, "Ktx2Header is part of the KTX2 format");
+static_assert(sizeof(graphics::Ktx2Level) == 24, "Ktx2Level is part of the KTX2 format");
+
+namespace
+{
+	// Khronos data format color models
+	constexpr uint32_t KHR_DF_MODEL_RGBSDA = 1;
+	constexpr uint32_t KHR_DF_MODEL_BC1A = 128;
+	constexpr uint32_t KHR_DF_MODEL_BC2 = 129;
+	constexpr uint32_t KHR_DF_MODEL_BC3 = 130;
+	constexpr uint32_t KHR_DF_MODEL_BC4 = 131;
+	constexpr uint32_t KHR_DF_MODEL_BC5 = 132;
+	constexpr uint32_t KHR_DF_MODEL_BC6H = 133;
+	constexpr uint32_t KHR_DF_MODEL_BC7 = 134;
+	constexpr uint32_t KHR_DF_MODEL_ASTC = 162;
+
+	bool InFile(uint64_t offset_, uint64_t bytes_, size_t size_)
+	{
+		return offset_ <= size_ && bytes_ <= size_ - offset_;
+	}
+
+	// Mip levels start at multiples of the block size and of 4
+	uint64_t LevelAlignment(const graphics::TextureFormatInfo& info_)
+	{
+		return std::lcm<uint64_t>(info_.block_bytes, 4);
+	}
+
+	void AppendU32(std::vector<uint8_t>& data_, uint32_t value_)
+	{
+		uint8_t bytes[4];
+		std::memcpy(bytes, &value_, 4);
+		data_.insert(data_.end(), bytes, bytes + 4);
+	}
+}
+
+graphics::TextureFormatInfo graphics::GetTextureFormatInfo(VkFormat format_)
+{
+	switch (format_)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM: return { 1, 1, 4, KHR_DF_MODEL_RGBSDA, false };
+	case VK_FORMAT_R8G8B8A8_SRGB: return { 1, 1, 4, KHR_DF_MODEL_RGBSDA, true };
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return { 4, 4, 8, KHR_DF_MODEL_BC1A, false };
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return { 4, 4, 8, KHR_DF_MODEL_BC1A, true };
+	case VK_FORMAT_BC2_UNORM_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC2, false };
+	case VK_FORMAT_BC2_SRGB_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC2, true };
+	case VK_FORMAT_BC3_UNORM_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC3, false };
+	case VK_FORMAT_BC3_SRGB_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC3, true };
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK: return { 4, 4, 8, KHR_DF_MODEL_BC4, false };
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC5, false };
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC6H, false };
+	case VK_FORMAT_BC7_UNORM_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC7, false };
+	case VK_FORMAT_BC7_SRGB_BLOCK: return { 4, 4, 16, KHR_DF_MODEL_BC7, true };
+	default: break;
+	}
+
+	// ASTC formats come in UNORM/SRGB pairs ordered by block size
+	if (format_ >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format_ <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+	{
+		constexpr uint32_t block_sizes[14][2] = {
+			{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+			{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+		uint32_t index = format_ - VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+		return { block_sizes[index / 2][0], block_sizes[index / 2][1], 16, KHR_DF_MODEL_ASTC, index % 2 == 1 };
+	}
+
+	return {};
+}
+
+uint64_t graphics::TextureMipBytes(const TextureFormatInfo& info_, uint32_t width_, uint32_t height_)
+{
+	uint64_t blocks_x = (width_ + info_.block_width - 1) / info_.block_width;
+	uint64_t blocks_y = (height_ + info_.block_height - 1) / info_.block_height;
+	return blocks_x * blocks_y * info_.block_bytes;
+}
+
+graphics::TextureView graphics::ReadTextureFile(const uint8_t* data_, size_t size_)
+{
+	if (data_ == nullptr || size_ < sizeof(Ktx2Header))
+		throw std::runtime_error("Texture file is too small");
+
+	const Ktx2Header& header = *reinterpret_cast<const Ktx2Header*>(data_);
+	if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		throw std::runtime_error("Not a KTX2 file");
+	if (header.supercompression_scheme != 0)
+		throw std::runtime_error("Supercompressed KTX2 files are not supported");
+	if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth != 0 || header.layer_count > 1 || header.face_count != 1)
+		throw std::runtime_error("Only 2D KTX2 textures without layers or faces are supported");
+
+	TextureView view;
+	view.format = static_cast<VkFormat>(header.vk_format);
+	view.format_info = GetTextureFormatInfo(view.format);
+	view.width = header.pixel_width;
+	view.height = header.pixel_height;
+	if (view.format_info.block_bytes == 0)
+		throw std::runtime_error("Unsupported texture format " + std::to_string(header.vk_format));
+
+	uint32_t level_count = (std::max)(header.level_count, 1u);
+	uint32_t full_chain = 1;
+	while ((std::max)(view.width, view.height) >> full_chain)
+		full_chain++;
+	if (level_count > MAX_TEXTURE_MIPS || level_count > full_chain)
+		throw std::runtime_error("Invalid texture mip count " + std::to_string(level_count));
+	if (!InFile(sizeof(Ktx2Header), level_count * sizeof(Ktx2Level), size_))
+		throw std::runtime_error("Invalid texture level index");
+
+	const Ktx2Level* levels = reinterpret_cast<const Ktx2Level*>(data_ + sizeof(Ktx2Header));
+	for (uint32_t mip = 0; mip < level_count; mip++)
+	{
+		TextureMip texture_mip;
+		texture_mip.width = (std::max)(view.width >> mip, 1u);
+		texture_mip.height = (std::max)(view.height >> mip, 1u);
+		texture_mip.bytes = TextureMipBytes(view.format_info, texture_mip.width, texture_mip.height);
+		if (levels[mip].byte_length != texture_mip.bytes || !InFile(levels[mip].byte_offset, levels[mip].byte_length, size_))
+			throw std::runtime_error("Texture mip " + std::to_string(mip) + " exceeds the file or has the wrong size");
+		texture_mip.data = data_ + levels[mip].byte_offset;
+		view.mips.push_back(texture_mip);
+	}
+	return view;
+}
+
+std::vector<uint8_t> graphics::WriteTextureFile(VkFormat format_, uint32_t width_, uint32_t height_, const std::vector<std::vector<uint8_t>>& mips_)
+{
+	TextureFormatInfo info = GetTextureFormatInfo(format_);
+	if (info.block_bytes == 0)
+		throw std::runtime_error("Unsupported texture format " + std::to_string(format_));
+	if (mips_.empty() || mips_.size() > MAX_TEXTURE_MIPS)
+		throw std::runtime_error("Texture does not fit the mip limits");
+
+	// Basic descriptor block with one sample covering the whole texel block
+	std::vector<uint8_t> dfd;
+	uint32_t samples = info.color_model == KHR_DF_MODEL_RGBSDA ? 4 : 1;
+	uint32_t block_size = 24 + 16 * samples;
+	AppendU32(dfd, 4 + block_size);
+	AppendU32(dfd, 0); // Khronos vendor, basic descriptor type
+	AppendU32(dfd, 2 | (block_size << 16)); // Version 2
+	AppendU32(dfd, info.color_model | (1 << 8) | ((info.srgb ? 2 : 1) << 16)); // BT709 primaries, linear or sRGB transfer
+	AppendU32(dfd, (info.block_width - 1) | ((info.block_height - 1) << 8));
+	AppendU32(dfd, info.block_bytes);
+	AppendU32(dfd, 0);
+	if (samples == 4)
+	{
+		const uint32_t channels[4] = { 0, 1, 2, 15 }; // R, G, B, A
+		for (uint32_t channel = 0; channel < 4; channel++)
+		{
+			AppendU32(dfd, (channel * 8) | (7 << 16) | (channels[channel] << 24));
+			AppendU32(dfd, 0);
+			AppendU32(dfd, 0);
+			AppendU32(dfd, 255);
+		}
+	}
+	else
+	{
+		AppendU32(dfd, (info.block_bytes * 8 - 1) << 16);
+		AppendU32(dfd, 0);
+		AppendU32(dfd, 0);
+		AppendU32(dfd, 0xFFFFFFFF);
+	}
+
+	Ktx2Header header = {};
+	std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vk_format = format_;
+	header.type_size = 1; // Byte sized components, block compressed formats use 1 as well
+	header.pixel_width = width_;
+	header.pixel_height = height_;
+	header.face_count = 1;
+	header.level_count = static_cast<uint32_t>(mips_.size());
+	header.dfd_byte_offset = static_cast<uint32_t>(sizeof(Ktx2Header) + mips_.size() * sizeof(Ktx2Level));
+	header.dfd_byte_length = static_cast<uint32_t>(dfd.size());
+
+	// Mips are stored from the smallest to the most detailed one
+	std::vector<Ktx2Level> levels(mips_.size());
+	uint64_t alignment = LevelAlignment(info);
+	uint64_t offset = header.dfd_byte_offset + dfd.size();
+	for (size_t mip = mips_.size(); mip-- > 0;)
+	{
+		uint32_t width = (std::max)(width_ >> mip, 1u);
+		uint32_t height = (std::max)(height_ >> mip, 1u);
+		if (mips_[mip].size() != TextureMipBytes(info, width, height))
+			throw std::runtime_error("Texture mip " + std::to_string(mip) + " has the wrong size");
+
+		offset = (offset + alignment - 1) / alignment * alignment;
+		levels[mip] = { offset, mips_[mip].size(), mips_[mip].size() };
+		offset += mips_[mip].size();
+	}
+
+	std::vector<uint8_t> file(static_cast<size_t>(offset), 0);
+	std::memcpy(file.data(), &header, sizeof(header));
+	std::memcpy(file.data() + sizeof(header), levels.data(), levels.size() * sizeof(Ktx2Level));
+	std::memcpy(file.data() + header.dfd_byte_offset, dfd.data(), dfd.size());
+	for (size_t mip = 0; mip < mips_.size(); mip++)
+		std::memcpy(file.data() + levels[mip].byte_offset, mips_[mip].data(), mips_[mip].size());
+	return file;
+}
+
+bool graphics::SamplerDesc::operator<(const SamplerDesc& other_) const
+{
+	return std::tie(filter, mipmap_mode, address_mode, max_anisotropy) <
+		std::tie(other_.filter, other_.mipmap_mode, other_.address_mode, other_.max_anisotropy);
+}
\ No newline at end of file
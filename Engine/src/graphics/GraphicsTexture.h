@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace graphics
+{
+	constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A }; // "«KTX 20»\r\n\x1A\n"
+	constexpr uint32_t MAX_TEXTURE_MIPS = 16;
+
+	struct TextureFormatInfo
+	{
+		uint32_t block_width = 0;
+		uint32_t block_height = 0;
+		uint32_t block_bytes = 0; // 0 for formats textures can not use
+		uint32_t color_model = 0; // Khronos data format color model, written to the KTX2 format descriptor
+		bool srgb = false;
+	};
+
+	// Block compressed BC1-7 and ASTC LDR formats plus R8G8B8A8 for uncompressed textures
+	TextureFormatInfo GetTextureFormatInfo(VkFormat format_);
+	uint64_t TextureMipBytes(const TextureFormatInfo& info_, uint32_t width_, uint32_t height_);
+
+	struct Ktx2Header
+	{
+		uint8_t identifier[12];
+		uint32_t vk_format;
+		uint32_t type_size;
+		uint32_t pixel_width;
+		uint32_t pixel_height;
+		uint32_t pixel_depth; // 0 for 2D textures
+		uint32_t layer_count; // 0 if not an array
+		uint32_t face_count;
+		uint32_t level_count; // 0 asks the loader to generate mips
+		uint32_t supercompression_scheme;
+		uint32_t dfd_byte_offset;
+		uint32_t dfd_byte_length;
+		uint32_t kvd_byte_offset;
+		uint32_t kvd_byte_length;
+		uint64_t sgd_byte_offset;
+		uint64_t sgd_byte_length;
+	};
+
+	struct Ktx2Level
+	{
+		uint64_t byte_offset;
+		uint64_t byte_length;
+		uint64_t uncompressed_byte_length;
+	};
+
+	struct TextureMip
+	{
+		const uint8_t* data = nullptr;
+		uint64_t bytes = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	// Pointers into the file data, valid as long as the data is. Mip 0 is the most detailed
+	struct TextureView
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		TextureFormatInfo format_info;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<TextureMip> mips;
+	};
+
+	// Reads the KTX2 subset the engine streams: 2D, one layer and face, no supercompression, every mip stored.
+	// Validates the level index without touching the mip data, throws on malformed or unsupported files
+	TextureView ReadTextureFile(const uint8_t* data_, size_t size_);
+
+	// mips_ from the most detailed one, each sized as TextureMipBytes. Writes a minimal basic data format descriptor,
+	// enough for readers that take the format from vk_format
+	std::vector<uint8_t> WriteTextureFile(VkFormat format_, uint32_t width_, uint32_t height_, const std::vector<std::vector<uint8_t>>& mips_);
+
+	struct SamplerDesc
+	{
+		VkFilter filter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmap_mode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		float max_anisotropy = 1.0f; // 1 disables anisotropic filtering, clamped to the device limit
+
+		bool operator<(const SamplerDesc& other_) const;
+	};
+}
\ No newline at end of file
@@ -133,14 +133,21 @@ VkSurfaceFormatKHR graphics::ChooseSwapSurfaceFormat(const std::vector<VkSurface
 	return available_formats_[0];
 }
 
-VkPresentModeKHR graphics::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes_) 
+VkPresentModeKHR graphics::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes_, PresentPolicy policy_) 
 {
+	// FIFO is the only mode every device supports
+	if (policy_ == PresentVsync)
+		return VK_PRESENT_MODE_FIFO_KHR;
+
+	// Uncapped wants tearing rather than waiting, the other policies prefer MAILBOX which never tears
+	VkPresentModeKHR preferred = policy_ == PresentUncapped ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_MAILBOX_KHR;
+	VkPresentModeKHR fallback = policy_ == PresentUncapped ? VK_PRESENT_MODE_MAILBOX_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR;
 	VkPresentModeKHR best = VK_PRESENT_MODE_FIFO_KHR;
 
 	for (const auto& available_present_mode : available_present_modes_) {
-		if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (available_present_mode == preferred)
 			return available_present_mode;
-		else if (available_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+		else if (available_present_mode == fallback)
 			best = available_present_mode;
 	}
 
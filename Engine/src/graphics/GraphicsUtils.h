@@ -21,6 +21,14 @@ namespace graphics
 		}
 	};
 
+	enum PresentPolicy
+	{
+		PresentVsync, // FIFO, never tears, up to a full frame of queueing
+		PresentLowLatency, // MAILBOX or IMMEDIATE, paced to the refresh rate with input sampled late
+		PresentUncapped, // IMMEDIATE if available, as many frames as the GPU can take
+		PresentCapped // MAILBOX or IMMEDIATE, limited to a fixed frame rate
+	};
+
 	struct SwapChainSupportDetails {
 		VkSurfaceCapabilitiesKHR capabilities;
 		std::vector<VkSurfaceFormatKHR> formats;
@@ -34,7 +42,7 @@ namespace graphics
 
 	SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device_, VkSurfaceKHR surface_);
 	VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats_);
-	VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes_);
+	VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes_, PresentPolicy policy_);
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities_, int width_, int height_);
 
 	uint32_t FindMemoryType(uint32_t type_filter_, VkMemoryPropertyFlags properties_, VkPhysicalDevice physical_device_);
@@ -0,0 +1,216 @@
+#include "GraphicsVertex.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "packing.hpp"
+#include "gtc/packing.hpp"
+
+namespace
+{
+	const std::array<graphics::VertexFormatInfo, graphics::FormatCount> FORMAT_INFOS =
+	{ {
+		{ VK_FORMAT_R32G32_SFLOAT, 8, 2, "float2" },
+		{ VK_FORMAT_R32G32B32_SFLOAT, 12, 3, "float3" },
+		{ VK_FORMAT_R32G32B32A32_SFLOAT, 16, 4, "float4" },
+		{ VK_FORMAT_R16G16_SFLOAT, 4, 2, "half2" },
+		{ VK_FORMAT_R16G16B16A16_SFLOAT, 8, 4, "half4" },
+		{ VK_FORMAT_R8G8B8A8_UNORM, 4, 4, "unorm8x4" },
+		{ VK_FORMAT_R8G8B8A8_SNORM, 4, 4, "snorm8x4" },
+		{ VK_FORMAT_R16G16_UNORM, 4, 2, "unorm16x2" },
+		{ VK_FORMAT_R16G16_SNORM, 4, 2, "octahedral16" },
+	} };
+
+	void EncodeAttribute(graphics::VertexFormat format_, const glm::vec4& value_, uint8_t* out_)
+	{
+		switch (format_)
+		{
+		case graphics::FormatFloat2:
+		case graphics::FormatFloat3:
+		case graphics::FormatFloat4:
+			std::memcpy(out_, &value_[0], FORMAT_INFOS[format_].size);
+			break;
+		case graphics::FormatHalf2:
+		{
+			uint32_t packed = glm::packHalf2x16(glm::vec2(value_));
+			std::memcpy(out_, &packed, sizeof(packed));
+			break;
+		}
+		case graphics::FormatHalf4:
+		{
+			glm::uint64 packed = glm::packHalf4x16(value_);
+			std::memcpy(out_, &packed, sizeof(packed));
+			break;
+		}
+		case graphics::FormatUnorm8x4:
+		{
+			uint32_t packed = glm::packUnorm4x8(value_);
+			std::memcpy(out_, &packed, sizeof(packed));
+			break;
+		}
+		case graphics::FormatSnorm8x4:
+		{
+			uint32_t packed = glm::packSnorm4x8(value_);
+			std::memcpy(out_, &packed, sizeof(packed));
+			break;
+		}
+		case graphics::FormatUnorm16x2:
+		{
+			uint32_t packed = glm::packUnorm2x16(glm::vec2(value_));
+			std::memcpy(out_, &packed, sizeof(packed));
+			break;
+		}
+		case graphics::FormatOctahedral16:
+		{
+			uint32_t packed = glm::packSnorm2x16(graphics::OctahedralEncode(glm::vec3(value_)));
+			std::memcpy(out_, &packed, sizeof(packed));
+			break;
+		}
+		default:
+			throw std::runtime_error("Unknown vertex format");
+		}
+	}
+}
+
+const graphics::VertexFormatInfo& graphics::FormatInfo(VertexFormat format_)
+{
+	return FORMAT_INFOS[format_];
+}
+
+graphics::VertexLayout& graphics::VertexLayout::Add(VertexSemantic semantic_, VertexFormat format_, uint32_t stream_)
+{
+	if (Find(semantic_) != nullptr)
+		throw std::runtime_error("Vertex layout already has this semantic");
+
+	if (stream_ >= m_strides.size())
+		m_strides.resize(stream_ + 1, 0);
+
+	VertexAttribute attribute = {};
+	attribute.semantic = semantic_;
+	attribute.format = format_;
+	attribute.stream = stream_;
+	attribute.location = static_cast<uint32_t>(m_attributes.size());
+	attribute.offset = m_strides[stream_];
+	m_attributes.push_back(attribute);
+
+	m_strides[stream_] += FORMAT_INFOS[format_].size;
+	return *this;
+}
+
+const graphics::VertexAttribute* graphics::VertexLayout::Find(VertexSemantic semantic_) const
+{
+	for (const auto& attribute : m_attributes)
+		if (attribute.semantic == semantic_)
+			return &attribute;
+	return nullptr;
+}
+
+uint32_t graphics::VertexLayout::VertexSize() const
+{
+	uint32_t size = 0;
+	for (uint32_t stride : m_strides)
+		size += stride;
+	return size;
+}
+
+std::vector<VkVertexInputBindingDescription> graphics::VertexLayout::BindingDescriptions() const
+{
+	std::vector<VkVertexInputBindingDescription> binding_descriptions(m_strides.size());
+	for (uint32_t stream = 0; stream < m_strides.size(); stream++)
+	{
+		binding_descriptions[stream].binding = stream;
+		binding_descriptions[stream].stride = m_strides[stream];
+		binding_descriptions[stream].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	}
+	return binding_descriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> graphics::VertexLayout::AttributeDescriptions() const
+{
+	std::vector<VkVertexInputAttributeDescription> attribute_descriptions(m_attributes.size());
+	for (size_t i = 0; i < m_attributes.size(); i++)
+	{
+		attribute_descriptions[i].binding = m_attributes[i].stream;
+		attribute_descriptions[i].location = m_attributes[i].location;
+		attribute_descriptions[i].format = FORMAT_INFOS[m_attributes[i].format].vk_format;
+		attribute_descriptions[i].offset = m_attributes[i].offset;
+	}
+	return attribute_descriptions;
+}
+
+bool graphics::VertexLayout::operator==(const VertexLayout& other_) const
+{
+	if (m_attributes.size() != other_.m_attributes.size())
+		return false;
+
+	for (size_t i = 0; i < m_attributes.size(); i++)
+	{
+		const VertexAttribute& a = m_attributes[i];
+		const VertexAttribute& b = other_.m_attributes[i];
+		if (a.semantic != b.semantic || a.format != b.format || a.stream != b.stream)
+			return false;
+	}
+	return true;
+}
+
+graphics::EncodedVertices graphics::EncodeVertices(const VertexLayout& layout_, const VertexSource& source_)
+{
+	EncodedVertices encoded;
+	size_t size = 0;
+	for (uint32_t stream = 0; stream < layout_.StreamCount(); stream++)
+	{
+		size = (size + VERTEX_STREAM_ALIGNMENT - 1) / VERTEX_STREAM_ALIGNMENT * VERTEX_STREAM_ALIGNMENT;
+		encoded.stream_offsets.push_back(size);
+		size += static_cast<size_t>(layout_.Stride(stream)) * source_.vertex_count;
+	}
+	encoded.data.assign(size, 0);
+
+	for (const auto& attribute : layout_.Attributes())
+	{
+		const std::vector<glm::vec4>& values = source_.attributes[attribute.semantic];
+		if (values.empty())
+			continue;
+		if (values.size() != source_.vertex_count)
+			throw std::runtime_error("Vertex attribute count does not match the vertex count");
+
+		uint32_t stride = layout_.Stride(attribute.stream);
+		uint8_t* out = encoded.data.data() + encoded.stream_offsets[attribute.stream] + attribute.offset;
+		for (size_t i = 0; i < values.size(); i++)
+			EncodeAttribute(attribute.format, values[i], out + i * stride);
+	}
+
+	return encoded;
+}
+
+glm::vec2 graphics::OctahedralEncode(const glm::vec3& normal_)
+{
+	// Zero length or NaN normals, e.g. faces without one in a mesh that has normals, would pack NaNs
+	float length = glm::abs(normal_.x) + glm::abs(normal_.y) + glm::abs(normal_.z);
+	if (!(length > 0.0f) || std::isinf(length))
+		return glm::vec2(0.0f); // +Z
+
+	// Project onto the octahedron, then fold the lower half over the diagonals
+	glm::vec3 normal = normal_ / length;
+	if (normal.z >= 0.0f)
+		return glm::vec2(normal.x, normal.y);
+
+	glm::vec2 sign(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+	return (1.0f - glm::abs(glm::vec2(normal.y, normal.x))) * sign;
+}
+
+glm::vec3 graphics::OctahedralDecode(const glm::vec2& encoded_)
+{
+	glm::vec3 normal(encoded_.x, encoded_.y, 1.0f - glm::abs(encoded_.x) - glm::abs(encoded_.y));
+	float fold = glm::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+	return glm::normalize(normal);
+}
+
+graphics::VertexLayout graphics::BasicLayout()
+{
+	VertexLayout layout;
+	layout.Add(SemanticPosition, FormatHalf2).Add(SemanticColor, FormatUnorm8x4);
+	return layout;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "glm.hpp"
+
+namespace graphics
+{
+	constexpr uint32_t VERTEX_STREAM_ALIGNMENT = 16; // Byte alignment of every stream inside EncodedVertices::data
+
+	enum VertexSemantic
+	{
+		SemanticPosition,
+		SemanticNormal,
+		SemanticTangent,
+		SemanticColor,
+		SemanticTexCoord0,
+		SemanticTexCoord1,
+		SemanticCount
+	};
+
+	enum VertexFormat
+	{
+		FormatFloat2,
+		FormatFloat3,
+		FormatFloat4,
+		FormatHalf2,
+		FormatHalf4, // Half float positions, 3 components are not a valid vertex format everywhere
+		FormatUnorm8x4, // Colors
+		FormatSnorm8x4, // Tangents with the bitangent sign in w
+		FormatUnorm16x2, // Texture coordinates inside [0, 1]
+		FormatOctahedral16, // Unit vectors folded onto 2 components, the shader decodes like OctahedralDecode
+		FormatCount
+	};
+
+	struct VertexFormatInfo
+	{
+		VkFormat vk_format;
+		uint32_t size;
+		uint32_t components; // Read by the shader, all formats read as floats
+		const char* name;
+	};
+
+	const VertexFormatInfo& FormatInfo(VertexFormat format_);
+
+	struct VertexAttribute
+	{
+		VertexSemantic semantic;
+		VertexFormat format;
+		uint32_t stream; // Vertex buffer binding
+		uint32_t location; // Shader input location
+		uint32_t offset; // Inside the stream's vertex
+	};
+
+	// Attributes in shader location order. Every stream is one binding holding its attributes interleaved,
+	// e.g. positions alone in stream 0 for depth passes and everything else in stream 1
+	class VertexLayout
+	{
+		// VARIABLES
+	private:
+		std::vector<VertexAttribute> m_attributes;
+		std::vector<uint32_t> m_strides; // Of every stream
+
+		// METHODES
+	public:
+		VertexLayout& Add(VertexSemantic semantic_, VertexFormat format_, uint32_t stream_ = 0);
+
+		const std::vector<VertexAttribute>& Attributes() const { return m_attributes; }
+		const VertexAttribute* Find(VertexSemantic semantic_) const;
+		uint32_t StreamCount() const { return static_cast<uint32_t>(m_strides.size()); }
+		uint32_t Stride(uint32_t stream_) const { return m_strides[stream_]; }
+		uint32_t VertexSize() const; // Bytes per vertex over all streams
+
+		std::vector<VkVertexInputBindingDescription> BindingDescriptions() const;
+		std::vector<VkVertexInputAttributeDescription> AttributeDescriptions() const;
+
+		bool operator==(const VertexLayout& other_) const; // Same attributes in the same locations and streams
+		bool operator!=(const VertexLayout& other_) const { return !(*this == other_); }
+	};
+
+	// Uncompressed attributes as authored, one vec4 per vertex for every semantic the mesh has
+	struct VertexSource
+	{
+		size_t vertex_count = 0;
+		std::array<std::vector<glm::vec4>, SemanticCount> attributes;
+	};
+
+	// All streams in one buffer, bind stream i at stream_offsets[i]
+	struct EncodedVertices
+	{
+		std::vector<uint8_t> data;
+		std::vector<VkDeviceSize> stream_offsets;
+	};
+
+	// Attributes the source does not have are encoded as zero
+	EncodedVertices EncodeVertices(const VertexLayout& layout_, const VertexSource& source_);
+
+	glm::vec2 OctahedralEncode(const glm::vec3& normal_); // Normals without a direction encode +Z
+	glm::vec3 OctahedralDecode(const glm::vec2& encoded_);
+
+	// Half float 2D positions and 8 bit colors, 8 bytes instead of the 20 of Vertex
+	VertexLayout BasicLayout();
+}
\ No newline at end of file
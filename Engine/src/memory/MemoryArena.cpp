@@ -0,0 +1,70 @@
+#include "MemoryArena.h"
+
+memory::LinearArena::LinearArena(size_t capacity_) : m_capacity(capacity_)
+{
+	m_memory = static_cast<std::byte*>(::operator new(m_capacity, std::align_val_t(ARENA_BLOCK_ALIGNMENT)));
+}
+
+memory::LinearArena::~LinearArena()
+{
+	ReleaseOverflow();
+	::operator delete(m_memory, std::align_val_t(ARENA_BLOCK_ALIGNMENT));
+}
+
+void* memory::LinearArena::Allocate(size_t size_, size_t alignment_)
+{
+	uintptr_t base = reinterpret_cast<uintptr_t>(m_memory);
+	uintptr_t aligned = (base + m_offset + alignment_ - 1) & ~(static_cast<uintptr_t>(alignment_) - 1);
+
+	if (aligned + size_ <= base + m_capacity)
+	{
+		m_offset = aligned + size_ - base;
+		m_high_water = (std::max)(m_high_water, Used());
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	// Out of space, serve from the heap until the block is grown on reset
+	size_t alignment = (std::max)(alignment_, alignof(std::max_align_t));
+	m_overflow.push_back({ ::operator new(size_, std::align_val_t(alignment)), alignment });
+	m_overflow_bytes += size_ + alignment_;
+	m_high_water = (std::max)(m_high_water, Used());
+	return m_overflow.back().memory;
+}
+
+void memory::LinearArena::ReleaseOverflow()
+{
+	for (const auto& overflow : m_overflow)
+		::operator delete(overflow.memory, std::align_val_t(overflow.alignment));
+	m_overflow.clear();
+	m_overflow_bytes = 0;
+}
+
+void memory::LinearArena::Reset()
+{
+	if (!m_overflow.empty())
+	{
+		ReleaseOverflow();
+
+		// Half again the peak so small variations do not overflow the next frame
+		::operator delete(m_memory, std::align_val_t(ARENA_BLOCK_ALIGNMENT));
+		m_capacity = m_high_water + m_high_water / 2;
+		m_memory = static_cast<std::byte*>(::operator new(m_capacity, std::align_val_t(ARENA_BLOCK_ALIGNMENT)));
+	}
+
+	m_offset = 0;
+}
+
+memory::FrameArenas::FrameArenas(size_t frames_in_flight_, size_t capacity_)
+{
+	for (size_t i = 0; i < frames_in_flight_; i++)
+	{
+		m_arenas.push_back(std::make_unique<LinearArena>(capacity_));
+		m_resources.push_back(std::make_unique<ArenaResource>(*m_arenas.back()));
+	}
+}
+
+void memory::FrameArenas::NextFrame()
+{
+	m_current = (m_current + 1) % m_arenas.size();
+	m_arenas[m_current]->Reset();
+}
\ No newline at end of file
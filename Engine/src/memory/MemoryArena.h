@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+namespace memory
+{
+	constexpr size_t ARENA_BLOCK_ALIGNMENT = 64;
+
+	// Bump allocator, individual allocations are never freed, Reset releases everything at once.
+	// Requests that do not fit go to the heap until the next Reset, which then grows the block to the peak usage,
+	// so a steady workload stops touching the heap after its first frames
+	class LinearArena
+	{
+		// VARIABLES
+	private:
+		struct Overflow
+		{
+			void* memory;
+			size_t alignment;
+		};
+
+		std::byte* m_memory = nullptr;
+		size_t m_capacity = 0;
+		size_t m_offset = 0;
+		size_t m_high_water = 0; // Peak bytes used before a reset, overflow included
+		std::vector<Overflow> m_overflow;
+		size_t m_overflow_bytes = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		explicit LinearArena(size_t capacity_);
+		~LinearArena();
+
+		LinearArena(const LinearArena&) = delete;
+		LinearArena& operator=(const LinearArena&) = delete;
+
+		// METHODES
+	private:
+		void ReleaseOverflow();
+
+	public:
+		void* Allocate(size_t size_, size_t alignment_ = alignof(std::max_align_t));
+
+		template<typename T>
+		T* Allocate(size_t count_ = 1) { return static_cast<T*>(Allocate(sizeof(T) * count_, alignof(T))); }
+
+		void Reset();
+
+		size_t Used() const { return m_offset + m_overflow_bytes; }
+		size_t Capacity() const { return m_capacity; }
+		size_t HighWater() const { return m_high_water; }
+		size_t OverflowCount() const { return m_overflow.size(); }
+	};
+
+	// std::pmr adapter, deallocation is a no-op and memory comes back on the arena reset
+	class ArenaResource : public std::pmr::memory_resource
+	{
+		// VARIABLES
+	private:
+		LinearArena& m_arena;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		explicit ArenaResource(LinearArena& arena_) : m_arena(arena_) {}
+
+		// METHODES
+	private:
+		void* do_allocate(size_t bytes_, size_t alignment_) override { return m_arena.Allocate(bytes_, alignment_); }
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other_) const noexcept override { return this == &other_; }
+	};
+
+	// One arena per frame in flight, data allocated during a frame stays valid until the same slot comes around again
+	class FrameArenas
+	{
+		// VARIABLES
+	private:
+		std::vector<std::unique_ptr<LinearArena>> m_arenas;
+		std::vector<std::unique_ptr<ArenaResource>> m_resources;
+		size_t m_current = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		FrameArenas(size_t frames_in_flight_, size_t capacity_);
+
+		// METHODES
+	public:
+		void NextFrame(); // Moves to the next slot and resets its arena
+
+		LinearArena& Arena() { return *m_arenas[m_current]; }
+		std::pmr::memory_resource* Resource() { return m_resources[m_current].get(); }
+	};
+}
\ No newline at end of file
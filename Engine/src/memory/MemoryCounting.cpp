@@ -0,0 +1,124 @@
+#include "MemoryCounting.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if ENGINE_COUNT_ALLOCATIONS
+
+namespace
+{
+	thread_local uint64_t t_allocations = 0;
+	std::atomic<uint64_t> g_allocations = 0;
+
+	void* CountedAllocate(size_t size_, size_t alignment_)
+	{
+		t_allocations++;
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+
+		if (size_ == 0)
+			size_ = 1;
+#ifdef _MSC_VER
+		void* memory = alignment_ <= alignof(std::max_align_t) ? std::malloc(size_) : _aligned_malloc(size_, alignment_);
+#else
+		void* memory = alignment_ <= alignof(std::max_align_t) ? std::malloc(size_) : std::aligned_alloc(alignment_, (size_ + alignment_ - 1) / alignment_ * alignment_);
+#endif
+		return memory;
+	}
+
+	void CountedFree(void* memory_, size_t alignment_)
+	{
+#ifdef _MSC_VER
+		if (alignment_ > alignof(std::max_align_t))
+		{
+			_aligned_free(memory_);
+			return;
+		}
+#endif
+		std::free(memory_);
+	}
+}
+
+void* operator new(size_t size_)
+{
+	void* memory = CountedAllocate(size_, alignof(std::max_align_t));
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size_)
+{
+	return operator new(size_);
+}
+
+void* operator new(size_t size_, std::align_val_t alignment_)
+{
+	void* memory = CountedAllocate(size_, static_cast<size_t>(alignment_));
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size_, std::align_val_t alignment_)
+{
+	return operator new(size_, alignment_);
+}
+
+void* operator new(size_t size_, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size_, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size_, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size_, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size_, std::align_val_t alignment_, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size_, static_cast<size_t>(alignment_));
+}
+
+void* operator new[](size_t size_, std::align_val_t alignment_, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size_, static_cast<size_t>(alignment_));
+}
+
+void operator delete(void* memory_) noexcept { CountedFree(memory_, alignof(std::max_align_t)); }
+void operator delete[](void* memory_) noexcept { CountedFree(memory_, alignof(std::max_align_t)); }
+void operator delete(void* memory_, size_t) noexcept { CountedFree(memory_, alignof(std::max_align_t)); }
+void operator delete[](void* memory_, size_t) noexcept { CountedFree(memory_, alignof(std::max_align_t)); }
+void operator delete(void* memory_, std::align_val_t alignment_) noexcept { CountedFree(memory_, static_cast<size_t>(alignment_)); }
+void operator delete[](void* memory_, std::align_val_t alignment_) noexcept { CountedFree(memory_, static_cast<size_t>(alignment_)); }
+void operator delete(void* memory_, size_t, std::align_val_t alignment_) noexcept { CountedFree(memory_, static_cast<size_t>(alignment_)); }
+void operator delete[](void* memory_, size_t, std::align_val_t alignment_) noexcept { CountedFree(memory_, static_cast<size_t>(alignment_)); }
+void operator delete(void* memory_, const std::nothrow_t&) noexcept { CountedFree(memory_, alignof(std::max_align_t)); }
+void operator delete[](void* memory_, const std::nothrow_t&) noexcept { CountedFree(memory_, alignof(std::max_align_t)); }
+void operator delete(void* memory_, std::align_val_t alignment_, const std::nothrow_t&) noexcept { CountedFree(memory_, static_cast<size_t>(alignment_)); }
+void operator delete[](void* memory_, std::align_val_t alignment_, const std::nothrow_t&) noexcept { CountedFree(memory_, static_cast<size_t>(alignment_)); }
+
+uint64_t memory::ThreadAllocationCount()
+{
+	return t_allocations;
+}
+
+uint64_t memory::TotalAllocationCount()
+{
+	return g_allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+uint64_t memory::ThreadAllocationCount()
+{
+	return 0;
+}
+
+uint64_t memory::TotalAllocationCount()
+{
+	return 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Debug builds replace the global operator new/delete to count heap allocations,
+// set ENGINE_COUNT_ALLOCATIONS to override the default
+#ifndef ENGINE_COUNT_ALLOCATIONS
+#ifdef _DEBUG
+#define ENGINE_COUNT_ALLOCATIONS 1
+#else
+#define ENGINE_COUNT_ALLOCATIONS 0
+#endif
+#endif
+
+namespace memory
+{
+	constexpr bool ALLOCATION_COUNTING = ENGINE_COUNT_ALLOCATIONS != 0;
+
+	uint64_t ThreadAllocationCount(); // Heap allocations made by the calling thread, 0 without counting
+	uint64_t TotalAllocationCount(); // Heap allocations made by all threads, 0 without counting
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "MemoryMappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+memory::MappedFile& memory::MappedFile::operator=(MappedFile&& other_) noexcept
+{
+	if (this == &other_)
+		return *this;
+
+	Close();
+	m_data = other_.m_data;
+	m_size = other_.m_size;
+	m_file = other_.m_file;
+	m_mapping = other_.m_mapping;
+	m_open = other_.m_open;
+	other_.m_data = nullptr;
+	other_.m_size = 0;
+	other_.m_open = false;
+	return *this;
+}
+
+void memory::MappedFile::Open(const std::string& file_name_)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(file_name_.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open file for mapping: " + file_name_);
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to query the size of: " + file_name_);
+	}
+
+	HANDLE mapping = nullptr;
+	const void* data = nullptr;
+	if (size.QuadPart > 0) // Empty files can not be mapped
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (data == nullptr)
+		{
+			if (mapping != nullptr)
+				CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map file: " + file_name_);
+		}
+	}
+
+	m_file = reinterpret_cast<uintptr_t>(file);
+	m_mapping = reinterpret_cast<uintptr_t>(mapping);
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	int file = open(file_name_.c_str(), O_RDONLY);
+	if (file < 0)
+		throw std::runtime_error("Failed to open file for mapping: " + file_name_);
+
+	struct stat info;
+	if (fstat(file, &info) != 0)
+	{
+		close(file);
+		throw std::runtime_error("Failed to query the size of: " + file_name_);
+	}
+
+	const void* data = nullptr;
+	if (info.st_size > 0)
+	{
+		data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+		{
+			close(file);
+			throw std::runtime_error("Failed to map file: " + file_name_);
+		}
+	}
+
+	m_file = static_cast<uintptr_t>(file);
+	m_size = static_cast<size_t>(info.st_size);
+#endif
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_open = true;
+}
+
+void memory::MappedFile::Close()
+{
+	if (!m_open)
+		return;
+
+#ifdef _WIN32
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != 0)
+		CloseHandle(reinterpret_cast<HANDLE>(m_mapping));
+	CloseHandle(reinterpret_cast<HANDLE>(m_file));
+#else
+	if (m_data != nullptr)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	close(static_cast<int>(m_file));
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+	m_file = 0;
+	m_mapping = 0;
+	m_open = false;
+}
\ No newline at end of file
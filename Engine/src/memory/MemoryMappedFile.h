@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace memory
+{
+	// Read only mapping of a whole file. Pages are loaded by the OS on first access,
+	// so opening is cheap and data that is never touched is never read
+	class MappedFile
+	{
+		// VARIABLES
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		uintptr_t m_file = 0; // Native file handle or descriptor
+		uintptr_t m_mapping = 0; // Windows file mapping object
+		bool m_open = false;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		MappedFile() {}
+		MappedFile(const std::string& file_name_) { Open(file_name_); }
+		~MappedFile() { Close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other_) noexcept { *this = std::move(other_); }
+		MappedFile& operator=(MappedFile&& other_) noexcept;
+
+		// METHODES
+	public:
+		void Open(const std::string& file_name_); // Throws if the file can not be mapped
+		void Close();
+
+		bool IsOpen() const { return m_open; }
+		const uint8_t* Data() const { return m_data; } // nullptr for empty files
+		size_t Size() const { return m_size; }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,443 @@
+#include "MemoryPackage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+// The table of contents is read in place, the structs must not change size between compilers
+static_assert(sizeof(memory::PackageHeader) == 48, "PackageHeader is part of the package file format");
+static_assert(sizeof(memory::PackageEntry) == 48, "PackageEntry is part of the package file format");
+
+namespace
+{
+	constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+	// LZ4 block format limits, a block ends with at least 5 literals and the last match starts 12 bytes before the end
+	constexpr size_t LZ4_MIN_MATCH = 4;
+	constexpr size_t LZ4_LAST_LITERALS = 5;
+	constexpr size_t LZ4_MATCH_START_LIMIT = 12;
+	constexpr size_t LZ4_MAX_OFFSET = 65535;
+	constexpr uint64_t LZ4_MAX_RATIO = 255; // Every length byte adds at most 255 bytes, no block expands further
+	constexpr uint32_t LZ4_HASH_BITS = 14;
+
+	char NormalizeChar(char c_)
+	{
+		if (c_ == '\\')
+			return '/';
+		return c_ >= 'A' && c_ <= 'Z' ? static_cast<char>(c_ - 'A' + 'a') : c_;
+	}
+
+	bool PathEquals(const char* normalized_, const std::string& path_)
+	{
+		for (char c : path_)
+			if (*normalized_ == '\0' || *normalized_++ != NormalizeChar(c))
+				return false;
+		return *normalized_ == '\0';
+	}
+
+	bool InFile(uint64_t offset_, uint64_t bytes_, size_t size_)
+	{
+		return offset_ <= size_ && bytes_ <= size_ - offset_;
+	}
+
+	uint64_t Align(uint64_t offset_, uint64_t alignment_)
+	{
+		return (offset_ + alignment_ - 1) / alignment_ * alignment_;
+	}
+
+	uint32_t Read32(const uint8_t* data_)
+	{
+		uint32_t value;
+		std::memcpy(&value, data_, 4);
+		return value;
+	}
+
+	void WriteLength(std::vector<uint8_t>& output_, size_t length_)
+	{
+		for (; length_ >= 255; length_ -= 255)
+			output_.push_back(255);
+		output_.push_back(static_cast<uint8_t>(length_));
+	}
+
+	// A match_length_ of 0 writes the literals only sequence that ends a block
+	void WriteSequence(std::vector<uint8_t>& output_, const uint8_t* literals_, size_t literal_count_, size_t offset_, size_t match_length_)
+	{
+		size_t match_code = match_length_ > 0 ? match_length_ - LZ4_MIN_MATCH : 0;
+		output_.push_back(static_cast<uint8_t>(((std::min)(literal_count_, size_t(15)) << 4) | (std::min)(match_code, size_t(15))));
+		if (literal_count_ >= 15)
+			WriteLength(output_, literal_count_ - 15);
+		output_.insert(output_.end(), literals_, literals_ + literal_count_);
+		if (match_length_ == 0)
+			return;
+
+		output_.push_back(static_cast<uint8_t>(offset_));
+		output_.push_back(static_cast<uint8_t>(offset_ >> 8));
+		if (match_code >= 15)
+			WriteLength(output_, match_code - 15);
+	}
+
+	bool ReadLength(const uint8_t*& input_, const uint8_t* end_, size_t& length_)
+	{
+		uint8_t byte;
+		do
+		{
+			if (input_ == end_)
+				return false;
+			byte = *input_++;
+			length_ += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+std::string memory::NormalizePackagePath(const std::string& path_)
+{
+	std::string normalized = path_;
+	std::transform(normalized.begin(), normalized.end(), normalized.begin(), NormalizeChar);
+	return normalized;
+}
+
+uint64_t memory::HashPackagePath(const std::string& path_)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (char c : path_)
+		hash = (hash ^ static_cast<uint8_t>(NormalizeChar(c))) * FNV_PRIME;
+	return hash;
+}
+
+uint64_t memory::HashContent(const uint8_t* data_, size_t size_)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (size_t i = 0; i < size_; i++)
+		hash = (hash ^ data_[i]) * FNV_PRIME;
+	return hash;
+}
+
+std::vector<uint8_t> memory::CompressLz4(const uint8_t* data_, size_t size_)
+{
+	std::vector<uint8_t> output;
+	output.reserve(size_ + size_ / 255 + 16);
+
+	// Greedy parse, the table holds the last position + 1 of every hashed 4 byte sequence
+	size_t anchor = 0;
+	if (size_ > LZ4_MATCH_START_LIMIT)
+	{
+		std::vector<uint32_t> table(size_t(1) << LZ4_HASH_BITS, 0);
+		size_t match_start_limit = size_ - LZ4_MATCH_START_LIMIT;
+		size_t match_end_limit = size_ - LZ4_LAST_LITERALS;
+		size_t position = 0;
+		while (position < match_start_limit)
+		{
+			uint32_t sequence = Read32(data_ + position);
+			uint32_t& slot = table[(sequence * 2654435761u) >> (32 - LZ4_HASH_BITS)];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(position + 1);
+
+			if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET || Read32(data_ + candidate - 1) != sequence)
+			{
+				position++;
+				continue;
+			}
+
+			size_t match = candidate - 1;
+			size_t length = LZ4_MIN_MATCH;
+			while (position + length < match_end_limit && data_[match + length] == data_[position + length])
+				length++;
+
+			WriteSequence(output, data_ + anchor, position - anchor, position - match, length);
+			position += length;
+			anchor = position;
+		}
+	}
+
+	WriteSequence(output, data_ + anchor, size_ - anchor, 0, 0);
+	return output;
+}
+
+bool memory::DecompressLz4(const uint8_t* source_, size_t source_size_, uint8_t* data_, size_t size_)
+{
+	const uint8_t* input = source_;
+	const uint8_t* input_end = source_ + source_size_;
+	size_t written = 0;
+	while (input < input_end)
+	{
+		uint8_t token = *input++;
+		size_t literal_count = token >> 4;
+		if (literal_count == 15 && !ReadLength(input, input_end, literal_count))
+			return false;
+		if (literal_count > static_cast<size_t>(input_end - input) || literal_count > size_ - written)
+			return false;
+
+		if (literal_count > 0)
+			std::memcpy(data_ + written, input, literal_count);
+		input += literal_count;
+		written += literal_count;
+		if (input == input_end)
+			break;
+
+		if (input_end - input < 2)
+			return false;
+		size_t offset = input[0] | (input[1] << 8);
+		input += 2;
+
+		size_t length = token & 15;
+		if (length == 15 && !ReadLength(input, input_end, length))
+			return false;
+		length += LZ4_MIN_MATCH;
+		if (offset == 0 || offset > written || length > size_ - written)
+			return false;
+
+		// Overlapping matches repeat the last offset bytes
+		uint8_t* target = data_ + written;
+		const uint8_t* match = target - offset;
+		if (offset >= length)
+			std::memcpy(target, match, length);
+		else
+			for (size_t i = 0; i < length; i++)
+				target[i] = match[i];
+		written += length;
+	}
+	return written == size_;
+}
+
+memory::PackageWriteStats memory::WritePackage(const std::string& file_name_, const std::vector<PackageFile>& files_)
+{
+	PackageWriteStats stats;
+	stats.entries = static_cast<uint32_t>(files_.size());
+
+	std::vector<PackageEntry> entries(files_.size());
+	std::vector<std::string> names(files_.size());
+	for (size_t i = 0; i < files_.size(); i++)
+	{
+		names[i] = NormalizePackagePath(files_[i].path);
+		entries[i].path_hash = HashPackagePath(names[i]);
+	}
+
+	std::vector<uint32_t> order(files_.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t a_, uint32_t b_) { return entries[a_].path_hash < entries[b_].path_hash; });
+	for (size_t i = 1; i < order.size(); i++)
+	{
+		if (entries[order[i - 1]].path_hash != entries[order[i]].path_hash)
+			continue;
+		if (names[order[i - 1]] == names[order[i]])
+			throw std::runtime_error("Package path added twice: " + names[order[i]]);
+		throw std::runtime_error("Package paths with the same hash: " + names[order[i - 1]] + ", " + names[order[i]]);
+	}
+
+	uint32_t slot_count = 1;
+	while (slot_count < files_.size() * 2)
+		slot_count *= 2;
+
+	PackageHeader header = {};
+	header.magic = PACKAGE_MAGIC;
+	header.version = PACKAGE_VERSION;
+	header.entry_count = stats.entries;
+	header.slot_count = slot_count;
+	header.entries_offset = sizeof(PackageHeader);
+	header.slots_offset = header.entries_offset + files_.size() * sizeof(PackageEntry);
+	header.names_offset = header.slots_offset + slot_count * sizeof(uint32_t);
+
+	std::string name_data;
+	for (uint32_t file : order)
+	{
+		entries[file].name_offset = static_cast<uint32_t>(name_data.size());
+		name_data += names[file];
+		name_data += '\0';
+	}
+	header.names_bytes = name_data.size();
+
+	// Entries with the same content share the data of the first one
+	std::vector<std::vector<uint8_t>> compressed(files_.size());
+	std::unordered_multimap<uint64_t, uint32_t> contents;
+	std::vector<uint32_t> stored_files;
+	uint64_t offset = header.names_offset + header.names_bytes;
+	for (uint32_t file : order)
+	{
+		const std::vector<uint8_t>& data = files_[file].data;
+		PackageEntry& entry = entries[file];
+		entry.content_hash = HashContent(data.data(), data.size());
+		entry.size = data.size();
+		stats.input_bytes += data.size();
+
+		auto range = contents.equal_range(entry.content_hash);
+		auto shared = std::find_if(range.first, range.second, [&](const auto& content_) { return files_[content_.second].data == data; });
+		if (shared != range.second)
+		{
+			const PackageEntry& original = entries[shared->second];
+			entry.offset = original.offset;
+			entry.stored_bytes = original.stored_bytes;
+			entry.compression = original.compression;
+			stats.shared_entries++;
+			continue;
+		}
+		contents.emplace(entry.content_hash, file);
+
+		entry.compression = CompressionNone;
+		entry.stored_bytes = data.size();
+		if (files_[file].compress)
+		{
+			compressed[file] = CompressLz4(data.data(), data.size());
+			if (compressed[file].size() <= data.size() - data.size() / 8)
+			{
+				entry.compression = CompressionLz4;
+				entry.stored_bytes = compressed[file].size();
+				stats.compressed_entries++;
+			}
+			else
+				compressed[file].clear();
+		}
+
+		offset = Align(offset, PACKAGE_ENTRY_ALIGNMENT);
+		entry.offset = offset;
+		offset += entry.stored_bytes;
+		stored_files.push_back(file);
+	}
+
+	std::vector<uint32_t> slots(slot_count, 0);
+	std::vector<PackageEntry> sorted_entries;
+	for (uint32_t file : order)
+	{
+		uint32_t slot = static_cast<uint32_t>(entries[file].path_hash) & (slot_count - 1);
+		while (slots[slot] != 0)
+			slot = (slot + 1) & (slot_count - 1);
+		sorted_entries.push_back(entries[file]);
+		slots[slot] = static_cast<uint32_t>(sorted_entries.size());
+	}
+
+	std::ofstream output(file_name_, std::ios::binary);
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	output.write(reinterpret_cast<const char*>(sorted_entries.data()), sorted_entries.size() * sizeof(PackageEntry));
+	output.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint32_t));
+	output.write(name_data.data(), name_data.size());
+
+	uint64_t written = header.names_offset + header.names_bytes;
+	const char padding[PACKAGE_ENTRY_ALIGNMENT] = {};
+	for (uint32_t file : stored_files)
+	{
+		output.write(padding, entries[file].offset - written);
+		const std::vector<uint8_t>& data = entries[file].compression == CompressionNone ? files_[file].data : compressed[file];
+		output.write(reinterpret_cast<const char*>(data.data()), data.size());
+		written = entries[file].offset + data.size();
+	}
+
+	if (!output.flush())
+		throw std::runtime_error("Unable to write package " + file_name_);
+	stats.file_bytes = written;
+	return stats;
+}
+
+void memory::Package::Open(const std::string& file_name_)
+{
+	Close();
+	m_file.Open(file_name_);
+
+	const uint8_t* data = m_file.Data();
+	size_t size = m_file.Size();
+	const PackageHeader* header = reinterpret_cast<const PackageHeader*>(data);
+	if (size < sizeof(PackageHeader) || header->magic != PACKAGE_MAGIC)
+		throw std::runtime_error("Not a package file: " + file_name_);
+	if (header->version != PACKAGE_VERSION)
+		throw std::runtime_error("Unsupported package version " + std::to_string(header->version) + ": " + file_name_);
+
+	bool valid_tables =
+		(header->slot_count & (header->slot_count - 1)) == 0 && header->slot_count > header->entry_count &&
+		header->entries_offset % alignof(PackageEntry) == 0 && header->slots_offset % alignof(uint32_t) == 0 &&
+		InFile(header->entries_offset, uint64_t(header->entry_count) * sizeof(PackageEntry), size) &&
+		InFile(header->slots_offset, uint64_t(header->slot_count) * sizeof(uint32_t), size) &&
+		InFile(header->names_offset, header->names_bytes, size) &&
+		(header->names_bytes == 0 || data[header->names_offset + header->names_bytes - 1] == '\0');
+	if (!valid_tables)
+		throw std::runtime_error("Invalid package table of contents: " + file_name_);
+
+	const PackageEntry* entries = reinterpret_cast<const PackageEntry*>(data + header->entries_offset);
+	for (uint32_t i = 0; i < header->entry_count; i++)
+	{
+		const PackageEntry& entry = entries[i];
+		bool valid_entry = InFile(entry.offset, entry.stored_bytes, size) && entry.name_offset < header->names_bytes &&
+			((entry.compression == CompressionLz4 && entry.size <= entry.stored_bytes * LZ4_MAX_RATIO) ||
+			(entry.compression == CompressionNone && entry.stored_bytes == entry.size));
+		if (!valid_entry)
+			throw std::runtime_error("Invalid package entry " + std::to_string(i) + ": " + file_name_);
+	}
+
+	const uint32_t* slots = reinterpret_cast<const uint32_t*>(data + header->slots_offset);
+	for (uint32_t slot = 0; slot < header->slot_count; slot++)
+		if (slots[slot] > header->entry_count)
+			throw std::runtime_error("Invalid package slot table: " + file_name_);
+
+	m_header = header;
+	m_entries = entries;
+	m_slots = slots;
+	m_names = reinterpret_cast<const char*>(data + header->names_offset);
+}
+
+void memory::Package::Close()
+{
+	m_file.Close();
+	m_header = nullptr;
+	m_entries = nullptr;
+	m_slots = nullptr;
+	m_names = nullptr;
+}
+
+const memory::PackageEntry* memory::Package::Find(const std::string& path_) const
+{
+	if (m_header == nullptr)
+		return nullptr;
+
+	uint64_t hash = HashPackagePath(path_);
+	uint32_t mask = m_header->slot_count - 1;
+	uint32_t slot = static_cast<uint32_t>(hash) & mask;
+	for (uint32_t probe = 0; probe < m_header->slot_count; probe++)
+	{
+		uint32_t index = m_slots[slot];
+		if (index == 0)
+			return nullptr;
+
+		const PackageEntry& entry = m_entries[index - 1];
+		if (entry.path_hash == hash && PathEquals(Name(entry), path_))
+			return &entry;
+		slot = (slot + 1) & mask;
+	}
+	return nullptr;
+}
+
+void memory::Package::Decompress(const PackageEntry& entry_, std::vector<uint8_t>& data_) const
+{
+	data_.resize(static_cast<size_t>(entry_.size));
+	if (entry_.compression == CompressionNone)
+		std::memcpy(data_.data(), StoredData(entry_), data_.size());
+	else if (!DecompressLz4(StoredData(entry_), static_cast<size_t>(entry_.stored_bytes), data_.data(), data_.size()))
+		throw std::runtime_error("Corrupt package entry: " + std::string(Name(entry_)));
+}
+
+void memory::AssetFile::Open(const Package* package_, const std::string& path_)
+{
+	m_file.Close();
+	m_buffer.clear();
+
+	const PackageEntry* entry = package_ != nullptr ? package_->Find(path_) : nullptr;
+	m_packed = entry != nullptr;
+	if (entry != nullptr && entry->compression == CompressionNone)
+	{
+		m_data = package_->StoredData(*entry);
+		m_size = static_cast<size_t>(entry->size);
+	}
+	else if (entry != nullptr)
+	{
+		package_->Decompress(*entry, m_buffer);
+		m_data = m_buffer.data();
+		m_size = m_buffer.size();
+	}
+	else
+	{
+		m_file.Open(path_);
+		m_data = m_file.Data();
+		m_size = m_file.Size();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MemoryMappedFile.h"
+
+namespace memory
+{
+	constexpr uint32_t PACKAGE_MAGIC = 0x4B415045; // "EPAK"
+	constexpr uint32_t PACKAGE_VERSION = 1;
+	constexpr uint64_t PACKAGE_ENTRY_ALIGNMENT = 64; // Of every entry inside the file, covers the mesh sections and SPIR-V words
+
+	enum PackageCompression : uint32_t
+	{
+		CompressionNone,
+		CompressionLz4 // LZ4 block format
+	};
+
+	// Followed by the entries sorted by path hash, the slot table and the names
+	struct PackageHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entry_count;
+		uint32_t slot_count; // Power of two, at least twice the entry count
+		uint64_t entries_offset;
+		uint64_t slots_offset; // uint32_t entry index + 1 per slot, 0 marks an empty slot
+		uint64_t names_offset;
+		uint64_t names_bytes;
+	};
+
+	struct PackageEntry
+	{
+		uint64_t path_hash;
+		uint64_t content_hash; // Of the uncompressed data, entries with equal content share their data
+		uint64_t offset;
+		uint64_t stored_bytes;
+		uint64_t size; // Uncompressed
+		uint32_t compression;
+		uint32_t name_offset; // Into the names, null terminated
+	};
+
+	// Package paths use '/' and are case insensitive, so "src\\shaders\\A.spv" finds "src/shaders/a.spv"
+	std::string NormalizePackagePath(const std::string& path_);
+	uint64_t HashPackagePath(const std::string& path_); // FNV-1a of the normalized path
+	uint64_t HashContent(const uint8_t* data_, size_t size_);
+
+	std::vector<uint8_t> CompressLz4(const uint8_t* data_, size_t size_);
+	// False if the block is malformed or does not decompress to exactly size_ bytes
+	bool DecompressLz4(const uint8_t* source_, size_t source_size_, uint8_t* data_, size_t size_);
+
+	struct PackageFile
+	{
+		std::string path;
+		std::vector<uint8_t> data;
+		bool compress = false; // Stored compressed if that saves at least an eighth
+	};
+
+	struct PackageWriteStats
+	{
+		uint32_t entries = 0;
+		uint32_t compressed_entries = 0;
+		uint32_t shared_entries = 0; // Point at the data of an earlier entry with the same content
+		uint64_t input_bytes = 0;
+		uint64_t file_bytes = 0;
+	};
+
+	// Throws on duplicate paths, path hash collisions and write errors
+	PackageWriteStats WritePackage(const std::string& file_name_, const std::vector<PackageFile>& files_);
+
+	// Read only view of a package file mapped once. Lookups hash the path and probe the slot table,
+	// uncompressed entries are read in place from the mapping
+	class Package
+	{
+		// VARIABLES
+	private:
+		MappedFile m_file;
+		const PackageHeader* m_header = nullptr;
+		const PackageEntry* m_entries = nullptr;
+		const uint32_t* m_slots = nullptr;
+		const char* m_names = nullptr;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		Package() {}
+		Package(const std::string& file_name_) { Open(file_name_); }
+
+		// METHODES
+	public:
+		void Open(const std::string& file_name_); // Validates the table of contents, throws on malformed files
+		void Close();
+
+		bool IsOpen() const { return m_header != nullptr; }
+		const PackageEntry* Find(const std::string& path_) const; // nullptr if the package has no such entry
+		const PackageEntry* Entries() const { return m_entries; }
+		uint32_t EntryCount() const { return m_header != nullptr ? m_header->entry_count : 0; }
+		const char* Name(const PackageEntry& entry_) const { return m_names + entry_.name_offset; }
+		const uint8_t* StoredData(const PackageEntry& entry_) const { return m_file.Data() + entry_.offset; }
+		void Decompress(const PackageEntry& entry_, std::vector<uint8_t>& data_) const; // Throws if the data is corrupt
+	};
+
+	// Bytes of an asset, from the package if it has the path and from the loose file otherwise.
+	// Both are mapped and read in place, only compressed package entries are decompressed into memory
+	class AssetFile
+	{
+		// VARIABLES
+	private:
+		MappedFile m_file;
+		std::vector<uint8_t> m_buffer;
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		bool m_packed = false;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		AssetFile() {}
+		AssetFile(const Package* package_, const std::string& path_) { Open(package_, path_); }
+
+		// METHODES
+	public:
+		void Open(const Package* package_, const std::string& path_); // package_ may be nullptr, throws if neither has the file
+
+		const uint8_t* Data() const { return m_data; }
+		size_t Size() const { return m_size; }
+		bool IsPacked() const { return m_packed; }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+#include <utility>
+
+namespace memory
+{
+	constexpr uint32_t INVALID_HANDLE_INDEX = 0xFFFFFFFF;
+
+	// Index into a Pool plus the generation of the slot when the object was created.
+	// Destroying the object bumps the slot generation, so stale copies of the handle stop resolving
+	template<typename T>
+	struct Handle
+	{
+		uint32_t index = INVALID_HANDLE_INDEX;
+		uint32_t generation = 0;
+
+		bool IsNull() const { return index == INVALID_HANDLE_INDEX; }
+		bool operator==(const Handle& other_) const { return index == other_.index && generation == other_.generation; }
+		bool operator!=(const Handle& other_) const { return !(*this == other_); }
+	};
+
+	// Objects are stored densely for iteration, destroy moves the last object into the hole.
+	// Slots map handles to dense positions and are recycled through a free list, all operations are O(1)
+	template<typename T>
+	class Pool
+	{
+		// VARIABLES
+	private:
+		struct Slot
+		{
+			uint32_t dense_index; // Next free slot while the slot is free
+			uint32_t generation;
+		};
+
+		std::vector<T> m_dense;
+		std::vector<uint32_t> m_dense_slots; // Slot of every dense object
+		std::vector<Slot> m_slots;
+		uint32_t m_free_head = INVALID_HANDLE_INDEX;
+
+		// METHODES
+	public:
+		template<typename... Args>
+		Handle<T> Create(Args&&... args_)
+		{
+			uint32_t index = m_free_head;
+			if (index == INVALID_HANDLE_INDEX)
+			{
+				index = static_cast<uint32_t>(m_slots.size());
+				m_slots.push_back({ 0, 1 });
+			}
+			else
+			{
+				m_free_head = m_slots[index].dense_index;
+			}
+
+			m_slots[index].dense_index = static_cast<uint32_t>(m_dense.size());
+			m_dense.push_back(T{ std::forward<Args>(args_)... });
+			m_dense_slots.push_back(index);
+
+			return { index, m_slots[index].generation };
+		}
+
+		bool Destroy(Handle<T> handle_)
+		{
+			if (!IsValid(handle_))
+				return false;
+
+			Slot& slot = m_slots[handle_.index];
+			uint32_t last = static_cast<uint32_t>(m_dense.size() - 1);
+			if (slot.dense_index != last)
+			{
+				m_dense[slot.dense_index] = std::move(m_dense[last]);
+				m_dense_slots[slot.dense_index] = m_dense_slots[last];
+				m_slots[m_dense_slots[slot.dense_index]].dense_index = slot.dense_index;
+			}
+			m_dense.pop_back();
+			m_dense_slots.pop_back();
+
+			// Generation 0 is never handed out, so a default constructed handle cannot match a slot
+			if (++slot.generation == 0)
+				slot.generation = 1;
+			slot.dense_index = m_free_head;
+			m_free_head = handle_.index;
+			return true;
+		}
+
+		bool IsValid(Handle<T> handle_) const
+		{
+			if (handle_.index >= m_slots.size() || m_slots[handle_.index].generation != handle_.generation)
+				return false;
+
+			// A free slot already carries the generation of its next object, check it is occupied
+			uint32_t dense_index = m_slots[handle_.index].dense_index;
+			return dense_index < m_dense_slots.size() && m_dense_slots[dense_index] == handle_.index;
+		}
+
+		// nullptr for null, destroyed or foreign handles
+		T* Get(Handle<T> handle_) { return IsValid(handle_) ? &m_dense[m_slots[handle_.index].dense_index] : nullptr; }
+		const T* Get(Handle<T> handle_) const { return IsValid(handle_) ? &m_dense[m_slots[handle_.index].dense_index] : nullptr; }
+
+		// Throws on a stale handle, for code paths where a use after free is a bug
+		T& At(Handle<T> handle_)
+		{
+			T* object = Get(handle_);
+			if (object == nullptr)
+				throw std::out_of_range("Stale or invalid pool handle");
+			return *object;
+		}
+
+		Handle<T> HandleAt(size_t dense_index_) const
+		{
+			uint32_t index = m_dense_slots[dense_index_];
+			return { index, m_slots[index].generation };
+		}
+
+		size_t Size() const { return m_dense.size(); }
+		bool Empty() const { return m_dense.empty(); }
+
+		void Reserve(size_t count_)
+		{
+			m_dense.reserve(count_);
+			m_dense_slots.reserve(count_);
+			m_slots.reserve(count_);
+		}
+
+		// Dense iteration, the order changes when objects are destroyed
+		T* begin() { return m_dense.data(); }
+		T* end() { return m_dense.data() + m_dense.size(); }
+		const T* begin() const { return m_dense.data(); }
+		const T* end() const { return m_dense.data() + m_dense.size(); }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "MemoryRanges.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+uint64_t memory::RangeAllocator::Allocate(uint64_t size_, uint64_t alignment_)
+{
+	if (size_ == 0)
+		return NO_RANGE;
+
+	for (auto it = m_free.begin(); it != m_free.end(); ++it)
+	{
+		uint64_t begin = it->first;
+		uint64_t end = it->first + it->second;
+		uint64_t offset = (begin + alignment_ - 1) / alignment_ * alignment_;
+		if (offset + size_ > end)
+			continue;
+
+		// Keep the padding in front and the rest behind as free ranges
+		m_free.erase(it);
+		if (offset > begin)
+			m_free.emplace(begin, offset - begin);
+		if (offset + size_ < end)
+			m_free.emplace(offset + size_, end - offset - size_);
+
+		m_used += size_;
+		return offset;
+	}
+	return NO_RANGE;
+}
+
+void memory::RangeAllocator::Free(uint64_t offset_, uint64_t size_)
+{
+	if (offset_ == NO_RANGE || size_ == 0)
+		return;
+	assert(offset_ + size_ <= m_capacity);
+
+	auto next = m_free.lower_bound(offset_);
+	assert(next == m_free.end() || next->first >= offset_ + size_); // Double free or overlap
+
+	uint64_t begin = offset_;
+	uint64_t end = offset_ + size_;
+	if (next != m_free.begin())
+	{
+		auto previous = std::prev(next);
+		assert(previous->first + previous->second <= offset_);
+		if (previous->first + previous->second == offset_)
+		{
+			begin = previous->first;
+			m_free.erase(previous);
+		}
+	}
+	if (next != m_free.end() && next->first == end)
+	{
+		end = next->first + next->second;
+		m_free.erase(next);
+	}
+
+	m_free.emplace(begin, end - begin);
+	m_used -= size_;
+}
+
+void memory::RangeAllocator::Grow(uint64_t capacity_)
+{
+	if (capacity_ <= m_capacity)
+		return;
+
+	uint64_t old_capacity = m_capacity;
+	m_capacity = capacity_;
+	m_used += capacity_ - old_capacity;
+	Free(old_capacity, capacity_ - old_capacity); // Merges with a free range at the old end
+}
+
+uint64_t memory::RangeAllocator::LargestFree() const
+{
+	uint64_t largest = 0;
+	for (const auto& range : m_free)
+		largest = std::max(largest, range.second);
+	return largest;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+namespace memory
+{
+	constexpr uint64_t NO_RANGE = ~uint64_t(0);
+
+	// First fit sub-allocation of [0, capacity) in caller defined units, e.g. vertices or bytes of a GPU buffer.
+	// Only offsets are handed out, the caller owns the memory and passes the size back when freeing
+	class RangeAllocator
+	{
+		// VARIABLES
+	private:
+		std::map<uint64_t, uint64_t> m_free; // Offset to size, neighbouring free ranges are always merged
+		uint64_t m_capacity = 0;
+		uint64_t m_used = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		RangeAllocator(uint64_t capacity_ = 0) { Grow(capacity_); }
+
+		// METHODES
+	public:
+		uint64_t Allocate(uint64_t size_, uint64_t alignment_ = 1); // NO_RANGE if no free range fits
+		void Free(uint64_t offset_, uint64_t size_);
+		void Grow(uint64_t capacity_); // Appends [Capacity(), capacity_) as free space
+
+		uint64_t Capacity() const { return m_capacity; }
+		uint64_t Used() const { return m_used; }
+		uint64_t LargestFree() const;
+	};
+}
\ No newline at end of file
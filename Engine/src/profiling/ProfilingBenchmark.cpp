@@ -0,0 +1,186 @@
+#include "ProfilingBenchmark.h"
+
+profiling::Benchmark::Benchmark(const BenchmarkSettings& settings_) : m_settings(settings_)
+{
+	m_cpu_frame_times.reserve(m_settings.frames);
+	m_gpu_frame_times.reserve(m_settings.frames);
+	for (auto& stage : m_stage_times)
+		stage.reserve(m_settings.frames);
+}
+
+void profiling::Benchmark::RecordFrame(const FrameTiming& timing_)
+{
+	if (Finished())
+		return;
+
+	if (m_frames_seen++ < m_settings.warmup_frames)
+		return;
+
+	m_cpu_frame_times.push_back(timing_.cpu_frame_ms);
+	for (size_t i = 0; i < StageCount; i++)
+		m_stage_times[i].push_back(timing_.stage_ms[i]);
+	if (timing_.gpu_frame_ms >= 0.0)
+		m_gpu_frame_times.push_back(timing_.gpu_frame_ms);
+
+	if (timing_.heap_allocations >= 0)
+	{
+		uint64_t allocations = static_cast<uint64_t>(timing_.heap_allocations);
+		m_allocations_counted = true;
+		m_heap_allocations += allocations;
+		m_max_frame_allocations = (std::max)(m_max_frame_allocations, allocations);
+		m_allocating_frames += allocations > 0 ? 1 : 0;
+	}
+}
+
+profiling::SampleSummary profiling::Benchmark::Summarize(std::vector<double> samples_)
+{
+	SampleSummary summary;
+	if (samples_.empty())
+		return summary;
+
+	std::sort(samples_.begin(), samples_.end());
+
+	// Nearest rank percentile
+	auto percentile = [&samples_](double p_) {
+		size_t rank = static_cast<size_t>(p_ * static_cast<double>(samples_.size()) + 0.5);
+		return samples_[std::clamp<size_t>(rank, 1, samples_.size()) - 1];
+	};
+
+	double sum = 0.0;
+	for (double sample : samples_)
+		sum += sample;
+
+	summary.count = samples_.size();
+	summary.min = samples_.front();
+	summary.avg = sum / static_cast<double>(samples_.size());
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	summary.max = samples_.back();
+	return summary;
+}
+
+std::string profiling::Benchmark::SummaryJson(const std::vector<double>& samples_, bool histogram_) const
+{
+	SampleSummary summary = Summarize(samples_);
+
+	std::ostringstream json;
+	json << "{ \"count\": " << summary.count
+		<< ", \"min\": " << summary.min
+		<< ", \"avg\": " << summary.avg
+		<< ", \"p50\": " << summary.p50
+		<< ", \"p95\": " << summary.p95
+		<< ", \"p99\": " << summary.p99
+		<< ", \"max\": " << summary.max;
+
+	if (histogram_)
+	{
+		std::vector<size_t> counts(m_settings.histogram_buckets, 0);
+		for (double sample : samples_)
+		{
+			size_t bucket = static_cast<size_t>(sample / m_settings.histogram_bucket_ms);
+			counts[std::min(bucket, counts.size() - 1)]++;
+		}
+
+		json << ", \"histogram\": { \"bucket_ms\": " << m_settings.histogram_bucket_ms << ", \"counts\": [";
+		for (size_t i = 0; i < counts.size(); i++)
+			json << (i == 0 ? "" : ", ") << counts[i];
+		json << "] }";
+	}
+
+	json << " }";
+	return json.str();
+}
+
+std::string profiling::Benchmark::ReportJson() const
+{
+	std::ostringstream json;
+	json << "{\n";
+	json << "\t\"frames\": " << m_cpu_frame_times.size() << ",\n";
+	json << "\t\"warmup_frames\": " << m_settings.warmup_frames << ",\n";
+	json << "\t\"cpu_frame_ms\": " << SummaryJson(m_cpu_frame_times, true) << ",\n";
+	json << "\t\"stages_ms\": {\n";
+	for (size_t i = 0; i < StageCount; i++)
+		json << "\t\t\"" << FRAME_STAGE_NAMES[i] << "\": " << SummaryJson(m_stage_times[i], false) << (i + 1 < StageCount ? ",\n" : "\n");
+	json << "\t}";
+	if (!m_gpu_frame_times.empty())
+		json << ",\n\t\"gpu_frame_ms\": " << SummaryJson(m_gpu_frame_times, true);
+	if (m_allocations_counted)
+		json << ",\n\t\"heap_allocations\": { \"total\": " << m_heap_allocations
+			<< ", \"max_per_frame\": " << m_max_frame_allocations
+			<< ", \"allocating_frames\": " << m_allocating_frames << " }";
+	json << "\n}\n";
+
+	return json.str();
+}
+
+void profiling::Benchmark::WriteReport() const
+{
+	std::ofstream output_file(m_settings.report_file, std::ios::out | std::ios::trunc);
+	if (!output_file.is_open())
+		throw std::runtime_error("Unable to open benchmark report file: " + m_settings.report_file);
+
+	output_file << ReportJson();
+}
+
+double profiling::Benchmark::ReadBaselineValue(const std::string& json_, const std::string& section_, const std::string& key_)
+{
+	// Baselines are reports written by ReportJson, so a key lookup inside the section object is enough
+	size_t section = json_.find("\"" + section_ + "\"");
+	if (section == std::string::npos)
+		return -1.0;
+
+	size_t section_end = json_.find('}', section);
+	size_t key = json_.find("\"" + key_ + "\":", section);
+	if (key == std::string::npos || key > section_end)
+		return -1.0;
+
+	return std::stod(json_.substr(key + key_.size() + 3));
+}
+
+bool profiling::Benchmark::CompareWithBaseline(std::ostream& log_) const
+{
+	if (m_settings.baseline_file.empty())
+		return true;
+
+	std::ifstream input_file(m_settings.baseline_file, std::ios::in);
+	if (!input_file.is_open())
+		throw std::runtime_error("Unable to open benchmark baseline file: " + m_settings.baseline_file);
+
+	std::stringstream buffer;
+	buffer << input_file.rdbuf();
+	const std::string baseline = buffer.str();
+
+	struct Metric
+	{
+		const char* section;
+		const std::vector<double>* samples;
+	};
+	const Metric metrics[] = { { "cpu_frame_ms", &m_cpu_frame_times }, { "gpu_frame_ms", &m_gpu_frame_times } };
+
+	bool passed = true;
+	for (const auto& metric : metrics)
+	{
+		if (metric.samples->empty())
+			continue;
+
+		SampleSummary current = Summarize(*metric.samples);
+		const std::pair<const char*, double> values[] = { { "p50", current.p50 }, { "p95", current.p95 }, { "p99", current.p99 } };
+
+		for (const auto& value : values)
+		{
+			double reference = ReadBaselineValue(baseline, metric.section, value.first);
+			if (reference <= 0.0)
+				continue;
+
+			double change = value.second / reference - 1.0;
+			bool regressed = change > m_settings.regression_threshold;
+			passed = passed && !regressed;
+
+			log_ << metric.section << " " << value.first << ": " << reference << " -> " << value.second
+				<< " ms (" << (change >= 0.0 ? "+" : "") << change * 100.0 << "%)" << (regressed ? " REGRESSION" : "") << "\n";
+		}
+	}
+
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace profiling
+{
+	enum FrameStage
+	{
+		StageProcessMessages,
+		StageBeginFrame,
+		StageFrameAction,
+		StageEndFrame,
+		StageCount
+	};
+
+	constexpr const char* FRAME_STAGE_NAMES[StageCount] = { "ProcessMessages", "BeginFrame", "FrameAction", "EndFrame" };
+
+	struct FrameTiming
+	{
+		double cpu_frame_ms = 0.0;
+		std::array<double, StageCount> stage_ms = {};
+		double gpu_frame_ms = -1.0; // Negative when the GPU time is not available
+		int64_t heap_allocations = -1; // Negative when allocations are not counted
+	};
+
+	struct BenchmarkSettings
+	{
+		size_t frames = 1000;
+		size_t warmup_frames = 60; // Not recorded, lets caches and clocks settle
+		std::string report_file = "benchmark.json";
+		std::string baseline_file; // Empty - no comparison
+		double regression_threshold = 0.05; // Allowed relative slowdown of p50/p95/p99 against the baseline
+		double histogram_bucket_ms = 0.5;
+		size_t histogram_buckets = 64; // The last bucket collects everything above the range
+	};
+
+	struct SampleSummary
+	{
+		size_t count = 0;
+		double min = 0.0;
+		double avg = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	class Benchmark
+	{
+		// VARIABLES
+	private:
+		BenchmarkSettings m_settings;
+		size_t m_frames_seen = 0;
+
+		std::vector<double> m_cpu_frame_times;
+		std::array<std::vector<double>, StageCount> m_stage_times;
+		std::vector<double> m_gpu_frame_times;
+
+		bool m_allocations_counted = false;
+		uint64_t m_heap_allocations = 0;
+		uint64_t m_max_frame_allocations = 0;
+		size_t m_allocating_frames = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		Benchmark(const BenchmarkSettings& settings_);
+		~Benchmark() {}
+
+		// METHODES
+	private:
+		std::string SummaryJson(const std::vector<double>& samples_, bool histogram_) const;
+		static double ReadBaselineValue(const std::string& json_, const std::string& section_, const std::string& key_);
+
+	public:
+		static SampleSummary Summarize(std::vector<double> samples_);
+
+		void RecordFrame(const FrameTiming& timing_);
+		bool Finished() const { return m_frames_seen >= m_settings.warmup_frames + m_settings.frames; }
+
+		std::string ReportJson() const;
+		void WriteReport() const;
+		bool CompareWithBaseline(std::ostream& log_) const; // True if no metric regressed beyond the threshold
+
+		const BenchmarkSettings& Settings() const { return m_settings; }
+	};
+}
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "ProfilingMetrics.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using NativeSocket = SOCKET;
+#define CloseSocket closesocket
+constexpr int SEND_FLAGS = 0;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+using NativeSocket = int;
+constexpr NativeSocket INVALID_SOCKET = -1;
+#define CloseSocket close
+// A scraper disconnecting mid response must not raise SIGPIPE, Apple platforms set SO_NOSIGPIPE on the socket instead
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+#endif
+
+namespace
+{
+	std::atomic<uint32_t> g_next_shard = 0;
+
+	// Waits until the socket is readable, so the server thread notices a shutdown without a blocking accept
+	bool WaitReadable(NativeSocket socket_, long timeout_ms_)
+	{
+		fd_set read_set;
+		FD_ZERO(&read_set);
+		FD_SET(socket_, &read_set);
+		timeval timeout = { timeout_ms_ / 1000, (timeout_ms_ % 1000) * 1000 };
+		return select(static_cast<int>(socket_ + 1), &read_set, nullptr, nullptr, &timeout) > 0;
+	}
+
+	void AddDouble(std::atomic<double>& target_, double value_)
+	{
+		double current = target_.load(std::memory_order_relaxed);
+		while (!target_.compare_exchange_weak(current, current + value_, std::memory_order_relaxed))
+			;
+	}
+}
+
+uint32_t profiling::MetricShardIndex()
+{
+	thread_local uint32_t shard = g_next_shard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+	return shard;
+}
+
+void profiling::Metric::WriteHeader(std::ostream& output_, const char* type_) const
+{
+	output_ << "# HELP " << m_name << " " << m_help << "\n";
+	output_ << "# TYPE " << m_name << " " << type_ << "\n";
+}
+
+uint64_t profiling::Counter::Value() const
+{
+	uint64_t value = 0;
+	for (const auto& shard : m_shards)
+		value += shard.value.load(std::memory_order_relaxed);
+	return value;
+}
+
+void profiling::Counter::WritePrometheus(std::ostream& output_) const
+{
+	WriteHeader(output_, "counter");
+	output_ << Name() << " " << Value() << "\n";
+}
+
+void profiling::Gauge::Add(double value_)
+{
+	AddDouble(m_value, value_);
+}
+
+void profiling::Gauge::WritePrometheus(std::ostream& output_) const
+{
+	WriteHeader(output_, "gauge");
+	output_ << Name() << " " << Value() << "\n";
+}
+
+profiling::Histogram::Histogram(const std::string& name_, const std::string& help_, const std::vector<double>& bounds_) :
+	Metric(name_, help_),
+	m_bounds(bounds_),
+	m_buckets(std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1))
+{
+	for (size_t i = 0; i <= m_bounds.size(); i++)
+		m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void profiling::Histogram::Observe(double value_)
+{
+	// Bucket lists are short, a linear scan beats a binary search here
+	size_t bucket = 0;
+	while (bucket < m_bounds.size() && value_ > m_bounds[bucket])
+		bucket++;
+
+	m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	AddDouble(m_sum, value_);
+}
+
+void profiling::Histogram::WritePrometheus(std::ostream& output_) const
+{
+	WriteHeader(output_, "histogram");
+
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < m_bounds.size(); i++)
+	{
+		cumulative += m_buckets[i].load(std::memory_order_relaxed);
+		output_ << Name() << "_bucket{le=\"" << m_bounds[i] << "\"} " << cumulative << "\n";
+	}
+	cumulative += m_buckets[m_bounds.size()].load(std::memory_order_relaxed);
+	output_ << Name() << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+	output_ << Name() << "_sum " << m_sum.load(std::memory_order_relaxed) << "\n";
+	output_ << Name() << "_count " << cumulative << "\n";
+}
+
+template<typename T, typename... Args>
+T& profiling::MetricsRegistry::Register(const std::string& name_, Args&&... args_)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const auto& metric : m_metrics)
+	{
+		if (metric->Name() != name_)
+			continue;
+
+		T* existing = dynamic_cast<T*>(metric.get());
+		if (existing == nullptr)
+			throw std::runtime_error("Metric registered with a different type: " + name_);
+		return *existing;
+	}
+
+	m_metrics.push_back(std::make_unique<T>(name_, std::forward<Args>(args_)...));
+	return static_cast<T&>(*m_metrics.back());
+}
+
+profiling::Counter& profiling::MetricsRegistry::AddCounter(const std::string& name_, const std::string& help_)
+{
+	return Register<Counter>(name_, help_);
+}
+
+profiling::Gauge& profiling::MetricsRegistry::AddGauge(const std::string& name_, const std::string& help_)
+{
+	return Register<Gauge>(name_, help_);
+}
+
+profiling::Histogram& profiling::MetricsRegistry::AddHistogram(const std::string& name_, const std::string& help_, const std::vector<double>& bounds_)
+{
+	return Register<Histogram>(name_, help_, bounds_);
+}
+
+std::string profiling::MetricsRegistry::PrometheusText() const
+{
+	std::ostringstream output;
+	output << std::setprecision(9);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const auto& metric : m_metrics)
+		metric->WritePrometheus(output);
+
+	return output.str();
+}
+
+profiling::MetricsRegistry& profiling::Metrics()
+{
+	static MetricsRegistry registry;
+	return registry;
+}
+
+void profiling::MetricsServer::Initialize()
+{
+#ifdef _WIN32
+	WSADATA wsa_data;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+	{
+		std::cerr << "Failed to initialize Winsock for the metrics server" << std::endl;
+		return;
+	}
+#endif
+
+	NativeSocket listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listen_socket == INVALID_SOCKET)
+	{
+		std::cerr << "Failed to create metrics server socket" << std::endl;
+		return;
+	}
+
+	int reuse = 1;
+	setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	// Only local scrapers, the endpoint is not meant to be reachable from the network
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(m_port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(listen_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listen_socket, 4) != 0)
+	{
+		std::cerr << "Failed to listen for metrics on port " << m_port << std::endl;
+		CloseSocket(listen_socket);
+		return;
+	}
+
+	m_socket = static_cast<uintptr_t>(listen_socket);
+	m_running = true;
+	m_thread = std::thread(&MetricsServer::Serve, this);
+
+	m_initialized = true;
+}
+
+void profiling::MetricsServer::Shutdown()
+{
+	if (!m_initialized)
+		return;
+
+	m_running = false;
+	m_thread.join();
+	CloseSocket(static_cast<NativeSocket>(m_socket));
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+
+	m_initialized = false;
+}
+
+void profiling::MetricsServer::Serve()
+{
+	NativeSocket listen_socket = static_cast<NativeSocket>(m_socket);
+	while (m_running)
+	{
+		if (!WaitReadable(listen_socket, 100))
+			continue;
+
+		NativeSocket client = accept(listen_socket, nullptr, nullptr);
+		if (client == INVALID_SOCKET)
+			continue;
+
+		HandleClient(static_cast<uintptr_t>(client));
+		CloseSocket(client);
+	}
+}
+
+void profiling::MetricsServer::HandleClient(uintptr_t client_)
+{
+	NativeSocket client = static_cast<NativeSocket>(client_);
+#ifdef SO_NOSIGPIPE
+	int no_sigpipe = 1;
+	setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+	// Only the request line matters, headers and body are ignored
+	char request[1024];
+	if (!WaitReadable(client, 1000))
+		return;
+	int received = recv(client, request, sizeof(request) - 1, 0);
+	if (received <= 0)
+		return;
+	request[received] = '\0';
+
+	std::string request_line(request, std::strcspn(request, "\r\n"));
+	bool found = request_line.rfind("GET /metrics", 0) == 0 || request_line.rfind("GET / ", 0) == 0;
+
+	std::string body = found ? m_registry.PrometheusText() : "Not found\n";
+	std::ostringstream response;
+	response << (found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n")
+		<< "Content-Type: text/plain; version=0.0.4\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Connection: close\r\n\r\n"
+		<< body;
+
+	std::string data = response.str();
+	for (size_t sent = 0; sent < data.size();)
+	{
+		int result = send(client, data.data() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS);
+		if (result <= 0)
+			return;
+		sent += static_cast<size_t>(result);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+
+namespace profiling
+{
+	constexpr size_t METRIC_SHARDS = 8; // Counter slots, writers on different threads rarely share a cache line
+
+	uint32_t MetricShardIndex(); // Stable per thread, assigned round robin
+
+	class Metric
+	{
+		// VARIABLES
+	private:
+		std::string m_name;
+		std::string m_help;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		Metric(const std::string& name_, const std::string& help_) : m_name(name_), m_help(help_) {}
+		virtual ~Metric() {}
+
+		// METHODES
+	protected:
+		void WriteHeader(std::ostream& output_, const char* type_) const;
+
+	public:
+		virtual void WritePrometheus(std::ostream& output_) const = 0;
+
+		const std::string& Name() const { return m_name; }
+	};
+
+	// Monotonic count, e.g. draw calls or uploaded bytes
+	class Counter : public Metric
+	{
+		// VARIABLES
+	private:
+		struct alignas(64) Shard
+		{
+			std::atomic<uint64_t> value = 0;
+		};
+		Shard m_shards[METRIC_SHARDS];
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		using Metric::Metric;
+
+		// METHODES
+	public:
+		void Add(uint64_t value_ = 1) { m_shards[MetricShardIndex()].value.fetch_add(value_, std::memory_order_relaxed); }
+		uint64_t Value() const;
+
+		void WritePrometheus(std::ostream& output_) const override;
+	};
+
+	// Value that goes up and down, e.g. memory in use or queue depth
+	class Gauge : public Metric
+	{
+		// VARIABLES
+	private:
+		std::atomic<double> m_value = 0.0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		using Metric::Metric;
+
+		// METHODES
+	public:
+		void Set(double value_) { m_value.store(value_, std::memory_order_relaxed); }
+		void Add(double value_);
+		double Value() const { return m_value.load(std::memory_order_relaxed); }
+
+		void WritePrometheus(std::ostream& output_) const override;
+	};
+
+	// Distribution over fixed buckets, exported cumulatively like Prometheus expects
+	class Histogram : public Metric
+	{
+		// VARIABLES
+	private:
+		std::vector<double> m_bounds; // Ascending upper bounds, the +Inf bucket is implicit
+		std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+		std::atomic<uint64_t> m_count = 0;
+		std::atomic<double> m_sum = 0.0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		Histogram(const std::string& name_, const std::string& help_, const std::vector<double>& bounds_);
+
+		// METHODES
+	public:
+		void Observe(double value_);
+		uint64_t Count() const { return m_count.load(std::memory_order_relaxed); }
+
+		void WritePrometheus(std::ostream& output_) const override;
+	};
+
+	// Metrics are registered once and live as long as the registry, so subsystems keep plain pointers to them.
+	// Registering an existing name returns the existing metric
+	class MetricsRegistry
+	{
+		// VARIABLES
+	private:
+		mutable std::mutex m_mutex;
+		std::vector<std::unique_ptr<Metric>> m_metrics;
+
+		// METHODES
+	private:
+		template<typename T, typename... Args>
+		T& Register(const std::string& name_, Args&&... args_);
+
+	public:
+		Counter& AddCounter(const std::string& name_, const std::string& help_);
+		Gauge& AddGauge(const std::string& name_, const std::string& help_);
+		Histogram& AddHistogram(const std::string& name_, const std::string& help_, const std::vector<double>& bounds_);
+
+		std::string PrometheusText() const;
+	};
+
+	MetricsRegistry& Metrics(); // Process wide registry
+
+	// Serves the registry in the Prometheus text format over HTTP on 127.0.0.1:port_
+	class MetricsServer
+	{
+		// VARIABLES
+	private:
+		bool m_initialized = false;
+		uint16_t m_port = 0;
+		MetricsRegistry& m_registry;
+
+		uintptr_t m_socket = 0; // Native listening socket
+		std::atomic<bool> m_running = false;
+		std::thread m_thread;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		MetricsServer(uint16_t port_, MetricsRegistry& registry_ = Metrics()) : m_port(port_), m_registry(registry_) { Initialize(); }
+		~MetricsServer() { Shutdown(); }
+
+		// METHODES
+	private:
+		void Initialize();
+		void Shutdown();
+
+		void Serve();
+		void HandleClient(uintptr_t client_);
+
+	public:
+		bool IsInitialized() const { return m_initialized; }
+	};
+}
\ No newline at end of file
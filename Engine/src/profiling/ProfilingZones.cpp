@@ -0,0 +1,154 @@
+#include "ProfilingZones.h"
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+
+std::atomic<uint64_t> profiling::detail::g_capture = 0;
+thread_local uint32_t profiling::detail::t_depth = 0;
+
+namespace
+{
+	// Buffers outlive their threads so zones of finished threads can still be exported
+	std::mutex g_buffers_mutex;
+	std::vector<std::unique_ptr<profiling::ZoneBuffer>> g_buffers;
+	uint64_t g_last_capture = 0;
+
+	thread_local profiling::ZoneBuffer* t_buffer = nullptr;
+
+	profiling::ZoneBuffer& ThreadBuffer()
+	{
+		if (t_buffer == nullptr)
+		{
+			auto buffer = std::make_unique<profiling::ZoneBuffer>();
+			buffer->events = std::make_unique<profiling::ZoneEvent[]>(profiling::ZONE_BUFFER_CAPACITY);
+
+			std::lock_guard<std::mutex> lock(g_buffers_mutex);
+			buffer->thread_index = static_cast<uint32_t>(g_buffers.size());
+			t_buffer = buffer.get();
+			g_buffers.push_back(std::move(buffer));
+		}
+		return *t_buffer;
+	}
+
+	void WriteJsonString(std::ostream& output_, const std::string& string_)
+	{
+		output_ << '"';
+		for (char c : string_)
+		{
+			if (c == '"' || c == '\\')
+				output_ << '\\' << c;
+			else if (static_cast<unsigned char>(c) >= 0x20)
+				output_ << c;
+		}
+		output_ << '"';
+	}
+}
+
+void profiling::detail::RecordZone(const char* name_, int64_t begin_, uint32_t depth_)
+{
+	int64_t end = ZoneTimestamp();
+
+	// Zones that straddle a stop are still written into the capture they started in
+	uint64_t capture = g_capture.load(std::memory_order_acquire);
+	ZoneBuffer& buffer = ThreadBuffer();
+	uint64_t buffer_capture = buffer.capture.load(std::memory_order_relaxed); // Only this thread writes it
+	if (capture == 0)
+		capture = buffer_capture;
+
+	// An exporter that acquires the new capture sees the reset count, never zones of the old one
+	if (buffer_capture != capture)
+	{
+		buffer.dropped.store(0, std::memory_order_relaxed);
+		buffer.count.store(0, std::memory_order_relaxed);
+		buffer.capture.store(capture, std::memory_order_release);
+	}
+
+	size_t count = buffer.count.load(std::memory_order_relaxed);
+	if (count >= ZONE_BUFFER_CAPACITY)
+	{
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer.events[count] = { name_, begin_, end, depth_ };
+	buffer.count.store(count + 1, std::memory_order_release);
+}
+
+void profiling::StartCapture()
+{
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+	detail::g_capture.store(++g_last_capture, std::memory_order_release);
+}
+
+void profiling::StopCapture()
+{
+	detail::g_capture.store(0, std::memory_order_release);
+}
+
+bool profiling::IsCapturing()
+{
+	return detail::g_capture.load(std::memory_order_relaxed) != 0;
+}
+
+void profiling::SetThreadName(const std::string& name_)
+{
+	ZoneBuffer& buffer = ThreadBuffer();
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+	buffer.thread_name = name_;
+}
+
+bool profiling::WriteChromeTrace(const std::string& file_name_)
+{
+	std::ofstream output_file(file_name_, std::ios::out | std::ios::trunc);
+	if (!output_file.is_open())
+		return false;
+
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+
+	// Timestamps are relative to the earliest zone, the trace format expects microseconds
+	int64_t origin = (std::numeric_limits<int64_t>::max)();
+	for (const auto& buffer : g_buffers)
+	{
+		if (buffer->capture.load(std::memory_order_acquire) != g_last_capture)
+			continue;
+		// Zones are recorded when they end, so an outer zone follows the zones nested in it
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++)
+			origin = (std::min)(origin, buffer->events[i].begin);
+	}
+
+	output_file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (const auto& buffer : g_buffers)
+	{
+		if (buffer->capture.load(std::memory_order_acquire) != g_last_capture)
+			continue;
+
+		std::string thread_name = buffer->thread_name.empty() ? "Thread " + std::to_string(buffer->thread_index) : buffer->thread_name;
+		output_file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_index << ",\"args\":{\"name\":";
+		WriteJsonString(output_file, thread_name);
+		output_file << "}}";
+		first = false;
+
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++)
+		{
+			const ZoneEvent& event = buffer->events[i];
+			output_file << ",\n{\"name\":";
+			WriteJsonString(output_file, event.name);
+			output_file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_index
+				<< ",\"ts\":" << static_cast<double>(event.begin - origin) / 1000.0
+				<< ",\"dur\":" << static_cast<double>(event.end - event.begin) / 1000.0
+				<< ",\"args\":{\"depth\":" << event.depth << "}}";
+		}
+
+		size_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+		if (dropped > 0)
+			output_file << ",\n{\"name\":\"dropped zones\",\"ph\":\"C\",\"pid\":1,\"tid\":" << buffer->thread_index << ",\"ts\":0,\"args\":{\"count\":" << dropped << "}}";
+	}
+	output_file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	return true;
+}
\ No newline at end of file
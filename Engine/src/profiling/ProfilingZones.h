@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Set ENGINE_PROFILING to 0 in the preprocessor definitions to compile every zone out
+#ifndef ENGINE_PROFILING
+#define ENGINE_PROFILING 1
+#endif
+
+namespace profiling
+{
+	constexpr size_t ZONE_BUFFER_CAPACITY = 1 << 16; // Zones per thread and capture, later zones are dropped
+
+	using ZoneClock = std::chrono::steady_clock;
+
+	inline int64_t ZoneTimestamp()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(ZoneClock::now().time_since_epoch()).count();
+	}
+
+	struct ZoneEvent
+	{
+		const char* name; // Must outlive the capture, zone names are string literals
+		int64_t begin;
+		int64_t end;
+		uint32_t depth;
+	};
+
+	// Zones of a single thread. Only the owning thread writes, the writer publishes with a release store of the count
+	struct ZoneBuffer
+	{
+		std::unique_ptr<ZoneEvent[]> events;
+		std::atomic<size_t> count = 0;
+		std::atomic<size_t> dropped = 0;
+		std::atomic<uint64_t> capture = 0; // Capture the events belong to, the owner resets the count before publishing a new one
+		uint32_t thread_index = 0;
+		std::string thread_name;
+	};
+
+	void StartCapture();
+	void StopCapture();
+	bool IsCapturing();
+	void SetThreadName(const std::string& name_);
+	// Writes the zones of the last capture in the Chrome trace event format, also loadable in Perfetto.
+	// Stop the capture first, zones written during the export are not included
+	bool WriteChromeTrace(const std::string& file_name_);
+
+	namespace detail
+	{
+		extern std::atomic<uint64_t> g_capture; // Current capture id, 0 - not capturing
+		extern thread_local uint32_t t_depth;
+
+		void RecordZone(const char* name_, int64_t begin_, uint32_t depth_);
+	}
+
+	class ProfileZone
+	{
+		// VARIABLES
+	private:
+		const char* m_name;
+		int64_t m_begin = 0;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		explicit ProfileZone(const char* name_) : m_name(name_)
+		{
+			// A single relaxed load is the whole cost while no capture is running
+			if (detail::g_capture.load(std::memory_order_relaxed) == 0)
+			{
+				m_name = nullptr;
+				return;
+			}
+			detail::t_depth++;
+			m_begin = ZoneTimestamp();
+		}
+
+		~ProfileZone()
+		{
+			if (m_name == nullptr)
+				return;
+			detail::RecordZone(m_name, m_begin, --detail::t_depth);
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+	};
+}
+
+#define PROFILING_CONCAT_INNER(a, b) a##b
+#define PROFILING_CONCAT(a, b) PROFILING_CONCAT_INNER(a, b)
+
+#if ENGINE_PROFILING
+#define PROFILE_SCOPE(name) profiling::ProfileZone PROFILING_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#endif
\ No newline at end of file
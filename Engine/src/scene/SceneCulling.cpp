@@ -0,0 +1,474 @@
+#include "SceneCulling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "../profiling/ProfilingZones.h"
+
+namespace
+{
+	enum BoxResult
+	{
+		BoxOutside,
+		BoxIntersecting,
+		BoxInside
+	};
+
+	BoxResult TestBox(const scene::Frustum& frustum_, const scene::Aabb& box_)
+	{
+		glm::vec3 center = (box_.min + box_.max) * 0.5f;
+		glm::vec3 extent = (box_.max - box_.min) * 0.5f;
+
+		BoxResult result = BoxInside;
+		for (const auto& plane : frustum_.planes)
+		{
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			if (distance + radius < 0.0f)
+				return BoxOutside;
+			if (distance - radius < 0.0f)
+				result = BoxIntersecting;
+		}
+		return result;
+	}
+
+	void AppendMask(uint32_t mask_, const uint32_t* ids_, std::vector<uint32_t>& visible_)
+	{
+		while (mask_ != 0)
+		{
+			visible_.push_back(ids_[std::countr_zero(mask_)]);
+			mask_ &= mask_ - 1;
+		}
+	}
+
+	// Appends the ids of the objects in [first_, first_ + count_) intersecting the frustum. Removed objects have a NaN
+	// center, every comparison with it fails, so they are never reported
+	void TestObjects(const scene::Frustum& frustum_, const float* const* bounds_, const uint32_t* ids_,
+		uint32_t first_, uint32_t count_, std::vector<uint32_t>& visible_)
+	{
+		const float* center_x = bounds_[0];
+		const float* center_y = bounds_[1];
+		const float* center_z = bounds_[2];
+		const float* extent_x = bounds_[3];
+		const float* extent_y = bounds_[4];
+		const float* extent_z = bounds_[5];
+
+		uint32_t i = first_;
+		const uint32_t end = first_ + count_;
+
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(center_x + i);
+			__m256 cy = _mm256_loadu_ps(center_y + i);
+			__m256 cz = _mm256_loadu_ps(center_z + i);
+			__m256 ex = _mm256_loadu_ps(extent_x + i);
+			__m256 ey = _mm256_loadu_ps(extent_y + i);
+			__m256 ez = _mm256_loadu_ps(extent_z + i);
+
+			__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (const auto& plane : frustum_.planes)
+			{
+				__m256 distance = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)), _mm256_mul_ps(cy, _mm256_set1_ps(plane.y))),
+					_mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+				__m256 radius = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(std::fabs(plane.x))), _mm256_mul_ps(ey, _mm256_set1_ps(std::fabs(plane.y)))),
+					_mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(plane.z))));
+				visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			AppendMask(static_cast<uint32_t>(_mm256_movemask_ps(visible)), ids_ + i, visible_);
+		}
+#endif
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(center_x + i);
+			__m128 cy = _mm_loadu_ps(center_y + i);
+			__m128 cz = _mm_loadu_ps(center_z + i);
+			__m128 ex = _mm_loadu_ps(extent_x + i);
+			__m128 ey = _mm_loadu_ps(extent_y + i);
+			__m128 ez = _mm_loadu_ps(extent_z + i);
+
+			__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (const auto& plane : frustum_.planes)
+			{
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+					_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+				__m128 radius = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y)))),
+					_mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+				visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+			AppendMask(static_cast<uint32_t>(_mm_movemask_ps(visible)), ids_ + i, visible_);
+		}
+#endif
+
+		for (; i < end; i++)
+		{
+			bool visible = true;
+			for (const auto& plane : frustum_.planes)
+			{
+				float distance = plane.x * center_x[i] + plane.y * center_y[i] + plane.z * center_z[i] + plane.w;
+				float radius = std::fabs(plane.x) * extent_x[i] + std::fabs(plane.y) * extent_y[i] + std::fabs(plane.z) * extent_z[i];
+				visible = visible && distance + radius >= 0.0f;
+			}
+			if (visible)
+				visible_.push_back(ids_[i]);
+		}
+	}
+
+	scene::Aabb Merge(const scene::Aabb& a_, const scene::Aabb& b_)
+	{
+		return { glm::min(a_.min, b_.min), glm::max(a_.max, b_.max) };
+	}
+
+	const scene::Aabb EMPTY_AABB = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()) };
+}
+
+scene::Frustum scene::ExtractFrustum(const glm::mat4& view_projection_)
+{
+	// Rows of the column major matrix
+	glm::vec4 row_x(view_projection_[0][0], view_projection_[1][0], view_projection_[2][0], view_projection_[3][0]);
+	glm::vec4 row_y(view_projection_[0][1], view_projection_[1][1], view_projection_[2][1], view_projection_[3][1]);
+	glm::vec4 row_z(view_projection_[0][2], view_projection_[1][2], view_projection_[2][2], view_projection_[3][2]);
+	glm::vec4 row_w(view_projection_[0][3], view_projection_[1][3], view_projection_[2][3], view_projection_[3][3]);
+
+	Frustum frustum;
+	frustum.planes = { row_w + row_x, row_w - row_x, row_w + row_y, row_w - row_y, row_z, row_w - row_z };
+	for (auto& plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+	return frustum;
+}
+
+uint32_t scene::CullingScene::DenseIndex(CullHandle object_) const
+{
+	if (!IsValid(object_))
+		throw std::out_of_range("Stale or invalid culling object");
+	return m_slots[object_.index].dense_index;
+}
+
+bool scene::CullingScene::IsValid(CullHandle object_) const
+{
+	if (object_.index >= m_slots.size() || m_slots[object_.index].generation != object_.generation)
+		return false;
+
+	uint32_t dense_index = m_slots[object_.index].dense_index;
+	return dense_index < m_dense_slots.size() && m_dense_slots[dense_index] == object_.index;
+}
+
+void scene::CullingScene::SetDenseBounds(uint32_t index_, const Aabb& bounds_)
+{
+	glm::vec3 center = (bounds_.min + bounds_.max) * 0.5f;
+	glm::vec3 extent = (bounds_.max - bounds_.min) * 0.5f;
+	m_bounds[CenterX][index_] = center.x;
+	m_bounds[CenterY][index_] = center.y;
+	m_bounds[CenterZ][index_] = center.z;
+	m_bounds[ExtentX][index_] = extent.x;
+	m_bounds[ExtentY][index_] = extent.y;
+	m_bounds[ExtentZ][index_] = extent.z;
+}
+
+scene::Aabb scene::CullingScene::ObjectBounds(uint32_t index_) const
+{
+	glm::vec3 center(m_bounds[CenterX][index_], m_bounds[CenterY][index_], m_bounds[CenterZ][index_]);
+	glm::vec3 extent(m_bounds[ExtentX][index_], m_bounds[ExtentY][index_], m_bounds[ExtentZ][index_]);
+	return { center - extent, center + extent };
+}
+
+scene::CullHandle scene::CullingScene::Insert(const Aabb& bounds_, uint32_t id_)
+{
+	uint32_t slot = m_free_head;
+	if (slot == NO_CULL_ID)
+	{
+		slot = static_cast<uint32_t>(m_slots.size());
+		m_slots.push_back({ 0, 1 });
+	}
+	else
+	{
+		m_free_head = m_slots[slot].dense_index;
+	}
+
+	// New objects go to the tail behind the BVH objects
+	uint32_t index = static_cast<uint32_t>(m_ids.size());
+	m_slots[slot].dense_index = index;
+	for (auto& bounds : m_bounds)
+		bounds.push_back(0.0f);
+	SetDenseBounds(index, bounds_);
+	m_ids.push_back(id_);
+	m_leaves.push_back(NO_CULL_ID);
+	m_dense_slots.push_back(slot);
+
+	return { slot, m_slots[slot].generation };
+}
+
+void scene::CullingScene::Remove(CullHandle object_)
+{
+	if (!IsValid(object_))
+		return;
+
+	// The object keeps its place until the next rebuild, NaN bounds fail every plane test
+	uint32_t index = m_slots[object_.index].dense_index;
+	m_bounds[CenterX][index] = std::numeric_limits<float>::quiet_NaN();
+	m_ids[index] = NO_CULL_ID;
+	m_dense_slots[index] = NO_CULL_ID;
+	m_removed++;
+
+	if (++m_slots[object_.index].generation == 0)
+		m_slots[object_.index].generation = 1;
+	m_slots[object_.index].dense_index = m_free_head;
+	m_free_head = object_.index;
+}
+
+void scene::CullingScene::SetBounds(CullHandle object_, const Aabb& bounds_)
+{
+	uint32_t index = DenseIndex(object_);
+	SetDenseBounds(index, bounds_);
+
+	if (m_leaves[index] != NO_CULL_ID)
+	{
+		m_dirty_leaves[m_leaves[index]] = 1;
+		m_needs_refit = true;
+	}
+}
+
+uint32_t scene::CullingScene::Build(std::vector<uint32_t>& order_, uint32_t first_, uint32_t count_, uint32_t parent_)
+{
+	uint32_t node = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back({ EMPTY_AABB, first_, 0, 0, parent_ });
+
+	Aabb bounds = EMPTY_AABB;
+	Aabb centers = EMPTY_AABB;
+	for (uint32_t i = first_; i < first_ + count_; i++)
+	{
+		bounds = Merge(bounds, ObjectBounds(order_[i]));
+		glm::vec3 center(m_bounds[CenterX][order_[i]], m_bounds[CenterY][order_[i]], m_bounds[CenterZ][order_[i]]);
+		centers = Merge(centers, { center, center });
+	}
+	m_nodes[node].bounds = bounds;
+
+	if (count_ <= CULL_LEAF_SIZE)
+	{
+		m_nodes[node].count = count_;
+		return node;
+	}
+
+	// Median split on the longest axis of the centers
+	glm::vec3 size = centers.max - centers.min;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	const std::vector<float>& axis_centers = m_bounds[CenterX + axis];
+	uint32_t middle = first_ + count_ / 2;
+	std::nth_element(order_.begin() + first_, order_.begin() + middle, order_.begin() + first_ + count_,
+		[&axis_centers](uint32_t a_, uint32_t b_) { return axis_centers[a_] < axis_centers[b_]; });
+
+	Build(order_, first_, middle - first_, node);
+	uint32_t right = Build(order_, middle, first_ + count_ - middle, node);
+	m_nodes[node].right = right;
+	return node;
+}
+
+void scene::CullingScene::Rebuild()
+{
+	PROFILE_FUNCTION();
+
+	// Live objects in their future leaf order
+	std::vector<uint32_t> order;
+	order.reserve(Size());
+	for (uint32_t i = 0; i < m_ids.size(); i++)
+		if (m_ids[i] != NO_CULL_ID)
+			order.push_back(i);
+
+	m_nodes.clear();
+	if (!order.empty())
+		Build(order, 0, static_cast<uint32_t>(order.size()), NO_CULL_ID);
+
+	for (auto& bounds : m_bounds)
+	{
+		std::vector<float> sorted(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+			sorted[i] = bounds[order[i]];
+		bounds.swap(sorted);
+	}
+
+	std::vector<uint32_t> ids(order.size()), dense_slots(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		ids[i] = m_ids[order[i]];
+		dense_slots[i] = m_dense_slots[order[i]];
+		m_slots[dense_slots[i]].dense_index = static_cast<uint32_t>(i);
+	}
+	m_ids.swap(ids);
+	m_dense_slots.swap(dense_slots);
+
+	m_leaves.assign(order.size(), NO_CULL_ID);
+	for (uint32_t node = 0; node < m_nodes.size(); node++)
+		for (uint32_t i = 0; i < m_nodes[node].count; i++)
+			m_leaves[m_nodes[node].first + i] = node;
+
+	m_dirty_leaves.assign(m_nodes.size(), 0);
+	m_needs_refit = false;
+	m_removed = 0;
+	m_tree_objects = static_cast<uint32_t>(order.size());
+}
+
+void scene::CullingScene::Refit()
+{
+	PROFILE_FUNCTION();
+
+	// Children come after their parent, walking backwards visits them first
+	for (size_t node = m_nodes.size(); node-- > 0;)
+	{
+		Node& current = m_nodes[node];
+		if (current.count > 0)
+		{
+			if (!m_dirty_leaves[node])
+				continue;
+			current.bounds = EMPTY_AABB;
+			for (uint32_t i = current.first; i < current.first + current.count; i++)
+				if (m_ids[i] != NO_CULL_ID)
+					current.bounds = Merge(current.bounds, ObjectBounds(i));
+			m_dirty_leaves[node] = 0;
+		}
+		else
+		{
+			current.bounds = Merge(m_nodes[node + 1].bounds, m_nodes[current.right].bounds);
+		}
+	}
+	m_needs_refit = false;
+}
+
+void scene::CullingScene::CollectTasks(const Frustum& frustum_)
+{
+	m_tasks.clear();
+
+	// Walk down until subtrees are small enough to be one task each
+	std::vector<std::pair<uint32_t, uint32_t>>& stack = m_task_stack;
+	stack.clear();
+	if (!m_nodes.empty())
+		stack.push_back({ 0, m_tree_objects });
+	while (!stack.empty())
+	{
+		auto [node, objects] = stack.back();
+		stack.pop_back();
+		m_stats.nodes_visited++;
+
+		BoxResult result = TestBox(frustum_, m_nodes[node].bounds);
+		if (result == BoxOutside)
+			continue;
+		if (result == BoxInside || objects <= CULL_TASK_SIZE || m_nodes[node].count > 0)
+		{
+			m_tasks.push_back({ node, 0, objects, result == BoxInside });
+			continue;
+		}
+
+		// Inner nodes split their objects in half, see Build. The left half is popped first, tasks come in leaf order
+		uint32_t left = objects / 2;
+		stack.push_back({ m_nodes[node].right, objects - left });
+		stack.push_back({ node + 1, left });
+	}
+
+	for (uint32_t first = m_tree_objects; first < m_ids.size(); first += CULL_TASK_SIZE)
+		m_tasks.push_back({ NO_CULL_ID, first, (std::min)(CULL_TASK_SIZE, static_cast<uint32_t>(m_ids.size()) - first), false });
+}
+
+void scene::CullingScene::RunTask(const Frustum& frustum_, size_t task_)
+{
+	const Task& task = m_tasks[task_];
+	std::vector<uint32_t>& visible = m_task_visible[task_];
+	CullingStats& stats = m_task_stats[task_];
+	visible.clear();
+	visible.reserve(task.count); // Grows to the largest task once instead of to every new visible count
+	stats = {};
+
+	const float* bounds[BoundsArrayCount];
+	for (int i = 0; i < BoundsArrayCount; i++)
+		bounds[i] = m_bounds[i].data();
+
+	if (task.node == NO_CULL_ID)
+	{
+		TestObjects(frustum_, bounds, m_ids.data(), task.first, task.count, visible);
+		stats.objects_tested += task.count;
+		return;
+	}
+
+	// Depth first through the subtree, inside flags are inherited by all children
+	std::pair<uint32_t, bool> stack[64];
+	size_t depth = 0;
+	stack[depth++] = { task.node, task.inside };
+	while (depth > 0)
+	{
+		auto [node, inside] = stack[--depth];
+		const Node& current = m_nodes[node];
+		if (!inside)
+		{
+			stats.nodes_visited++;
+			BoxResult result = TestBox(frustum_, current.bounds);
+			if (result == BoxOutside)
+				continue;
+			inside = result == BoxInside;
+		}
+
+		if (current.count == 0)
+		{
+			stack[depth++] = { current.right, inside };
+			stack[depth++] = { node + 1, inside };
+			continue;
+		}
+
+		if (inside)
+		{
+			for (uint32_t i = current.first; i < current.first + current.count; i++)
+				if (m_ids[i] != NO_CULL_ID)
+					visible.push_back(m_ids[i]);
+			stats.objects_accepted += current.count;
+		}
+		else
+		{
+			TestObjects(frustum_, bounds, m_ids.data(), current.first, current.count, visible);
+			stats.objects_tested += current.count;
+		}
+	}
+}
+
+void scene::CullingScene::Cull(const Frustum& frustum_, std::pmr::vector<uint32_t>& visible_, ecs::Scheduler* scheduler_)
+{
+	PROFILE_FUNCTION();
+
+	// A large unsorted tail or many holes make the tree worse than a rebuild
+	size_t tail = m_ids.size() - m_tree_objects;
+	if ((tail > CULL_TASK_SIZE && tail > m_tree_objects / 4) || m_removed > m_ids.size() / 4)
+		Rebuild();
+	if (m_needs_refit)
+		Refit();
+
+	m_stats = {};
+	CollectTasks(frustum_);
+	if (m_task_visible.size() < m_tasks.size())
+		m_task_visible.resize(m_tasks.size());
+	m_task_stats.resize(m_tasks.size());
+
+	if (scheduler_ != nullptr)
+		scheduler_->ParallelFor(m_tasks.size(), [this, &frustum_](size_t task_) { RunTask(frustum_, task_); });
+	else
+		for (size_t i = 0; i < m_tasks.size(); i++)
+			RunTask(frustum_, i);
+
+	// Compact the task results in task order
+	size_t visible_count = 0;
+	for (size_t i = 0; i < m_tasks.size(); i++)
+		visible_count += m_task_visible[i].size();
+	visible_.clear();
+	visible_.reserve(visible_count);
+	for (size_t i = 0; i < m_tasks.size(); i++)
+	{
+		visible_.insert(visible_.end(), m_task_visible[i].begin(), m_task_visible[i].end());
+		m_stats.nodes_visited += m_task_stats[i].nodes_visited;
+		m_stats.objects_tested += m_task_stats[i].objects_tested;
+		m_stats.objects_accepted += m_task_stats[i].objects_accepted;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "glm.hpp"
+
+#include "../memory/MemoryPool.h"
+#include "../ecs/EcsScheduler.h"
+
+namespace scene
+{
+	constexpr uint32_t CULL_LEAF_SIZE = 64; // Objects per BVH leaf
+	constexpr uint32_t CULL_TASK_SIZE = 16384; // Objects per worker task, smaller subtrees are not split further
+	constexpr uint32_t NO_CULL_ID = 0xFFFFFFFF;
+
+	struct Aabb
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// Planes point inwards, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+	struct Frustum
+	{
+		std::array<glm::vec4, 6> planes;
+	};
+
+	// Planes of a Vulkan projection * view matrix (clip depth 0 to w)
+	Frustum ExtractFrustum(const glm::mat4& view_projection_);
+
+	struct CullingStats
+	{
+		size_t nodes_visited = 0;
+		size_t objects_tested = 0;
+		size_t objects_accepted = 0; // Taken without a test, their leaf was fully inside
+	};
+
+	struct CullObject;
+	using CullHandle = memory::Handle<CullObject>;
+
+	// Bounding boxes kept as center/extent arrays in BVH leaf order, tested 4 (SSE) or 8 (AVX) at a time.
+	// Moving an object refits its leaf on the next Cull, objects inserted after the last Rebuild are tested linearly
+	// until enough of them piled up for an automatic rebuild
+	class CullingScene
+	{
+		// VARIABLES
+	private:
+		enum BoundsArray
+		{
+			CenterX,
+			CenterY,
+			CenterZ,
+			ExtentX,
+			ExtentY,
+			ExtentZ,
+			BoundsArrayCount
+		};
+
+		struct Node
+		{
+			Aabb bounds;
+			uint32_t first; // First object of a leaf
+			uint32_t count; // Objects of a leaf, 0 for inner nodes
+			uint32_t right; // Right child of an inner node, the left one follows the node directly
+			uint32_t parent;
+		};
+
+		struct Slot
+		{
+			uint32_t dense_index; // Next free slot while the slot is free
+			uint32_t generation;
+		};
+
+		struct Task
+		{
+			uint32_t node; // NO_CULL_ID for a range of the unsorted tail
+			uint32_t first;
+			uint32_t count;
+			bool inside; // Node known to be fully inside, accept everything
+		};
+
+		std::array<std::vector<float>, BoundsArrayCount> m_bounds;
+		std::vector<uint32_t> m_ids; // Caller id of every object, NO_CULL_ID once removed
+		std::vector<uint32_t> m_leaves; // Leaf node of every object, NO_CULL_ID in the tail
+		std::vector<uint32_t> m_dense_slots;
+		std::vector<Slot> m_slots;
+		uint32_t m_free_head = NO_CULL_ID;
+		size_t m_removed = 0;
+
+		std::vector<Node> m_nodes; // Depth first, children after their parent
+		std::vector<uint8_t> m_dirty_leaves;
+		bool m_needs_refit = false;
+		uint32_t m_tree_objects = 0; // Objects covered by the BVH, the rest form the tail
+
+		std::vector<Task> m_tasks;
+		std::vector<std::pair<uint32_t, uint32_t>> m_task_stack; // Node and its object count, kept like the task results
+		std::vector<std::vector<uint32_t>> m_task_visible; // Kept between culls to avoid allocations
+		std::vector<CullingStats> m_task_stats;
+		CullingStats m_stats;
+
+		// METHODES
+	private:
+		uint32_t DenseIndex(CullHandle object_) const;
+		void SetDenseBounds(uint32_t index_, const Aabb& bounds_);
+		Aabb ObjectBounds(uint32_t index_) const;
+		uint32_t Build(std::vector<uint32_t>& order_, uint32_t first_, uint32_t count_, uint32_t parent_);
+		void Refit();
+		void CollectTasks(const Frustum& frustum_);
+		void RunTask(const Frustum& frustum_, size_t task_);
+
+	public:
+		CullHandle Insert(const Aabb& bounds_, uint32_t id_); // id_ is what Cull reports for the object
+		void Remove(CullHandle object_);
+		void SetBounds(CullHandle object_, const Aabb& bounds_);
+		bool IsValid(CullHandle object_) const;
+
+		// Rebuilds the BVH over every object, also drops removed objects
+		void Rebuild();
+
+		// Replaces visible_ with the ids of all objects intersecting the frustum, ordered by BVH leaf.
+		// Runs on the scheduler workers when one is given. visible_ grows once, e.g. inside the frame arena
+		void Cull(const Frustum& frustum_, std::pmr::vector<uint32_t>& visible_, ecs::Scheduler* scheduler_ = nullptr);
+
+		size_t Size() const { return m_ids.size() - m_removed; }
+		const CullingStats& Stats() const { return m_stats; } // Of the last Cull
+	};
+}
\ No newline at end of file
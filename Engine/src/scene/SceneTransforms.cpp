@@ -0,0 +1,286 @@
+#include "SceneTransforms.h"
+
+#include <stdexcept>
+
+#include "simd/matrix.h"
+#include "../profiling/ProfilingZones.h"
+
+namespace
+{
+	// world_ = parent_ * local_ for column major matrices. Builds with AVX enabled (/arch:AVX) compute two columns
+	// per instruction, x64 builds otherwise use the SSE multiply of glm
+	inline void MultiplyMatrix(const glm::mat4& parent_, const glm::mat4& local_, glm::mat4& world_)
+	{
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+		const float* a = &parent_[0][0];
+		const float* b = &local_[0][0];
+		float* out = &world_[0][0];
+
+		// Both 128 bit lanes hold the same parent column, each lane of b one local column
+		__m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 0));
+		__m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+		__m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+		__m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+		for (int column = 0; column < 4; column += 2)
+		{
+			__m256 b01 = _mm256_loadu_ps(b + column * 4);
+			__m256 result = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+			result = _mm256_add_ps(result, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+			result = _mm256_add_ps(result, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+			result = _mm256_add_ps(result, _mm256_mul_ps(a3, _mm256_permute_ps(b01, 0xFF)));
+			_mm256_storeu_ps(out + column * 4, result);
+		}
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		glm_vec4 a[4], b[4], out[4];
+		for (int column = 0; column < 4; column++)
+		{
+			a[column] = _mm_loadu_ps(&parent_[column][0]);
+			b[column] = _mm_loadu_ps(&local_[column][0]);
+		}
+		glm_mat4_mul(a, b, out);
+		for (int column = 0; column < 4; column++)
+			_mm_storeu_ps(&world_[column][0], out[column]);
+#else
+		world_ = parent_ * local_;
+#endif
+	}
+}
+
+uint32_t scene::TransformHierarchy::DenseIndex(NodeHandle node_) const
+{
+	if (!IsValid(node_))
+		throw std::out_of_range("Stale or invalid transform node");
+	return m_slots[node_.index].dense_index;
+}
+
+bool scene::TransformHierarchy::IsValid(NodeHandle node_) const
+{
+	if (node_.index >= m_slots.size() || m_slots[node_.index].generation != node_.generation)
+		return false;
+
+	uint32_t dense_index = m_slots[node_.index].dense_index;
+	return dense_index < m_dense_slots.size() && m_dense_slots[dense_index] == node_.index;
+}
+
+void scene::TransformHierarchy::FreeSlot(uint32_t slot_)
+{
+	// Generation 0 is never handed out, see memory::Handle
+	if (++m_slots[slot_].generation == 0)
+		m_slots[slot_].generation = 1;
+	m_slots[slot_].dense_index = m_free_head;
+	m_free_head = slot_;
+}
+
+scene::NodeHandle scene::TransformHierarchy::Create(NodeHandle parent_, const glm::mat4& local_)
+{
+	uint32_t parent = parent_.IsNull() ? NO_PARENT : DenseIndex(parent_);
+
+	uint32_t slot = m_free_head;
+	if (slot == NO_PARENT)
+	{
+		slot = static_cast<uint32_t>(m_slots.size());
+		m_slots.push_back({ 0, 1 });
+	}
+	else
+	{
+		m_free_head = m_slots[slot].dense_index;
+	}
+
+	// Appending keeps the order, the parent is already in the arrays
+	m_slots[slot].dense_index = static_cast<uint32_t>(m_local.size());
+	m_local.push_back(local_);
+	m_world.push_back(local_);
+	m_parent.push_back(parent);
+	m_dirty.push_back(1);
+	m_world_changed.push_back(0);
+	m_removed.push_back(0);
+	m_dense_slots.push_back(slot);
+
+	return { slot, m_slots[slot].generation };
+}
+
+void scene::TransformHierarchy::Destroy(NodeHandle node_)
+{
+	if (!IsValid(node_))
+		return;
+
+	uint32_t index = m_slots[node_.index].dense_index;
+	FreeSlot(node_.index);
+	m_dense_slots[index] = NO_PARENT;
+	m_removed[index] = 1;
+	m_needs_compact = true;
+}
+
+void scene::TransformHierarchy::SetParent(NodeHandle node_, NodeHandle parent_)
+{
+	uint32_t index = DenseIndex(node_);
+	uint32_t parent = parent_.IsNull() ? NO_PARENT : DenseIndex(parent_);
+
+	for (uint32_t ancestor = parent; ancestor != NO_PARENT; ancestor = m_parent[ancestor])
+		if (ancestor == index)
+			throw std::invalid_argument("Transform node cannot become a child of its own subtree");
+
+	m_parent[index] = parent;
+	m_dirty[index] = 1;
+	if (parent != NO_PARENT && parent > index)
+		m_needs_sort = true;
+}
+
+void scene::TransformHierarchy::SetLocal(NodeHandle node_, const glm::mat4& local_)
+{
+	uint32_t index = DenseIndex(node_);
+	m_local[index] = local_;
+	m_dirty[index] = 1;
+}
+
+void scene::TransformHierarchy::SetLocal(NodeHandle node_, const glm::vec3& position_, const glm::quat& rotation_, const glm::vec3& scale_)
+{
+	// Translation * rotation * scale without the full matrix products
+	glm::mat3 rotation = glm::mat3_cast(rotation_);
+	SetLocal(node_, glm::mat4(
+		glm::vec4(rotation[0] * scale_.x, 0.0f),
+		glm::vec4(rotation[1] * scale_.y, 0.0f),
+		glm::vec4(rotation[2] * scale_.z, 0.0f),
+		glm::vec4(position_, 1.0f)));
+}
+
+void scene::TransformHierarchy::Compact()
+{
+	PROFILE_FUNCTION();
+	const size_t count = m_local.size();
+	std::vector<uint32_t> remap(count);
+	uint32_t kept = 0;
+
+	// m_removed keeps the old indices during the pass, parents are visited before their children
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t parent = m_parent[i];
+		if (parent != NO_PARENT && m_removed[parent])
+			m_removed[i] = 1;
+
+		if (m_removed[i])
+		{
+			if (m_dense_slots[i] != NO_PARENT)
+				FreeSlot(m_dense_slots[i]);
+			remap[i] = NO_PARENT;
+			continue;
+		}
+
+		remap[i] = kept;
+		m_local[kept] = m_local[i];
+		m_world[kept] = m_world[i];
+		m_parent[kept] = parent == NO_PARENT ? NO_PARENT : remap[parent];
+		m_dirty[kept] = m_dirty[i];
+		m_world_changed[kept] = m_world_changed[i];
+		m_dense_slots[kept] = m_dense_slots[i];
+		m_slots[m_dense_slots[kept]].dense_index = kept;
+		kept++;
+	}
+
+	m_local.resize(kept);
+	m_world.resize(kept);
+	m_parent.resize(kept);
+	m_dirty.resize(kept);
+	m_world_changed.resize(kept);
+	m_dense_slots.resize(kept);
+	m_removed.assign(kept, 0);
+	m_needs_compact = false;
+}
+
+void scene::TransformHierarchy::Sort()
+{
+	PROFILE_FUNCTION();
+	const uint32_t count = static_cast<uint32_t>(m_local.size());
+
+	// Children of every node in one array, offsets by parent
+	std::vector<uint32_t> child_offsets(count + 1, 0);
+	for (uint32_t i = 0; i < count; i++)
+		if (m_parent[i] != NO_PARENT)
+			child_offsets[m_parent[i] + 1]++;
+	for (uint32_t i = 0; i < count; i++)
+		child_offsets[i + 1] += child_offsets[i];
+	std::vector<uint32_t> children(child_offsets[count]);
+	std::vector<uint32_t> fill(child_offsets.begin(), child_offsets.end() - 1);
+	for (uint32_t i = 0; i < count; i++)
+		if (m_parent[i] != NO_PARENT)
+			children[fill[m_parent[i]]++] = i;
+
+	// Depth first from every root, children in their previous relative order
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> stack;
+	order.reserve(count);
+	for (uint32_t root = 0; root < count; root++)
+	{
+		if (m_parent[root] != NO_PARENT)
+			continue;
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			uint32_t node = stack.back();
+			stack.pop_back();
+			order.push_back(node);
+			for (uint32_t child = child_offsets[node + 1]; child > child_offsets[node]; child--)
+				stack.push_back(children[child - 1]);
+		}
+	}
+
+	std::vector<uint32_t> remap(count);
+	for (uint32_t i = 0; i < count; i++)
+		remap[order[i]] = i;
+
+	std::vector<glm::mat4> local(count), world(count);
+	std::vector<uint32_t> parent(count), dense_slots(count);
+	std::vector<uint8_t> dirty(count), world_changed(count), removed(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t old = order[i];
+		local[i] = m_local[old];
+		world[i] = m_world[old];
+		parent[i] = m_parent[old] == NO_PARENT ? NO_PARENT : remap[m_parent[old]];
+		dirty[i] = m_dirty[old];
+		world_changed[i] = m_world_changed[old];
+		removed[i] = m_removed[old];
+		dense_slots[i] = m_dense_slots[old];
+		if (dense_slots[i] != NO_PARENT)
+			m_slots[dense_slots[i]].dense_index = i;
+	}
+
+	m_local.swap(local);
+	m_world.swap(world);
+	m_parent.swap(parent);
+	m_dirty.swap(dirty);
+	m_world_changed.swap(world_changed);
+	m_removed.swap(removed);
+	m_dense_slots.swap(dense_slots);
+	m_needs_sort = false;
+}
+
+size_t scene::TransformHierarchy::Update()
+{
+	PROFILE_FUNCTION();
+	if (m_needs_sort)
+		Sort();
+	if (m_needs_compact)
+		Compact();
+
+	size_t updated = 0;
+	const size_t count = m_local.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		// The parent was handled earlier in this pass
+		uint32_t parent = m_parent[i];
+		uint8_t dirty = m_dirty[i] | (parent != NO_PARENT ? m_world_changed[parent] : 0);
+		m_world_changed[i] = dirty;
+		if (!dirty)
+			continue;
+
+		m_dirty[i] = 0;
+		if (parent == NO_PARENT)
+			m_world[i] = m_local[i];
+		else
+			MultiplyMatrix(m_world[parent], m_local[i], m_world[i]);
+		updated++;
+	}
+
+	return updated;
+}
\ No newline at end of file
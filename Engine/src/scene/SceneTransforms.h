@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.hpp"
+#include "gtc/quaternion.hpp"
+
+#include "../memory/MemoryPool.h"
+
+namespace scene
+{
+	struct TransformNode;
+	using NodeHandle = memory::Handle<TransformNode>;
+
+	constexpr uint32_t NO_PARENT = 0xFFFFFFFF;
+
+	// Transform hierarchy kept in parent before child order in flat arrays, so Update computes every world matrix
+	// in one linear pass. Only nodes whose local matrix or ancestor changed are multiplied, static subtrees cost a byte test
+	class TransformHierarchy
+	{
+		// VARIABLES
+	private:
+		struct Slot
+		{
+			uint32_t dense_index; // Next free slot while the slot is free
+			uint32_t generation;
+		};
+
+		// Dense arrays, index order is parent before child
+		std::vector<glm::mat4> m_local;
+		std::vector<glm::mat4> m_world;
+		std::vector<uint32_t> m_parent; // Dense index of the parent, NO_PARENT for roots
+		std::vector<uint8_t> m_dirty; // Local matrix or parent changed since the last update
+		std::vector<uint8_t> m_world_changed; // World matrix was recomputed by the last update
+		std::vector<uint8_t> m_removed;
+		std::vector<uint32_t> m_dense_slots; // Slot of every dense node, NO_PARENT once destroyed
+
+		std::vector<Slot> m_slots;
+		uint32_t m_free_head = NO_PARENT;
+
+		bool m_needs_sort = false; // A reparent broke the parent before child order
+		bool m_needs_compact = false;
+
+		// CONSTRUCTORS/DESTRUCTORS
+	public:
+		TransformHierarchy() = default;
+
+		// METHODES
+	private:
+		uint32_t DenseIndex(NodeHandle node_) const; // Throws on stale handles
+		void FreeSlot(uint32_t slot_);
+		void Compact(); // Drops destroyed nodes and their descendants
+		void Sort(); // Restores parent before child order, depth first so subtrees stay contiguous
+
+	public:
+		NodeHandle Create(NodeHandle parent_ = {}, const glm::mat4& local_ = glm::mat4(1.0f));
+		// Children are destroyed with their parent, their handles stay valid until the next Update
+		void Destroy(NodeHandle node_);
+		bool IsValid(NodeHandle node_) const;
+
+		void SetParent(NodeHandle node_, NodeHandle parent_); // Null parent_ makes the node a root
+		void SetLocal(NodeHandle node_, const glm::mat4& local_);
+		void SetLocal(NodeHandle node_, const glm::vec3& position_, const glm::quat& rotation_, const glm::vec3& scale_);
+
+		const glm::mat4& Local(NodeHandle node_) const { return m_local[DenseIndex(node_)]; }
+		const glm::mat4& World(NodeHandle node_) const { return m_world[DenseIndex(node_)]; }
+		bool WorldChanged(NodeHandle node_) const { return m_world_changed[DenseIndex(node_)] != 0; }
+
+		// Reorders the nodes depth first on the next Update so every subtree is contiguous in memory,
+		// worth calling once after building or loading a scene in arbitrary order
+		void SortDepthFirst() { m_needs_sort = true; }
+
+		// Recomputes the world matrices of every dirty node and its descendants, returns the number of recomputed nodes
+		size_t Update();
+
+		size_t Size() const { return m_local.size(); }
+		// Dense access for systems consuming the results, valid until the next Create, Destroy, SetParent or Update
+		const glm::mat4* WorldMatrices() const { return m_world.data(); }
+		const uint8_t* WorldChangedFlags() const { return m_world_changed.data(); }
+	};
+}
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 void sound::SoundManager::Initialize()
 {
+	PROFILE_FUNCTION();
+	m_voices_metric = &profiling::Metrics().AddGauge("sound_active_voices", "Sound streams currently playing");
+	m_streams_started_metric = &profiling::Metrics().AddCounter("sound_streams_started_total", "Sound streams started");
+
 	if (!BASS_Init(-1, 44100, BASS_DEVICE_3D, 0, NULL))
 	{
 		m_initialized = false;
@@ -13,30 +17,74 @@ void sound::SoundManager::Initialize()
 
 void sound::SoundManager::Shutdown()
 {
+	for (const auto& sound : m_sounds)
+		BASS_StreamFree(sound.stream_handle);
+
 	BASS_Stop();
 	BASS_Free();
 }
 
-void sound::SoundManager::Play(Sound& sound_)
+sound::SoundHandle sound::SoundManager::CreateSound(const std::string& file_name_)
 {
+	PROFILE_FUNCTION();
 	if (!m_initialized)
+		return {};
+
+	memory::AssetFile file(m_package.get(), file_name_);
+	HSTREAM hstream = BASS_StreamCreateFile(TRUE, file.Data(), 0, file.Size(), 0);
+	if (hstream == 0)
+		throw std::runtime_error("Failed to create sound stream for " + file_name_ + ", error: " + std::to_string(BASS_ErrorGetCode()));
+
+	return m_sounds.Create(file_name_, hstream, std::move(file));
+}
+
+void sound::SoundManager::DestroySound(SoundHandle sound_)
+{
+	Sound* sound = m_sounds.Get(sound_);
+	if (sound == nullptr)
 		return;
 
-	HSTREAM hstream = BASS_StreamCreateFile(FALSE, sound_.file_name.c_str(), 0, 0, 0);
-	BASS_ChannelPlay(hstream, FALSE);
-	sound_.stream_handle = hstream;
+	BASS_StreamFree(sound->stream_handle);
+	m_sounds.Destroy(sound_);
+	UpdateVoices();
 }
 
-void sound::SoundManager::Stop(Sound& sound_)
+void sound::SoundManager::Play(SoundHandle sound_)
 {
-	if (!m_initialized)
+	PROFILE_FUNCTION();
+	Sound* sound = m_sounds.Get(sound_);
+	if (!m_initialized || sound == nullptr)
 		return;
 
-	BASS_ChannelStop(sound_.stream_handle);
+	BASS_ChannelPlay(sound->stream_handle, TRUE);
+
+	if (std::find(m_voices.begin(), m_voices.end(), sound->stream_handle) == m_voices.end())
+		m_voices.push_back(sound->stream_handle);
+	m_streams_started_metric->Add();
+	UpdateVoices();
+}
+
+void sound::SoundManager::Stop(SoundHandle sound_)
+{
+	PROFILE_FUNCTION();
+	Sound* sound = m_sounds.Get(sound_);
+	if (!m_initialized || sound == nullptr)
+		return;
+
+	BASS_ChannelStop(sound->stream_handle);
+	UpdateVoices();
+}
+
+void sound::SoundManager::UpdateVoices()
+{
+	m_voices.erase(std::remove_if(m_voices.begin(), m_voices.end(),
+		[](HSTREAM stream_) { return BASS_ChannelIsActive(stream_) == BASS_ACTIVE_STOPPED; }), m_voices.end());
+	m_voices_metric->Set(static_cast<double>(m_voices.size()));
 }
 
 void sound::SoundManager::SetVolume(float volume_)
 {
+	PROFILE_FUNCTION();
 	if (!m_initialized)
 		return;
 
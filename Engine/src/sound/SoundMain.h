@@ -1,8 +1,16 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 
 #include "bass.h"
+#include "../profiling/ProfilingZones.h"
+#include "../profiling/ProfilingMetrics.h"
+#include "../memory/MemoryPool.h"
+#include "../memory/MemoryPackage.h"
 
 namespace sound
 {
@@ -10,17 +18,26 @@ namespace sound
 	{
 		std::string file_name;
 		HSTREAM stream_handle;
+		memory::AssetFile file; // BASS decodes the stream from this memory
 	};
 
+	using SoundHandle = memory::Handle<Sound>;
+
 	class SoundManager
 	{
 		// VARIABLES
 	private:
 		bool m_initialized = false;
 
+		std::shared_ptr<const memory::Package> m_package;
+		memory::Pool<Sound> m_sounds; // One stream per sound, replaying restarts it
+		std::vector<HSTREAM> m_voices; // Streams started by Play, pruned once BASS reports them stopped
+		profiling::Gauge* m_voices_metric = nullptr;
+		profiling::Counter* m_streams_started_metric = nullptr;
+
 		// CONSTRUCTORS/DESTRUCTORS
 	public:
-		SoundManager() { Initialize(); }
+		SoundManager(std::shared_ptr<const memory::Package> package_ = nullptr) : m_package(package_) { Initialize(); }
 		~SoundManager() { Shutdown(); }
 
 		// METHODES
@@ -29,8 +46,14 @@ namespace sound
 		void Shutdown();
 
 	public:
-		void Play(Sound& sound_);
-		void Stop(Sound& sound_);
+		// Frame boundary, called by the engine. Prunes the streams that ended on their own from the active voices
+		void UpdateVoices();
+
+		SoundHandle CreateSound(const std::string& file_name_); // From the package if it has the file, else the loose file
+		void DestroySound(SoundHandle sound_);
+
+		void Play(SoundHandle sound_);
+		void Stop(SoundHandle sound_);
 		void SetVolume(float volume_); // Volume range from 0 (no sound) to 1 (maximum)
 	};
 }
\ No newline at end of file
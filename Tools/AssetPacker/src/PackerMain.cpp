@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "memory/MemoryPackage.h"
+
+namespace
+{
+	volatile size_t g_benchmark_sink = 0; // Keeps the benchmarked work from being optimized away
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: AssetPacker <output.pack> <file|directory>... [options]\n"
+			<< "  Entries are named by the paths as given, run it from the directory the engine starts in\n"
+			<< "  --compress          LZ4 compress entries that shrink by at least an eighth, mesh and KTX2 files stay\n"
+			<< "                      uncompressed so the engine reads them in place\n"
+			<< "  --benchmark <runs>  Compare loading every entry from the loose files against the package\n";
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string& file_name_)
+	{
+		std::ifstream input_file(file_name_, std::ios::binary | std::ios::ate);
+		if (!input_file.is_open())
+			throw std::runtime_error("Unable to open " + file_name_);
+
+		std::vector<uint8_t> data(static_cast<size_t>(input_file.tellg()));
+		input_file.seekg(0);
+		input_file.read(reinterpret_cast<char*>(data.data()), data.size());
+		return data;
+	}
+
+	void AddInput(const std::filesystem::path& input_, std::vector<std::string>& paths_)
+	{
+		if (std::filesystem::is_regular_file(input_))
+		{
+			paths_.push_back(input_.generic_string());
+			return;
+		}
+		if (!std::filesystem::is_directory(input_))
+			throw std::runtime_error("No such file or directory: " + input_.string());
+
+		for (const auto& item : std::filesystem::recursive_directory_iterator(input_))
+			if (item.is_regular_file())
+				paths_.push_back(item.path().generic_string());
+	}
+
+	bool ReadInPlace(const std::string& path_)
+	{
+		std::string extension = std::filesystem::path(path_).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c_) { return static_cast<char>(std::tolower(c_)); });
+		return extension == ".mesh" || extension == ".ktx2";
+	}
+
+	double ElapsedMs(std::chrono::steady_clock::time_point start_)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+	}
+
+	template<typename Function>
+	double MedianMs(size_t runs_, Function function_)
+	{
+		std::vector<double> times;
+		for (size_t i = 0; i < runs_; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			function_();
+			times.push_back(ElapsedMs(start));
+		}
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	// Both sides end with every asset copied into a staging buffer like an upload would, the file cache is warm.
+	// Loose files are read the way the shader manager read them before packages
+	void RunBenchmark(const std::string& package_, const std::vector<std::string>& paths_, size_t runs_)
+	{
+		std::vector<uint8_t> staging;
+		double loose_ms = MedianMs(runs_, [&]()
+		{
+			for (const std::string& path : paths_)
+			{
+				std::fstream input_file(path, std::ios::binary | std::ios::ate | std::ios::in);
+				std::vector<char> data(static_cast<size_t>(input_file.tellg()));
+				input_file.seekg(0);
+				input_file.read(data.data(), data.size());
+				staging.resize(data.size());
+				if (!data.empty())
+					std::memcpy(staging.data(), data.data(), data.size());
+				g_benchmark_sink = g_benchmark_sink + staging.size();
+			}
+		});
+
+		double packed_ms = MedianMs(runs_, [&]()
+		{
+			memory::Package package(package_);
+			for (const std::string& path : paths_)
+			{
+				memory::AssetFile file(&package, path);
+				staging.resize(file.Size());
+				if (file.Size() > 0)
+					std::memcpy(staging.data(), file.Data(), file.Size());
+				g_benchmark_sink = g_benchmark_sink + staging.size();
+			}
+		});
+
+		std::cout << "Benchmark (median of " << runs_ << " runs, " << paths_.size() << " assets)\n"
+			<< "  loose files: " << loose_ms << " ms\n"
+			<< "  map " << package_ << " and look up every entry: " << packed_ms << " ms\n"
+			<< "  speedup: " << loose_ms / packed_ms << "x" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		std::string output = argv[1];
+		std::vector<std::string> paths;
+		bool compress = false;
+		size_t benchmark_runs = 0;
+
+		for (int i = 2; i < argc; i++)
+		{
+			std::string option = argv[i];
+			bool has_value = i + 1 < argc;
+			if (option == "--compress")
+				compress = true;
+			else if (option == "--benchmark" && has_value)
+				benchmark_runs = std::stoul(argv[++i]);
+			else if (option.rfind("--", 0) == 0)
+			{
+				PrintUsage();
+				return 1;
+			}
+			else
+				AddInput(option, paths);
+		}
+
+		// Sorted input keeps the package identical between runs
+		std::sort(paths.begin(), paths.end());
+		paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+		paths.erase(std::remove(paths.begin(), paths.end(), std::filesystem::path(output).generic_string()), paths.end());
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<memory::PackageFile> files;
+		for (const std::string& path : paths)
+			files.push_back({ path, ReadFile(path), compress && !ReadInPlace(path) });
+
+		memory::PackageWriteStats stats = memory::WritePackage(output, files);
+		std::cout << output << ": " << stats.entries << " entries, " << stats.compressed_entries << " compressed, "
+			<< stats.shared_entries << " sharing the data of an equal entry\n"
+			<< "  " << stats.input_bytes << " bytes of assets in " << stats.file_bytes << " bytes, packed in " << ElapsedMs(start) << " ms" << std::endl;
+
+		if (benchmark_runs > 0)
+			RunBenchmark(output, paths, benchmark_runs);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "AssetPacker failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
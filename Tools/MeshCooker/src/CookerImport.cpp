@@ -0,0 +1,770 @@
+#include "CookerImport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "gtc/quaternion.hpp"
+#include "gtc/type_ptr.hpp"
+
+namespace
+{
+	std::string ReadFile(const std::string& file_name_)
+	{
+		std::ifstream file(file_name_, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			throw std::runtime_error("Unable to open " + file_name_);
+
+		std::string data(static_cast<size_t>(file.tellg()), '\0');
+		file.seekg(0);
+		file.read(&data[0], data.size());
+		return data;
+	}
+
+	std::string Extension(const std::string& file_name_)
+	{
+		size_t dot = file_name_.find_last_of('.');
+		std::string extension = dot == std::string::npos ? "" : file_name_.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c_) { return static_cast<char>(std::tolower(c_)); });
+		return extension;
+	}
+
+	std::string Directory(const std::string& file_name_)
+	{
+		size_t slash = file_name_.find_last_of("/\\");
+		return slash == std::string::npos ? "" : file_name_.substr(0, slash + 1);
+	}
+
+	glm::vec4 DefaultValue(graphics::VertexSemantic semantic_)
+	{
+		return semantic_ == graphics::SemanticColor ? glm::vec4(1.0f) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	// OBJ
+
+	struct ObjCorner
+	{
+		int position;
+		int tex_coord;
+		int normal;
+
+		bool operator==(const ObjCorner& other_) const
+		{
+			return position == other_.position && tex_coord == other_.tex_coord && normal == other_.normal;
+		}
+	};
+
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner& corner_) const
+		{
+			return (static_cast<size_t>(corner_.position) * 73856093) ^ (static_cast<size_t>(corner_.tex_coord) * 19349663) ^ (static_cast<size_t>(corner_.normal) * 83492791);
+		}
+	};
+
+	const char* SkipSpaces(const char* p_, const char* end_)
+	{
+		while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r'))
+			p_++;
+		return p_;
+	}
+
+	// Reads up to max_count_ floats until the end of the line
+	int ParseFloats(const char*& p_, const char* end_, float* values_, int max_count_)
+	{
+		int count = 0;
+		while (count < max_count_)
+		{
+			p_ = SkipSpaces(p_, end_);
+			if (p_ >= end_ || *p_ == '\n' || *p_ == '#')
+				break;
+			char* next = nullptr;
+			values_[count++] = std::strtof(p_, &next);
+			if (next == p_)
+				throw std::runtime_error("Malformed number in OBJ file");
+			p_ = next;
+		}
+		return count;
+	}
+
+	// 1 based index, negative indices count back from the last element, 0 if the index is missing
+	int ParseObjIndex(const char*& p_, int element_count_)
+	{
+		if (*p_ == '/')
+			return 0;
+		char* next = nullptr;
+		long index = std::strtol(p_, &next, 10);
+		if (next == p_)
+			throw std::runtime_error("Malformed face index in OBJ file");
+		p_ = next;
+		if (index < 0)
+			index += element_count_ + 1;
+		if (index <= 0 || index > element_count_)
+			throw std::runtime_error("Face index out of range in OBJ file");
+		return static_cast<int>(index);
+	}
+
+	// glTF
+
+	struct JsonValue
+	{
+		enum Type { Null, Bool, Number, String, Array, Object };
+
+		Type type = Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<JsonValue> array;
+		std::vector<std::pair<std::string, JsonValue>> object;
+
+		const JsonValue* Find(const std::string& key_) const
+		{
+			for (const auto& member : object)
+				if (member.first == key_)
+					return &member.second;
+			return nullptr;
+		}
+
+		const JsonValue& At(const std::string& key_) const
+		{
+			const JsonValue* value = Find(key_);
+			if (value == nullptr)
+				throw std::runtime_error("glTF is missing \"" + key_ + "\"");
+			return *value;
+		}
+
+		const JsonValue& At(size_t index_) const
+		{
+			if (type != Array || index_ >= array.size())
+				throw std::runtime_error("glTF index out of range");
+			return array[index_];
+		}
+
+		double NumberOr(const std::string& key_, double default_) const
+		{
+			const JsonValue* value = Find(key_);
+			return value != nullptr && value->type == Number ? value->number : default_;
+		}
+	};
+
+	class JsonParser
+	{
+	private:
+		const char* m_p;
+		const char* m_end;
+
+		void SkipWhitespace()
+		{
+			while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+				m_p++;
+		}
+
+		void Expect(char c_)
+		{
+			SkipWhitespace();
+			if (m_p >= m_end || *m_p != c_)
+				throw std::runtime_error(std::string("Malformed glTF JSON, expected '") + c_ + "'");
+			m_p++;
+		}
+
+		bool Consume(const char* literal_)
+		{
+			size_t length = std::strlen(literal_);
+			if (static_cast<size_t>(m_end - m_p) < length || std::strncmp(m_p, literal_, length) != 0)
+				return false;
+			m_p += length;
+			return true;
+		}
+
+		static void AppendUtf8(std::string& out_, uint32_t code_)
+		{
+			if (code_ < 0x80)
+				out_ += static_cast<char>(code_);
+			else if (code_ < 0x800)
+			{
+				out_ += static_cast<char>(0xC0 | (code_ >> 6));
+				out_ += static_cast<char>(0x80 | (code_ & 0x3F));
+			}
+			else
+			{
+				out_ += static_cast<char>(0xE0 | (code_ >> 12));
+				out_ += static_cast<char>(0x80 | ((code_ >> 6) & 0x3F));
+				out_ += static_cast<char>(0x80 | (code_ & 0x3F));
+			}
+		}
+
+		std::string ParseString()
+		{
+			Expect('"');
+			std::string result;
+			while (m_p < m_end && *m_p != '"')
+			{
+				char c = *m_p++;
+				if (c != '\\')
+				{
+					result += c;
+					continue;
+				}
+				if (m_p >= m_end)
+					break;
+				char escape = *m_p++;
+				switch (escape)
+				{
+				case 'b': result += '\b'; break;
+				case 'f': result += '\f'; break;
+				case 'n': result += '\n'; break;
+				case 'r': result += '\r'; break;
+				case 't': result += '\t'; break;
+				case 'u':
+					if (m_end - m_p < 4)
+						throw std::runtime_error("Malformed glTF JSON string escape");
+					AppendUtf8(result, static_cast<uint32_t>(std::strtoul(std::string(m_p, 4).c_str(), nullptr, 16)));
+					m_p += 4;
+					break;
+				default: result += escape; break;
+				}
+			}
+			Expect('"');
+			return result;
+		}
+
+	public:
+		JsonParser(const char* begin_, const char* end_) : m_p(begin_), m_end(end_) {}
+
+		JsonValue Parse()
+		{
+			SkipWhitespace();
+			if (m_p >= m_end)
+				throw std::runtime_error("Unexpected end of glTF JSON");
+
+			JsonValue value;
+			if (*m_p == '{')
+			{
+				value.type = JsonValue::Object;
+				m_p++;
+				SkipWhitespace();
+				if (m_p < m_end && *m_p == '}')
+				{
+					m_p++;
+					return value;
+				}
+				do
+				{
+					std::string key = ParseString();
+					Expect(':');
+					value.object.emplace_back(std::move(key), Parse());
+					SkipWhitespace();
+				} while (m_p < m_end && *m_p == ',' && ++m_p);
+				Expect('}');
+			}
+			else if (*m_p == '[')
+			{
+				value.type = JsonValue::Array;
+				m_p++;
+				SkipWhitespace();
+				if (m_p < m_end && *m_p == ']')
+				{
+					m_p++;
+					return value;
+				}
+				do
+				{
+					value.array.push_back(Parse());
+					SkipWhitespace();
+				} while (m_p < m_end && *m_p == ',' && ++m_p);
+				Expect(']');
+			}
+			else if (*m_p == '"')
+			{
+				value.type = JsonValue::String;
+				value.string = ParseString();
+			}
+			else if (Consume("true"))
+			{
+				value.type = JsonValue::Bool;
+				value.boolean = true;
+			}
+			else if (Consume("false"))
+				value.type = JsonValue::Bool;
+			else if (Consume("null"))
+				value.type = JsonValue::Null;
+			else
+			{
+				char* next = nullptr;
+				value.type = JsonValue::Number;
+				value.number = std::strtod(m_p, &next);
+				if (next == m_p)
+					throw std::runtime_error("Malformed glTF JSON value");
+				m_p = next;
+			}
+			return value;
+		}
+	};
+
+	std::vector<uint8_t> DecodeBase64(const std::string& text_, size_t begin_)
+	{
+		auto Value = [](char c_) -> int
+		{
+			if (c_ >= 'A' && c_ <= 'Z') return c_ - 'A';
+			if (c_ >= 'a' && c_ <= 'z') return c_ - 'a' + 26;
+			if (c_ >= '0' && c_ <= '9') return c_ - '0' + 52;
+			if (c_ == '+' || c_ == '-') return 62;
+			if (c_ == '/' || c_ == '_') return 63;
+			return -1;
+		};
+
+		std::vector<uint8_t> data;
+		data.reserve((text_.size() - begin_) * 3 / 4);
+		uint32_t bits = 0;
+		int bit_count = 0;
+		for (size_t i = begin_; i < text_.size(); i++)
+		{
+			int value = Value(text_[i]);
+			if (value < 0)
+				continue; // Padding and whitespace
+			bits = (bits << 6) | static_cast<uint32_t>(value);
+			bit_count += 6;
+			if (bit_count >= 8)
+			{
+				bit_count -= 8;
+				data.push_back(static_cast<uint8_t>(bits >> bit_count));
+			}
+		}
+		return data;
+	}
+
+	struct GltfDocument
+	{
+		JsonValue json;
+		std::vector<std::vector<uint8_t>> buffers;
+	};
+
+	uint32_t ComponentCount(const std::string& type_)
+	{
+		if (type_ == "SCALAR") return 1;
+		if (type_ == "VEC2") return 2;
+		if (type_ == "VEC3") return 3;
+		if (type_ == "VEC4") return 4;
+		throw std::runtime_error("Unsupported glTF accessor type " + type_);
+	}
+
+	uint32_t ComponentSize(int component_type_)
+	{
+		switch (component_type_)
+		{
+		case 5120: case 5121: return 1; // BYTE, UNSIGNED_BYTE
+		case 5122: case 5123: return 2; // SHORT, UNSIGNED_SHORT
+		case 5125: case 5126: return 4; // UNSIGNED_INT, FLOAT
+		default: throw std::runtime_error("Unsupported glTF component type " + std::to_string(component_type_));
+		}
+	}
+
+	float ReadComponent(const uint8_t* data_, int component_type_, bool normalized_)
+	{
+		switch (component_type_)
+		{
+		case 5120: { int8_t v; std::memcpy(&v, data_, 1); return normalized_ ? std::max(v / 127.0f, -1.0f) : v; }
+		case 5121: { uint8_t v = *data_; return normalized_ ? v / 255.0f : v; }
+		case 5122: { int16_t v; std::memcpy(&v, data_, 2); return normalized_ ? std::max(v / 32767.0f, -1.0f) : v; }
+		case 5123: { uint16_t v; std::memcpy(&v, data_, 2); return normalized_ ? v / 65535.0f : v; }
+		case 5125: { uint32_t v; std::memcpy(&v, data_, 4); return static_cast<float>(v); }
+		default: { float v; std::memcpy(&v, data_, 4); return v; }
+		}
+	}
+
+	// Calls visit_(index, value, component count) for every element of an accessor, missing components are zero
+	template<typename Visit>
+	void ReadAccessor(const GltfDocument& document_, size_t accessor_index_, Visit visit_)
+	{
+		const JsonValue& accessor = document_.json.At("accessors").At(accessor_index_);
+		if (accessor.Find("sparse") != nullptr)
+			throw std::runtime_error("Sparse glTF accessors are not supported");
+
+		size_t count = static_cast<size_t>(accessor.At("count").number);
+		int component_type = static_cast<int>(accessor.At("componentType").number);
+		uint32_t components = ComponentCount(accessor.At("type").string);
+		uint32_t component_size = ComponentSize(component_type);
+		const JsonValue* normalized = accessor.Find("normalized");
+		bool is_normalized = normalized != nullptr && normalized->boolean;
+
+		const JsonValue* view_index = accessor.Find("bufferView");
+		if (view_index == nullptr)
+		{
+			// No data, every element is zero
+			for (size_t i = 0; i < count; i++)
+				visit_(i, glm::vec4(0.0f), components);
+			return;
+		}
+
+		const JsonValue& view = document_.json.At("bufferViews").At(static_cast<size_t>(view_index->number));
+		size_t buffer_index = static_cast<size_t>(view.At("buffer").number);
+		if (buffer_index >= document_.buffers.size())
+			throw std::runtime_error("glTF buffer view references a missing buffer");
+		const std::vector<uint8_t>& buffer = document_.buffers[buffer_index];
+
+		size_t offset = static_cast<size_t>(view.NumberOr("byteOffset", 0.0) + accessor.NumberOr("byteOffset", 0.0));
+		size_t element_size = components * component_size;
+		size_t stride = static_cast<size_t>(view.NumberOr("byteStride", static_cast<double>(element_size)));
+		if (count > 0 && offset + (count - 1) * stride + element_size > buffer.size())
+			throw std::runtime_error("glTF accessor exceeds its buffer");
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint8_t* element = buffer.data() + offset + i * stride;
+			glm::vec4 value(0.0f);
+			for (uint32_t c = 0; c < components; c++)
+				value[c] = ReadComponent(element + c * component_size, component_type, is_normalized);
+			visit_(i, value, components);
+		}
+	}
+
+	GltfDocument LoadGltf(const std::string& file_name_)
+	{
+		GltfDocument document;
+		std::string data = ReadFile(file_name_);
+		std::vector<uint8_t> binary_chunk;
+		bool has_binary_chunk = false;
+
+		if (Extension(file_name_) == "glb")
+		{
+			// 12 byte header, then a JSON chunk and an optional BIN chunk
+			uint32_t header[3];
+			if (data.size() < sizeof(header))
+				throw std::runtime_error("GLB file is too small");
+			std::memcpy(header, data.data(), sizeof(header));
+			if (header[0] != 0x46546C67 || header[1] != 2)
+				throw std::runtime_error("Not a glTF 2.0 binary file");
+
+			size_t offset = sizeof(header);
+			std::string json;
+			while (offset + 8 <= data.size())
+			{
+				uint32_t chunk[2];
+				std::memcpy(chunk, data.data() + offset, sizeof(chunk));
+				offset += sizeof(chunk);
+				if (offset + chunk[0] > data.size())
+					throw std::runtime_error("GLB chunk exceeds the file");
+				if (chunk[1] == 0x4E4F534A) // JSON
+					json.assign(data.data() + offset, chunk[0]);
+				else if (chunk[1] == 0x004E4942) // BIN
+				{
+					binary_chunk.assign(data.begin() + offset, data.begin() + offset + chunk[0]);
+					has_binary_chunk = true;
+				}
+				offset += chunk[0];
+			}
+			data = std::move(json);
+		}
+
+		document.json = JsonParser(data.data(), data.data() + data.size()).Parse();
+
+		const JsonValue* buffers = document.json.Find("buffers");
+		if (buffers == nullptr)
+			return document;
+
+		for (const auto& buffer : buffers->array)
+		{
+			const JsonValue* uri = buffer.Find("uri");
+			if (uri == nullptr)
+			{
+				if (!has_binary_chunk)
+					throw std::runtime_error("glTF buffer without uri outside of a GLB file");
+				document.buffers.push_back(binary_chunk);
+			}
+			else if (uri->string.compare(0, 5, "data:") == 0)
+			{
+				size_t comma = uri->string.find(',');
+				if (comma == std::string::npos || uri->string.find(";base64") > comma)
+					throw std::runtime_error("Only base64 data URIs are supported in glTF buffers");
+				document.buffers.push_back(DecodeBase64(uri->string, comma + 1));
+			}
+			else
+			{
+				std::string content = ReadFile(Directory(file_name_) + uri->string);
+				document.buffers.emplace_back(content.begin(), content.end());
+			}
+		}
+		return document;
+	}
+
+	glm::mat4 NodeTransform(const JsonValue& node_)
+	{
+		const JsonValue* matrix = node_.Find("matrix");
+		if (matrix != nullptr && matrix->array.size() == 16)
+		{
+			float values[16];
+			for (size_t i = 0; i < 16; i++)
+				values[i] = static_cast<float>(matrix->array[i].number);
+			return glm::make_mat4(values); // Column major like glTF
+		}
+
+		glm::vec3 translation(0.0f);
+		glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 scale(1.0f);
+		if (const JsonValue* t = node_.Find("translation"))
+			translation = glm::vec3(t->At(0).number, t->At(1).number, t->At(2).number);
+		if (const JsonValue* r = node_.Find("rotation"))
+			rotation = glm::quat(static_cast<float>(r->At(3).number), static_cast<float>(r->At(0).number), static_cast<float>(r->At(1).number), static_cast<float>(r->At(2).number));
+		if (const JsonValue* s = node_.Find("scale"))
+			scale = glm::vec3(s->At(0).number, s->At(1).number, s->At(2).number);
+
+		glm::mat4 transform = glm::mat4_cast(rotation);
+		transform[0] *= scale.x;
+		transform[1] *= scale.y;
+		transform[2] *= scale.z;
+		transform[3] = glm::vec4(translation, 1.0f);
+		return transform;
+	}
+
+	void AppendPrimitive(const GltfDocument& document_, const JsonValue& primitive_, const glm::mat4& transform_, cooker::ImportedMesh& mesh_)
+	{
+		if (primitive_.NumberOr("mode", 4.0) != 4.0)
+			return; // Only triangle lists
+
+		static const std::pair<const char*, graphics::VertexSemantic> SEMANTICS[] =
+		{
+			{ "POSITION", graphics::SemanticPosition },
+			{ "NORMAL", graphics::SemanticNormal },
+			{ "TANGENT", graphics::SemanticTangent },
+			{ "COLOR_0", graphics::SemanticColor },
+			{ "TEXCOORD_0", graphics::SemanticTexCoord0 },
+			{ "TEXCOORD_1", graphics::SemanticTexCoord1 },
+		};
+
+		const JsonValue& attributes = primitive_.At("attributes");
+		const JsonValue* position = attributes.Find("POSITION");
+		if (position == nullptr)
+			return;
+
+		glm::mat3 normal_transform = glm::transpose(glm::inverse(glm::mat3(transform_)));
+		size_t base = mesh_.source.vertex_count;
+		size_t count = static_cast<size_t>(document_.json.At("accessors").At(static_cast<size_t>(position->number)).At("count").number);
+
+		for (const auto& semantic : SEMANTICS)
+		{
+			const JsonValue* accessor = attributes.Find(semantic.first);
+			if (accessor == nullptr)
+				continue;
+
+			// Earlier primitives without this attribute get defaults
+			std::vector<glm::vec4>& values = mesh_.source.attributes[semantic.second];
+			values.resize(base, DefaultValue(semantic.second));
+			values.resize(base + count, DefaultValue(semantic.second));
+
+			ReadAccessor(document_, static_cast<size_t>(accessor->number), [&](size_t i_, glm::vec4 value_, uint32_t components_)
+			{
+				if (i_ >= count)
+					return;
+				if (components_ < 4)
+					value_.w = DefaultValue(semantic.second).w;
+
+				if (semantic.second == graphics::SemanticPosition)
+					value_ = glm::vec4(glm::vec3(transform_ * glm::vec4(glm::vec3(value_), 1.0f)), 1.0f);
+				else if (semantic.second == graphics::SemanticNormal)
+					value_ = glm::vec4(glm::normalize(normal_transform * glm::vec3(value_)), 0.0f);
+				else if (semantic.second == graphics::SemanticTangent)
+					value_ = glm::vec4(glm::normalize(glm::mat3(transform_) * glm::vec3(value_)), value_.w);
+				values[base + i_] = value_;
+			});
+		}
+
+		size_t first_index = mesh_.indices.size();
+		if (const JsonValue* indices = primitive_.Find("indices"))
+		{
+			ReadAccessor(document_, static_cast<size_t>(indices->number), [&](size_t, glm::vec4 value_, uint32_t)
+			{
+				uint32_t index = static_cast<uint32_t>(value_.x);
+				if (index >= count)
+					throw std::runtime_error("glTF index exceeds the vertex count");
+				mesh_.indices.push_back(static_cast<uint32_t>(base) + index);
+			});
+		}
+		else
+		{
+			for (size_t i = 0; i < count; i++)
+				mesh_.indices.push_back(static_cast<uint32_t>(base + i));
+		}
+
+		// Mirroring transforms flip the winding
+		if (glm::determinant(glm::mat3(transform_)) < 0.0f)
+			for (size_t i = first_index; i + 2 < mesh_.indices.size(); i += 3)
+				std::swap(mesh_.indices[i + 1], mesh_.indices[i + 2]);
+
+		mesh_.source.vertex_count = base + count;
+	}
+
+	void AppendNode(const GltfDocument& document_, size_t node_index_, const glm::mat4& parent_, cooker::ImportedMesh& mesh_, int depth_)
+	{
+		if (depth_ > 64)
+			throw std::runtime_error("glTF node hierarchy is too deep or cyclic");
+
+		const JsonValue& node = document_.json.At("nodes").At(node_index_);
+		glm::mat4 transform = parent_ * NodeTransform(node);
+
+		if (const JsonValue* mesh = node.Find("mesh"))
+			for (const auto& primitive : document_.json.At("meshes").At(static_cast<size_t>(mesh->number)).At("primitives").array)
+				AppendPrimitive(document_, primitive, transform, mesh_);
+
+		if (const JsonValue* children = node.Find("children"))
+			for (const auto& child : children->array)
+				AppendNode(document_, static_cast<size_t>(child.number), transform, mesh_, depth_ + 1);
+	}
+}
+
+cooker::ImportedMesh cooker::ImportObj(const std::string& file_name_)
+{
+	std::string data = ReadFile(file_name_);
+	const char* p = data.data();
+	const char* end = data.data() + data.size();
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec2> tex_coords;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners;
+	std::vector<uint32_t> face;
+	std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> corner_indices;
+
+	ImportedMesh mesh;
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		float values[6];
+		if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 2;
+			int count = ParseFloats(p, end, values, 6);
+			if (count < 3)
+				throw std::runtime_error("OBJ vertex with less than 3 coordinates");
+			positions.emplace_back(values[0], values[1], values[2]);
+			if (count == 6)
+			{
+				colors.resize(positions.size() - 1, glm::vec3(1.0f));
+				colors.emplace_back(values[3], values[4], values[5]);
+			}
+		}
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			p += 3;
+			values[1] = 0.0f;
+			ParseFloats(p, end, values, 3);
+			tex_coords.emplace_back(values[0], 1.0f - values[1]);
+		}
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			p += 3;
+			if (ParseFloats(p, end, values, 3) < 3)
+				throw std::runtime_error("OBJ normal with less than 3 components");
+			normals.emplace_back(values[0], values[1], values[2]);
+		}
+		else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 2;
+			face.clear();
+			while (true)
+			{
+				p = SkipSpaces(p, end);
+				if (p >= end || *p == '\n' || *p == '#')
+					break;
+
+				ObjCorner corner = { ParseObjIndex(p, static_cast<int>(positions.size())), 0, 0 };
+				if (p < end && *p == '/')
+				{
+					p++;
+					corner.tex_coord = ParseObjIndex(p, static_cast<int>(tex_coords.size()));
+					if (p < end && *p == '/')
+					{
+						p++;
+						corner.normal = ParseObjIndex(p, static_cast<int>(normals.size()));
+					}
+				}
+
+				auto inserted = corner_indices.emplace(corner, static_cast<uint32_t>(corners.size()));
+				if (inserted.second)
+					corners.push_back(corner);
+				face.push_back(inserted.first->second);
+			}
+
+			for (size_t i = 2; i < face.size(); i++)
+			{
+				mesh.indices.push_back(face[0]);
+				mesh.indices.push_back(face[i - 1]);
+				mesh.indices.push_back(face[i]);
+			}
+		}
+
+		// Rest of the line, comments and unsupported statements included
+		while (p < end && *p != '\n')
+			p++;
+		p++;
+	}
+
+	bool has_tex_coords = false;
+	bool has_normals = false;
+	for (const auto& corner : corners)
+	{
+		has_tex_coords |= corner.tex_coord != 0;
+		has_normals |= corner.normal != 0;
+	}
+	if (!colors.empty())
+		colors.resize(positions.size(), glm::vec3(1.0f));
+
+	auto& attributes = mesh.source.attributes;
+	mesh.source.vertex_count = corners.size();
+	for (const auto& corner : corners)
+	{
+		attributes[graphics::SemanticPosition].emplace_back(positions[corner.position - 1], 1.0f);
+		if (!colors.empty())
+			attributes[graphics::SemanticColor].emplace_back(colors[corner.position - 1], 1.0f);
+		if (has_tex_coords)
+			attributes[graphics::SemanticTexCoord0].emplace_back(corner.tex_coord != 0 ? tex_coords[corner.tex_coord - 1] : glm::vec2(0.0f), 0.0f, 0.0f);
+		if (has_normals)
+			attributes[graphics::SemanticNormal].emplace_back(corner.normal != 0 ? normals[corner.normal - 1] : glm::vec3(0.0f), 0.0f);
+	}
+	return mesh;
+}
+
+cooker::ImportedMesh cooker::ImportGltf(const std::string& file_name_)
+{
+	GltfDocument document = LoadGltf(file_name_);
+	ImportedMesh mesh;
+
+	const JsonValue* scenes = document.json.Find("scenes");
+	if (scenes != nullptr && !scenes->array.empty())
+	{
+		size_t scene = static_cast<size_t>(document.json.NumberOr("scene", 0.0));
+		if (const JsonValue* nodes = scenes->At(scene).Find("nodes"))
+			for (const auto& node : nodes->array)
+				AppendNode(document, static_cast<size_t>(node.number), glm::mat4(1.0f), mesh, 0);
+	}
+	else if (const JsonValue* meshes = document.json.Find("meshes"))
+	{
+		// No scene, take every mesh untransformed
+		for (const auto& gltf_mesh : meshes->array)
+			for (const auto& primitive : gltf_mesh.At("primitives").array)
+				AppendPrimitive(document, primitive, glm::mat4(1.0f), mesh);
+	}
+
+	for (size_t semantic = 0; semantic < graphics::SemanticCount; semantic++)
+		if (!mesh.source.attributes[semantic].empty())
+			mesh.source.attributes[semantic].resize(mesh.source.vertex_count, DefaultValue(static_cast<graphics::VertexSemantic>(semantic)));
+
+	if (mesh.indices.empty())
+		throw std::runtime_error("glTF file has no triangle primitives: " + file_name_);
+	return mesh;
+}
+
+cooker::ImportedMesh cooker::ImportMesh(const std::string& file_name_)
+{
+	std::string extension = Extension(file_name_);
+	if (extension == "obj")
+		return ImportObj(file_name_);
+	if (extension == "gltf" || extension == "glb")
+		return ImportGltf(file_name_);
+	throw std::runtime_error("Unsupported mesh file type: " + file_name_);
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "graphics/GraphicsVertex.h"
+
+namespace cooker
+{
+	// Triangle list as read from the source file, vertices may still be duplicated
+	struct ImportedMesh
+	{
+		graphics::VertexSource source;
+		std::vector<uint32_t> indices;
+	};
+
+	// Positions, texture coordinates, normals and the common "v x y z r g b" color extension.
+	// Polygons are triangulated as fans, texture coordinates are flipped to a top left origin
+	ImportedMesh ImportObj(const std::string& file_name_);
+
+	// .gltf with external or base64 buffers and .glb. Every triangle primitive of the default scene
+	// is merged into one mesh with the node transforms applied, sparse accessors are not supported
+	ImportedMesh ImportGltf(const std::string& file_name_);
+
+	// Picks the importer by file extension, throws for unknown extensions
+	ImportedMesh ImportMesh(const std::string& file_name_);
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "graphics/GraphicsMesh.h"
+#include "memory/MemoryMappedFile.h"
+#include "CookerImport.h"
+#include "CookerOptimize.h"
+
+namespace
+{
+	volatile size_t g_benchmark_sink = 0; // Keeps the benchmarked work from being optimized away
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: MeshCooker <input.obj|.gltf|.glb> <output.mesh> [options]\n"
+			<< "  --layout basic|standard|precise  Vertex layout, basic is the only one the engine loads (default basic)\n"
+			<< "  --lods <count>                   Lods including the full detail one (default 4)\n"
+			<< "  --lod-ratio <ratio>              Triangles of a lod relative to the previous one (default 0.5)\n"
+			<< "  --index-size 16|32|auto          Stored index size, auto picks 16 bit when the vertex count allows it (default auto)\n"
+			<< "  --no-optimize                    Keep the imported triangle and vertex order\n"
+			<< "  --benchmark <runs>               Compare parsing the input against loading the cooked file\n";
+	}
+
+	graphics::VertexLayout LayoutByName(const std::string& name_)
+	{
+		using namespace graphics;
+		VertexLayout layout;
+		if (name_ == "basic")
+			return BasicLayout();
+		if (name_ == "standard") // Positions alone in stream 0 for depth only passes
+			return layout.Add(SemanticPosition, FormatHalf4, 0).Add(SemanticNormal, FormatOctahedral16, 1).Add(SemanticTexCoord0, FormatHalf2, 1).Add(SemanticColor, FormatUnorm8x4, 1);
+		if (name_ == "precise")
+			return layout.Add(SemanticPosition, FormatFloat3, 0).Add(SemanticNormal, FormatOctahedral16, 1).Add(SemanticTexCoord0, FormatFloat2, 1).Add(SemanticColor, FormatUnorm8x4, 1);
+		throw std::runtime_error("Unknown vertex layout " + name_);
+	}
+
+	double ElapsedMs(std::chrono::steady_clock::time_point start_)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+	}
+
+	template<typename Function>
+	double MedianMs(size_t runs_, Function function_)
+	{
+		std::vector<double> times;
+		for (size_t i = 0; i < runs_; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			function_();
+			times.push_back(ElapsedMs(start));
+		}
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	// Both sides end with the vertex and index data in memory ready for a staging copy, the file cache is warm
+	void RunBenchmark(const std::string& input_, const std::string& output_, size_t runs_)
+	{
+		double parse_ms = MedianMs(runs_, [&]()
+		{
+			cooker::ImportedMesh mesh = cooker::ImportMesh(input_);
+			g_benchmark_sink = mesh.indices.size();
+		});
+
+		std::vector<uint8_t> staging;
+		double load_ms = MedianMs(runs_, [&]()
+		{
+			memory::MappedFile file(output_);
+			graphics::MeshView view = graphics::ReadMeshFile(file.Data(), file.Size());
+			size_t vertex_bytes = static_cast<size_t>(view.header->vertex_bytes);
+			size_t index_bytes = static_cast<size_t>(view.header->index_bytes);
+			staging.resize(vertex_bytes + index_bytes);
+			std::memcpy(staging.data(), view.vertex_data, vertex_bytes);
+			std::memcpy(staging.data() + vertex_bytes, view.index_data, index_bytes);
+			g_benchmark_sink = staging[staging.size() / 2];
+		});
+
+		std::cout << "Benchmark (median of " << runs_ << " runs)\n"
+			<< "  parse " << input_ << ": " << parse_ms << " ms\n"
+			<< "  map and copy " << output_ << ": " << load_ms << " ms\n"
+			<< "  speedup: " << parse_ms / load_ms << "x" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	try
+	{
+		std::string input = argv[1];
+		std::string output = argv[2];
+		cooker::CookSettings settings;
+		settings.layout = LayoutByName("basic"); // The only layout the engine's pipeline loads
+		uint32_t index_size = 0;
+		size_t benchmark_runs = 0;
+
+		for (int i = 3; i < argc; i++)
+		{
+			std::string option = argv[i];
+			bool has_value = i + 1 < argc;
+			if (option == "--layout" && has_value)
+				settings.layout = LayoutByName(argv[++i]);
+			else if (option == "--lods" && has_value)
+				settings.max_lods = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else if (option == "--lod-ratio" && has_value)
+				settings.lod_ratio = std::stof(argv[++i]);
+			else if (option == "--index-size" && has_value)
+			{
+				std::string size = argv[++i];
+				index_size = size == "16" ? 2 : size == "32" ? 4 : 0;
+				if (index_size == 0 && size != "auto")
+					throw std::runtime_error("Unknown index size " + size);
+			}
+			else if (option == "--no-optimize")
+				settings.optimize = false;
+			else if (option == "--benchmark" && has_value)
+				benchmark_runs = std::stoul(argv[++i]);
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		cooker::ImportedMesh mesh = cooker::ImportMesh(input);
+		double import_ms = ElapsedMs(start);
+
+		if (settings.layout.Find(graphics::SemanticNormal) != nullptr && mesh.source.attributes[graphics::SemanticNormal].empty())
+			cooker::GenerateNormals(mesh);
+
+		start = std::chrono::steady_clock::now();
+		cooker::CookStats stats;
+		cooker::CookedMesh cooked = cooker::CookMesh(mesh, settings, &stats);
+		double cook_ms = ElapsedMs(start);
+
+		std::vector<uint8_t> file = graphics::WriteMeshFile(settings.layout, cooked.vertices, cooked.vertex_count, cooked.indices, cooked.lods, cooked.bounds, index_size);
+		std::ofstream output_file(output, std::ios::binary);
+		if (!output_file.write(reinterpret_cast<const char*>(file.data()), file.size()))
+			throw std::runtime_error("Unable to write " + output);
+		output_file.close();
+
+		std::cout << input << ": " << stats.imported_vertices << " vertices, " << mesh.indices.size() / 3 << " triangles, imported in " << import_ms << " ms\n"
+			<< "  welded to " << stats.welded_vertices << " vertices, " << stats.degenerate_triangles << " degenerate triangles removed\n"
+			<< "  ACMR " << stats.acmr_before << " -> " << stats.acmr_after << "\n";
+		for (size_t lod = 0; lod < cooked.lods.size(); lod++)
+			std::cout << "  lod " << lod << ": " << cooked.lods[lod].index_count / 3 << " triangles, error " << cooked.lods[lod].error << "\n";
+		std::cout << output << ": " << cooked.vertex_count << " vertices of " << settings.layout.VertexSize() << " bytes, "
+			<< file.size() << " bytes, cooked in " << cook_ms << " ms" << std::endl;
+
+		if (benchmark_runs > 0)
+			RunBenchmark(input, output, benchmark_runs);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "MeshCooker failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,547 @@
+#include "CookerOptimize.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+	constexpr uint32_t NO_INDEX = 0xFFFFFFFF;
+	constexpr uint32_t MAX_CLUSTER_GRID = 1024; // Cells per axis of the finest clustering grid
+
+	struct TriangleKey
+	{
+		uint32_t a;
+		uint32_t b;
+		uint32_t c;
+
+		bool operator==(const TriangleKey& other_) const { return a == other_.a && b == other_.b && c == other_.c; }
+	};
+
+	struct TriangleKeyHash
+	{
+		size_t operator()(const TriangleKey& key_) const
+		{
+			return (static_cast<size_t>(key_.a) * 73856093) ^ (static_cast<size_t>(key_.b) * 19349663) ^ (static_cast<size_t>(key_.c) * 83492791);
+		}
+	};
+
+	struct PositionKey
+	{
+		glm::vec3 position;
+
+		bool operator==(const PositionKey& other_) const { return position == other_.position; }
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key_) const
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &key_.position, sizeof(bits));
+			return (static_cast<size_t>(bits[0]) * 73856093) ^ (static_cast<size_t>(bits[1]) * 19349663) ^ (static_cast<size_t>(bits[2]) * 83492791);
+		}
+	};
+
+	uint64_t HashBytes(const uint8_t* data_, size_t size_)
+	{
+		uint64_t hash = 14695981039346656037ull; // FNV-1a
+		for (size_t i = 0; i < size_; i++)
+			hash = (hash ^ data_[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	float VertexScore(int32_t cache_position_, uint32_t remaining_triangles_)
+	{
+		if (remaining_triangles_ == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cache_position_ >= 0)
+		{
+			// The last triangle's vertices get a fixed score so the next triangle does not just reuse them
+			if (cache_position_ < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - (cache_position_ - 3) / static_cast<float>(cooker::VERTEX_CACHE_SIZE - 3), 1.5f);
+		}
+
+		// Vertices with few triangles left are finished first
+		return score + 2.0f / std::sqrt(static_cast<float>(remaining_triangles_));
+	}
+}
+
+void cooker::GenerateNormals(ImportedMesh& mesh_)
+{
+	const std::vector<glm::vec4>& positions = mesh_.source.attributes[graphics::SemanticPosition];
+	std::unordered_map<PositionKey, uint32_t, PositionKeyHash> groups;
+	std::vector<uint32_t> group_of(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+		group_of[i] = groups.emplace(PositionKey{ glm::vec3(positions[i]) }, static_cast<uint32_t>(groups.size())).first->second;
+
+	// The cross product length is twice the area, larger triangles weigh more
+	std::vector<glm::vec3> sums(groups.size(), glm::vec3(0.0f));
+	for (size_t i = 0; i + 2 < mesh_.indices.size(); i += 3)
+	{
+		glm::vec3 a = positions[mesh_.indices[i]];
+		glm::vec3 b = positions[mesh_.indices[i + 1]];
+		glm::vec3 c = positions[mesh_.indices[i + 2]];
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		for (size_t k = 0; k < 3; k++)
+			sums[group_of[mesh_.indices[i + k]]] += normal;
+	}
+
+	std::vector<glm::vec4>& normals = mesh_.source.attributes[graphics::SemanticNormal];
+	normals.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		glm::vec3 sum = sums[group_of[i]];
+		float length = glm::length(sum);
+		normals[i] = glm::vec4(length > 0.0f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f), 0.0f);
+	}
+}
+
+cooker::CookedMesh cooker::CookMesh(const ImportedMesh& mesh_, const CookSettings& settings_, CookStats* stats_)
+{
+	const graphics::VertexLayout& layout = settings_.layout;
+	const std::vector<glm::vec4>& source_positions = mesh_.source.attributes[graphics::SemanticPosition];
+	if (source_positions.size() != mesh_.source.vertex_count)
+		throw std::runtime_error("Mesh has no positions");
+	for (uint32_t index : mesh_.indices)
+		if (index >= mesh_.source.vertex_count)
+			throw std::runtime_error("Mesh index " + std::to_string(index) + " exceeds the vertex count");
+
+	graphics::EncodedVertices encoded = graphics::EncodeVertices(layout, mesh_.source);
+	size_t vertex_count = mesh_.source.vertex_count;
+	size_t vertex_size = layout.VertexSize();
+
+	// Every vertex over all streams in one row, the key for welding
+	std::vector<uint8_t> rows(vertex_count * vertex_size);
+	for (size_t vertex = 0; vertex < vertex_count; vertex++)
+	{
+		size_t offset = 0;
+		for (uint32_t stream = 0; stream < layout.StreamCount(); stream++)
+		{
+			size_t stride = layout.Stride(stream);
+			std::memcpy(rows.data() + vertex * vertex_size + offset, encoded.data.data() + encoded.stream_offsets[stream] + vertex * stride, stride);
+			offset += stride;
+		}
+	}
+
+	// Welding compares the encoded bytes, vertices that only differed below the format's precision merge too
+	size_t table_size = 1;
+	while (table_size < vertex_count * 2)
+		table_size *= 2;
+	std::vector<uint32_t> table(table_size, NO_INDEX);
+	std::vector<uint32_t> remap(vertex_count);
+	std::vector<uint32_t> unique; // Source vertex of every welded vertex
+	for (size_t vertex = 0; vertex < vertex_count; vertex++)
+	{
+		const uint8_t* row = rows.data() + vertex * vertex_size;
+		size_t slot = HashBytes(row, vertex_size) & (table_size - 1);
+		while (table[slot] != NO_INDEX && std::memcmp(rows.data() + unique[table[slot]] * vertex_size, row, vertex_size) != 0)
+			slot = (slot + 1) & (table_size - 1);
+
+		if (table[slot] == NO_INDEX)
+		{
+			table[slot] = static_cast<uint32_t>(unique.size());
+			unique.push_back(static_cast<uint32_t>(vertex));
+		}
+		remap[vertex] = table[slot];
+	}
+
+	std::vector<glm::vec3> positions(unique.size());
+	for (size_t i = 0; i < unique.size(); i++)
+		positions[i] = glm::vec3(source_positions[unique[i]]);
+
+	std::vector<std::vector<uint32_t>> lods(1);
+	std::vector<float> errors(1, 0.0f);
+	size_t degenerate = 0;
+	for (size_t i = 0; i + 2 < mesh_.indices.size(); i += 3)
+	{
+		uint32_t a = remap[mesh_.indices[i]];
+		uint32_t b = remap[mesh_.indices[i + 1]];
+		uint32_t c = remap[mesh_.indices[i + 2]];
+		if (a == b || b == c || a == c)
+		{
+			degenerate++;
+			continue;
+		}
+		lods[0].insert(lods[0].end(), { a, b, c });
+	}
+
+	if (stats_ != nullptr)
+	{
+		stats_->imported_vertices = vertex_count;
+		stats_->welded_vertices = unique.size();
+		stats_->degenerate_triangles = degenerate;
+		stats_->acmr_before = AverageCacheMissRatio(lods[0], unique.size());
+	}
+
+	if (settings_.optimize)
+		OptimizeVertexCache(lods[0], unique.size());
+
+	if (stats_ != nullptr)
+		stats_->acmr_after = AverageCacheMissRatio(lods[0], unique.size());
+
+	// Every lod is simplified from lod 0 so the errors do not add up
+	for (uint32_t lod = 1; lod < settings_.max_lods && lod < graphics::MAX_MESH_LODS; lod++)
+	{
+		size_t previous_triangles = lods.back().size() / 3;
+		size_t target = static_cast<size_t>(previous_triangles * settings_.lod_ratio);
+		if (target < MIN_LOD_TRIANGLES)
+			break;
+
+		float error = 0.0f;
+		std::vector<uint32_t> simplified = SimplifyClustered(positions, lods[0], target, error);
+		if (simplified.size() / 3 < MIN_LOD_TRIANGLES || simplified.size() / 3 > previous_triangles * 9 / 10)
+			break;
+
+		if (settings_.optimize)
+			OptimizeVertexCache(simplified, unique.size());
+		lods.push_back(std::move(simplified));
+		errors.push_back(error);
+	}
+
+	// Vertices in the order lod 0 first uses them, so fetches walk the vertex buffer forwards.
+	// Vertices no lod references are dropped
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> new_index(unique.size(), NO_INDEX);
+	if (!settings_.optimize)
+	{
+		for (uint32_t i = 0; i < unique.size(); i++)
+			new_index[i] = i;
+		order = new_index;
+	}
+	for (auto& lod : lods)
+	{
+		for (uint32_t& index : lod)
+		{
+			if (new_index[index] == NO_INDEX)
+			{
+				new_index[index] = static_cast<uint32_t>(order.size());
+				order.push_back(index);
+			}
+			index = new_index[index];
+		}
+	}
+
+	CookedMesh cooked;
+	cooked.vertex_count = static_cast<uint32_t>(order.size());
+
+	// A source without attributes only allocates the zeroed streams
+	graphics::VertexSource empty_source;
+	empty_source.vertex_count = order.size();
+	cooked.vertices = graphics::EncodeVertices(layout, empty_source);
+	for (uint32_t stream = 0; stream < layout.StreamCount(); stream++)
+	{
+		size_t stride = layout.Stride(stream);
+		const uint8_t* source = encoded.data.data() + encoded.stream_offsets[stream];
+		uint8_t* destination = cooked.vertices.data.data() + cooked.vertices.stream_offsets[stream];
+		for (size_t i = 0; i < order.size(); i++)
+			std::memcpy(destination + i * stride, source + unique[order[i]] * stride, stride);
+	}
+
+	std::vector<glm::vec3> final_positions(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		final_positions[i] = positions[order[i]];
+	cooked.bounds = ComputeBounds(final_positions);
+
+	for (size_t lod = 0; lod < lods.size(); lod++)
+	{
+		graphics::MeshLod range = {};
+		range.first_index = static_cast<uint32_t>(cooked.indices.size());
+		range.index_count = static_cast<uint32_t>(lods[lod].size());
+		range.error = errors[lod];
+		cooked.lods.push_back(range);
+		cooked.indices.insert(cooked.indices.end(), lods[lod].begin(), lods[lod].end());
+	}
+	return cooked;
+}
+
+void cooker::OptimizeVertexCache(std::vector<uint32_t>& indices_, size_t vertex_count_)
+{
+	size_t triangle_count = indices_.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	// Triangles of every vertex, the live ones first in every range
+	std::vector<uint32_t> offsets(vertex_count_ + 1, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+		offsets[indices_[i] + 1]++;
+	for (size_t vertex = 0; vertex < vertex_count_; vertex++)
+		offsets[vertex + 1] += offsets[vertex];
+
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	std::vector<uint32_t> remaining(vertex_count_, 0);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+	{
+		uint32_t vertex = indices_[i];
+		adjacency[offsets[vertex] + remaining[vertex]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int32_t> cache_position(vertex_count_, -1);
+	std::vector<float> vertex_score(vertex_count_);
+	for (size_t vertex = 0; vertex < vertex_count_; vertex++)
+		vertex_score[vertex] = VertexScore(-1, remaining[vertex]);
+
+	std::vector<float> triangle_score(triangle_count);
+	std::vector<uint8_t> emitted(triangle_count, 0);
+	uint32_t best = 0;
+	for (size_t triangle = 0; triangle < triangle_count; triangle++)
+	{
+		const uint32_t* corners = &indices_[triangle * 3];
+		triangle_score[triangle] = vertex_score[corners[0]] + vertex_score[corners[1]] + vertex_score[corners[2]];
+		if (triangle_score[triangle] > triangle_score[best])
+			best = static_cast<uint32_t>(triangle);
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+	std::array<uint32_t, VERTEX_CACHE_SIZE + 3> cache;
+	std::array<uint32_t, VERTEX_CACHE_SIZE + 3> new_cache;
+	size_t cache_size = 0;
+	size_t cursor = 0; // Fallback when no cached vertex has triangles left
+
+	while (output.size() < triangle_count * 3)
+	{
+		if (best == NO_INDEX)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = static_cast<uint32_t>(cursor);
+		}
+
+		const uint32_t* corners = &indices_[best * 3];
+		output.insert(output.end(), corners, corners + 3);
+		emitted[best] = 1;
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			uint32_t vertex = corners[k];
+			uint32_t* first = &adjacency[offsets[vertex]];
+			uint32_t* last = first + remaining[vertex] - 1;
+			std::iter_swap(std::find(first, last + 1, best), last);
+			remaining[vertex]--;
+		}
+
+		// Emitted vertices move to the front, everything else shifts back
+		size_t new_size = 0;
+		for (size_t k = 0; k < 3; k++)
+			new_cache[new_size++] = corners[k];
+		for (size_t i = 0; i < cache_size; i++)
+			if (cache[i] != corners[0] && cache[i] != corners[1] && cache[i] != corners[2])
+				new_cache[new_size++] = cache[i];
+
+		for (size_t i = 0; i < new_size; i++)
+		{
+			uint32_t vertex = new_cache[i];
+			cache_position[vertex] = i < VERTEX_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+			vertex_score[vertex] = VertexScore(cache_position[vertex], remaining[vertex]);
+		}
+
+		best = NO_INDEX;
+		float best_score = -1.0f;
+		for (size_t i = 0; i < new_size; i++)
+		{
+			uint32_t vertex = new_cache[i];
+			for (uint32_t t = offsets[vertex]; t < offsets[vertex] + remaining[vertex]; t++)
+			{
+				uint32_t triangle = adjacency[t];
+				const uint32_t* triangle_corners = &indices_[triangle * 3];
+				triangle_score[triangle] = vertex_score[triangle_corners[0]] + vertex_score[triangle_corners[1]] + vertex_score[triangle_corners[2]];
+				if (i < VERTEX_CACHE_SIZE && triangle_score[triangle] > best_score)
+				{
+					best_score = triangle_score[triangle];
+					best = triangle;
+				}
+			}
+		}
+
+		cache_size = std::min<size_t>(new_size, VERTEX_CACHE_SIZE);
+		std::copy(new_cache.begin(), new_cache.begin() + cache_size, cache.begin());
+	}
+
+	std::copy(output.begin(), output.end(), indices_.begin());
+}
+
+float cooker::AverageCacheMissRatio(const std::vector<uint32_t>& indices_, size_t vertex_count_, uint32_t cache_size_)
+{
+	if (indices_.size() < 3)
+		return 0.0f;
+
+	// A vertex is cached while fewer than cache_size_ misses happened since it was loaded
+	std::vector<uint32_t> loaded_at(vertex_count_, 0);
+	uint32_t misses = cache_size_ + 1;
+	for (uint32_t index : indices_)
+	{
+		if (misses - loaded_at[index] > cache_size_)
+			loaded_at[index] = misses++;
+	}
+	return static_cast<float>(misses - cache_size_ - 1) / (indices_.size() / 3);
+}
+
+std::vector<uint32_t> cooker::SimplifyClustered(
+	const std::vector<glm::vec3>& positions_,
+	const std::vector<uint32_t>& indices_,
+	size_t target_triangles_,
+	float& error_)
+{
+	error_ = 0.0f;
+	std::vector<uint8_t> used(positions_.size(), 0);
+	for (uint32_t index : indices_)
+		used[index] = 1;
+
+	glm::vec3 min(std::numeric_limits<float>::max());
+	glm::vec3 max(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < positions_.size(); i++)
+	{
+		if (!used[i])
+			continue;
+		min = glm::min(min, positions_[i]);
+		max = glm::max(max, positions_[i]);
+	}
+	float extent = glm::max(max.x - min.x, glm::max(max.y - min.y, max.z - min.z));
+	if (!(extent > 0.0f))
+		return {};
+
+	std::vector<uint32_t> cluster_of(positions_.size(), NO_INDEX);
+	auto Cluster = [&](uint32_t grid_, std::vector<uint32_t>& out_)
+	{
+		float cell_size = extent / grid_;
+		std::unordered_map<uint64_t, uint32_t> cells;
+		std::vector<glm::vec3> sums;
+		std::vector<uint32_t> counts;
+		for (size_t i = 0; i < positions_.size(); i++)
+		{
+			if (!used[i])
+				continue;
+			glm::uvec3 cell = glm::min(glm::uvec3((positions_[i] - min) / cell_size), glm::uvec3(grid_ - 1));
+			uint64_t key = cell.x | (static_cast<uint64_t>(cell.y) << 21) | (static_cast<uint64_t>(cell.z) << 42);
+			auto inserted = cells.emplace(key, static_cast<uint32_t>(sums.size()));
+			if (inserted.second)
+			{
+				sums.push_back(glm::vec3(0.0f));
+				counts.push_back(0);
+			}
+			cluster_of[i] = inserted.first->second;
+			sums[cluster_of[i]] += positions_[i];
+			counts[cluster_of[i]]++;
+		}
+
+		// The vertex closest to the cluster mean represents the cluster, its attributes are kept
+		std::vector<uint32_t> representative(sums.size(), NO_INDEX);
+		std::vector<float> distance(sums.size(), 0.0f);
+		for (size_t i = 0; i < positions_.size(); i++)
+		{
+			if (!used[i])
+				continue;
+			uint32_t cluster = cluster_of[i];
+			glm::vec3 offset = positions_[i] - sums[cluster] / static_cast<float>(counts[cluster]);
+			float d = glm::dot(offset, offset);
+			if (representative[cluster] == NO_INDEX || d < distance[cluster])
+			{
+				representative[cluster] = static_cast<uint32_t>(i);
+				distance[cluster] = d;
+			}
+		}
+
+		out_.clear();
+		std::unordered_set<TriangleKey, TriangleKeyHash> seen;
+		for (size_t i = 0; i + 2 < indices_.size(); i += 3)
+		{
+			uint32_t a = representative[cluster_of[indices_[i]]];
+			uint32_t b = representative[cluster_of[indices_[i + 1]]];
+			uint32_t c = representative[cluster_of[indices_[i + 2]]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			// Rotate the smallest index first, the winding stays the same
+			TriangleKey key = { a, b, c };
+			if (b < a && b < c)
+				key = { b, c, a };
+			else if (c < a && c < b)
+				key = { c, a, b };
+			if (seen.insert(key).second)
+				out_.insert(out_.end(), { a, b, c });
+		}
+	};
+
+	// Finer grids keep more triangles, find the finest one below the target
+	std::vector<uint32_t> result;
+	std::vector<uint32_t> candidate;
+	uint32_t low = 1;
+	uint32_t high = MAX_CLUSTER_GRID;
+	uint32_t best_grid = 0;
+	while (low <= high)
+	{
+		uint32_t grid = low + (high - low) / 2;
+		Cluster(grid, candidate);
+		if (candidate.size() / 3 <= target_triangles_)
+		{
+			result.swap(candidate);
+			best_grid = grid;
+			low = grid + 1;
+		}
+		else
+			high = grid - 1;
+	}
+
+	if (best_grid > 0)
+		error_ = extent / best_grid * std::sqrt(3.0f);
+	return result;
+}
+
+graphics::MeshBounds cooker::ComputeBounds(const std::vector<glm::vec3>& positions_)
+{
+	graphics::MeshBounds bounds = {};
+	if (positions_.empty())
+		return bounds;
+
+	bounds.min = positions_[0];
+	bounds.max = positions_[0];
+	for (const auto& position : positions_)
+	{
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+
+	// Ritter's sphere, grown over the points it misses
+	auto Farthest = [&](const glm::vec3& from_)
+	{
+		size_t farthest = 0;
+		for (size_t i = 1; i < positions_.size(); i++)
+			if (glm::distance(positions_[i], from_) > glm::distance(positions_[farthest], from_))
+				farthest = i;
+		return positions_[farthest];
+	};
+	glm::vec3 a = Farthest(positions_[0]);
+	glm::vec3 b = Farthest(a);
+	glm::vec3 center = (a + b) * 0.5f;
+	float radius = glm::distance(a, b) * 0.5f;
+	for (const auto& position : positions_)
+	{
+		float d = glm::distance(position, center);
+		if (d > radius)
+		{
+			float new_radius = (radius + d) * 0.5f;
+			center += (position - center) * ((new_radius - radius) / d);
+			radius = new_radius;
+		}
+	}
+
+	// Centering on the box is tighter for some shapes
+	glm::vec3 box_center = (bounds.min + bounds.max) * 0.5f;
+	float box_radius = 0.0f;
+	for (const auto& position : positions_)
+		box_radius = glm::max(box_radius, glm::distance(position, box_center));
+
+	bounds.sphere = box_radius < radius ? glm::vec4(box_center, box_radius) : glm::vec4(center, radius);
+	return bounds;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "graphics/GraphicsVertex.h"
+#include "graphics/GraphicsMesh.h"
+#include "CookerImport.h"
+
+namespace cooker
+{
+	constexpr uint32_t VERTEX_CACHE_SIZE = 32; // Entries of the cache the triangle order is optimized for
+	constexpr uint32_t MIN_LOD_TRIANGLES = 32; // Smaller lods are not worth an extra draw range
+
+	struct CookSettings
+	{
+		graphics::VertexLayout layout;
+		uint32_t max_lods = 4; // Including the full detail lod
+		float lod_ratio = 0.5f; // Triangles of every lod relative to the previous one
+		bool optimize = true; // Reorder triangles and vertices for the vertex cache and vertex fetch
+	};
+
+	struct CookStats
+	{
+		size_t imported_vertices = 0;
+		size_t welded_vertices = 0;
+		size_t degenerate_triangles = 0; // Removed after welding
+		float acmr_before = 0.0f; // Average cache miss ratio of lod 0 in a 16 entry FIFO cache
+		float acmr_after = 0.0f;
+	};
+
+	struct CookedMesh
+	{
+		graphics::EncodedVertices vertices;
+		uint32_t vertex_count = 0;
+		std::vector<uint32_t> indices; // Of every lod
+		std::vector<graphics::MeshLod> lods;
+		graphics::MeshBounds bounds = {};
+	};
+
+	// Area weighted smooth normals, corners at the same position share their normal
+	void GenerateNormals(ImportedMesh& mesh_);
+
+	// Welds vertices that encode to the same bytes, builds the lods and reorders everything for the GPU
+	CookedMesh CookMesh(const ImportedMesh& mesh_, const CookSettings& settings_, CookStats* stats_ = nullptr);
+
+	// Triangle order for a LRU cache of VERTEX_CACHE_SIZE entries (Forsyth's linear speed optimizer)
+	void OptimizeVertexCache(std::vector<uint32_t>& indices_, size_t vertex_count_);
+
+	// Transformed vertices per triangle with a FIFO post transform cache, 0.5 is the best a regular grid reaches
+	float AverageCacheMissRatio(const std::vector<uint32_t>& indices_, size_t vertex_count_, uint32_t cache_size_ = 16);
+
+	// Vertex clustering on a uniform grid, picks the finest grid that stays below target_triangles_.
+	// Indices keep referencing the original vertices, error_ receives the cell diagonal
+	std::vector<uint32_t> SimplifyClustered(
+		const std::vector<glm::vec3>& positions_,
+		const std::vector<uint32_t>& indices_,
+		size_t target_triangles_,
+		float& error_);
+
+	graphics::MeshBounds ComputeBounds(const std::vector<glm::vec3>& positions_);
+}
\ No newline at end of file